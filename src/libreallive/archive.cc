@@ -36,9 +36,14 @@
 #include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
 #include <cstring>
+#include <functional>
 #include <string>
+#include <utility>
 
+#include "libreallive/bytecode.h"
 #include "libreallive/compression.h"
+#include "libreallive/expression.h"
+#include "utilities/worker_pool.h"
 
 using boost::istarts_with;
 using boost::iends_with;
@@ -46,14 +51,60 @@ namespace fs = boost::filesystem;
 
 namespace libreallive {
 
+namespace {
+
+// Whether |command| transfers control to another scenario: jump, farcall and
+// farcall_with in either the Jmp (0:1) or Bra (0:6) module. All of them take
+// the target scenario as their first parameter.
+bool IsCrossScenarioJump(const CommandElement& command) {
+  if (command.modtype() != 0 ||
+      (command.module() != 1 && command.module() != 6))
+    return false;
+
+  return command.opcode() == 11 || command.opcode() == 12 ||
+         command.opcode() == 18;
+}
+
+// Adds every scenario that |scenario| jumps or farcalls to with a constant
+// scenario number to |targets|.
+void CollectJumpTargets(const Scenario& scenario, std::set<int>* targets) {
+  for (auto const& element : scenario) {
+    const CommandElement* command =
+        dynamic_cast<const CommandElement*>(element);
+    if (!command || !IsCrossScenarioJump(*command) ||
+        command->GetParamCount() == 0)
+      continue;
+
+    try {
+      std::string param = command->GetParam(0);
+      const char* src = param.c_str();
+      ExpressionPiece target = GetData(src);
+      if (target.IsIntegerConstant())
+        targets->insert(target.GetIntegerConstant());
+    }
+    catch (Error&) {
+      // Not worth prefetching if we can't read it; the interpreter will
+      // report the error if this command is ever reached.
+    }
+  }
+}
+
+}  // namespace
+
 Archive::Archive(const std::string& filename)
-    : name_(filename), info_(filename, Read), second_level_xor_key_(NULL) {
+    : cache_budget_(0),
+      prefetch_(false),
+      name_(filename),
+      info_(filename, Read),
+      second_level_xor_key_(NULL) {
   ReadTOC();
   ReadOverrides();
 }
 
 Archive::Archive(const std::string& filename, const std::string& regname)
-    : name_(filename),
+    : cache_budget_(0),
+      prefetch_(false),
+      name_(filename),
       info_(filename, Read),
       second_level_xor_key_(NULL),
       regname_(regname) {
@@ -92,20 +143,212 @@ Archive::Archive(const std::string& filename, const std::string& regname)
   }
 }
 
-Archive::~Archive() {}
+Archive::~Archive() {
+  // Make sure no worker is still writing into |accessed_|.
+  decode_pool_.reset();
+}
+
+Archive::PendingDecode::PendingDecode()
+    : started(false), done(promise.get_future().share()) {}
+
+Archive::PendingDecode::~PendingDecode() {}
 
 Scenario* Archive::GetScenario(int index) {
-  accessed_t::const_iterator at = accessed_.find(index);
-  if (at != accessed_.end())
-    return at->second.get();
-  scenarios_t::const_iterator st = scenarios_.find(index);
-  if (st != scenarios_.end()) {
-    Scenario* scene =
-        new Scenario(st->second, index, regname_, second_level_xor_key_);
-    accessed_[index].reset(scene);
-    return scene;
+  std::shared_ptr<PendingDecode> pending;
+  bool decode_here = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    accessed_t::iterator at = accessed_.find(index);
+    if (at != accessed_.end()) {
+      prefetch_stats_.hits++;
+      TouchLocked(at->second);
+      QueuePrefetchLocked(index);
+      return at->second.scenario.get();
+    }
+
+    pending_t::iterator pt = pending_.find(index);
+    if (pt != pending_.end()) {
+      pending = pt->second;
+    } else {
+      if (scenarios_.find(index) == scenarios_.end())
+        return NULL;
+      pending.reset(new PendingDecode);
+      pending_.emplace(index, pending);
+    }
+
+    // If the scenario is only queued, don't wait for the pool to get around
+    // to it.
+    if (!pending->started) {
+      pending->started = true;
+      decode_here = true;
+      prefetch_stats_.misses++;
+    } else {
+      prefetch_stats_.waits++;
+    }
+  }
+
+  if (decode_here)
+    DecodeScenario(index, pending);
+
+  // Rethrows any parse error from whichever thread did the decoding.
+  pending->done.get();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  accessed_t::iterator at = accessed_.find(index);
+  if (at == accessed_.end())
+    return NULL;
+  TouchLocked(at->second);
+  QueuePrefetchLocked(index);
+  return at->second.scenario.get();
+}
+
+void Archive::DecodeAllScenarios() {
+  for (auto const& entry : scenarios_)
+    GetScenario(entry.first);
+}
+
+void Archive::DecodeAllScenariosInBackground(int thread_count) {
+  EnsureDecodePool(thread_count);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto const& entry : scenarios_)
+    QueueDecodeLocked(entry.first);
+}
+
+void Archive::WaitForBackgroundDecoding() {
+  if (decode_pool_)
+    decode_pool_->WaitUntilIdle();
+}
+
+void Archive::EnablePrefetch(int thread_count) {
+  EnsureDecodePool(thread_count);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  prefetch_ = true;
+}
+
+Archive::PrefetchStats Archive::GetPrefetchStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return prefetch_stats_;
+}
+
+void Archive::TrimCache(const std::set<int>& pinned) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (cache_budget_ == 0)
+    return;
+
+  std::list<int>::iterator it = lru_.begin();
+  while (cache_stats_.bytes > cache_budget_ && it != lru_.end()) {
+    int index = *it++;
+    if (pinned.count(index))
+      continue;
+
+    accessed_t::iterator at = accessed_.find(index);
+    cache_stats_.bytes -= at->second.bytes;
+    cache_stats_.scenarios--;
+    cache_stats_.evictions++;
+    cache_stats_.evicted_bytes += at->second.bytes;
+    lru_.erase(at->second.lru_position);
+    accessed_.erase(at);
+
+    // Scan the jump targets again if the scenario is ever reloaded.
+    prefetched_from_.erase(index);
+  }
+}
+
+Archive::CacheStats Archive::GetCacheStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return cache_stats_;
+}
+
+void Archive::EnsureDecodePool(int thread_count) {
+  if (!decode_pool_)
+    decode_pool_.reset(new WorkerPool(thread_count));
+}
+
+void Archive::QueueDecodeLocked(int index) {
+  if (scenarios_.find(index) == scenarios_.end() ||
+      accessed_.find(index) != accessed_.end() ||
+      pending_.find(index) != pending_.end())
+    return;
+
+  pending_.emplace(index, std::make_shared<PendingDecode>());
+  decode_pool_->PostTask(std::bind(&Archive::RunQueuedDecode, this, index));
+}
+
+void Archive::RunQueuedDecode(int index) {
+  std::shared_ptr<PendingDecode> pending;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_t::iterator pt = pending_.find(index);
+    if (pt == pending_.end() || pt->second->started)
+      return;
+    pending = pt->second;
+    pending->started = true;
+  }
+
+  DecodeScenario(index, pending);
+}
+
+void Archive::QueuePrefetchLocked(int index) {
+  if (prefetch_ && prefetched_from_.insert(index).second) {
+    decode_pool_->PostTask(
+        std::bind(&Archive::PrefetchJumpTargets, this, index));
+  }
+}
+
+void Archive::PrefetchJumpTargets(int index) {
+  std::shared_ptr<const Scenario> scenario;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    accessed_t::const_iterator at = accessed_.find(index);
+    if (at == accessed_.end())
+      return;
+    scenario = at->second.scenario;
+  }
+
+  // The scan only reads each command's opcode and unparsed parameters, which
+  // never change once the scenario is published (unlike the interpreter's
+  // parsed parameter and operation caches). Our reference keeps the scenario
+  // alive even if it's evicted, so it can be scanned without the lock.
+  std::set<int> targets;
+  CollectJumpTargets(*scenario, &targets);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (int target : targets)
+    QueueDecodeLocked(target);
+}
+
+void Archive::TouchLocked(CachedScenario& entry) {
+  lru_.splice(lru_.end(), lru_, entry.lru_position);
+}
+
+void Archive::DecodeScenario(int index,
+                             const std::shared_ptr<PendingDecode>& pending) {
+  // |scenarios_| is only written during construction, so it's safe to read
+  // without the lock.
+  const FilePos& fp = scenarios_.find(index)->second;
+  try {
+    std::shared_ptr<Scenario> scene(
+        new Scenario(fp, index, regname_, second_level_xor_key_));
+    size_t bytes = scene->ApproximateMemoryUsage();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      CachedScenario& entry = accessed_[index];
+      entry.scenario = std::move(scene);
+      entry.bytes = bytes;
+      entry.lru_position = lru_.insert(lru_.end(), index);
+      cache_stats_.scenarios++;
+      cache_stats_.bytes += bytes;
+      pending_.erase(index);
+    }
+    pending->promise.set_value();
+  }
+  catch (...) {
+    // |pending| stays in |pending_|, so every later GetScenario() rethrows
+    // this error instead of parsing the scenario again.
+    pending->promise.set_exception(std::current_exception());
   }
-  return NULL;
 }
 
 int Archive::GetProbableEncodingType() const {
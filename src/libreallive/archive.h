@@ -34,8 +34,12 @@
 #ifndef SRC_LIBREALLIVE_ARCHIVE_H_
 #define SRC_LIBREALLIVE_ARCHIVE_H_
 
+#include <future>
+#include <list>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -43,6 +47,8 @@
 #include "libreallive/scenario.h"
 #include "libreallive/filemap.h"
 
+class WorkerPool;
+
 namespace libreallive {
 
 namespace compression {
@@ -64,23 +70,142 @@ class Archive {
   const_iterator begin() { return scenarios_.cbegin(); }
   const_iterator end() { return scenarios_.cend(); }
 
-  // Returns a specific scenario by |index| number or NULL if none exist.
+  // Returns a specific scenario by |index| number or NULL if none exist. If
+  // the scenario is being decoded in the background, blocks until it's ready.
+  // Throws the parse error if the scenario couldn't be decoded, on whichever
+  // thread that happened. The returned pointer stays valid until the scenario
+  // is evicted by TrimCache().
   Scenario* GetScenario(int index);
 
+  // Decodes every scenario in the table of contents on the calling thread.
+  void DecodeAllScenarios();
+
+  // Starts decoding every scenario in the table of contents on
+  // |thread_count| background threads and returns immediately. Scenarios are
+  // otherwise parsed lazily on first access, which can stall the interpreter
+  // on every jump to a cold SEEN.
+  void DecodeAllScenariosInBackground(int thread_count);
+
+  // Blocks until all background decoding has finished.
+  void WaitForBackgroundDecoding();
+
+  // Whenever a scenario is requested for the first time, queue the scenarios
+  // it can jump or farcall to (with constant arguments) for decoding on
+  // |thread_count| background threads.
+  void EnablePrefetch(int thread_count);
+
+  // How well background decoding is keeping ahead of the interpreter. A hit
+  // is a GetScenario() call that found its scenario already parsed, a wait is
+  // one that blocked on a background thread that was still parsing it, and a
+  // miss is one that had to parse the scenario synchronously.
+  struct PrefetchStats {
+    PrefetchStats() : hits(0), waits(0), misses(0) {}
+
+    int hits;
+    int waits;
+    int misses;
+  };
+  PrefetchStats GetPrefetchStats() const;
+
+  // Limits the memory used by parsed scenarios to roughly |bytes|. Zero (the
+  // default) means unlimited. The budget is only enforced by TrimCache().
+  void set_cache_budget(size_t bytes) { cache_budget_ = bytes; }
+
+  // Evicts least recently used scenarios until the cache fits in its budget.
+  // Scenarios whose numbers are in |pinned| are never evicted; the caller must
+  // pin everything it still holds pointers into.
+  void TrimCache(const std::set<int>& pinned);
+
+  struct CacheStats {
+    CacheStats()
+        : scenarios(0), bytes(0), evictions(0), evicted_bytes(0) {}
+
+    // Parsed scenarios currently held, and their approximate size.
+    size_t scenarios;
+    size_t bytes;
+
+    // Totals since the Archive was created.
+    int evictions;
+    size_t evicted_bytes;
+  };
+  CacheStats GetCacheStats() const;
+
   // Does a quick pass through all scenarios in the archive, looking for any
   // with non-default encoding. This short circuits when it finds one.
   int GetProbableEncodingType() const;
 
  private:
   typedef std::map<int, FilePos> scenarios_t;
-  typedef std::map<int, std::unique_ptr<Scenario>> accessed_t;
+
+  // A parsed scenario. It's reference counted so that background threads can
+  // keep reading it while the interpreter thread evicts it.
+  struct CachedScenario {
+    std::shared_ptr<Scenario> scenario;
+    size_t bytes;
+    std::list<int>::iterator lru_position;
+  };
+  typedef std::map<int, CachedScenario> accessed_t;
+
+  // Bookkeeping for a scenario that somebody has started (or queued) to
+  // decode. |started| is flipped by whichever thread gets to it first; the
+  // worker pool and GetScenario() can both claim a queued scenario.
+  struct PendingDecode {
+    PendingDecode();
+    ~PendingDecode();
+
+    bool started;
+    std::promise<void> promise;
+    std::shared_future<void> done;
+  };
+  typedef std::map<int, std::shared_ptr<PendingDecode>> pending_t;
+
+  // Queues |index| for decoding on |decode_pool_|. Must hold |mutex_|.
+  void QueueDecodeLocked(int index);
+
+  // Claims the queued scenario |index| for a worker thread and decodes it.
+  void RunQueuedDecode(int index);
+
+  // Creates |decode_pool_| if it doesn't already exist.
+  void EnsureDecodePool(int thread_count);
+
+  // If prefetching is enabled and |index| hasn't been seen before, posts
+  // PrefetchJumpTargets(|index|) to |decode_pool_|. Must hold |mutex_|.
+  void QueuePrefetchLocked(int index);
+
+  // Queues every scenario that the already decoded scenario |index| can jump
+  // to. Runs on |decode_pool_|.
+  void PrefetchJumpTargets(int index);
+
+  // Marks |entry| as the most recently used scenario. Must hold |mutex_|.
+  void TouchLocked(CachedScenario& entry);
+
+  // Parses scenario |index| on the calling thread and publishes it to
+  // |accessed_|. The caller must have claimed |pending|.
+  void DecodeScenario(int index, const std::shared_ptr<PendingDecode>& pending);
 
   void ReadTOC();
 
   void ReadOverrides();
 
   scenarios_t scenarios_;
+
+  // Guards |accessed_|, |pending_| and the prefetch and cache bookkeeping,
+  // which can be touched by background decoding threads.
+  mutable std::mutex mutex_;
   accessed_t accessed_;
+  pending_t pending_;
+
+  // Scenario numbers in |accessed_|, least recently used first.
+  std::list<int> lru_;
+  size_t cache_budget_;
+  CacheStats cache_stats_;
+
+  // Whether GetScenario() should prefetch jump targets, and the scenarios
+  // whose jump targets have already been queued.
+  bool prefetch_;
+  std::set<int> prefetched_from_;
+  PrefetchStats prefetch_stats_;
+
   string name_;
   Mapping info_;
 
@@ -94,6 +219,10 @@ class Archive {
   // The #REGNAME key from the Gameexe.ini file. Passed down to Scenario for
   // prettier error messages.
   std::string regname_;
+
+  // Threads that decode scenarios ahead of time. Declared last so it is
+  // destroyed (and its threads joined) before the data they touch.
+  std::unique_ptr<WorkerPool> decode_pool_;
 };
 
 }  // namespace libreallive
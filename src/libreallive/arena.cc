@@ -0,0 +1,81 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+
+#include "libreallive/arena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace libreallive {
+
+Arena::Arena()
+    : position_(NULL),
+      remaining_(0),
+      next_block_size_(kInitialBlockSize),
+      bytes_reserved_(0),
+      bytes_used_(0) {}
+
+Arena::~Arena() {}
+
+void Arena::Reserve(size_t size) {
+  if (size > remaining_)
+    AddBlock(size);
+}
+
+void* Arena::Allocate(size_t size, size_t alignment) {
+  // Oversized requests get a block of their own so we don't throw away the
+  // rest of the current one.
+  if (size > kMaxBlockSize / 4) {
+    blocks_.emplace_back(new char[size]);
+    bytes_reserved_ += size;
+    bytes_used_ += size;
+    return blocks_.back().get();
+  }
+
+  size_t padding = -reinterpret_cast<uintptr_t>(position_) & (alignment - 1);
+  if (padding + size > remaining_) {
+    AddBlock(std::max(next_block_size_, size));
+    if (next_block_size_ < kMaxBlockSize)
+      next_block_size_ *= 2;
+    padding = 0;
+  }
+
+  char* out = position_ + padding;
+  position_ = out + size;
+  remaining_ -= padding + size;
+  bytes_used_ += size;
+  return out;
+}
+
+void Arena::AddBlock(size_t size) {
+  blocks_.emplace_back(new char[size]);
+  position_ = blocks_.back().get();
+  remaining_ = size;
+  bytes_reserved_ += size;
+}
+
+}  // namespace libreallive
@@ -0,0 +1,130 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+
+#ifndef SRC_LIBREALLIVE_ARENA_H_
+#define SRC_LIBREALLIVE_ARENA_H_
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace libreallive {
+
+// A bump allocator for objects that live exactly as long as the Script that
+// parsed them. Memory is carved out of blocks that double in size up to
+// kMaxBlockSize, and is only returned when the Arena is destroyed; the owner
+// must run the destructors of anything it placement-new'd into the arena
+// itself.
+class Arena {
+ public:
+  static const size_t kInitialBlockSize = 256;
+  static const size_t kMaxBlockSize = 64 * 1024;
+
+  Arena();
+  ~Arena();
+
+  // Makes sure the current block has at least |size| free bytes, so callers
+  // that can estimate their total usage up front get a single block.
+  void Reserve(size_t size);
+
+  // Returns |size| bytes aligned to |alignment|, which must be a power of two
+  // no larger than alignof(std::max_align_t).
+  void* Allocate(size_t size, size_t alignment);
+
+  // Bytes reserved from the heap, and the subset of those handed out.
+  size_t bytes_reserved() const { return bytes_reserved_; }
+  size_t bytes_used() const { return bytes_used_; }
+
+ private:
+  // Allocates a new block of |size| bytes and makes it current.
+  void AddBlock(size_t size);
+
+  std::vector<std::unique_ptr<char[]>> blocks_;
+  char* position_;
+  size_t remaining_;
+
+  size_t next_block_size_;
+  size_t bytes_reserved_;
+  size_t bytes_used_;
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+};
+
+// Standard allocator interface over an Arena, so that containers owned by
+// parsed elements can keep their storage in the Script's arena. With a NULL
+// arena it falls back to the regular heap; this is what elements read outside
+// of a Script get.
+template <typename T>
+class ArenaAllocator {
+ public:
+  typedef T value_type;
+
+  ArenaAllocator() : arena_(NULL) {}
+  explicit ArenaAllocator(Arena* arena) : arena_(arena) {}
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other) : arena_(other.arena()) {}
+
+  T* allocate(size_t n) {
+    if (arena_)
+      return static_cast<T*>(arena_->Allocate(n * sizeof(T), alignof(T)));
+    return static_cast<T*>(::operator new(n * sizeof(T)));
+  }
+
+  void deallocate(T* p, size_t n) {
+    // Arena memory is only reclaimed when the whole arena goes away.
+    if (!arena_)
+      ::operator delete(p);
+  }
+
+  Arena* arena() const { return arena_; }
+
+ private:
+  Arena* arena_;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>& lhs, const ArenaAllocator<U>& rhs) {
+  return lhs.arena() == rhs.arena();
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& lhs, const ArenaAllocator<U>& rhs) {
+  return lhs.arena() != rhs.arena();
+}
+
+typedef std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>>
+    ArenaString;
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+}  // namespace libreallive
+
+#endif  // SRC_LIBREALLIVE_ARENA_H_
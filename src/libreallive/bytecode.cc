@@ -33,15 +33,18 @@
 
 #include "libreallive/bytecode.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <exception>
 #include <iomanip>
+#include <new>
 #include <sstream>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "libreallive/arena.h"
 #include "libreallive/scenario.h"
 #include "libreallive/expression.h"
 
@@ -51,7 +54,49 @@ namespace libreallive {
 
 namespace {
 
-inline BytecodeElement* ReadFunction(const char* stream,
+// Allocates a T in |cdata.arena| if there is one, or on the heap otherwise.
+template <typename T, typename... Args>
+T* NewElement(ConstructionData& cdata, Args&&... args) {
+  if (cdata.arena) {
+    void* memory = cdata.arena->Allocate(sizeof(T), alignof(T));
+    return new (memory) T(std::forward<Args>(args)...);
+  }
+
+  return new T(std::forward<Args>(args)...);
+}
+
+CommandElement* ReadFunctionElement(const char* stream,
+                                    ConstructionData& cdata) {
+  const char* ptr = stream;
+  ptr += 8;
+  ArenaVector<ArenaString> params(cdata.allocator());
+  if (*ptr == '(') {
+    // Arena memory isn't reused, so avoid growing the vector if we can. The
+    // argument count is only a hint; see FunctionElement::GetParamCount().
+    params.reserve(read_i16(stream + 5));
+    const char* end = ptr + 1;
+    while (*end != ')') {
+      const size_t len = NextData(end);
+      params.emplace_back(end, len, cdata.allocator());
+      end += len;
+    }
+  }
+
+  if (params.size() == 0) {
+    return NewElement<VoidFunctionElement>(cdata, stream);
+  } else if (params.size() == 1) {
+    return NewElement<SingleArgFunctionElement>(cdata, stream,
+                                                std::move(params.front()));
+  } else {
+    return NewElement<FunctionElement>(cdata, stream, std::move(params));
+  }
+}
+
+inline string ToString(const ArenaString& str) {
+  return string(str.data(), str.size());
+}
+
+inline CommandElement* ReadFunction(const char* stream,
                                      ConstructionData& cdata) {
   // opcode: 0xttmmoooo (Type, Module, Opcode: e.g. 0x01030101 = 1:03:00257
   const unsigned long opcode =
@@ -63,7 +108,7 @@ inline BytecodeElement* ReadFunction(const char* stream,
     case 0x00050005:
     case 0x00060001:
     case 0x00060005:
-      return new GotoElement(stream, cdata);
+      return NewElement<GotoElement>(cdata, stream, cdata);
     case 0x00010001:
     case 0x00010002:
     case 0x00010006:
@@ -75,24 +120,24 @@ inline BytecodeElement* ReadFunction(const char* stream,
     case 0x00060002:
     case 0x00060006:
     case 0x00060007:
-      return new GotoIfElement(stream, cdata);
+      return NewElement<GotoIfElement>(cdata, stream, cdata);
     case 0x00010003:
     case 0x00010008:
     case 0x00050003:
     case 0x00050008:
     case 0x00060003:
     case 0x00060008:
-      return new GotoOnElement(stream, cdata);
+      return NewElement<GotoOnElement>(cdata, stream, cdata);
     case 0x00010004:
     case 0x00010009:
     case 0x00050004:
     case 0x00050009:
     case 0x00060004:
     case 0x00060009:
-      return new GotoCaseElement(stream, cdata);
+      return NewElement<GotoCaseElement>(cdata, stream, cdata);
     case 0x00010010:
     case 0x00060010:
-      return new GosubWithElement(stream, cdata);
+      return NewElement<GosubWithElement>(cdata, stream, cdata);
 
     // Select elements.
     case 0x00020000:
@@ -100,35 +145,19 @@ inline BytecodeElement* ReadFunction(const char* stream,
     case 0x00020002:
     case 0x00020003:
     case 0x00020010:
-      return new SelectElement(stream);
+      return NewElement<SelectElement>(cdata, stream, cdata);
   }
 
-  return BuildFunctionElement(stream);
+  return ReadFunctionElement(stream, cdata);
 }
 
 }  // namespace
 
-char BytecodeElement::entrypoint_marker = '@';
+std::atomic<char> BytecodeElement::entrypoint_marker('@');
 
 CommandElement* BuildFunctionElement(const char* stream) {
-  const char* ptr = stream;
-  ptr += 8;
-  std::vector<std::string> params;
-  if (*ptr == '(') {
-    const char* end = ptr + 1;
-    while (*end != ')') {
-      const size_t len = NextData(end);
-      params.emplace_back(end, len);
-      end += len;
-    }
-  }
-
-  if (params.size() == 0)
-    return new VoidFunctionElement(stream);
-  else if (params.size() == 1)
-    return new SingleArgFunctionElement(stream, params.front());
-  else
-    return new FunctionElement(stream, params);
+  ConstructionData cdata(0);
+  return ReadFunctionElement(stream, cdata);
 }
 
 void PrintParameterString(std::ostream& oss,
@@ -159,18 +188,46 @@ void PrintParameterString(std::ostream& oss,
 // ConstructionData
 // -----------------------------------------------------------------------
 
-ConstructionData::ConstructionData(size_t kt, pointer_t pt)
-    : kidoku_table(kt), null(pt) {}
+ConstructionData::ConstructionData(size_t kt, Arena* arena,
+                                   ParsedParameterStore* parameter_store)
+    : kidoku_table(kt), arena(arena), parameter_store(parameter_store) {}
 
 // -----------------------------------------------------------------------
 
 ConstructionData::~ConstructionData() {}
 
+ConstructionData::offsets_t::const_iterator ConstructionData::FindOffset(
+    unsigned long offset) const {
+  offsets_t::const_iterator it = std::lower_bound(
+      offsets.begin(), offsets.end(), offset,
+      [](const offsets_t::value_type& entry, unsigned long offset) {
+        return entry.first < offset;
+      });
+  if (it != offsets.end() && it->first != offset)
+    return offsets.end();
+  return it;
+}
+
+// -----------------------------------------------------------------------
+// ParsedParameterStore
+// -----------------------------------------------------------------------
+
+ParsedParameterStore::ParsedParameterStore() {}
+
+ParsedParameterStore::~ParsedParameterStore() {}
+
+ExpressionPiecesVector* ParsedParameterStore::Add(
+    ExpressionPiecesVector parameters) {
+  parameters_.push_back(std::move(parameters));
+  return &parameters_.back();
+}
+
 // -----------------------------------------------------------------------
 // Pointers
 // -----------------------------------------------------------------------
 
-Pointers::Pointers() {}
+Pointers::Pointers(const ArenaAllocator<char>& allocator)
+    : target_ids(allocator), targets(allocator) {}
 
 Pointers::~Pointers() {}
 
@@ -179,7 +236,7 @@ void Pointers::SetPointers(ConstructionData& cdata) {
   targets.reserve(target_ids.size());
   for (unsigned int i = 0; i < target_ids.size(); ++i) {
     ConstructionData::offsets_t::const_iterator it =
-        cdata.offsets.find(target_ids[i]);
+        cdata.FindOffset(target_ids[i]);
     assert(it != cdata.offsets.end());
     targets.push_back(it->second);
   }
@@ -213,6 +270,8 @@ void BytecodeElement::RunOnMachine(RLMachine& machine) const {
   machine.AdvanceInstructionPointer();
 }
 
+bool BytecodeElement::IsFusable() const { return false; }
+
 // static
 BytecodeElement* BytecodeElement::Read(const char* stream,
                                        const char* end,
@@ -223,18 +282,21 @@ BytecodeElement* BytecodeElement::Read(const char* stream,
   switch (c) {
     case 0:
     case ',':
-      return new CommaElement;
+      return NewElement<CommaElement>(cdata);
     case '\n':
-      return new MetaElement(0, stream);
+      return NewElement<MetaElement>(cdata, nullptr, stream);
     case '@':  // fall through
     case '!':
-      return new MetaElement(&cdata, stream);
+      return NewElement<MetaElement>(cdata, &cdata, stream);
     case '$':
-      return new ExpressionElement(stream);
-    case '#':
-      return ReadFunction(stream, cdata);
+      return NewElement<ExpressionElement>(cdata, stream, cdata.arena);
+    case '#': {
+      CommandElement* command = ReadFunction(stream, cdata);
+      command->parameter_store_ = cdata.parameter_store;
+      return command;
+    }
     default:
-      return new TextoutElement(stream, end);
+      return NewElement<TextoutElement>(cdata, stream, end, cdata);
   }
 }
 
@@ -254,6 +316,8 @@ void CommaElement::PrintSourceRepresentation(RLMachine* machine,
 
 const size_t CommaElement::GetBytecodeLength() const { return 1; }
 
+bool CommaElement::IsFusable() const { return true; }
+
 // -----------------------------------------------------------------------
 // MetaElement
 // -----------------------------------------------------------------------
@@ -297,11 +361,16 @@ void MetaElement::RunOnMachine(RLMachine& machine) const {
   machine.AdvanceInstructionPointer();
 }
 
+bool MetaElement::IsFusable() const { return true; }
+
 // -----------------------------------------------------------------------
 // TextoutElement
 // -----------------------------------------------------------------------
 
-TextoutElement::TextoutElement(const char* src, const char* file_end) {
+TextoutElement::TextoutElement(const char* src,
+                               const char* file_end,
+                               ConstructionData& cdata)
+    : repr(cdata.allocator()) {
   const char* end = src;
   bool quoted = false;
   while (true && end < file_end) {
@@ -330,7 +399,7 @@ TextoutElement::~TextoutElement() {}
 const string TextoutElement::GetText() const {
   string rv;
   bool quoted = false;
-  string::const_iterator it = repr.cbegin();
+  ArenaString::const_iterator it = repr.cbegin();
   while (it != repr.cend()) {
     if (*it == '"') {
       ++it;
@@ -368,10 +437,11 @@ void TextoutElement::RunOnMachine(RLMachine& machine) const {
 // ExpressionElement
 // -----------------------------------------------------------------------
 
-ExpressionElement::ExpressionElement(const char* src)
+ExpressionElement::ExpressionElement(const char* src, Arena* arena)
     : parsed_expression_(invalid_expression_piece_t()) {
   const char* end = src;
-  parsed_expression_ = GetAssignment(end);
+  parsed_expression_ = GetAssignment(end, arena);
+  parsed_expression_.Compile(arena);
   length_ = std::distance(src, end);
 }
 
@@ -404,13 +474,18 @@ void ExpressionElement::RunOnMachine(RLMachine& machine) const {
   machine.ExecuteExpression(*this);
 }
 
+bool ExpressionElement::IsFusable() const { return true; }
+
 // -----------------------------------------------------------------------
 // CommandElement
 // -----------------------------------------------------------------------
 
 CommandElement::CommandElement(const char* src) { memcpy(command, src, 8); }
 
-CommandElement::~CommandElement() {}
+CommandElement::~CommandElement() {
+  if (!parameter_store_)
+    delete parsed_parameters_;
+}
 
 std::vector<std::string> CommandElement::GetUnparsedParameters() const {
   std::vector<std::string> parameters;
@@ -421,16 +496,27 @@ std::vector<std::string> CommandElement::GetUnparsedParameters() const {
 }
 
 bool CommandElement::AreParametersParsed() const {
-  return GetParamCount() == parsed_parameters_.size();
+  size_t parsed = parsed_parameters_ ? parsed_parameters_->size() : 0;
+  return GetParamCount() == parsed;
 }
 
 void CommandElement::SetParsedParameters(
     ExpressionPiecesVector parsedParameters) const {
-  parsed_parameters_ = std::move(parsedParameters);
+  for (ExpressionPiece& piece : parsedParameters)
+    piece.Compile();
+
+  if (parsed_parameters_)
+    *parsed_parameters_ = std::move(parsedParameters);
+  else if (parameter_store_)
+    parsed_parameters_ = parameter_store_->Add(std::move(parsedParameters));
+  else
+    parsed_parameters_ =
+        new ExpressionPiecesVector(std::move(parsedParameters));
 }
 
 const ExpressionPiecesVector& CommandElement::GetParsedParameters() const {
-  return parsed_parameters_;
+  static const ExpressionPiecesVector kNoParameters;
+  return parsed_parameters_ ? *parsed_parameters_ : kNoParameters;
 }
 
 const size_t CommandElement::GetPointersCount() const { return 0; }
@@ -467,8 +553,11 @@ void CommandElement::RunOnMachine(RLMachine& machine) const {
 // SelectElement
 // -----------------------------------------------------------------------
 
-SelectElement::SelectElement(const char* src)
-    : CommandElement(src), uselessjunk(0) {
+SelectElement::SelectElement(const char* src, ConstructionData& cdata)
+    : CommandElement(src),
+      repr(cdata.allocator()),
+      params(cdata.allocator()),
+      uselessjunk(0) {
   repr.assign(src, 8);
 
   src += 8;
@@ -481,6 +570,7 @@ SelectElement::SelectElement(const char* src)
   if (*src++ != '{')
     throw Error("SelectElement(): expected `{'");
 
+  params.reserve(argc());
   if (*src == '\n') {
     firstline = read_i16(src + 1);
     src += 3;
@@ -494,14 +584,14 @@ SelectElement::SelectElement(const char* src)
       ++src;
     // Read condition, if present.
     const char* cond = src;
-    std::vector<Condition> cond_parsed;
+    ArenaVector<Condition> cond_parsed(cdata.allocator());
     if (*src == '(') {
       ++src;
       while (*src != ')') {
-        Condition c;
+        Condition c(cdata.allocator());
         if (*src == '(') {
           int len = NextExpression(src);
-          c.condition = string(src, len);
+          c.condition.assign(src, len);
           src += len;
         }
         bool seekarg = *src != '2' && *src != '3';
@@ -509,10 +599,10 @@ SelectElement::SelectElement(const char* src)
         ++src;
         if (seekarg && *src != ')' && (*src < '0' || *src > '9')) {
           int len = NextExpression(src);
-          c.effect_argument = string(src, len);
+          c.effect_argument.assign(src, len);
           src += len;
         }
-        cond_parsed.push_back(c);
+        cond_parsed.push_back(std::move(c));
       }
       if (*src++ != ')')
         throw Error("SelectElement(): expected `)'");
@@ -527,7 +617,8 @@ SelectElement::SelectElement(const char* src)
       throw Error("SelectElement(): expected `\\n'");
     int lnum = read_i16(src + 1);
     src += 3;
-    params.emplace_back(cond_parsed, cond, clen, text, tlen, lnum);
+    params.emplace_back(std::move(cond_parsed), cond, clen, text, tlen, lnum,
+                        cdata.allocator());
   }
 
   // HACK?: In Kotomi's path in CLANNAD, there's a select with empty options
@@ -560,8 +651,8 @@ ExpressionPiece SelectElement::GetWindowExpression() const {
 const size_t SelectElement::GetParamCount() const { return params.size(); }
 
 string SelectElement::GetParam(int i) const {
-  string rv(params[i].cond_text);
-  rv.append(params[i].text);
+  string rv = ToString(params[i].cond_text);
+  rv.append(params[i].text.data(), params[i].text.size());
   return rv;
 }
 
@@ -578,8 +669,8 @@ const size_t SelectElement::GetBytecodeLength() const {
 // -----------------------------------------------------------------------
 
 FunctionElement::FunctionElement(const char* src,
-                                 const std::vector<string>& params)
-    : CommandElement(src), params(params) {}
+                                 ArenaVector<ArenaString>&& params)
+    : CommandElement(src), params(std::move(params)) {}
 
 FunctionElement::~FunctionElement() {}
 
@@ -590,19 +681,19 @@ const size_t FunctionElement::GetParamCount() const {
   // dropping the parameter will put the stream cursor in the wrong place), so
   // hack this here.
   if (!params.empty()) {
-    string final = params.back();
+    const ArenaString& final = params.back();
     if (final.size() == 3 && final[0] == '\n')
       return params.size() - 1;
   }
   return params.size();
 }
 
-string FunctionElement::GetParam(int i) const { return params[i]; }
+string FunctionElement::GetParam(int i) const { return ToString(params[i]); }
 
 const size_t FunctionElement::GetBytecodeLength() const {
   if (params.size() > 0) {
     size_t rv(COMMAND_SIZE + 2);
-    for (std::string const& param : params)
+    for (ArenaString const& param : params)
       rv += param.size();
     return rv;
   } else {
@@ -616,7 +707,7 @@ std::string FunctionElement::GetSerializedCommand(RLMachine& machine) const {
     rv.push_back(command[i]);
   if (params.size() > 0) {
     rv.push_back('(');
-    for (string const& param : params) {
+    for (ArenaString const& param : params) {
       const char* data = param.c_str();
       ExpressionPiece expression(GetData(data));
       rv.append(expression.GetSerializedExpression(machine));
@@ -656,15 +747,15 @@ std::string VoidFunctionElement::GetSerializedCommand(RLMachine& machine)
 // -----------------------------------------------------------------------
 
 SingleArgFunctionElement::SingleArgFunctionElement(const char* src,
-                                                   const std::string& arg)
-    : CommandElement(src), arg_(arg) {}
+                                                   ArenaString&& arg)
+    : CommandElement(src), arg_(std::move(arg)) {}
 
 SingleArgFunctionElement::~SingleArgFunctionElement() {}
 
 const size_t SingleArgFunctionElement::GetParamCount() const { return 1; }
 
 string SingleArgFunctionElement::GetParam(int i) const {
-  return i == 0 ? arg_ : std::string();
+  return i == 0 ? ToString(arg_) : std::string();
 }
 
 const size_t SingleArgFunctionElement::GetBytecodeLength() const {
@@ -688,7 +779,9 @@ std::string SingleArgFunctionElement::GetSerializedCommand(RLMachine& machine)
 // PointerElement
 // -----------------------------------------------------------------------
 
-PointerElement::PointerElement(const char* src) : CommandElement(src) {}
+PointerElement::PointerElement(const char* src,
+                               const ArenaAllocator<char>& allocator)
+    : CommandElement(src), targets(allocator) {}
 
 PointerElement::~PointerElement() {}
 
@@ -730,7 +823,7 @@ pointer_t GotoElement::GetPointer(int i) const {
 const size_t GotoElement::GetBytecodeLength() const { return 12; }
 
 void GotoElement::SetPointers(ConstructionData& cdata) {
-  ConstructionData::offsets_t::const_iterator it = cdata.offsets.find(id_);
+  ConstructionData::offsets_t::const_iterator it = cdata.FindOffset(id_);
   assert(it != cdata.offsets.end());
   pointer_ = it->second;
 }
@@ -740,7 +833,7 @@ void GotoElement::SetPointers(ConstructionData& cdata) {
 // -----------------------------------------------------------------------
 
 GotoIfElement::GotoIfElement(const char* src, ConstructionData& cdata)
-    : CommandElement(src) {
+    : CommandElement(src), repr(cdata.allocator()) {
   repr.assign(src, 8);
   src += 8;
 
@@ -766,7 +859,8 @@ const size_t GotoIfElement::GetParamCount() const {
 
 string GotoIfElement::GetParam(int i) const {
   return i == 0
-             ? (repr.size() == 8 ? string() : repr.substr(9, repr.size() - 10))
+             ? (repr.size() == 8 ? string()
+                                 : string(repr.data() + 9, repr.size() - 10))
              : string();
 }
 
@@ -782,7 +876,7 @@ const size_t GotoIfElement::GetBytecodeLength() const {
 }
 
 void GotoIfElement::SetPointers(ConstructionData& cdata) {
-  ConstructionData::offsets_t::const_iterator it = cdata.offsets.find(id_);
+  ConstructionData::offsets_t::const_iterator it = cdata.FindOffset(id_);
   assert(it != cdata.offsets.end());
   pointer_ = it->second;
 }
@@ -792,7 +886,9 @@ void GotoIfElement::SetPointers(ConstructionData& cdata) {
 // -----------------------------------------------------------------------
 
 GotoCaseElement::GotoCaseElement(const char* src, ConstructionData& cdata)
-    : PointerElement(src) {
+    : PointerElement(src, cdata.allocator()),
+      repr(cdata.allocator()),
+      cases(cdata.allocator()) {
   repr.assign(src, 8);
   src += 8;
   // Condition
@@ -809,11 +905,11 @@ GotoCaseElement::GotoCaseElement(const char* src, ConstructionData& cdata)
     if (src[0] != '(')
       throw Error("GotoCaseElement(): expected `('");
     if (src[1] == ')') {
-      cases.push_back("()");
+      cases.emplace_back("()", cdata.allocator());
       src += 2;
     } else {
       int cexpr = NextExpression(src + 1);
-      cases.emplace_back(src, cexpr + 2);
+      cases.emplace_back(src, cexpr + 2, cdata.allocator());
       src += cexpr + 1;
       if (*src++ != ')')
         throw Error("GotoCaseElement(): expected `)'");
@@ -833,12 +929,14 @@ const size_t GotoCaseElement::GetParamCount() const {
 }
 
 string GotoCaseElement::GetParam(int i) const {
-  return i == 0 ? repr.substr(8, repr.size() - 8) : string();
+  return i == 0 ? string(repr.data() + 8, repr.size() - 8) : string();
 }
 
 const size_t GotoCaseElement::GetCaseCount() const { return cases.size(); }
 
-const string GotoCaseElement::GetCase(int i) const { return cases[i]; }
+const string GotoCaseElement::GetCase(int i) const {
+  return ToString(cases[i]);
+}
 
 const size_t GotoCaseElement::GetBytecodeLength() const {
   size_t rv = repr.size() + 2;
@@ -852,7 +950,7 @@ const size_t GotoCaseElement::GetBytecodeLength() const {
 // -----------------------------------------------------------------------
 
 GotoOnElement::GotoOnElement(const char* src, ConstructionData& cdata)
-    : PointerElement(src) {
+    : PointerElement(src, cdata.allocator()), repr(cdata.allocator()) {
   repr.assign(src, 8);
   src += 8;
   // Condition
@@ -877,7 +975,7 @@ GotoOnElement::~GotoOnElement() {}
 const size_t GotoOnElement::GetParamCount() const { return 1; }
 
 string GotoOnElement::GetParam(int i) const {
-  return i == 0 ? repr.substr(8, repr.size() - 8) : string();
+  return i == 0 ? string(repr.data() + 8, repr.size() - 8) : string();
 }
 
 const size_t GotoOnElement::GetBytecodeLength() const {
@@ -889,7 +987,8 @@ const size_t GotoOnElement::GetBytecodeLength() const {
 // -----------------------------------------------------------------------
 
 GosubWithElement::GosubWithElement(const char* src, ConstructionData& cdata)
-    : CommandElement(src), repr_size(8) {
+    : CommandElement(src), repr_size(8), params(cdata.allocator()) {
+  params.reserve(argc());
   src += 8;
   if (*src == '(') {
     src++;
@@ -898,7 +997,7 @@ GosubWithElement::GosubWithElement(const char* src, ConstructionData& cdata)
     while (*src != ')') {
       int expr = NextData(src);
       repr_size += expr;
-      params.emplace_back(src, expr);
+      params.emplace_back(src, expr, cdata.allocator());
       src += expr;
     }
     src++;
@@ -916,7 +1015,9 @@ const size_t GosubWithElement::GetParamCount() const {
   return params.size();
 }
 
-string GosubWithElement::GetParam(int i) const { return params[i]; }
+string GosubWithElement::GetParam(int i) const {
+  return ToString(params[i]);
+}
 
 const size_t GosubWithElement::GetPointersCount() const { return 1; }
 
@@ -930,7 +1031,7 @@ const size_t GosubWithElement::GetBytecodeLength() const {
 }
 
 void GosubWithElement::SetPointers(ConstructionData& cdata) {
-  ConstructionData::offsets_t::const_iterator it = cdata.offsets.find(id_);
+  ConstructionData::offsets_t::const_iterator it = cdata.FindOffset(id_);
   assert(it != cdata.offsets.end());
   pointer_ = it->second;
 }
@@ -34,16 +34,21 @@
 #ifndef SRC_LIBREALLIVE_BYTECODE_H_
 #define SRC_LIBREALLIVE_BYTECODE_H_
 
+#include <atomic>
 #include <cstdint>
+#include <deque>
 #include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "libreallive/arena.h"
 #include "libreallive/bytecode_fwd.h"
 #include "libreallive/defs.h"
 #include "libreallive/expression.h"
 
 class RLMachine;
+class RLOperation;
 
 namespace libreallive {
 
@@ -55,22 +60,56 @@ CommandElement* BuildFunctionElement(const char* stream);
 void PrintParameterString(std::ostream& oss,
                           const std::vector<std::string>& paramseters);
 
+// Owns the parameters that the CommandElements of one Script parse while the
+// game runs. Those are the only heap allocations the Script's elements make,
+// so the Script can drop its elements with its Arena instead of destroying
+// each one.
+class ParsedParameterStore {
+ public:
+  ParsedParameterStore();
+  ~ParsedParameterStore();
+
+  // Takes |parameters| and returns where they now live.
+  ExpressionPiecesVector* Add(ExpressionPiecesVector parameters);
+
+ private:
+  // A deque so that returned pointers stay valid.
+  std::deque<ExpressionPiecesVector> parameters_;
+};
+
 struct ConstructionData {
-  ConstructionData(size_t kt, pointer_t pt);
+  explicit ConstructionData(size_t kt, Arena* arena = NULL,
+                            ParsedParameterStore* parameter_store = NULL);
   ~ConstructionData();
 
   std::vector<unsigned long> kidoku_table;
-  pointer_t null;
-  typedef std::map<unsigned long, pointer_t> offsets_t;
+
+  // If non-NULL, elements and everything they own are allocated in |arena|
+  // instead of on the heap.
+  Arena* arena;
+
+  ArenaAllocator<char> allocator() const {
+    return ArenaAllocator<char>(arena);
+  }
+
+  // If non-NULL, CommandElements keep their parsed parameters here instead
+  // of owning them.
+  ParsedParameterStore* parameter_store;
+
+  // The element starting at each byte offset, sorted by offset.
+  typedef std::vector<std::pair<unsigned long, pointer_t>> offsets_t;
   offsets_t offsets;
+
+  // Returns the entry in |offsets| for |offset|, or offsets.end().
+  offsets_t::const_iterator FindOffset(unsigned long offset) const;
 };
 
 class Pointers {
  public:
-  Pointers();
+  explicit Pointers(const ArenaAllocator<char>& allocator);
   ~Pointers();
 
-  typedef std::vector<pointer_t>::iterator iterator;
+  typedef ArenaVector<pointer_t>::iterator iterator;
   iterator begin() { return targets.begin(); }
   iterator end() { return targets.end(); }
 
@@ -84,8 +123,8 @@ class Pointers {
   void SetPointers(ConstructionData& cdata);
 
  private:
-  std::vector<unsigned long> target_ids;
-  std::vector<pointer_t> targets;
+  ArenaVector<unsigned long> target_ids;
+  ArenaVector<pointer_t> targets;
 };
 
 // Base classes for bytecode elements.
@@ -120,13 +159,22 @@ class BytecodeElement {
   // Execute this bytecode instruction on this virtual machine
   virtual void RunOnMachine(RLMachine& machine) const;
 
-  // Read the next element from a stream.
+  // Whether running this element only touches memory and the machine's line
+  // and kidoku state, so that the machine may go straight on to the next
+  // element in the same step.
+  virtual bool IsFusable() const;
+
+  // Read the next element from a stream. The element is allocated in
+  // |cdata.arena| if there is one; otherwise it's owned by the caller.
+  // Commands keep their parsed parameters in |cdata.parameter_store|.
   static BytecodeElement* Read(const char* stream,
                                const char* end,
                                ConstructionData& cdata);
 
  protected:
-  static char entrypoint_marker;
+  // Newer compilers mark entrypoints with '!' instead of '@'. Scenarios may be
+  // parsed on background threads, so this is atomic.
+  static std::atomic<char> entrypoint_marker;
   BytecodeElement(const BytecodeElement& c);
 
  private:
@@ -142,6 +190,7 @@ class CommaElement : public BytecodeElement {
   virtual void PrintSourceRepresentation(RLMachine* machine,
                                          std::ostream& oss) const final;
   virtual const size_t GetBytecodeLength() const final;
+  virtual bool IsFusable() const final;
 };
 
 // Metadata elements: source line, kidoku, and entrypoint markers.
@@ -153,12 +202,16 @@ class MetaElement : public BytecodeElement {
   const int value() const { return value_; }
   void set_value(const int value) { value_ = value; }
 
+  // Whether this marks a source line, in which case value() is the line.
+  bool IsLineMarker() const { return type_ == Line_; }
+
   // Overridden from BytecodeElement:
   virtual void PrintSourceRepresentation(RLMachine* machine,
                                          std::ostream& oss) const final;
   virtual const size_t GetBytecodeLength() const final;
   virtual const int GetEntrypoint() const final;
   virtual void RunOnMachine(RLMachine& machine) const final;
+  virtual bool IsFusable() const final;
 
  private:
   enum MetaElementType { Line_ = '\n', Kidoku_ = '@', Entrypoint_ };
@@ -170,7 +223,9 @@ class MetaElement : public BytecodeElement {
 // Display-text elements.
 class TextoutElement : public BytecodeElement {
  public:
-  TextoutElement(const char* src, const char* file_end);
+  TextoutElement(const char* src,
+                 const char* file_end,
+                 ConstructionData& cdata);
   virtual ~TextoutElement();
 
   const string GetText() const;
@@ -182,7 +237,7 @@ class TextoutElement : public BytecodeElement {
   virtual void RunOnMachine(RLMachine& machine) const final;
 
  private:
-  string repr;
+  ArenaString repr;
 };
 
 // Expression elements.
@@ -192,7 +247,9 @@ class TextoutElement : public BytecodeElement {
 class ExpressionElement : public BytecodeElement {
  public:
   explicit ExpressionElement(const long val);
-  explicit ExpressionElement(const char* src);
+  // Parses the expression at |src|, placing its operands in |arena| if one
+  // is given.
+  explicit ExpressionElement(const char* src, Arena* arena = NULL);
   ExpressionElement(const ExpressionElement& rhs);
   virtual ~ExpressionElement();
 
@@ -204,6 +261,7 @@ class ExpressionElement : public BytecodeElement {
                                          std::ostream& oss) const final;
   virtual const size_t GetBytecodeLength() const final;
   virtual void RunOnMachine(RLMachine& machine) const final;
+  virtual bool IsFusable() const final;
 
  private:
   int length_;
@@ -233,10 +291,21 @@ class CommandElement : public BytecodeElement {
   // Whether the RLOperation has cached the parsed versions of the parameters.
   bool AreParametersParsed() const;
 
-  // Gets/Sets the cached parameters.
+  // Gets/Sets the cached parameters. Set compiles each parameter.
   void SetParsedParameters(ExpressionPiecesVector p) const;
   const ExpressionPiecesVector& GetParsedParameters() const;
 
+  // The RLOperation a machine resolved this command to, tagged with that
+  // machine's dispatch epoch so that a different machine, or the same one
+  // after AttachModule(), doesn't pick it up. Returns NULL on a mismatch.
+  RLOperation* GetCachedOperation(unsigned int epoch) const {
+    return cached_epoch_ == epoch ? cached_operation_ : NULL;
+  }
+  void SetCachedOperation(unsigned int epoch, RLOperation* op) const {
+    cached_epoch_ = epoch;
+    cached_operation_ = op;
+  }
+
   // Returns the number of parameters.
   virtual const size_t GetParamCount() const = 0;
   virtual string GetParam(int index) const = 0;
@@ -258,7 +327,16 @@ class CommandElement : public BytecodeElement {
   static const int COMMAND_SIZE = 8;
   unsigned char command[COMMAND_SIZE];
 
-  mutable std::vector<ExpressionPiece> parsed_parameters_;
+  // Lives in |parameter_store_| if there is one, and is owned by this
+  // element otherwise.
+  mutable ExpressionPiecesVector* parsed_parameters_ = NULL;
+  ParsedParameterStore* parameter_store_ = NULL;
+
+  mutable RLOperation* cached_operation_ = NULL;
+  mutable unsigned int cached_epoch_ = 0;
+
+ private:
+  friend class BytecodeElement;
 };
 
 class SelectElement : public CommandElement {
@@ -270,28 +348,31 @@ class SelectElement : public CommandElement {
   static const int OPTION_CURSOR = 0x34;
 
   struct Condition {
-    string condition;
+    explicit Condition(const ArenaAllocator<char>& allocator)
+        : condition(allocator), effect(0), effect_argument(allocator) {}
+
+    ArenaString condition;
     uint8_t effect;
-    string effect_argument;
+    ArenaString effect_argument;
   };
 
   struct Param {
-    std::vector<Condition> cond_parsed;
-    string cond_text;
-    string text;
+    ArenaVector<Condition> cond_parsed;
+    ArenaString cond_text;
+    ArenaString text;
     int line;
-    Param() : cond_text(), text(), line(0) {}
-    Param(const char* tsrc, const size_t tlen, const int lnum)
-        : cond_text(), text(tsrc, tlen), line(lnum) {}
-    Param(const std::vector<Condition>& conditions,
+    Param(ArenaVector<Condition>&& conditions,
           const char* csrc, const size_t clen,
-          const char* tsrc, const size_t tlen, const int lnum)
-        : cond_parsed(conditions), cond_text(csrc, clen), text(tsrc, tlen),
+          const char* tsrc, const size_t tlen, const int lnum,
+          const ArenaAllocator<char>& allocator)
+        : cond_parsed(std::move(conditions)),
+          cond_text(csrc, clen, allocator),
+          text(tsrc, tlen, allocator),
           line(lnum) {}
   };
-  typedef std::vector<Param> params_t;
+  typedef ArenaVector<Param> params_t;
 
-  explicit SelectElement(const char* src);
+  SelectElement(const char* src, ConstructionData& cdata);
   virtual ~SelectElement();
 
   // Returns the expression in the source code which refers to which window to
@@ -308,7 +389,7 @@ class SelectElement : public CommandElement {
   virtual const size_t GetBytecodeLength() const final;
 
  private:
-  string repr;
+  ArenaString repr;
   params_t params;
   int firstline;
   int uselessjunk;
@@ -316,7 +397,7 @@ class SelectElement : public CommandElement {
 
 class FunctionElement : public CommandElement {
  public:
-  FunctionElement(const char* src, const std::vector<string>& params);
+  FunctionElement(const char* src, ArenaVector<ArenaString>&& params);
   virtual ~FunctionElement();
 
   // Overridden from CommandElement:
@@ -328,7 +409,7 @@ class FunctionElement : public CommandElement {
   virtual string GetSerializedCommand(RLMachine& machine) const final;
 
  private:
-  std::vector<string> params;
+  ArenaVector<ArenaString> params;
 };
 
 class VoidFunctionElement : public CommandElement {
@@ -347,8 +428,7 @@ class VoidFunctionElement : public CommandElement {
 
 class SingleArgFunctionElement : public CommandElement {
  public:
-  SingleArgFunctionElement(const char* src,
-                           const std::string& arg);
+  SingleArgFunctionElement(const char* src, ArenaString&& arg);
   virtual ~SingleArgFunctionElement();
 
   // Overridden from CommandElement:
@@ -360,12 +440,12 @@ class SingleArgFunctionElement : public CommandElement {
   virtual string GetSerializedCommand(RLMachine& machine) const final;
 
  private:
-  std::string arg_;
+  ArenaString arg_;
 };
 
 class PointerElement : public CommandElement {
  public:
-  explicit PointerElement(const char* src);
+  PointerElement(const char* src, const ArenaAllocator<char>& allocator);
   virtual ~PointerElement();
 
   // Overridden from CommandElement:
@@ -417,7 +497,7 @@ class GotoIfElement : public CommandElement {
  private:
   unsigned long id_;
   pointer_t pointer_;
-  string repr;
+  ArenaString repr;
 };
 
 class GotoCaseElement : public PointerElement {
@@ -435,8 +515,8 @@ class GotoCaseElement : public PointerElement {
   virtual const size_t GetBytecodeLength() const final;
 
  private:
-  string repr;
-  std::vector<string> cases;
+  ArenaString repr;
+  ArenaVector<ArenaString> cases;
 };
 
 class GotoOnElement : public PointerElement {
@@ -452,7 +532,7 @@ class GotoOnElement : public PointerElement {
   virtual const size_t GetBytecodeLength() const final;
 
  private:
-  string repr;
+  ArenaString repr;
 };
 
 class GosubWithElement : public CommandElement {
@@ -474,7 +554,7 @@ class GosubWithElement : public CommandElement {
   unsigned long id_;
   pointer_t pointer_;
   int repr_size;
-  std::vector<string> params;
+  ArenaVector<ArenaString> params;
 };
 
 }  // namespace libreallive
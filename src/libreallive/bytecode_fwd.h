@@ -29,15 +29,16 @@
 #ifndef SRC_LIBREALLIVE_BYTECODE_FWD_H_
 #define SRC_LIBREALLIVE_BYTECODE_FWD_H_
 
-#include <forward_list>
-#include <memory>
+#include <vector>
 
 namespace libreallive {
 
-// List definitions.
+// List definitions. A Script's elements are stored contiguously in its Arena;
+// the list only holds pointers into it and doesn't own them.
+class Arena;
 class ExpressionPiece;
 class BytecodeElement;
-typedef std::forward_list<std::unique_ptr<BytecodeElement>> BytecodeList;
+typedef std::vector<BytecodeElement*> BytecodeList;
 typedef BytecodeList::iterator pointer_t;
 
 struct ConstructionData;
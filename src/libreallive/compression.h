@@ -36,6 +36,10 @@
 namespace libreallive {
 namespace compression {
 
+// The key every scenario's compressed data is xored with, indexed by offset
+// into the compressed data.
+extern const char xor_mask[256];
+
 // An individual xor key; some games use multiple ones.
 struct XorKey {
   char xor_key[16];
@@ -52,9 +56,27 @@ extern const XorKey snow_standard_edition_xor_mask[];
 extern const XorKey kud_wafter_xor_mask[];
 extern const XorKey kud_wafter_all_ages_xor_mask[];
 
+// Descrambles and decompresses a scenario's bytecode. The xor passes use the
+// widest vector instructions the CPU supports.
 void Decompress(const char* src, size_t src_len, char* dst, size_t dst_len,
                 const XorKey* per_game_xor_key);
 
+// The original byte at a time implementation of Decompress(), kept so the
+// fast one can be checked against it.
+void DecompressReference(const char* src, size_t src_len, char* dst,
+                         size_t dst_len, const XorKey* per_game_xor_key);
+
+// Instruction sets Decompress() can use for its xor passes.
+enum XorImplementation { XOR_SCALAR, XOR_SSE2, XOR_AVX2 };
+
+// Whether |implementation| can run on this CPU.
+bool IsXorImplementationSupported(XorImplementation implementation);
+
+// The implementation Decompress() uses. Defaults to the fastest supported one;
+// tests and benchmarks can override it.
+XorImplementation GetXorImplementation();
+void SetXorImplementation(XorImplementation implementation);
+
 }  // namespace compression
 }  // namespace libreallive
 
@@ -38,10 +38,13 @@
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/tokenizer.hpp>
 
+#include <algorithm>
+#include <cassert>
 #include <iomanip>
 #include <sstream>
 #include <string>
 
+#include "libreallive/arena.h"
 #include "libreallive/defs.h"
 #include "libreallive/intmemref.h"
 #include "machine/reference.h"
@@ -203,7 +206,7 @@ size_t NextData(const char* src) {
 // dissassembler.ml in RLDev, so really, while I coded this, Haeleth
 // really gets all the credit.
 
-ExpressionPiece GetExpressionToken(const char*& src) {
+ExpressionPiece GetExpressionToken(const char*& src, Arena* arena) {
   if (src[0] == 0xff) {
     src++;
     int value = read_i32(src);
@@ -215,7 +218,7 @@ ExpressionPiece GetExpressionToken(const char*& src) {
   } else if ((src[0] != 0xc8 && src[0] != 0xff) && src[1] == '[') {
     int type = src[0];
     src += 2;
-    ExpressionPiece location = GetExpression(src);
+    ExpressionPiece location = GetExpression(src, arena);
 
     if (src[0] != ']') {
       std::ostringstream ss;
@@ -225,7 +228,7 @@ ExpressionPiece GetExpressionToken(const char*& src) {
     }
     src++;
 
-    return ExpressionPiece::MemoryReference(type, std::move(location));
+    return ExpressionPiece::MemoryReference(type, std::move(location), arena);
   } else if (src[0] == 0) {
     throw Error("Unexpected end of buffer in GetExpressionToken");
   } else {
@@ -236,20 +239,21 @@ ExpressionPiece GetExpressionToken(const char*& src) {
   }
 }
 
-ExpressionPiece GetExpressionTerm(const char*& src) {
+ExpressionPiece GetExpressionTerm(const char*& src, Arena* arena) {
   if (src[0] == '$') {
     src++;
-    return GetExpressionToken(src);
+    return GetExpressionToken(src, arena);
   } else if (src[0] == '\\' && src[1] == 0x00) {
     src += 2;
-    return GetExpressionTerm(src);
+    return GetExpressionTerm(src, arena);
   } else if (src[0] == '\\' && src[1] == 0x01) {
     // Uniary -
     src += 2;
-    return ExpressionPiece::UniaryExpression(0x01, GetExpressionTerm(src));
+    return ExpressionPiece::UniaryExpression(
+        0x01, GetExpressionTerm(src, arena), arena);
   } else if (src[0] == '(') {
     src++;
-    ExpressionPiece p = GetExpressionBoolean(src);
+    ExpressionPiece p = GetExpressionBoolean(src, arena);
     if (src[0] != ')') {
       std::ostringstream ss;
       ss << "Unexpected character '" << src[0] << "' in GetExpressionTerm"
@@ -270,14 +274,16 @@ ExpressionPiece GetExpressionTerm(const char*& src) {
 
 static ExpressionPiece GetExpressionArithmaticLoopHiPrec(
     const char*& src,
-    ExpressionPiece tok) {
+    ExpressionPiece tok,
+    Arena* arena) {
   if (src[0] == '\\' && src[1] >= 0x02 && src[1] <= 0x09) {
     char op = src[1];
     // Advance past this operator
     src += 2;
     ExpressionPiece new_piece = ExpressionPiece::BinaryExpression(
-        op, std::move(tok), GetExpressionTerm(src));
-    return GetExpressionArithmaticLoopHiPrec(src, std::move(new_piece));
+        op, std::move(tok), GetExpressionTerm(src, arena), arena);
+    return GetExpressionArithmaticLoopHiPrec(src, std::move(new_piece),
+                                             arena);
   } else {
     // We don't consume anything and just return our input token.
     return tok;
@@ -286,55 +292,63 @@ static ExpressionPiece GetExpressionArithmaticLoopHiPrec(
 
 static ExpressionPiece GetExpressionArithmaticLoop(
     const char*& src,
-    ExpressionPiece tok) {
+    ExpressionPiece tok,
+    Arena* arena) {
   if (src[0] == '\\' && (src[1] == 0x00 || src[1] == 0x01)) {
     char op = src[1];
     src += 2;
-    ExpressionPiece other = GetExpressionTerm(src);
+    ExpressionPiece other = GetExpressionTerm(src, arena);
     ExpressionPiece rhs =
-        GetExpressionArithmaticLoopHiPrec(src, std::move(other));
-    ExpressionPiece new_piece =
-        ExpressionPiece::BinaryExpression(op, std::move(tok), std::move(rhs));
-    return GetExpressionArithmaticLoop(src, std::move(new_piece));
+        GetExpressionArithmaticLoopHiPrec(src, std::move(other), arena);
+    ExpressionPiece new_piece = ExpressionPiece::BinaryExpression(
+        op, std::move(tok), std::move(rhs), arena);
+    return GetExpressionArithmaticLoop(src, std::move(new_piece), arena);
   } else {
     return tok;
   }
 }
 
-ExpressionPiece GetExpressionArithmatic(const char*& src) {
+ExpressionPiece GetExpressionArithmatic(const char*& src, Arena* arena) {
   return GetExpressionArithmaticLoop(
-      src, GetExpressionArithmaticLoopHiPrec(src, GetExpressionTerm(src)));
+      src,
+      GetExpressionArithmaticLoopHiPrec(src, GetExpressionTerm(src, arena),
+                                        arena),
+      arena);
 }
 
 static ExpressionPiece GetExpressionConditionLoop(
     const char*& src,
-    ExpressionPiece tok) {
+    ExpressionPiece tok,
+    Arena* arena) {
   if (src[0] == '\\' && (src[1] >= 0x28 && src[1] <= 0x2d)) {
     char op = src[1];
     src += 2;
-    ExpressionPiece rhs = GetExpressionArithmatic(src);
-    ExpressionPiece new_piece =
-        ExpressionPiece::BinaryExpression(op, std::move(tok), std::move(rhs));
-    return GetExpressionConditionLoop(src, std::move(new_piece));
+    ExpressionPiece rhs = GetExpressionArithmatic(src, arena);
+    ExpressionPiece new_piece = ExpressionPiece::BinaryExpression(
+        op, std::move(tok), std::move(rhs), arena);
+    return GetExpressionConditionLoop(src, std::move(new_piece), arena);
   } else {
     return tok;
   }
 }
 
-ExpressionPiece GetExpressionCondition(const char*& src) {
-  return GetExpressionConditionLoop(src, GetExpressionArithmatic(src));
+ExpressionPiece GetExpressionCondition(const char*& src, Arena* arena) {
+  return GetExpressionConditionLoop(src, GetExpressionArithmatic(src, arena),
+                                    arena);
 }
 
 static ExpressionPiece GetExpressionBooleanLoopAnd(
     const char*& src,
-    ExpressionPiece tok) {
+    ExpressionPiece tok,
+    Arena* arena) {
   if (src[0] == '\\' && src[1] == '<') {
     src += 2;
-    ExpressionPiece rhs = GetExpressionCondition(src);
+    ExpressionPiece rhs = GetExpressionCondition(src, arena);
     return GetExpressionBooleanLoopAnd(
         src,
         ExpressionPiece::BinaryExpression(
-            0x3c, std::move(tok), std::move(rhs)));
+            0x3c, std::move(tok), std::move(rhs), arena),
+        arena);
   } else {
     return tok;
   }
@@ -342,40 +356,44 @@ static ExpressionPiece GetExpressionBooleanLoopAnd(
 
 static ExpressionPiece GetExpressionBooleanLoopOr(
     const char*& src,
-    ExpressionPiece tok) {
+    ExpressionPiece tok,
+    Arena* arena) {
   if (src[0] == '\\' && src[1] == '=') {
     src += 2;
-    ExpressionPiece innerTerm = GetExpressionCondition(src);
+    ExpressionPiece innerTerm = GetExpressionCondition(src, arena);
     ExpressionPiece rhs =
-        GetExpressionBooleanLoopAnd(src, std::move(innerTerm));
+        GetExpressionBooleanLoopAnd(src, std::move(innerTerm), arena);
     return GetExpressionBooleanLoopOr(
         src,
         ExpressionPiece::BinaryExpression(
-            0x3d, std::move(tok), std::move(rhs)));
+            0x3d, std::move(tok), std::move(rhs), arena),
+        arena);
   } else {
     return tok;
   }
 }
 
-ExpressionPiece GetExpressionBoolean(const char*& src) {
+ExpressionPiece GetExpressionBoolean(const char*& src, Arena* arena) {
   return GetExpressionBooleanLoopOr(
       src,
-      GetExpressionBooleanLoopAnd(src, GetExpressionCondition(src)));
+      GetExpressionBooleanLoopAnd(src, GetExpressionCondition(src, arena),
+                                  arena),
+      arena);
 }
 
-ExpressionPiece GetExpression(const char*& src) {
-  return GetExpressionBoolean(src);
+ExpressionPiece GetExpression(const char*& src, Arena* arena) {
+  return GetExpressionBoolean(src, arena);
 }
 
 // Parses an expression of the form [dest] = [source expression];
-ExpressionPiece GetAssignment(const char*& src) {
-  ExpressionPiece itok(GetExpressionTerm(src));
+ExpressionPiece GetAssignment(const char*& src, Arena* arena) {
+  ExpressionPiece itok(GetExpressionTerm(src, arena));
   int op = src[1];
   src += 2;
-  ExpressionPiece etok(GetExpression(src));
+  ExpressionPiece etok(GetExpression(src, arena));
   if (op >= 0x14 && op <= 0x24) {
     return ExpressionPiece::BinaryExpression(
-        op, std::move(itok), std::move(etok));
+        op, std::move(itok), std::move(etok), arena);
   } else {
     throw Error("Undefined assignment in GetAssignment");
   }
@@ -406,13 +424,13 @@ static ExpressionPiece GetString(const char*& src) {
 // of all the get_*(const char*& src) functions that can parse
 // strings. It also deals with things like special and complex
 // parameters.
-ExpressionPiece GetData(const char*& src) {
+ExpressionPiece GetData(const char*& src, Arena* arena) {
   if (*src == ',') {
     ++src;
-    return GetData(src);
+    return GetData(src, arena);
   } else if (*src == '\n') {
     src += 3;
-    return GetData(src);
+    return GetData(src, arena);
   } else if ((*src >= 0x81 && *src <= 0x9f) || (*src >= 0xe0 && *src <= 0xef) ||
              (*src >= 'A' && *src <= 'Z') || (*src >= '0' && *src <= '9') ||
              *src == ' ' || *src == '?' || *src == '_' || *src == '"' ||
@@ -438,7 +456,7 @@ ExpressionPiece GetData(const char*& src) {
 
       if (*end != '(') {
         // We have a single parameter in this special expression;
-        cep.AddContainedPiece(GetData(end));
+        cep.AddContainedPiece(GetData(end, arena));
         return cep;
       } else {
         end++;
@@ -448,29 +466,29 @@ ExpressionPiece GetData(const char*& src) {
     }
 
     while (*end != ')') {
-      cep.AddContainedPiece(GetData(end));
+      cep.AddContainedPiece(GetData(end, arena));
     }
 
     return cep;
   } else {
-    return GetExpression(src);
+    return GetExpression(src, arena);
   }
 }
 
-ExpressionPiece GetComplexParam(const char*& src) {
+ExpressionPiece GetComplexParam(const char*& src, Arena* arena) {
   if (*src == ',') {
     ++src;
-    return GetData(src);
+    return GetData(src, arena);
   } else if (*src == '(') {
     ++src;
     ExpressionPiece cep = ExpressionPiece::ComplexExpression();
 
     while (*src != ')')
-      cep.AddContainedPiece(GetData(src));
+      cep.AddContainedPiece(GetData(src, arena));
 
     return cep;
   } else {
-    return GetExpression(src);
+    return GetExpression(src, arena);
   }
 }
 
@@ -488,7 +506,7 @@ std::string EvaluatePRINT(RLMachine& machine, const std::string& in) {
       throw Error(ss.str());
     }
 
-    return piece.GetStringValue(machine);
+    return piece.GetStringValue(machine).as_string();
   } else {
     // Just a normal string we can ignore
     return in;
@@ -547,6 +565,435 @@ std::string PrintableToParsableString(const std::string& src) {
 
 // ----------------------------------------------------------------------
 
+// A compiled ExpressionPiece: the tree flattened into postfix order and run
+// on a small fixed size stack. Memory references with a constant location
+// carry a prebuilt IntMemRef so they don't decode the bytecode memory type
+// on every access.
+class ExpressionProgram {
+ public:
+  // Returns nullptr when |piece| contains something only the tree walker
+  // handles, or when it would need more than kMaxStackDepth slots. The
+  // program is allocated in |arena| if there is one, in which case it owns
+  // no memory outside of it.
+  static ExpressionProgram* Compile(const ExpressionPiece& piece,
+                                    Arena* arena);
+
+  // Copies |other|, placing the instructions in |arena| or on the heap.
+  ExpressionProgram(const ExpressionProgram& other, Arena* arena);
+
+  int Run(RLMachine& machine) const;
+
+ private:
+  enum Opcode {
+    OP_CONSTANT,
+    OP_STORE_REGISTER,
+    OP_LOAD,
+    OP_LOAD_INDIRECT,
+    OP_NEGATE,
+    OP_ADD,
+    OP_SUBTRACT,
+    OP_MULTIPLY,
+    OP_DIVIDE,
+    OP_MODULO,
+    OP_AND,
+    OP_OR,
+    OP_XOR,
+    OP_SHIFT_LEFT,
+    OP_SHIFT_RIGHT,
+    OP_EQUAL,
+    OP_NOT_EQUAL,
+    OP_LESS_EQUAL,
+    OP_LESS,
+    OP_GREATER_EQUAL,
+    OP_GREATER,
+    OP_LOGICAL_AND,
+    OP_LOGICAL_OR,
+    OP_ASSIGN,
+    OP_ASSIGN_INDIRECT,
+    OP_ASSIGN_STORE_REGISTER
+  };
+
+  struct Instruction {
+    Instruction(Opcode op, int val)
+        : opcode(op), value(val), reference(0, 0, 0) {}
+    Instruction(Opcode op, const IntMemRef& ref)
+        : opcode(op), value(0), reference(ref) {}
+
+    Opcode opcode;
+
+    // The constant for OP_CONSTANT, or the bytecode memory type for the
+    // indirect loads and stores.
+    int value;
+
+    // The memory for OP_LOAD and OP_ASSIGN.
+    IntMemRef reference;
+  };
+
+  static const int kMaxStackDepth = 16;
+
+  explicit ExpressionProgram(Arena* arena)
+      : code_(ArenaAllocator<Instruction>(arena)), depth_(0), max_depth_(0) {}
+  ExpressionProgram(const ExpressionProgram&) = delete;
+
+  bool Emit(const ExpressionPiece& piece);
+  bool EmitLoad(const ExpressionPiece& piece);
+  bool EmitStore(const ExpressionPiece& lvalue);
+  void Push(Opcode opcode, int value, int stack_effect);
+  void Push(Opcode opcode, const IntMemRef& ref, int stack_effect);
+
+  // Maps one of PerformBinaryOperationOn()'s operators to an opcode.
+  static bool BinaryOpcode(char operation, Opcode* opcode);
+
+  ArenaVector<Instruction> code_;
+  int depth_;
+  int max_depth_;
+};
+
+namespace {
+
+ExpressionProgram* CopyProgram(const ExpressionProgram* program) {
+  return program ? new ExpressionProgram(*program, NULL) : nullptr;
+}
+
+// Frees a program from ExpressionProgram::Compile(); programs in an arena
+// go away with it.
+void DeleteProgram(ExpressionProgram* program, bool in_arena) {
+  if (!in_arena)
+    delete program;
+}
+
+}  // namespace
+
+// static
+ExpressionProgram* ExpressionProgram::Compile(const ExpressionPiece& piece,
+                                              Arena* arena) {
+  ExpressionProgram program(NULL);
+  if (!program.Emit(piece) || program.max_depth_ > kMaxStackDepth)
+    return nullptr;
+
+  // The copy holds exactly as many instructions as were emitted.
+  if (!arena)
+    return new ExpressionProgram(program, NULL);
+  void* memory =
+      arena->Allocate(sizeof(ExpressionProgram), alignof(ExpressionProgram));
+  return new (memory) ExpressionProgram(program, arena);
+}
+
+ExpressionProgram::ExpressionProgram(const ExpressionProgram& other,
+                                     Arena* arena)
+    : code_(other.code_.begin(), other.code_.end(),
+            ArenaAllocator<Instruction>(arena)),
+      depth_(other.depth_),
+      max_depth_(other.max_depth_) {}
+
+int ExpressionProgram::Run(RLMachine& machine) const {
+  int stack[kMaxStackDepth];
+  int* top = stack;
+
+  for (const Instruction& instruction : code_) {
+    switch (instruction.opcode) {
+      case OP_CONSTANT:
+        *top++ = instruction.value;
+        break;
+      case OP_STORE_REGISTER:
+        *top++ = machine.store_register();
+        break;
+      case OP_LOAD:
+        *top++ = machine.GetIntValue(instruction.reference);
+        break;
+      case OP_LOAD_INDIRECT:
+        top[-1] = machine.GetIntValue(IntMemRef(instruction.value, top[-1]));
+        break;
+      case OP_NEGATE:
+        top[-1] = -top[-1];
+        break;
+      case OP_ADD:
+        --top;
+        top[-1] += top[0];
+        break;
+      case OP_SUBTRACT:
+        --top;
+        top[-1] -= top[0];
+        break;
+      case OP_MULTIPLY:
+        --top;
+        top[-1] *= top[0];
+        break;
+      case OP_DIVIDE:
+        --top;
+        if (top[0] != 0)
+          top[-1] /= top[0];
+        break;
+      case OP_MODULO:
+        --top;
+        if (top[0] != 0)
+          top[-1] %= top[0];
+        break;
+      case OP_AND:
+        --top;
+        top[-1] &= top[0];
+        break;
+      case OP_OR:
+        --top;
+        top[-1] |= top[0];
+        break;
+      case OP_XOR:
+        --top;
+        top[-1] ^= top[0];
+        break;
+      case OP_SHIFT_LEFT:
+        --top;
+        top[-1] <<= top[0];
+        break;
+      case OP_SHIFT_RIGHT:
+        --top;
+        top[-1] >>= top[0];
+        break;
+      case OP_EQUAL:
+        --top;
+        top[-1] = top[-1] == top[0];
+        break;
+      case OP_NOT_EQUAL:
+        --top;
+        top[-1] = top[-1] != top[0];
+        break;
+      case OP_LESS_EQUAL:
+        --top;
+        top[-1] = top[-1] <= top[0];
+        break;
+      case OP_LESS:
+        --top;
+        top[-1] = top[-1] < top[0];
+        break;
+      case OP_GREATER_EQUAL:
+        --top;
+        top[-1] = top[-1] >= top[0];
+        break;
+      case OP_GREATER:
+        --top;
+        top[-1] = top[-1] > top[0];
+        break;
+      case OP_LOGICAL_AND:
+        --top;
+        top[-1] = top[-1] && top[0];
+        break;
+      case OP_LOGICAL_OR:
+        --top;
+        top[-1] = top[-1] || top[0];
+        break;
+      case OP_ASSIGN:
+        machine.SetIntValue(instruction.reference, top[-1]);
+        break;
+      case OP_ASSIGN_INDIRECT:
+        --top;
+        machine.SetIntValue(IntMemRef(instruction.value, top[-1]), top[0]);
+        top[-1] = top[0];
+        break;
+      case OP_ASSIGN_STORE_REGISTER:
+        machine.set_store_register(top[-1]);
+        break;
+    }
+  }
+
+  return top[-1];
+}
+
+bool ExpressionProgram::Emit(const ExpressionPiece& piece) {
+  switch (piece.piece_type) {
+    case TYPE_STORE_REGISTER:
+    case TYPE_INT_CONSTANT:
+    case TYPE_MEMORY_REFERENCE:
+    case TYPE_SIMPLE_MEMORY_REFERENCE:
+      return EmitLoad(piece);
+    case TYPE_UNIARY_EXPRESSION:
+      if (!Emit(*piece.uniary_expression.operand))
+        return false;
+      if (piece.uniary_expression.operation == 0x01)
+        Push(OP_NEGATE, 0, 0);
+      return true;
+    case TYPE_BINARY_EXPRESSION: {
+      char operation = piece.binary_expression.operation;
+      const ExpressionPiece& lhs = *piece.binary_expression.left_operand;
+      const ExpressionPiece& rhs = *piece.binary_expression.right_operand;
+      Opcode opcode;
+      if (operation == 30) {
+        // The store needs the lvalue's location underneath the value.
+        if (lhs.piece_type == TYPE_MEMORY_REFERENCE &&
+            !Emit(*lhs.mem_reference.location)) {
+          return false;
+        }
+        return Emit(rhs) && EmitStore(lhs);
+      } else if (operation >= 20 && operation < 30) {
+        // Like the tree walker, this evaluates the lvalue's location once
+        // for the read and once for the write.
+        if (!BinaryOpcode(operation, &opcode))
+          return false;
+        if (lhs.piece_type == TYPE_MEMORY_REFERENCE &&
+            !Emit(*lhs.mem_reference.location)) {
+          return false;
+        }
+        if (!Emit(lhs) || !Emit(rhs))
+          return false;
+        Push(opcode, 0, -1);
+        return EmitStore(lhs);
+      } else {
+        if (!BinaryOpcode(operation, &opcode) || !Emit(lhs) || !Emit(rhs))
+          return false;
+        Push(opcode, 0, -1);
+        return true;
+      }
+    }
+    case TYPE_SIMPLE_ASSIGNMENT: {
+      IntMemRef ref(piece.simple_assignment.type,
+                    piece.simple_assignment.location);
+      Push(OP_CONSTANT, piece.simple_assignment.value, 1);
+      Push(OP_ASSIGN, ref, 0);
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+bool ExpressionProgram::EmitLoad(const ExpressionPiece& piece) {
+  switch (piece.piece_type) {
+    case TYPE_STORE_REGISTER:
+      Push(OP_STORE_REGISTER, 0, 1);
+      return true;
+    case TYPE_INT_CONSTANT:
+      Push(OP_CONSTANT, piece.int_constant, 1);
+      return true;
+    case TYPE_MEMORY_REFERENCE:
+      if (is_string_location(piece.mem_reference.type) ||
+          !Emit(*piece.mem_reference.location)) {
+        return false;
+      }
+      Push(OP_LOAD_INDIRECT, piece.mem_reference.type, 0);
+      return true;
+    case TYPE_SIMPLE_MEMORY_REFERENCE:
+      if (is_string_location(piece.simple_mem_reference.type))
+        return false;
+      Push(OP_LOAD,
+           IntMemRef(piece.simple_mem_reference.type,
+                     piece.simple_mem_reference.location),
+           1);
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool ExpressionProgram::EmitStore(const ExpressionPiece& lvalue) {
+  switch (lvalue.piece_type) {
+    case TYPE_STORE_REGISTER:
+      Push(OP_ASSIGN_STORE_REGISTER, 0, 0);
+      return true;
+    case TYPE_MEMORY_REFERENCE:
+      if (is_string_location(lvalue.mem_reference.type))
+        return false;
+      Push(OP_ASSIGN_INDIRECT, lvalue.mem_reference.type, -1);
+      return true;
+    case TYPE_SIMPLE_MEMORY_REFERENCE:
+      if (is_string_location(lvalue.simple_mem_reference.type))
+        return false;
+      Push(OP_ASSIGN,
+           IntMemRef(lvalue.simple_mem_reference.type,
+                     lvalue.simple_mem_reference.location),
+           0);
+      return true;
+    default:
+      return false;
+  }
+}
+
+void ExpressionProgram::Push(Opcode opcode, int value, int stack_effect) {
+  code_.emplace_back(opcode, value);
+  depth_ += stack_effect;
+  max_depth_ = std::max(max_depth_, depth_);
+}
+
+void ExpressionProgram::Push(Opcode opcode,
+                             const IntMemRef& ref,
+                             int stack_effect) {
+  code_.emplace_back(opcode, ref);
+  depth_ += stack_effect;
+  max_depth_ = std::max(max_depth_, depth_);
+}
+
+// static
+bool ExpressionProgram::BinaryOpcode(char operation, Opcode* opcode) {
+  switch (operation) {
+    case 0:
+    case 20:
+      *opcode = OP_ADD;
+      return true;
+    case 1:
+    case 21:
+      *opcode = OP_SUBTRACT;
+      return true;
+    case 2:
+    case 22:
+      *opcode = OP_MULTIPLY;
+      return true;
+    case 3:
+    case 23:
+      *opcode = OP_DIVIDE;
+      return true;
+    case 4:
+    case 24:
+      *opcode = OP_MODULO;
+      return true;
+    case 5:
+    case 25:
+      *opcode = OP_AND;
+      return true;
+    case 6:
+    case 26:
+      *opcode = OP_OR;
+      return true;
+    case 7:
+    case 27:
+      *opcode = OP_XOR;
+      return true;
+    case 8:
+    case 28:
+      *opcode = OP_SHIFT_LEFT;
+      return true;
+    case 9:
+    case 29:
+      *opcode = OP_SHIFT_RIGHT;
+      return true;
+    case 40:
+      *opcode = OP_EQUAL;
+      return true;
+    case 41:
+      *opcode = OP_NOT_EQUAL;
+      return true;
+    case 42:
+      *opcode = OP_LESS_EQUAL;
+      return true;
+    case 43:
+      *opcode = OP_LESS;
+      return true;
+    case 44:
+      *opcode = OP_GREATER_EQUAL;
+      return true;
+    case 45:
+      *opcode = OP_GREATER;
+      return true;
+    case 60:
+      *opcode = OP_LOGICAL_AND;
+      return true;
+    case 61:
+      *opcode = OP_LOGICAL_OR;
+      return true;
+    default:
+      return false;
+  }
+}
+
+// ----------------------------------------------------------------------
+
 // OK: Here's the current things I need to do more:
 //
 // - I've written a move operator= (I've written the move ctor).
@@ -554,6 +1001,28 @@ std::string PrintableToParsableString(const std::string& src) {
 // - Lots of integration work still.
 
 
+namespace {
+
+// Moves |piece| into |arena|, or onto the heap when there is no arena.
+ExpressionPiece* NewOperand(Arena* arena, ExpressionPiece piece) {
+  if (!arena)
+    return new ExpressionPiece(std::move(piece));
+  void* memory =
+      arena->Allocate(sizeof(ExpressionPiece), alignof(ExpressionPiece));
+  return new (memory) ExpressionPiece(std::move(piece));
+}
+
+// Frees an operand allocated by NewOperand(); the arena reclaims its own
+// memory when the owning Script goes away.
+void DeleteOperand(ExpressionPiece* piece, bool in_arena) {
+  if (!in_arena)
+    delete piece;
+  else if (piece)
+    piece->~ExpressionPiece();
+}
+
+}  // namespace
+
 // static
 ExpressionPiece ExpressionPiece::StoreRegister() {
   ExpressionPiece piece;
@@ -573,13 +1042,14 @@ ExpressionPiece ExpressionPiece::IntConstant(const int constant) {
 ExpressionPiece ExpressionPiece::StrConstant(const std::string constant) {
   ExpressionPiece piece;
   piece.piece_type = TYPE_STRING_CONSTANT;
-  new (&piece.str_constant) std::string(constant);
+  new (&piece.str_constant) StringPiece(InternString(constant));
   return piece;
 }
 
 // static
 ExpressionPiece ExpressionPiece::MemoryReference(const int type,
-                                                 ExpressionPiece location) {
+                                                 ExpressionPiece location,
+                                                 Arena* arena) {
   ExpressionPiece piece;
   if (location.piece_type == TYPE_INT_CONSTANT) {
     piece.piece_type = TYPE_SIMPLE_MEMORY_REFERENCE;
@@ -588,25 +1058,39 @@ ExpressionPiece ExpressionPiece::MemoryReference(const int type,
   } else {
     piece.piece_type = TYPE_MEMORY_REFERENCE;
     piece.mem_reference.type = type;
-    piece.mem_reference.location = new ExpressionPiece(std::move(location));
+    piece.operands_in_arena = arena != NULL;
+    piece.mem_reference.location = NewOperand(arena, std::move(location));
+    piece.mem_reference.program = nullptr;
   }
   return piece;
 }
 
 // static
 ExpressionPiece ExpressionPiece::UniaryExpression(const char operation,
-                                                  ExpressionPiece operand) {
+                                                  ExpressionPiece operand,
+                                                  Arena* arena) {
   ExpressionPiece piece;
-  piece.piece_type = TYPE_UNIARY_EXPRESSION;
-  piece.uniary_expression.operation = operation;
-  piece.uniary_expression.operand = new ExpressionPiece(std::move(operand));
+  if (operand.piece_type == TYPE_INT_CONSTANT) {
+    // Negative literals are written as a negated constant in the bytecode;
+    // fold them so they don't cost an allocation and an evaluation.
+    piece.piece_type = TYPE_INT_CONSTANT;
+    piece.int_constant = operation == 0x01 ? -operand.int_constant
+                                           : operand.int_constant;
+  } else {
+    piece.piece_type = TYPE_UNIARY_EXPRESSION;
+    piece.uniary_expression.operation = operation;
+    piece.operands_in_arena = arena != NULL;
+    piece.uniary_expression.operand = NewOperand(arena, std::move(operand));
+    piece.uniary_expression.program = nullptr;
+  }
   return piece;
 }
 
 // static
 ExpressionPiece ExpressionPiece::BinaryExpression(const char operation,
                                                   ExpressionPiece lhs,
-                                                  ExpressionPiece rhs) {
+                                                  ExpressionPiece rhs,
+                                                  Arena* arena) {
   ExpressionPiece piece;
   if (operation == 30 &&
       lhs.piece_type == TYPE_SIMPLE_MEMORY_REFERENCE &&
@@ -628,8 +1112,10 @@ ExpressionPiece ExpressionPiece::BinaryExpression(const char operation,
   } else {
     piece.piece_type = TYPE_BINARY_EXPRESSION;
     piece.binary_expression.operation = operation;
-    piece.binary_expression.left_operand = new ExpressionPiece(std::move(lhs));
-    piece.binary_expression.right_operand = new ExpressionPiece(std::move(rhs));
+    piece.operands_in_arena = arena != NULL;
+    piece.binary_expression.left_operand = NewOperand(arena, std::move(lhs));
+    piece.binary_expression.right_operand = NewOperand(arena, std::move(rhs));
+    piece.binary_expression.program = nullptr;
   }
   return piece;
 }
@@ -652,11 +1138,11 @@ ExpressionPiece ExpressionPiece::SpecialExpression(const int tag) {
 }
 
 ExpressionPiece::ExpressionPiece(invalid_expression_piece_t)
-    : piece_type(TYPE_INVALID) {
+    : piece_type(TYPE_INVALID), operands_in_arena(false) {
 }
 
 ExpressionPiece::ExpressionPiece(const ExpressionPiece& rhs)
-    : piece_type(rhs.piece_type) {
+    : piece_type(rhs.piece_type), operands_in_arena(false) {
   switch (piece_type) {
     case TYPE_STORE_REGISTER:
       break;
@@ -664,12 +1150,13 @@ ExpressionPiece::ExpressionPiece(const ExpressionPiece& rhs)
       int_constant = rhs.int_constant;
       break;
     case TYPE_STRING_CONSTANT:
-      new (&str_constant) std::string(rhs.str_constant);
+      new (&str_constant) StringPiece(rhs.str_constant);
       break;
     case TYPE_MEMORY_REFERENCE:
       mem_reference.type = rhs.mem_reference.type;
       mem_reference.location =
           new ExpressionPiece(*rhs.mem_reference.location);
+      mem_reference.program = CopyProgram(rhs.mem_reference.program);
       break;
     case TYPE_SIMPLE_MEMORY_REFERENCE:
       simple_mem_reference.type = rhs.simple_mem_reference.type;
@@ -679,6 +1166,7 @@ ExpressionPiece::ExpressionPiece(const ExpressionPiece& rhs)
       uniary_expression.operation = rhs.uniary_expression.operation;
       uniary_expression.operand =
           new ExpressionPiece(*rhs.uniary_expression.operand);
+      uniary_expression.program = CopyProgram(rhs.uniary_expression.program);
       break;
     case TYPE_BINARY_EXPRESSION:
       binary_expression.operation = rhs.binary_expression.operation;
@@ -686,6 +1174,7 @@ ExpressionPiece::ExpressionPiece(const ExpressionPiece& rhs)
           new ExpressionPiece(*rhs.binary_expression.left_operand);
       binary_expression.right_operand =
           new ExpressionPiece(*rhs.binary_expression.right_operand);
+      binary_expression.program = CopyProgram(rhs.binary_expression.program);
       break;
     case TYPE_SIMPLE_ASSIGNMENT:
       simple_assignment.type = rhs.simple_assignment.type;
@@ -707,7 +1196,7 @@ ExpressionPiece::ExpressionPiece(const ExpressionPiece& rhs)
 }
 
 ExpressionPiece::ExpressionPiece(ExpressionPiece&& rhs)
-    : piece_type(rhs.piece_type) {
+    : piece_type(rhs.piece_type), operands_in_arena(rhs.operands_in_arena) {
   switch (piece_type) {
     case TYPE_STORE_REGISTER:
       break;
@@ -715,12 +1204,14 @@ ExpressionPiece::ExpressionPiece(ExpressionPiece&& rhs)
       int_constant = rhs.int_constant;
       break;
     case TYPE_STRING_CONSTANT:
-      new (&str_constant) std::string(std::move(rhs.str_constant));
+      new (&str_constant) StringPiece(rhs.str_constant);
       break;
     case TYPE_MEMORY_REFERENCE:
       mem_reference.type = rhs.mem_reference.type;
       mem_reference.location = rhs.mem_reference.location;
+      mem_reference.program = rhs.mem_reference.program;
       rhs.mem_reference.location = nullptr;
+      rhs.mem_reference.program = nullptr;
       break;
     case TYPE_SIMPLE_MEMORY_REFERENCE:
       simple_mem_reference.type = rhs.simple_mem_reference.type;
@@ -729,14 +1220,18 @@ ExpressionPiece::ExpressionPiece(ExpressionPiece&& rhs)
     case TYPE_UNIARY_EXPRESSION:
       uniary_expression.operation = rhs.uniary_expression.operation;
       uniary_expression.operand = rhs.uniary_expression.operand;
+      uniary_expression.program = rhs.uniary_expression.program;
       rhs.uniary_expression.operand = nullptr;
+      rhs.uniary_expression.program = nullptr;
       break;
     case TYPE_BINARY_EXPRESSION:
       binary_expression.operation = rhs.binary_expression.operation;
       binary_expression.left_operand = rhs.binary_expression.left_operand;
       binary_expression.right_operand = rhs.binary_expression.right_operand;
+      binary_expression.program = rhs.binary_expression.program;
       rhs.binary_expression.left_operand = nullptr;
       rhs.binary_expression.right_operand = nullptr;
+      rhs.binary_expression.program = nullptr;
       break;
     case TYPE_SIMPLE_ASSIGNMENT:
       simple_assignment.type = rhs.simple_assignment.type;
@@ -767,6 +1262,7 @@ ExpressionPiece& ExpressionPiece::operator=(const ExpressionPiece& rhs) {
   Invalidate();
 
   piece_type = rhs.piece_type;
+  operands_in_arena = false;
   switch (piece_type) {
     case TYPE_STORE_REGISTER:
       break;
@@ -774,12 +1270,13 @@ ExpressionPiece& ExpressionPiece::operator=(const ExpressionPiece& rhs) {
       int_constant = rhs.int_constant;
       break;
     case TYPE_STRING_CONSTANT:
-      new (&str_constant) std::string(rhs.str_constant);
+      new (&str_constant) StringPiece(rhs.str_constant);
       break;
     case TYPE_MEMORY_REFERENCE:
       mem_reference.type = rhs.mem_reference.type;
       mem_reference.location =
           new ExpressionPiece(*rhs.mem_reference.location);
+      mem_reference.program = CopyProgram(rhs.mem_reference.program);
       break;
     case TYPE_SIMPLE_MEMORY_REFERENCE:
       simple_mem_reference.type = rhs.simple_mem_reference.type;
@@ -789,6 +1286,7 @@ ExpressionPiece& ExpressionPiece::operator=(const ExpressionPiece& rhs) {
       uniary_expression.operation = rhs.uniary_expression.operation;
       uniary_expression.operand =
           new ExpressionPiece(*rhs.uniary_expression.operand);
+      uniary_expression.program = CopyProgram(rhs.uniary_expression.program);
       break;
     case TYPE_BINARY_EXPRESSION:
       binary_expression.operation = rhs.binary_expression.operation;
@@ -796,6 +1294,7 @@ ExpressionPiece& ExpressionPiece::operator=(const ExpressionPiece& rhs) {
           new ExpressionPiece(*rhs.binary_expression.left_operand);
       binary_expression.right_operand =
           new ExpressionPiece(*rhs.binary_expression.right_operand);
+      binary_expression.program = CopyProgram(rhs.binary_expression.program);
       break;
     case TYPE_SIMPLE_ASSIGNMENT:
       simple_assignment.type = rhs.simple_assignment.type;
@@ -822,6 +1321,7 @@ ExpressionPiece& ExpressionPiece::operator=(ExpressionPiece&& rhs) {
   Invalidate();
 
   piece_type = rhs.piece_type;
+  operands_in_arena = rhs.operands_in_arena;
   switch (piece_type) {
     case TYPE_STORE_REGISTER:
       break;
@@ -829,12 +1329,14 @@ ExpressionPiece& ExpressionPiece::operator=(ExpressionPiece&& rhs) {
       int_constant = rhs.int_constant;
       break;
     case TYPE_STRING_CONSTANT:
-      new (&str_constant) std::string(std::move(rhs.str_constant));
+      new (&str_constant) StringPiece(rhs.str_constant);
       break;
     case TYPE_MEMORY_REFERENCE:
       mem_reference.type = rhs.mem_reference.type;
       mem_reference.location = rhs.mem_reference.location;
+      mem_reference.program = rhs.mem_reference.program;
       rhs.mem_reference.location = nullptr;
+      rhs.mem_reference.program = nullptr;
       break;
     case TYPE_SIMPLE_MEMORY_REFERENCE:
       simple_mem_reference.type = rhs.simple_mem_reference.type;
@@ -843,14 +1345,18 @@ ExpressionPiece& ExpressionPiece::operator=(ExpressionPiece&& rhs) {
     case TYPE_UNIARY_EXPRESSION:
       uniary_expression.operation = rhs.uniary_expression.operation;
       uniary_expression.operand = rhs.uniary_expression.operand;
+      uniary_expression.program = rhs.uniary_expression.program;
       rhs.uniary_expression.operand = nullptr;
+      rhs.uniary_expression.program = nullptr;
       break;
     case TYPE_BINARY_EXPRESSION:
       binary_expression.operation = rhs.binary_expression.operation;
       binary_expression.left_operand = rhs.binary_expression.left_operand;
       binary_expression.right_operand = rhs.binary_expression.right_operand;
+      binary_expression.program = rhs.binary_expression.program;
       rhs.binary_expression.left_operand = nullptr;
       rhs.binary_expression.right_operand = nullptr;
+      rhs.binary_expression.program = nullptr;
       break;
     case TYPE_SIMPLE_ASSIGNMENT:
       simple_assignment.type = rhs.simple_assignment.type;
@@ -889,6 +1395,26 @@ bool ExpressionPiece::IsSpecialParameter() const {
   return piece_type == TYPE_SPECIAL_EXPRESSION;
 }
 
+bool ExpressionPiece::IsIntegerConstant() const {
+  return piece_type == TYPE_INT_CONSTANT;
+}
+
+int ExpressionPiece::GetIntegerConstant() const {
+  if (piece_type != TYPE_INT_CONSTANT)
+    throw Error("Request to GetIntegerConstant() invalid!");
+  return int_constant;
+}
+
+bool ExpressionPiece::IsStringConstant() const {
+  return piece_type == TYPE_STRING_CONSTANT;
+}
+
+StringPiece ExpressionPiece::GetStringConstant() const {
+  if (piece_type != TYPE_STRING_CONSTANT)
+    throw Error("Request to GetStringConstant() invalid!");
+  return str_constant;
+}
+
 ExpressionValueType ExpressionPiece::GetExpressionValueType() const {
   switch (piece_type) {
     case TYPE_STRING_CONSTANT:
@@ -939,6 +1465,8 @@ int ExpressionPiece::GetIntegerValue(RLMachine& machine) const {
     case TYPE_INT_CONSTANT:
       return int_constant;
     case TYPE_MEMORY_REFERENCE:
+      if (mem_reference.program)
+        return mem_reference.program->Run(machine);
       return machine.GetIntValue(IntMemRef(
           mem_reference.type,
           mem_reference.location->GetIntegerValue(machine)));
@@ -947,9 +1475,13 @@ int ExpressionPiece::GetIntegerValue(RLMachine& machine) const {
           simple_mem_reference.type,
           simple_mem_reference.location));
     case TYPE_UNIARY_EXPRESSION:
+      if (uniary_expression.program)
+        return uniary_expression.program->Run(machine);
       return PerformUniaryOperationOn(
           uniary_expression.operand->GetIntegerValue(machine));
     case TYPE_BINARY_EXPRESSION:
+      if (binary_expression.program)
+        return binary_expression.program->Run(machine);
       if (binary_expression.operation >= 20 &&
           binary_expression.operation < 30) {
         int value = PerformBinaryOperationOn(
@@ -983,8 +1515,58 @@ int ExpressionPiece::GetIntegerValue(RLMachine& machine) const {
   }
 }
 
+void ExpressionPiece::Compile(Arena* arena) {
+  // Programs live wherever the operands do, so that Invalidate() can tell
+  // whether to free them.
+  assert(arena || !operands_in_arena);
+  if (!operands_in_arena)
+    arena = NULL;
+
+  switch (piece_type) {
+    case TYPE_MEMORY_REFERENCE:
+      // References passed by reference to operations and string references
+      // only evaluate their location, so compile that as well.
+      mem_reference.location->Compile(arena);
+      if (!mem_reference.program)
+        mem_reference.program = ExpressionProgram::Compile(*this, arena);
+      break;
+    case TYPE_UNIARY_EXPRESSION:
+      if (!uniary_expression.program)
+        uniary_expression.program = ExpressionProgram::Compile(*this, arena);
+      break;
+    case TYPE_BINARY_EXPRESSION:
+      if (!binary_expression.program)
+        binary_expression.program = ExpressionProgram::Compile(*this, arena);
+      break;
+    case TYPE_COMPLEX_EXPRESSION:
+      for (ExpressionPiece& piece : complex_expression)
+        piece.Compile();
+      break;
+    case TYPE_SPECIAL_EXPRESSION:
+      for (ExpressionPiece& piece : special_expression.pieces)
+        piece.Compile();
+      break;
+    default:
+      // Everything else is already a single operation.
+      break;
+  }
+}
+
+bool ExpressionPiece::IsCompiled() const {
+  switch (piece_type) {
+    case TYPE_MEMORY_REFERENCE:
+      return mem_reference.program != nullptr;
+    case TYPE_UNIARY_EXPRESSION:
+      return uniary_expression.program != nullptr;
+    case TYPE_BINARY_EXPRESSION:
+      return binary_expression.program != nullptr;
+    default:
+      return false;
+  }
+}
+
 void ExpressionPiece::SetStringValue(RLMachine& machine,
-                                     const std::string& rvalue) {
+                                     StringPiece rvalue) {
   switch (piece_type) {
     case TYPE_MEMORY_REFERENCE:
       machine.SetStringValue(mem_reference.type,
@@ -1002,7 +1584,7 @@ void ExpressionPiece::SetStringValue(RLMachine& machine,
   }
 }
 
-const std::string& ExpressionPiece::GetStringValue(RLMachine& machine) const {
+StringPiece ExpressionPiece::GetStringValue(RLMachine& machine) const {
   switch (piece_type) {
     case TYPE_STRING_CONSTANT:
       return str_constant;
@@ -1090,16 +1672,18 @@ std::string ExpressionPiece::GetSerializedExpression(RLMachine& machine) const {
     case TYPE_INT_CONSTANT:
       return IntToBytecode(int_constant);
     case TYPE_STRING_CONSTANT:
-      return string("\"") + str_constant + string("\"");
+      return string("\"") + str_constant.as_string() + string("\"");
     case TYPE_MEMORY_REFERENCE:
       if (is_string_location(mem_reference.type)) {
-        return string("\"") + GetStringValue(machine) + string("\"");
+        return string("\"") + GetStringValue(machine).as_string() +
+               string("\"");
       } else {
         return IntToBytecode(GetIntegerValue(machine));
       }
     case TYPE_SIMPLE_MEMORY_REFERENCE:
       if (is_string_location(simple_mem_reference.type)) {
-        return string("\"") + GetStringValue(machine) + string("\"");
+        return string("\"") + GetStringValue(machine).as_string() +
+               string("\"");
       } else {
         return IntToBytecode(GetIntegerValue(machine));
       }
@@ -1125,7 +1709,7 @@ std::string ExpressionPiece::GetDebugString() const {
     case TYPE_INT_CONSTANT:
       return std::to_string(int_constant);
     case TYPE_STRING_CONSTANT:
-      return string("\"") + str_constant + string("\"");
+      return string("\"") + str_constant.as_string() + string("\"");
     case TYPE_MEMORY_REFERENCE:
       return GetMemoryDebugString(mem_reference.type,
                                   mem_reference.location->GetDebugString());
@@ -1159,31 +1743,32 @@ std::string ExpressionPiece::GetDebugString() const {
 
 // -----------------------------------------------------------------------------
 
-ExpressionPiece::ExpressionPiece() : piece_type(TYPE_INVALID) {}
+ExpressionPiece::ExpressionPiece()
+    : piece_type(TYPE_INVALID), operands_in_arena(false) {}
 
 void ExpressionPiece::Invalidate() {
   // Needed to get around a quirk of the language
-  using string_type = std::string;
   using vec_type = std::vector<ExpressionPiece>;
 
   switch (piece_type) {
     case TYPE_STORE_REGISTER:
     case TYPE_INT_CONSTANT:
-      break;
     case TYPE_STRING_CONSTANT:
-      str_constant.~string_type();
       break;
     case TYPE_MEMORY_REFERENCE:
-      delete mem_reference.location;
+      DeleteOperand(mem_reference.location, operands_in_arena);
+      DeleteProgram(mem_reference.program, operands_in_arena);
       break;
     case TYPE_SIMPLE_MEMORY_REFERENCE:
       break;
     case TYPE_UNIARY_EXPRESSION:
-      delete uniary_expression.operand;
+      DeleteOperand(uniary_expression.operand, operands_in_arena);
+      DeleteProgram(uniary_expression.program, operands_in_arena);
       break;
     case TYPE_BINARY_EXPRESSION:
-      delete binary_expression.left_operand;
-      delete binary_expression.right_operand;
+      DeleteOperand(binary_expression.left_operand, operands_in_arena);
+      DeleteOperand(binary_expression.right_operand, operands_in_arena);
+      DeleteProgram(binary_expression.program, operands_in_arena);
       break;
     case TYPE_SIMPLE_ASSIGNMENT:
       break;
@@ -40,28 +40,34 @@
 #include <vector>
 
 #include "machine/reference.h"
+#include "machine/string_bank.h"
 
 class RLMachine;
 
 namespace libreallive {
 
+class Arena;
+class ExpressionProgram;
+
 // Size of expression functions
 size_t NextToken(const char* src);
 size_t NextExpression(const char* src);
 size_t NextString(const char* src);
 size_t NextData(const char* src);
 
-// Parse expression functions
+// Parse expression functions. When |arena| is non-NULL, the operands of
+// the returned trees are placed in it and must not outlive it.
 class ExpressionPiece;
-ExpressionPiece GetExpressionToken(const char*& src);
-ExpressionPiece GetExpressionTerm(const char*& src);
-ExpressionPiece GetExpressionArithmatic(const char*& src);
-ExpressionPiece GetExpressionCondition(const char*& src);
-ExpressionPiece GetExpressionBoolean(const char*& src);
-ExpressionPiece GetExpression(const char*& src);
-ExpressionPiece GetAssignment(const char*& src);
-ExpressionPiece GetData(const char*& src);
-ExpressionPiece GetComplexParam(const char*& src);
+ExpressionPiece GetExpressionToken(const char*& src, Arena* arena = NULL);
+ExpressionPiece GetExpressionTerm(const char*& src, Arena* arena = NULL);
+ExpressionPiece GetExpressionArithmatic(const char*& src,
+                                        Arena* arena = NULL);
+ExpressionPiece GetExpressionCondition(const char*& src, Arena* arena = NULL);
+ExpressionPiece GetExpressionBoolean(const char*& src, Arena* arena = NULL);
+ExpressionPiece GetExpression(const char*& src, Arena* arena = NULL);
+ExpressionPiece GetAssignment(const char*& src, Arena* arena = NULL);
+ExpressionPiece GetData(const char*& src, Arena* arena = NULL);
+ExpressionPiece GetComplexParam(const char*& src, Arena* arena = NULL);
 
 std::string EvaluatePRINT(RLMachine& machine, const std::string& in);
 
@@ -99,13 +105,18 @@ class ExpressionPiece {
   static ExpressionPiece StoreRegister();
   static ExpressionPiece IntConstant(const int constant);
   static ExpressionPiece StrConstant(const std::string constant);
+  // The operand pieces of these are allocated in |arena| when one is given;
+  // copies of the result always own heap allocated operands.
   static ExpressionPiece MemoryReference(const int type,
-                                         ExpressionPiece location);
+                                         ExpressionPiece location,
+                                         Arena* arena = NULL);
   static ExpressionPiece UniaryExpression(const char operation,
-                                          ExpressionPiece operand);
+                                          ExpressionPiece operand,
+                                          Arena* arena = NULL);
   static ExpressionPiece BinaryExpression(const char operation,
                                           ExpressionPiece lhs,
-                                          ExpressionPiece rhs);
+                                          ExpressionPiece rhs,
+                                          Arena* arena = NULL);
   static ExpressionPiece ComplexExpression();
   static ExpressionPiece SpecialExpression(const int tag);
 
@@ -133,6 +144,16 @@ class ExpressionPiece {
   // @see Special_T
   bool IsSpecialParameter() const;
 
+  // Whether this is a literal integer, which can be read with
+  // GetIntegerConstant() without a machine.
+  bool IsIntegerConstant() const;
+  int GetIntegerConstant() const;
+
+  // Whether this is a literal string, which can be read with
+  // GetStringConstant() without a machine.
+  bool IsStringConstant() const;
+  StringPiece GetStringConstant() const;
+
   // Returns the value type of this expression (i.e. string or
   // integer)
   ExpressionValueType GetExpressionValueType() const;
@@ -146,8 +167,20 @@ class ExpressionPiece {
   // a memory access or a calculation based on some subexpressions.
   int GetIntegerValue(RLMachine& machine) const;
 
-  void SetStringValue(RLMachine& machine, const std::string& rvalue);
-  const std::string& GetStringValue(RLMachine& machine) const;
+  // Flattens this expression into a postfix program which GetIntegerValue()
+  // runs instead of walking the tree. Only worth calling on the roots of
+  // expressions that will be evaluated repeatedly; complex and special
+  // expressions compile each of their contained pieces. Expressions which
+  // can't be compiled (string operands, invalid operators) are left to the
+  // tree walker, which reports their errors as before. A piece parsed into
+  // an Arena must be given that |arena|, which then holds its programs too.
+  void Compile(Arena* arena = NULL);
+
+  // Whether Compile() produced a program for this piece.
+  bool IsCompiled() const;
+
+  void SetStringValue(RLMachine& machine, StringPiece rvalue);
+  StringPiece GetStringValue(RLMachine& machine) const;
 
   // I used to be able to just static cast any ExpressionPiece to a
   // MemoryReference if I wanted/needed a corresponding iterator. Haeleth's
@@ -173,6 +206,8 @@ class ExpressionPiece {
   int GetOverloadTag() const;
 
  private:
+  friend class ExpressionProgram;
+
   ExpressionPiece();
 
   // Frees all possible memory and sets |piece_type| to TYPE_INVALID.
@@ -197,17 +232,23 @@ class ExpressionPiece {
 
   ExpressionPieceType piece_type;
 
+  // Whether the operand pieces and compiled programs below were placement
+  // new'd into an Arena, in which case Invalidate() doesn't free them.
+  bool operands_in_arena;
+
   union {
     // TYPE_INT_CONSTANT
     int int_constant;
 
-    // TYPE_STRING_CONSTANT
-    std::string str_constant;
+    // TYPE_STRING_CONSTANT, interned so that assigning it to string memory
+    // doesn't copy it.
+    StringPiece str_constant;
 
     // TYPE_MEMORY_REFERENCE
     struct {
       int type;
       ExpressionPiece* location;
+      ExpressionProgram* program;
     } mem_reference;
 
     // TYPE_SIMPLE_MEMORY_REFERENCE
@@ -220,6 +261,7 @@ class ExpressionPiece {
     struct {
       char operation;
       ExpressionPiece* operand;
+      ExpressionProgram* program;
     } uniary_expression;
 
     // TYPE_BINARY_EXPRESSION
@@ -227,6 +269,7 @@ class ExpressionPiece {
       char operation;
       ExpressionPiece* left_operand;
       ExpressionPiece* right_operand;
+      ExpressionProgram* program;
     } binary_expression;
 
     // TYPE_SIMPLE_ASSIGNMENT
@@ -35,6 +35,7 @@
 
 #include <algorithm>
 #include <cassert>
+#include <memory>
 #include <sstream>
 #include <string>
 
@@ -117,7 +118,7 @@ Script::Script(const Header& hdr,
   // Kidoku/entrypoint table
   const int kidoku_offs = read_i32(data + 0x08);
   const size_t kidoku_length = read_i32(data + 0x0c);
-  ConstructionData cdat(kidoku_length, elts_.end());
+  ConstructionData cdat(kidoku_length, &arena_, &parameters_);
   for (size_t i = 0; i < kidoku_length; ++i)
     cdat.kidoku_table[i] = read_i32(data + kidoku_offs + i * 4);
 
@@ -140,44 +141,93 @@ Script::Script(const Header& hdr,
     }
   }
 
-  char* uncompressed = new char[dlen];
+  std::unique_ptr<char[]> uncompressed(new char[dlen]);
   compression::Decompress(data + read_i32(data + 0x20),
                           read_i32(data + 0x28),
-                          uncompressed,
+                          uncompressed.get(),
                           dlen,
                           key);
+  ParseBytecode(uncompressed.get(), dlen, cdat);
+}
+
+Script::~Script() {
+  DestroyElements();
+}
+
+void Script::ParseBytecode(const char* bytecode,
+                           size_t dlen,
+                           ConstructionData& cdat) {
+  // Parsed elements take up roughly four times as much space as their
+  // bytecode, so try to fit them all in one arena block.
+  arena_.Reserve(dlen * 4);
+
   // Read bytecode
-  const char* stream = uncompressed;
-  const char* end = uncompressed + dlen;
-  size_t pos = 0;
-  pointer_t it = elts_.before_begin();
-  while (pos < dlen) {
-    // Read element
-    it = elts_.emplace_after(it, BytecodeElement::Read(stream, end, cdat));
-    cdat.offsets[pos] = it;
-
-    // Keep track of the entrypoints
-    int entrypoint = (*it)->GetEntrypoint();
-    if (entrypoint != BytecodeElement::kInvalidEntrypoint)
-      entrypoint_associations_.emplace(entrypoint, it);
-
-    // Advance
-    size_t l = (*it)->GetBytecodeLength();
-    if (l <= 0)
-      l = 1;  // Failsafe: always advance at least one byte.
-    stream += l;
-    pos += l;
-  }
+  const char* stream = bytecode;
+  const char* end = bytecode + dlen;
+  try {
+    size_t pos = 0;
+    std::vector<size_t> positions;
+    std::map<int, size_t> entrypoints;
+    while (pos < dlen) {
+      // Read element
+      BytecodeElement* element = BytecodeElement::Read(stream, end, cdat);
+      elts_.push_back(element);
+      positions.push_back(pos);
+
+      // Keep track of the entrypoints
+      int entrypoint = element->GetEntrypoint();
+      if (entrypoint != BytecodeElement::kInvalidEntrypoint)
+        entrypoints.emplace(entrypoint, elts_.size() - 1);
+
+      // Advance
+      size_t l = element->GetBytecodeLength();
+      if (l <= 0)
+        l = 1;  // Failsafe: always advance at least one byte.
+      stream += l;
+      pos += l;
+    }
 
-  // Resolve pointers
-  for (auto& element : elts_) {
-    element->SetPointers(cdat);
+    // |elts_| won't grow any more, so iterators into it are now stable.
+    elts_.shrink_to_fit();
+    cdat.offsets.reserve(positions.size());
+    for (size_t i = 0; i < positions.size(); ++i)
+      cdat.offsets.emplace_back(positions[i], elts_.begin() + i);
+    for (auto const& entrypoint : entrypoints)
+      entrypoint_associations_.emplace(entrypoint.first,
+                                       elts_.begin() + entrypoint.second);
+
+    // Resolve pointers
+    for (auto& element : elts_) {
+      element->SetPointers(cdat);
+    }
+
+    MarkFusableElements();
   }
+  catch (...) {
+    DestroyElements();
+    throw;
+  }
+}
 
-  delete[] uncompressed;
+void Script::MarkFusableElements() {
+  fusion_.resize(elts_.size());
+  for (size_t i = 0; i < elts_.size(); ++i) {
+    const MetaElement* meta = dynamic_cast<const MetaElement*>(elts_[i]);
+    if (meta && meta->IsLineMarker())
+      fusion_[i] = Scenario::FUSABLE_LINE_MARKER;
+    else if (elts_[i]->IsFusable())
+      fusion_[i] = Scenario::FUSABLE;
+    else
+      fusion_[i] = Scenario::NOT_FUSABLE;
+  }
 }
 
-Script::~Script() {}
+void Script::DestroyElements() {
+  // Everything the elements own is in |arena_| or |parameters_|, so their
+  // destructors have nothing to do and aren't run.
+  elts_.clear();
+  fusion_.clear();
+}
 
 const pointer_t Script::GetEntrypoint(int entrypoint) const {
   pointernumber::const_iterator it = entrypoint_associations_.find(entrypoint);
@@ -211,4 +261,12 @@ Scenario::const_iterator Scenario::FindEntrypoint(int entrypoint) const {
   return script.GetEntrypoint(entrypoint);
 }
 
+size_t Scenario::ApproximateMemoryUsage() const {
+  return sizeof(*this) + script.arena_.bytes_reserved() +
+         script.elts_.capacity() * sizeof(BytecodeElement*) +
+         script.fusion_.capacity() +
+         script.entrypoint_associations_.size() *
+             (sizeof(Script::pointernumber::value_type) + 4 * sizeof(void*));
+}
+
 }  // namespace libreallive
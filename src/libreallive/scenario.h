@@ -36,6 +36,7 @@
 
 #include <string>
 
+#include "libreallive/arena.h"
 #include "libreallive/defs.h"
 #include "libreallive/bytecode.h"
 
@@ -76,9 +77,21 @@ class Scenario {
   const_iterator begin() const  { return script.elts_.cbegin(); }
   const_iterator end() const    { return script.elts_.cend();   }
 
+  // How the interpreter may run the element at |it| together with the
+  // elements after it. Line markers are told apart so that they can be run
+  // without a virtual call.
+  enum Fusion { NOT_FUSABLE, FUSABLE, FUSABLE_LINE_MARKER };
+  Fusion GetFusion(const_iterator it) const {
+    return static_cast<Fusion>(script.fusion_[it - begin()]);
+  }
+
   // Locate the entrypoint
   const_iterator FindEntrypoint(int entrypoint) const;
 
+  // Rough number of bytes held by the parsed script. Doesn't count the
+  // expression trees that commands build lazily.
+  size_t ApproximateMemoryUsage() const;
+
  private:
   Header header;
   Script script;
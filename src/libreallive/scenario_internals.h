@@ -86,8 +86,27 @@ class Script {
          bool use_xor_2, const compression::XorKey* second_level_xor_key);
   ~Script();
 
+  // Builds |elts_| and the entrypoint table from decompressed bytecode.
+  void ParseBytecode(const char* bytecode, size_t length,
+                     ConstructionData& cdat);
+
+  // Post-parse pass that fills |fusion_| from |elts_|.
+  void MarkFusableElements();
+
+  // Forgets the elements in |elts_|; their memory is freed with |arena_|.
+  void DestroyElements();
+
+  // Holds the elements themselves; |elts_| points into it in bytecode order.
+  Arena arena_;
   BytecodeList elts_;
 
+  // The parameters commands in |elts_| parse at runtime.
+  ParsedParameterStore parameters_;
+
+  // For each element of |elts_|, its Scenario::Fusion. Kept beside the
+  // elements so the interpreter doesn't need a virtual call to ask.
+  std::vector<char> fusion_;
+
   // Entrypoint handeling
   typedef std::map<int, pointer_t> pointernumber;
   pointernumber entrypoint_associations_;
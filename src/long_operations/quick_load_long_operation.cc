@@ -0,0 +1,51 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+
+#include "long_operations/quick_load_long_operation.h"
+
+#include <iostream>
+
+#include "machine/quick_save_ring.h"
+#include "machine/rlmachine.h"
+
+QuickLoadLongOperation::QuickLoadLongOperation(int id) : id_(id) {}
+
+QuickLoadLongOperation::~QuickLoadLongOperation() {}
+
+bool QuickLoadLongOperation::operator()(RLMachine& machine) {
+  // Loading destroys the stack frame that owns us.
+  int id = id_;
+  if (machine.quick_saves().Load(machine, id)) {
+    // Warning: |this| is an invalid pointer now. Returning false is correct
+    // since returning true would pop an unrelated stack frame.
+    return false;
+  }
+
+  std::cerr << "WARNING: Quick save " << id << " is no longer available"
+            << std::endl;
+  return true;
+}
@@ -0,0 +1,51 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+
+#ifndef SRC_LONG_OPERATIONS_QUICK_LOAD_LONG_OPERATION_H_
+#define SRC_LONG_OPERATIONS_QUICK_LOAD_LONG_OPERATION_H_
+
+#include "machine/long_operation.h"
+
+class RLMachine;
+
+// Loads a save from the machine's QuickSaveRing once the current instruction
+// has finished. Loading replaces the call stack, which can't happen in the
+// middle of an instruction (or a line action run by one). Unlike
+// LoadGameLongOperation, there's no fade.
+class QuickLoadLongOperation : public LongOperation {
+ public:
+  explicit QuickLoadLongOperation(int id);
+  virtual ~QuickLoadLongOperation();
+
+  // Overridden from LongOperation:
+  virtual bool operator()(RLMachine& machine) override;
+
+ private:
+  int id_;
+};
+
+#endif  // SRC_LONG_OPERATIONS_QUICK_LOAD_LONG_OPERATION_H_
@@ -68,8 +68,8 @@ SelectLongOperation::SelectLongOperation(RLMachine& machine,
     o.enabled = true;
     o.use_colour = false;
 
-    std::string evaluated_native =
-        libreallive::EvaluatePRINT(machine, param.text);
+    std::string evaluated_native = libreallive::EvaluatePRINT(
+        machine, std::string(param.text.data(), param.text.size()));
     o.str = cp932toUTF8(evaluated_native, machine.GetTextEncoding());
 
     for (auto const& condition : param.cond_parsed) {
@@ -113,10 +113,13 @@ SelectLongOperation::SelectLongOperation(RLMachine& machine,
         default:
           cerr << "Unsupported option in select statement "
                << "(condition: "
-               << libreallive::ParsableToPrintableString(condition.condition)
+               << libreallive::ParsableToPrintableString(std::string(
+                      condition.condition.data(), condition.condition.size()))
                << ", effect: " << condition.effect << ", effect_argument: "
                << libreallive::ParsableToPrintableString(
-                      condition.effect_argument) << ")" << endl;
+                      std::string(condition.effect_argument.data(),
+                                  condition.effect_argument.size()))
+               << ")" << endl;
           break;
       }
     }
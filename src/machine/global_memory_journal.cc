@@ -0,0 +1,275 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+
+#include "machine/global_memory_journal.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <istream>
+#include <string>
+
+#include "libreallive/intmemref.h"
+#include "machine/memory.h"
+
+namespace {
+
+const char JOURNAL_MAGIC[8] = {'R', 'L', 'V', 'M', 'J', 'R', 'N', 'L'};
+// Version 2 added the checkpoint generation after the version.
+const uint32_t JOURNAL_VERSION = 2;
+const size_t JOURNAL_HEADER_SIZE = sizeof(JOURNAL_MAGIC) + 4 + 4;
+
+// Record types. Each is followed by little-endian fields:
+enum RecordType {
+  // u8 bank (INTG_LOCATION or INTZ_LOCATION), u16 location, i32 value.
+  RECORD_INT = 1,
+  // u16 location, u32 length, bytes.
+  RECORD_STRING = 2,
+  // u16 index, u32 length, bytes.
+  RECORD_NAME = 3,
+  // i32 scenario, i32 kidoku.
+  RECORD_KIDOKU = 4
+};
+
+void Append8(std::string& out, int value) { out.push_back(value & 0xff); }
+
+void Append16(std::string& out, int value) {
+  out.push_back(value & 0xff);
+  out.push_back((value >> 8) & 0xff);
+}
+
+void Append32(std::string& out, uint32_t value) {
+  for (int i = 0; i < 4; ++i)
+    out.push_back((value >> (i * 8)) & 0xff);
+}
+
+void AppendString(std::string& out, StringPiece value) {
+  Append32(out, value.size());
+  value.AppendToString(&out);
+}
+
+// Reads fields out of a record, failing once the data runs out.
+class RecordReader {
+ public:
+  explicit RecordReader(std::istream& iss) : iss_(iss) {}
+
+  bool ok() const { return ok_; }
+  size_t bytes_read() const { return bytes_read_; }
+
+  uint32_t Read(int bytes) {
+    unsigned char buf[4] = {0};
+    Fill(reinterpret_cast<char*>(buf), bytes);
+    uint32_t value = 0;
+    for (int i = 0; i < bytes; ++i)
+      value |= uint32_t(buf[i]) << (i * 8);
+    return value;
+  }
+
+  std::string ReadString() {
+    uint32_t length = Read(4);
+    std::string value;
+    // Guard against garbage lengths in a torn record.
+    if (ok_ && length <= (1u << 20)) {
+      value.resize(length);
+      Fill(&value[0], length);
+    } else {
+      ok_ = false;
+    }
+    return value;
+  }
+
+ private:
+  void Fill(char* out, size_t bytes) {
+    if (!ok_ || bytes == 0)
+      return;
+    iss_.read(out, bytes);
+    if (static_cast<size_t>(iss_.gcount()) != bytes)
+      ok_ = false;
+    else
+      bytes_read_ += bytes;
+  }
+
+  std::istream& iss_;
+  bool ok_ = true;
+  size_t bytes_read_ = 0;
+};
+
+}  // namespace
+
+const size_t GlobalMemoryJournal::kCompactionThreshold = 64 * 1024;
+
+GlobalMemoryJournal::GlobalMemoryJournal() {}
+
+void GlobalMemoryJournal::RecordInt(int bank, int location, int value) {
+  if (!enabled_)
+    return;
+  Append8(pending_, RECORD_INT);
+  Append8(pending_, bank);
+  Append16(pending_, location);
+  Append32(pending_, value);
+}
+
+void GlobalMemoryJournal::RecordString(int location, StringPiece value) {
+  if (!enabled_)
+    return;
+  Append8(pending_, RECORD_STRING);
+  Append16(pending_, location);
+  AppendString(pending_, value);
+}
+
+void GlobalMemoryJournal::RecordName(int index, StringPiece value) {
+  if (!enabled_)
+    return;
+  Append8(pending_, RECORD_NAME);
+  Append16(pending_, index);
+  AppendString(pending_, value);
+}
+
+void GlobalMemoryJournal::RecordKidoku(int scenario, int kidoku) {
+  if (!enabled_)
+    return;
+  Append8(pending_, RECORD_KIDOKU);
+  Append32(pending_, scenario);
+  Append32(pending_, kidoku);
+}
+
+bool GlobalMemoryJournal::CanAppend(const std::string& settings,
+                                    int write_failures) const {
+  return enabled_ && has_checkpoint_ && write_failures == write_failures_ &&
+         settings == settings_ &&
+         journal_bytes_ + pending_.size() <= kCompactionThreshold;
+}
+
+std::string GlobalMemoryJournal::TakePending() {
+  std::string out;
+  if (pending_.empty())
+    return out;
+
+  if (journal_bytes_ == 0) {
+    out.append(JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+    Append32(out, JOURNAL_VERSION);
+    Append32(out, generation_);
+  }
+  out.append(pending_);
+  pending_.clear();
+
+  journal_bytes_ += out.size();
+  return out;
+}
+
+void GlobalMemoryJournal::MarkCheckpointed(const std::string& settings,
+                                           int write_failures) {
+  has_checkpoint_ = true;
+  settings_ = settings;
+  write_failures_ = write_failures;
+  generation_++;
+  journal_bytes_ = 0;
+  pending_.clear();
+}
+
+void GlobalMemoryJournal::MarkLoaded(const std::string& settings,
+                                     size_t journal_bytes,
+                                     int write_failures) {
+  has_checkpoint_ = true;
+  settings_ = settings;
+  write_failures_ = write_failures;
+  journal_bytes_ = journal_bytes;
+}
+
+// static
+size_t GlobalMemoryJournal::Replay(std::istream& iss,
+                                   uint32_t generation,
+                                   GlobalMemory& memory) {
+  char magic[sizeof(JOURNAL_MAGIC)];
+  if (!iss.read(magic, sizeof(magic)) ||
+      !std::equal(magic, magic + sizeof(magic), JOURNAL_MAGIC)) {
+    return 0;
+  }
+
+  RecordReader header(iss);
+  if (header.Read(4) != JOURNAL_VERSION || header.Read(4) != generation ||
+      !header.ok()) {
+    return 0;
+  }
+
+  size_t applied = JOURNAL_HEADER_SIZE;
+  while (true) {
+    RecordReader reader(iss);
+    int type = reader.Read(1);
+    if (!reader.ok())
+      break;
+
+    switch (type) {
+      case RECORD_INT: {
+        int bank = reader.Read(1);
+        int location = reader.Read(2);
+        int value = static_cast<int32_t>(reader.Read(4));
+        if (!reader.ok() || location >= SIZE_OF_MEM_BANK)
+          return applied;
+        if (bank == libreallive::INTG_LOCATION)
+          memory.intG[location] = value;
+        else if (bank == libreallive::INTZ_LOCATION)
+          memory.intZ[location] = value;
+        else
+          return applied;
+        break;
+      }
+      case RECORD_STRING: {
+        int location = reader.Read(2);
+        std::string value = reader.ReadString();
+        if (!reader.ok() || location >= SIZE_OF_MEM_BANK)
+          return applied;
+        memory.strM.Set(location, value);
+        break;
+      }
+      case RECORD_NAME: {
+        int index = reader.Read(2);
+        std::string value = reader.ReadString();
+        if (!reader.ok() || index >= SIZE_OF_NAME_BANK)
+          return applied;
+        memory.global_names.Set(index, value);
+        break;
+      }
+      case RECORD_KIDOKU: {
+        int scenario = static_cast<int32_t>(reader.Read(4));
+        int kidoku = static_cast<int32_t>(reader.Read(4));
+        if (!reader.ok() || kidoku < 0)
+          return applied;
+        boost::dynamic_bitset<>& bitset = memory.kidoku_data[scenario];
+        if (bitset.size() <= static_cast<size_t>(kidoku))
+          bitset.resize(kidoku + 1, false);
+        bitset[kidoku] = true;
+        break;
+      }
+      default:
+        return applied;
+    }
+
+    applied += reader.bytes_read();
+  }
+
+  return applied;
+}
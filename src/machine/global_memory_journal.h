@@ -0,0 +1,138 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+
+#ifndef SRC_MACHINE_GLOBAL_MEMORY_JOURNAL_H_
+#define SRC_MACHINE_GLOBAL_MEMORY_JOURNAL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+#include "machine/string_bank.h"
+
+struct GlobalMemory;
+
+// An append-only log of changes to GlobalMemory, so that the common case of
+// saving global memory (a few kidoku bits or flags changed since the last
+// save) appends a few bytes to a journal file instead of rewriting every
+// bank.
+//
+// Saving global memory either appends the records taken by TakePending() to
+// the journal file or, when the journal has grown past a threshold or
+// something outside GlobalMemory (the System globals) has changed, writes a
+// full checkpoint and deletes the journal. Loading replays the journal on top
+// of the checkpoint.
+//
+// Every record sets a value outright (or sets a kidoku bit), so replaying
+// records in order reproduces the state at the last append. Each checkpoint
+// starts a new generation, which is stored in the checkpoint and in the
+// journal file's header. The old journal is only deleted once the new
+// checkpoint has been renamed into place (see SaveWriter::QueueWrite()), and
+// a crash in between leaves a journal from the previous generation, which
+// loading ignores instead of replaying its stale records over the newer
+// checkpoint.
+//
+// Records are only kept once Enable() has been called, so machines that never
+// persist global memory don't accumulate them.
+class GlobalMemoryJournal {
+ public:
+  GlobalMemoryJournal();
+
+  void Enable() { enabled_ = true; }
+  bool enabled() const { return enabled_; }
+
+  // Record changes the caller makes to GlobalMemory.
+  void RecordInt(int bank, int location, int value);
+  void RecordString(int location, StringPiece value);
+  void RecordName(int index, StringPiece value);
+  void RecordKidoku(int scenario, int kidoku);
+
+  // Whether the pending records can be appended to the journal file instead
+  // of writing a checkpoint. |settings| is the serialized state stored next to
+  // GlobalMemory in the checkpoint, which the journal doesn't track.
+  // |write_failures| is the number of failed writes reported so far; a failed
+  // append may have left the journal file short, so any new failure forces a
+  // checkpoint.
+  bool CanAppend(const std::string& settings, int write_failures) const;
+
+  // Returns the pending records as bytes to append to the journal file,
+  // preceded by the file header if the file doesn't exist yet.
+  std::string TakePending();
+
+  // Notes that a checkpoint including every change so far, and |settings|,
+  // is about to be queued, and that the journal file is being deleted. Starts
+  // a new generation, so call this before snapshotting the checkpoint.
+  void MarkCheckpointed(const std::string& settings, int write_failures);
+
+  // The generation of the checkpoint that the journal file extends. Zero
+  // until a checkpoint is written or loaded.
+  uint32_t generation() const { return generation_; }
+  void set_generation(uint32_t generation) { generation_ = generation; }
+
+  // Notes that the global memory file was loaded, with |settings|, and that
+  // |journal_bytes| of a clean journal were replayed on top of it.
+  void MarkLoaded(const std::string& settings,
+                  size_t journal_bytes,
+                  int write_failures);
+
+  // Applies the records in the journal file |iss| to |memory|. Returns the
+  // number of bytes of whole records (including the header) that were
+  // applied, which is less than the file size when the last append was torn
+  // by a crash, or zero if |iss| isn't a journal or extends a checkpoint
+  // other than |generation|.
+  static size_t Replay(std::istream& iss,
+                       uint32_t generation,
+                       GlobalMemory& memory);
+
+  // Once the journal file reaches this size, the next save writes a
+  // checkpoint instead.
+  static const size_t kCompactionThreshold;
+
+ private:
+  bool enabled_ = false;
+
+  // Whether there is a checkpoint on disk that the journal file extends.
+  bool has_checkpoint_ = false;
+
+  // The settings stored in that checkpoint.
+  std::string settings_;
+
+  // Failed writes that had been reported when the checkpoint was taken.
+  int write_failures_ = 0;
+
+  // See generation().
+  uint32_t generation_ = 0;
+
+  // Size of the journal file once every taken record has been appended.
+  size_t journal_bytes_ = 0;
+
+  // Records not yet taken.
+  std::string pending_;
+};
+
+#endif  // SRC_MACHINE_GLOBAL_MEMORY_JOURNAL_H_
@@ -0,0 +1,131 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+#include "machine/image_prefetcher.h"
+
+#include <algorithm>
+
+#include "libreallive/bytecode.h"
+#include "libreallive/expression.h"
+#include "libreallive/scenario.h"
+#include "machine/stack_frame.h"
+#include "systems/base/graphics_system.h"
+
+using libreallive::CommandElement;
+using libreallive::ExpressionPiece;
+
+namespace {
+
+// Module numbers of the commands that take image file names.
+const int kGrpModule = 33;
+const int kBgrModule = 40;
+const int kObjFgCreationModule = 71;
+const int kObjBgCreationModule = 72;
+
+// objOfText takes a string too, but it's the text to display.
+const int kObjOfTextOpcode = 1200;
+
+bool LoadsImages(const CommandElement& command) {
+  switch (command.module()) {
+    case kGrpModule:
+    case kBgrModule:
+      return command.modtype() == 1;
+    case kObjFgCreationModule:
+    case kObjBgCreationModule:
+      // Type 2 is the child object version of the same module.
+      return (command.modtype() == 1 || command.modtype() == 2) &&
+             command.opcode() != kObjOfTextOpcode;
+    default:
+      return false;
+  }
+}
+
+}  // namespace
+
+ImagePrefetcher::ImagePrefetcher(GraphicsSystem& graphics, int lookahead)
+    : graphics_(graphics),
+      lookahead_(lookahead),
+      scenario_(nullptr),
+      scanned_begin_(0),
+      scanned_end_(0) {}
+
+ImagePrefetcher::~ImagePrefetcher() {}
+
+void ImagePrefetcher::Scan(const StackFrame& frame) {
+  const libreallive::Scenario* scenario = frame.scenario;
+  size_t ip = frame.ip - scenario->begin();
+  if (scenario != scenario_ || ip < scanned_begin_ || ip > scanned_end_) {
+    // We jumped out of the window; start a new one here.
+    scenario_ = scenario;
+    scanned_begin_ = scanned_end_ = ip;
+  }
+
+  size_t size = scenario->end() - scenario->begin();
+  size_t end = std::min(ip + lookahead_, size);
+  if (scanned_end_ >= end)
+    return;
+
+  names_.clear();
+  for (auto it = scenario->begin() + scanned_end_;
+       it != scenario->begin() + end;
+       ++it) {
+    const CommandElement* command = dynamic_cast<const CommandElement*>(*it);
+    if (command && CollectImageNames(*command, names_))
+      stats_.commands++;
+  }
+  scanned_end_ = end;
+
+  for (const std::string& name : names_) {
+    graphics_.PrefetchSurface(name);
+    stats_.names++;
+  }
+}
+
+// static
+bool ImagePrefetcher::CollectImageNames(const CommandElement& command,
+                                        std::vector<std::string>& names) {
+  if (!LoadsImages(command))
+    return false;
+
+  for (size_t i = 0; i < command.GetParamCount(); ++i) {
+    std::string param = command.GetParam(i);
+    const char* src = param.c_str();
+    try {
+      ExpressionPiece piece = libreallive::GetData(src);
+
+      // "???" stands for the default grp or bgr name, which is only known at
+      // runtime.
+      if (piece.IsStringConstant() && !piece.GetStringConstant().empty() &&
+          piece.GetStringConstant() != "???") {
+        names.push_back(piece.GetStringConstant().as_string());
+      }
+    } catch (std::exception& e) {
+      // Malformed parameters are reported when the command runs.
+    }
+  }
+
+  return true;
+}
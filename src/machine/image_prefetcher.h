@@ -0,0 +1,92 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+#ifndef SRC_MACHINE_IMAGE_PREFETCHER_H_
+#define SRC_MACHINE_IMAGE_PREFETCHER_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace libreallive {
+class CommandElement;
+class Scenario;
+}  // namespace libreallive
+
+class GraphicsSystem;
+struct StackFrame;
+
+// Reads ahead of the instruction pointer for grp, bgr and object creation
+// commands that name their image with a string constant, and has the
+// GraphicsSystem start decoding those images in the background. Scripts
+// usually load an image a few lines before it is shown, so by the time the
+// command runs the image is often already decoded and waiting in the cache.
+//
+// Only the elements between the instruction pointer and |lookahead| elements
+// past it are looked at, and each element is only looked at once while the
+// interpreter moves through that window.
+class ImagePrefetcher {
+ public:
+  ImagePrefetcher(GraphicsSystem& graphics, int lookahead);
+  ~ImagePrefetcher();
+
+  // Scans whatever part of the window ahead of |frame|'s instruction pointer
+  // hasn't been scanned yet. Cheap when there's nothing new.
+  void Scan(const StackFrame& frame);
+
+  // Appends the image names that |command| passes as string constants and
+  // returns true, if it is one of the commands that load images.
+  static bool CollectImageNames(const libreallive::CommandElement& command,
+                                std::vector<std::string>& names);
+
+  struct Stats {
+    Stats() : commands(0), names(0) {}
+
+    // Image loading commands scanned.
+    int commands;
+
+    // Image names handed to the GraphicsSystem, including ones it already
+    // had cached.
+    int names;
+  };
+  const Stats& stats() const { return stats_; }
+
+ private:
+  GraphicsSystem& graphics_;
+  const size_t lookahead_;
+
+  // The scenario being scanned and the range of element indices in it that
+  // has already been scanned.
+  const libreallive::Scenario* scenario_;
+  size_t scanned_begin_;
+  size_t scanned_end_;
+
+  std::vector<std::string> names_;
+
+  Stats stats_;
+};
+
+#endif  // SRC_MACHINE_IMAGE_PREFETCHER_H_
@@ -54,7 +54,8 @@ const IntegerBank_t GLOBAL_INTEGER_BANKS = {
 // -----------------------------------------------------------------------
 // GlobalMemory
 // -----------------------------------------------------------------------
-GlobalMemory::GlobalMemory() {
+GlobalMemory::GlobalMemory()
+    : strM(SIZE_OF_MEM_BANK), global_names(SIZE_OF_NAME_BANK) {
   memset(intG, 0, sizeof(intG));
   memset(intZ, 0, sizeof(intZ));
 }
@@ -62,9 +63,13 @@ GlobalMemory::GlobalMemory() {
 // -----------------------------------------------------------------------
 // LocalMemory
 // -----------------------------------------------------------------------
-LocalMemory::LocalMemory() { reset(); }
+LocalMemory::LocalMemory()
+    : strS(SIZE_OF_MEM_BANK), local_names(SIZE_OF_NAME_BANK) {
+  reset();
+}
 
-LocalMemory::LocalMemory(dont_initialize) {}
+LocalMemory::LocalMemory(dont_initialize)
+    : strS(SIZE_OF_MEM_BANK), local_names(SIZE_OF_NAME_BANK) {}
 
 void LocalMemory::reset() {
   memset(intA, 0, sizeof(intA));
@@ -74,10 +79,8 @@ void LocalMemory::reset() {
   memset(intE, 0, sizeof(intE));
   memset(intF, 0, sizeof(intF));
 
-  for (int i = 0; i < SIZE_OF_MEM_BANK; ++i)
-    strS[i].clear();
-  for (int i = 0; i < SIZE_OF_NAME_BANK; ++i)
-    local_names[i].clear();
+  strS.Clear();
+  local_names.Clear();
 }
 
 // -----------------------------------------------------------------------
@@ -119,50 +122,57 @@ void Memory::ConnectIntVarPointers() {
   original_int_var[7] = NULL;
 }
 
-const std::string& Memory::GetStringValue(int type, int location) {
+StringPiece Memory::GetStringValue(int type, int location) {
   if (location > (SIZE_OF_MEM_BANK - 1))
     throw rlvm::Exception(
         "Invalid range access in RLMachine::set_string_value");
 
   switch (type) {
-    case libreallive::STRK_LOCATION:
-      if ((location + 1) > machine_.CurrentStrKBank().size())
-        machine_.CurrentStrKBank().resize(location + 1);
-      return machine_.CurrentStrKBank()[location];
+    case libreallive::STRK_LOCATION: {
+      // Reading must not grow the bank: operations hold references to
+      // several strK values at once, and growing it would move them.
+      std::vector<std::string>& bank = machine_.CurrentStrKBank();
+      if (location >= bank.size())
+        return StringPiece();
+      return bank[location];
+    }
     case libreallive::STRM_LOCATION:
-      return global_->strM[location];
+      return global_->strM.Get(location);
     case libreallive::STRS_LOCATION:
-      return local_.strS[location];
+      return local_.strS.Get(location);
     default:
       throw rlvm::Exception("Invalid type in RLMachine::get_string_value");
   }
 }
 
-void Memory::SetStringValue(int type, int number, const std::string& value) {
+void Memory::SetStringValue(int type, int number, StringPiece value) {
   if (number > (SIZE_OF_MEM_BANK - 1))
     throw rlvm::Exception(
         "Invalid range access in RLMachine::set_string_value");
 
   switch (type) {
-    case libreallive::STRK_LOCATION:
-      if ((number + 1) > machine_.CurrentStrKBank().size())
-        machine_.CurrentStrKBank().resize(number + 1);
-      machine_.CurrentStrKBank()[number] = value;
+    case libreallive::STRK_LOCATION: {
+      std::vector<std::string>& bank = machine_.CurrentStrKBank();
+      if ((number + 1) > bank.size()) {
+        // |value| may refer to an element of |bank|, which growing it would
+        // move.
+        std::string copy = value.as_string();
+        bank.resize(number + 1);
+        bank[number] = std::move(copy);
+      } else {
+        bank[number].assign(value.data(), value.size());
+      }
       break;
+    }
     case libreallive::STRM_LOCATION:
-      global_->strM[number] = value;
+      global_->journal.RecordString(number, value);
+      global_->strM.Set(number, value);
       break;
-    case libreallive::STRS_LOCATION: {
+    case libreallive::STRS_LOCATION:
       // Possibly record the original value for a piece of local memory.
-      std::map<int, std::string>::iterator it =
-          local_.original_strS.find(number);
-      if (it == local_.original_strS.end()) {
-        local_.original_strS.insert(
-            std::make_pair(number, local_.strS[number]));
-      }
-      local_.strS[number] = value;
+      local_.original_strS.Record(local_.strS, number);
+      local_.strS.Set(number, value);
       break;
-    }
     default:
       throw rlvm::Exception("Invalid type in RLMachine::set_string_value");
   }
@@ -176,24 +186,25 @@ void Memory::CheckNameIndex(int index, const std::string& name) const {
   }
 }
 
-void Memory::SetName(int index, const std::string& name) {
+void Memory::SetName(int index, StringPiece name) {
   CheckNameIndex(index, "Memory::set_name");
-  global_->global_names[index] = name;
+  global_->journal.RecordName(index, name);
+  global_->global_names.Set(index, name);
 }
 
-const std::string& Memory::GetName(int index) const {
+StringPiece Memory::GetName(int index) const {
   CheckNameIndex(index, "Memory::get_name");
-  return global_->global_names[index];
+  return global_->global_names.Get(index);
 }
 
-void Memory::SetLocalName(int index, const std::string& name) {
+void Memory::SetLocalName(int index, StringPiece name) {
   CheckNameIndex(index, "Memory::set_local_name");
-  local_.local_names[index] = name;
+  local_.local_names.Set(index, name);
 }
 
-const std::string& Memory::GetLocalName(int index) const {
+StringPiece Memory::GetLocalName(int index) const {
   CheckNameIndex(index, "Memory::set_local_name");
-  return local_.local_names[index];
+  return local_.local_names.Get(index);
 }
 
 bool Memory::HasBeenRead(int scenario, int kidoku) const {
@@ -212,7 +223,12 @@ void Memory::RecordKidoku(int scenario, int kidoku) {
   if (bitset.size() <= static_cast<size_t>(kidoku))
     bitset.resize(kidoku + 1, false);
 
-  bitset[kidoku] = true;
+  // Most calls are for lines that have already been read, which shouldn't
+  // grow the journal.
+  if (!bitset[kidoku]) {
+    bitset[kidoku] = true;
+    global_->journal.RecordKidoku(scenario, kidoku);
+  }
 }
 
 void Memory::TakeSavepointSnapshot() {
@@ -33,6 +33,7 @@
 #include <boost/serialization/version.hpp>
 
 #include <algorithm>
+#include <bitset>
 #include <map>
 #include <memory>
 #include <string>
@@ -40,6 +41,8 @@
 #include <vector>
 
 #include "libreallive/intmemref.h"
+#include "machine/global_memory_journal.h"
+#include "machine/string_bank.h"
 
 const int NUMBER_OF_INT_LOCATIONS = 8;
 const int SIZE_OF_MEM_BANK = 2000;
@@ -53,6 +56,24 @@ extern const IntegerBank_t GLOBAL_INTEGER_BANKS;
 class RLMachine;
 class Gameexe;
 
+// boost::serialization writes a string bank as a plain array of std::string,
+// which is what the banks were before they were StringBanks.
+template <int N, class Archive>
+void SaveStringBank(Archive& ar, const StringBank& bank) {
+  std::string values[N];
+  for (int i = 0; i < N; ++i)
+    values[i] = bank.Get(i).as_string();
+  ar& values;
+}
+
+template <int N, class Archive>
+void LoadStringBank(Archive& ar, StringBank& bank) {
+  std::string values[N];
+  ar& values;
+  for (int i = 0; i < N; ++i)
+    bank.Set(i, values[i]);
+}
+
 // Struct that represents Global Memory. In any one rlvm process, there
 // should only be one GlobalMemory struct existing, as it will be
 // shared over all the Memory objects in the process.
@@ -62,31 +83,93 @@ struct GlobalMemory {
   int intG[SIZE_OF_MEM_BANK];
   int intZ[SIZE_OF_MEM_BANK];
 
-  std::string strM[SIZE_OF_MEM_BANK];
+  StringBank strM;
 
-  std::string global_names[SIZE_OF_NAME_BANK];
+  StringBank global_names;
 
   // A mapping from a scenario number to a dynamic bitset, where each bit
   // represents a specific kidoku bit.
   std::map<int, boost::dynamic_bitset<>> kidoku_data;
 
+  // Changes made since the last time global memory was saved. Not
+  // serialized; see serialization_global.cc.
+  GlobalMemoryJournal journal;
+
   // boost::serialization
   template <class Archive>
-  void serialize(Archive& ar, unsigned int version) {
-    ar& intG& intZ& strM;
+  void save(Archive& ar, unsigned int version) const {
+    ar& intG& intZ;
+    SaveStringBank<SIZE_OF_MEM_BANK>(ar, strM);
+    SaveStringBank<SIZE_OF_NAME_BANK>(ar, global_names);
+    ar& kidoku_data;
+  }
+
+  template <class Archive>
+  void load(Archive& ar, unsigned int version) {
+    ar& intG& intZ;
+    LoadStringBank<SIZE_OF_MEM_BANK>(ar, strM);
 
     // Starting in version 1, \#NAME variable storage were added.
     if (version > 0) {
-      ar& global_names;
+      LoadStringBank<SIZE_OF_NAME_BANK>(ar, global_names);
       ar& kidoku_data;
     }
   }
+
+  BOOST_SERIALIZATION_SPLIT_MEMBER()
 };
 
 BOOST_CLASS_VERSION(GlobalMemory, 1)
 
 struct dont_initialize {};
 
+// The values a memory bank had at the last savepoint, for only those
+// locations which have been written to since. A location's first write marks
+// it dirty and copies the old value into the shadow array; later writes only
+// test the bit.
+template <typename T>
+struct OriginalValues {
+  // Records |bank[location]| as the original value if it hasn't been already.
+  void Record(const T* bank, int location) {
+    if (!dirty[location]) {
+      dirty[location] = true;
+      values[location] = bank[location];
+    }
+  }
+
+  // Forgets every recorded value.
+  void clear() { dirty.reset(); }
+
+  std::bitset<SIZE_OF_MEM_BANK> dirty;
+  T values[SIZE_OF_MEM_BANK];
+};
+
+// OriginalValues for a string bank. Recording copies the old value into a
+// StringBank of its own, which reuses its blocks from one savepoint to the
+// next.
+struct OriginalStrings {
+  OriginalStrings() : values(SIZE_OF_MEM_BANK) {}
+
+  // Records |bank|'s value at |location| if it hasn't been already.
+  void Record(const StringBank& bank, int location) {
+    if (!dirty[location]) {
+      dirty[location] = true;
+      values.Set(location, bank.Get(location));
+    }
+  }
+
+  // Returns |bank|'s value at |location| as it was at the last savepoint.
+  StringPiece Original(const StringBank& bank, int location) const {
+    return dirty[location] ? values.Get(location) : bank.Get(location);
+  }
+
+  // Forgets every recorded value.
+  void clear() { dirty.reset(); }
+
+  std::bitset<SIZE_OF_MEM_BANK> dirty;
+  StringBank values;
+};
+
 // Struct that represents Local Memory. In any one rlvm process, lots
 // of these things will be created, because there are commands
 struct LocalMemory {
@@ -106,35 +189,48 @@ struct LocalMemory {
   int intE[SIZE_OF_MEM_BANK];
   int intF[SIZE_OF_MEM_BANK];
 
-  // Local string bank
-  std::string strS[SIZE_OF_MEM_BANK];
+  StringBank strS;
 
   // When one of our values is changed, we put the original value in here. Why?
   // So that we can save the state of string memory at the time of the last
   // Savepoint(). Instead of doing some sort of copying entire memory banks
   // whenever we hit a Savepoint() call, only reconstruct the original memory
   // when we save.
-  std::map<int, int> original_intA;
-  std::map<int, int> original_intB;
-  std::map<int, int> original_intC;
-  std::map<int, int> original_intD;
-  std::map<int, int> original_intE;
-  std::map<int, int> original_intF;
-  std::map<int, std::string> original_strS;
-
-  std::string local_names[SIZE_OF_NAME_BANK];
-
-  // Combines an array with a log of original values and writes the de-modified
-  // array to |ar|.
+  OriginalValues<int> original_intA;
+  OriginalValues<int> original_intB;
+  OriginalValues<int> original_intC;
+  OriginalValues<int> original_intD;
+  OriginalValues<int> original_intE;
+  OriginalValues<int> original_intF;
+  OriginalStrings original_strS;
+
+  StringBank local_names;
+
+  // Combines an array with a log of original values, giving the array as it
+  // was at the last savepoint.
+  template <typename T>
+  static void CopyRevertingChanges(const T (&a)[SIZE_OF_MEM_BANK],
+                                   const OriginalValues<T>& original,
+                                   T (&merged)[SIZE_OF_MEM_BANK]) {
+    for (int i = 0; i < SIZE_OF_MEM_BANK; ++i)
+      merged[i] = original.dirty[i] ? original.values[i] : a[i];
+  }
+
+  // Combines a string bank with its log of original values.
+  static void CopyRevertingChanges(const StringBank& a,
+                                   const OriginalStrings& original,
+                                   StringBank& merged) {
+    for (int i = 0; i < SIZE_OF_MEM_BANK; ++i)
+      merged.Set(i, original.Original(a, i));
+  }
+
+  // Writes the de-modified array to |ar|.
   template <class Archive, typename T>
   void saveArrayRevertingChanges(Archive& ar,
                                  const T (&a)[SIZE_OF_MEM_BANK],
-                                 const std::map<int, T>& original) const {
+                                 const OriginalValues<T>& original) const {
     T merged[SIZE_OF_MEM_BANK];
-    std::copy(a, a + SIZE_OF_MEM_BANK, merged);
-    for (auto it = original.cbegin(); it != original.cend(); ++it) {
-      merged[it->first] = it->second;
-    }
+    CopyRevertingChanges(a, original, merged);
     ar& merged;
   }
 
@@ -148,14 +244,17 @@ struct LocalMemory {
     saveArrayRevertingChanges(ar, intE, original_intE);
     saveArrayRevertingChanges(ar, intF, original_intF);
 
-    saveArrayRevertingChanges(ar, strS, original_strS);
+    StringBank merged(SIZE_OF_MEM_BANK);
+    CopyRevertingChanges(strS, original_strS, merged);
+    SaveStringBank<SIZE_OF_MEM_BANK>(ar, merged);
 
-    ar& local_names;
+    SaveStringBank<SIZE_OF_NAME_BANK>(ar, local_names);
   }
 
   template <class Archive>
   void load(Archive& ar, unsigned int version) {
-    ar& intA& intB& intC& intD& intE& intF& strS;
+    ar& intA& intB& intC& intD& intE& intF;
+    LoadStringBank<SIZE_OF_MEM_BANK>(ar, strS);
 
     // Starting in version 2, we no longer have the intL and strK in
     // LocalMemory. They were moved to StackFrame because they're stack
@@ -170,7 +269,7 @@ struct LocalMemory {
 
     // Starting in version 1, \#LOCALNAME variable storage were added.
     if (version > 0)
-      ar& local_names;
+      LoadStringBank<SIZE_OF_NAME_BANK>(ar, local_names);
   }
 
   BOOST_SERIALIZATION_SPLIT_MEMBER()
@@ -212,25 +311,26 @@ class Memory {
   // Sets the value of a certain memory location
   void SetIntValue(const libreallive::IntMemRef& ref, int value);
 
-  // Returns the string value of a string memory bank
-  const std::string& GetStringValue(int type, int location);
+  // Returns the string value of a string memory bank. The value is valid
+  // until that location is next written.
+  StringPiece GetStringValue(int type, int location);
 
   // Sets the string value of one of the string banks
-  void SetStringValue(int type, int number, const std::string& value);
+  void SetStringValue(int type, int number, StringPiece value);
 
   // Name table functions:
 
   // Sets the local name slot index to name.
-  void SetName(int index, const std::string& name);
+  void SetName(int index, StringPiece name);
 
   // Returns the local name slot index.
-  const std::string& GetName(int index) const;
+  StringPiece GetName(int index) const;
 
   // Sets the local name slot index to name.
-  void SetLocalName(int index, const std::string& name);
+  void SetLocalName(int index, StringPiece name);
 
   // Returns the local name slot index.
-  const std::string& GetLocalName(int index) const;
+  StringPiece GetLocalName(int index) const;
 
   // Methods that record whether a piece of text has been read. RealLive
   // scripts have a piece of metadata called a kidoku marker which signifies if
@@ -283,7 +383,7 @@ class Memory {
   int* int_var[NUMBER_OF_INT_LOCATIONS];
 
   // Change records for original.
-  std::map<int, int>* original_int_var[NUMBER_OF_INT_LOCATIONS];
+  OriginalValues<int>* original_int_var[NUMBER_OF_INT_LOCATIONS];
 };  // end of class Memory
 
 // Implementation of getting an integer out of an array. Global because we need
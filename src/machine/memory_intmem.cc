@@ -61,14 +61,21 @@ void throwIllegalIndex(const IntMemRef& ref, const std::string& function) {
 }
 
 void saveOriginalValue(int* bank,
-                       std::map<int, int>* original_bank,
+                       OriginalValues<int>* original_bank,
                        int location) {
-  if (bank && original_bank) {
-    std::map<int, int>::iterator it = original_bank->find(location);
-    if (it == original_bank->end()) {
-      original_bank->emplace(location, bank[location]);
-    }
-  }
+  if (bank && original_bank)
+    original_bank->Record(bank, location);
+}
+
+// Journals a write to global memory. |element| is the whole int the write
+// landed in, even for bit-packed writes.
+void recordGlobalValue(GlobalMemory& global,
+                       int index,
+                       const int* bank,
+                       int element) {
+  if (index == libreallive::INTG_LOCATION ||
+      index == libreallive::INTZ_LOCATION)
+    global.journal.RecordInt(index, element, bank[element]);
 }
 
 }  // namespace
@@ -111,7 +118,7 @@ void Memory::SetIntValue(const IntMemRef& ref, int value) {
   int location = ref.location();
 
   int* bank = NULL;
-  std::map<int, int>* original_bank = NULL;
+  OriginalValues<int>* original_bank = NULL;
   if (index == 8) {
     bank = machine_.CurrentIntLBank();
   } else if (index < 0 || index > NUMBER_OF_INT_LOCATIONS) {
@@ -127,6 +134,7 @@ void Memory::SetIntValue(const IntMemRef& ref, int value) {
       throwIllegalIndex(ref, "RLMachine::SetIntValue()");
     saveOriginalValue(bank, original_bank, location);
     bank[location] = value;
+    recordGlobalValue(*global_, index, bank, location);
   } else {
     // Ab[]..G4b[], Z8b[] などを書く
     int factor = 1 << (type - 1);
@@ -140,5 +148,6 @@ void Memory::SetIntValue(const IntMemRef& ref, int value) {
     bank[location / eltsize] =
         (bank[location / eltsize] & ~(eltmask << shift)) | (value & eltmask)
                                                                << shift;
+    recordGlobalValue(*global_, index, bank, location / eltsize);
   }
 }
@@ -0,0 +1,139 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+
+#include "machine/parameter_preparser.h"
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <utility>
+
+#include "libreallive/bytecode.h"
+#include "libreallive/expression.h"
+#include "libreallive/scenario.h"
+#include "machine/rlmachine.h"
+#include "machine/rloperation.h"
+#include "utilities/exception.h"
+#include "utilities/worker_pool.h"
+
+using libreallive::CommandElement;
+using libreallive::ExpressionPiecesVector;
+using libreallive::MetaElement;
+
+struct ParameterPreparser::ParsedScenario {
+  int scene_number;
+  std::vector<std::pair<const CommandElement*, ExpressionPiecesVector>>
+      parameters;
+  std::vector<std::string> errors;
+};
+
+ParameterPreparser::ParameterPreparser(RLMachine& machine)
+    : machine_(machine), pool_(new WorkerPool(1)) {}
+
+ParameterPreparser::~ParameterPreparser() {}
+
+void ParameterPreparser::QueueScenario(
+    const libreallive::Scenario* scenario) {
+  if (!queued_.insert(scenario).second)
+    return;
+
+  in_flight_.insert(scenario->scene_number());
+  finished_.Post(*pool_, [this, scenario] { return ParseScenario(scenario); });
+}
+
+void ParameterPreparser::InstallFinished() {
+  for (const std::unique_ptr<ParsedScenario>& parsed :
+       finished_.TakeFinished()) {
+    for (auto& entry : parsed->parameters) {
+      if (!entry.first->AreParametersParsed()) {
+        entry.first->SetParsedParameters(std::move(entry.second));
+        stats_.commands++;
+      }
+    }
+
+    for (const std::string& error : parsed->errors) {
+      std::cerr << "WARNING: " << error << std::endl;
+      errors_.push_back(error);
+    }
+
+    stats_.scenarios++;
+    stats_.errors += parsed->errors.size();
+    in_flight_.erase(in_flight_.find(parsed->scene_number));
+  }
+}
+
+void ParameterPreparser::WaitUntilIdle() { pool_->WaitUntilIdle(); }
+
+void ParameterPreparser::AddPinnedScenarios(std::set<int>& pinned) const {
+  pinned.insert(in_flight_.begin(), in_flight_.end());
+}
+
+std::unique_ptr<ParameterPreparser::ParsedScenario>
+ParameterPreparser::ParseScenario(const libreallive::Scenario* scenario) {
+  std::unique_ptr<ParsedScenario> parsed(new ParsedScenario);
+  parsed->scene_number = scenario->scene_number();
+
+  int line = 0;
+  for (const libreallive::BytecodeElement* element : *scenario) {
+    if (const MetaElement* meta = dynamic_cast<const MetaElement*>(element)) {
+      if (meta->IsLineMarker())
+        line = meta->value();
+      continue;
+    }
+
+    const CommandElement* command =
+        dynamic_cast<const CommandElement*>(element);
+    if (!command)
+      continue;
+
+    // Commands that nothing handles are reported by the interpreter if it
+    // ever reaches them.
+    RLOperation* op = machine_.GetOperation(*command);
+    if (!op)
+      continue;
+
+    try {
+      ExpressionPiecesVector output;
+      op->ParseParameters(command->GetUnparsedParameters(), output);
+      for (libreallive::ExpressionPiece& piece : output)
+        piece.Compile();
+      parsed->parameters.emplace_back(command, std::move(output));
+    }
+    catch (rlvm::UnimplementedOpcode& e) {
+      // Same as above.
+    }
+    catch (std::exception& e) {
+      std::ostringstream oss;
+      oss << "SEEN" << std::setw(4) << std::setfill('0')
+          << parsed->scene_number << "(Line " << line << "): " << op->name()
+          << ": " << e.what();
+      parsed->errors.push_back(oss.str());
+    }
+  }
+
+  return parsed;
+}
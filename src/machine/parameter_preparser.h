@@ -0,0 +1,125 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+
+#ifndef SRC_MACHINE_PARAMETER_PREPARSER_H_
+#define SRC_MACHINE_PARAMETER_PREPARSER_H_
+
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "utilities/finished_queue.h"
+
+namespace libreallive {
+class Scenario;
+}  // namespace libreallive
+
+class RLMachine;
+class WorkerPool;
+
+// Parses the parameters of every command in a scenario on a background thread
+// when the scenario is loaded, using the RLOperation that will dispatch each
+// command. Type mismatches are reported as soon as the scenario has been
+// parsed instead of when the interpreter reaches the line, and the
+// interpreter finds every command's parameters already parsed.
+//
+// The worker never writes into the bytecode elements, since the interpreter
+// may be lazily parsing the same command at the same time. Finished scenarios
+// are handed back and installed by InstallFinished() on the interpreter
+// thread.
+class ParameterPreparser {
+ public:
+  explicit ParameterPreparser(RLMachine& machine);
+  ~ParameterPreparser();
+
+  // Queues |scenario| to be parsed, unless it has been queued before. The
+  // scenario has to stay loaded until it has been installed; see
+  // AddPinnedScenarios().
+  void QueueScenario(const libreallive::Scenario* scenario);
+
+  // Installs the parameters of every scenario the worker has finished and
+  // prints their type errors. Only takes a lock when there is something to
+  // install.
+  void InstallFinished();
+
+  // Blocks until every queued scenario has been parsed. Doesn't install them.
+  void WaitUntilIdle();
+
+  // Adds the scenarios that are queued or waiting to be installed to
+  // |pinned|, so that the archive doesn't evict them out from under us.
+  void AddPinnedScenarios(std::set<int>& pinned) const;
+
+  struct Stats {
+    Stats() : scenarios(0), commands(0), errors(0) {}
+
+    // Scenarios that have been installed.
+    int scenarios;
+
+    // Commands whose parameters were installed. Commands the interpreter
+    // had already parsed by the time their scenario was installed are not
+    // counted.
+    int commands;
+
+    // Commands whose parameters didn't match their operation's signature.
+    int errors;
+  };
+  const Stats& stats() const { return stats_; }
+
+  // Every type error installed so far, formatted like
+  // "SEEN0042(Line 10): strcpy: <message>".
+  const std::vector<std::string>& errors() const { return errors_; }
+
+ private:
+  struct ParsedScenario;
+
+  // Runs on |pool_|.
+  std::unique_ptr<ParsedScenario> ParseScenario(
+      const libreallive::Scenario* scenario);
+
+  RLMachine& machine_;
+
+  // Every scenario that has been queued. A scenario that is evicted and
+  // decoded again may reuse an old address, in which case it is simply
+  // parsed lazily like before.
+  std::set<const libreallive::Scenario*> queued_;
+
+  // Scene numbers of the queued scenarios that haven't been installed.
+  std::multiset<int> in_flight_;
+
+  // Scenarios the worker has finished.
+  FinishedQueue<std::unique_ptr<ParsedScenario>> finished_;
+
+  Stats stats_;
+  std::vector<std::string> errors_;
+
+  // Declared last so its thread is joined before anything it touches goes
+  // away.
+  std::unique_ptr<WorkerPool> pool_;
+};
+
+#endif  // SRC_MACHINE_PARAMETER_PREPARSER_H_
@@ -0,0 +1,211 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+
+#include "machine/quick_save_ring.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "libreallive/archive.h"
+#include "libreallive/scenario.h"
+#include "machine/memory.h"
+#include "machine/rlmachine.h"
+#include "machine/stack_frame.h"
+#include "systems/base/graphics_system.h"
+#include "systems/base/sound_system.h"
+#include "systems/base/system.h"
+#include "systems/base/text_system.h"
+#include "utilities/exception.h"
+
+namespace {
+
+// A StackFrame as StackFrame::save() writes it. Scenarios are kept by number
+// since the archive may evict and reparse them in the meantime.
+struct SavedFrame {
+  int scene_number;
+  int position;
+  StackFrame::FrameType frame_type;
+  int intL[SIZE_OF_INT_PASSING_MEM];
+  std::vector<std::string> strK;
+};
+
+}  // namespace
+
+struct QuickSaveRing::Slot {
+  explicit Slot(int objects_in_layer)
+      : strS(SIZE_OF_MEM_BANK),
+        local_names(SIZE_OF_NAME_BANK),
+        graphics(objects_in_layer) {}
+
+  // The save in this slot, or -1.
+  int id = -1;
+
+  int line = 0;
+  std::vector<SavedFrame> call_stack;
+
+  // LocalMemory as of the savepoint.
+  int intA[SIZE_OF_MEM_BANK];
+  int intB[SIZE_OF_MEM_BANK];
+  int intC[SIZE_OF_MEM_BANK];
+  int intD[SIZE_OF_MEM_BANK];
+  int intE[SIZE_OF_MEM_BANK];
+  int intF[SIZE_OF_MEM_BANK];
+  StringBank strS;
+  StringBank local_names;
+
+  GraphicsSystem::SavepointState graphics;
+
+  int text_window = 0;
+  int text_cursor = 0;
+
+  std::string bgm_name;
+  bool bgm_looping = false;
+};
+
+QuickSaveRing::QuickSaveRing(int slots, int objects_in_layer) {
+  for (int i = 0; i < slots; ++i)
+    slots_.emplace_back(new Slot(objects_in_layer));
+}
+
+QuickSaveRing::~QuickSaveRing() {}
+
+int QuickSaveRing::Save(RLMachine& machine) {
+  if (machine.savepoint_call_stack_.empty())
+    throw rlvm::Exception("Can't quick save before the first savepoint");
+
+  Slot& slot = *slots_[next_id_ % slots_.size()];
+  slot.id = next_id_++;
+  slot.line = machine.line_number();
+
+  // Resized rather than rebuilt so the frames' strK vectors keep their
+  // storage between saves.
+  slot.call_stack.resize(machine.savepoint_call_stack_.size());
+  for (size_t i = 0; i < slot.call_stack.size(); ++i) {
+    const StackFrame& frame = machine.savepoint_call_stack_[i];
+    SavedFrame& saved = slot.call_stack[i];
+    saved.scene_number = frame.scenario->scene_number();
+    saved.position = std::distance(frame.scenario->begin(), frame.ip);
+    saved.frame_type = frame.frame_type;
+    std::copy(frame.intL, frame.intL + SIZE_OF_INT_PASSING_MEM, saved.intL);
+    saved.strK = frame.strK;
+  }
+
+  const LocalMemory& local = machine.memory().local();
+  LocalMemory::CopyRevertingChanges(local.intA, local.original_intA, slot.intA);
+  LocalMemory::CopyRevertingChanges(local.intB, local.original_intB, slot.intB);
+  LocalMemory::CopyRevertingChanges(local.intC, local.original_intC, slot.intC);
+  LocalMemory::CopyRevertingChanges(local.intD, local.original_intD, slot.intD);
+  LocalMemory::CopyRevertingChanges(local.intE, local.original_intE, slot.intE);
+  LocalMemory::CopyRevertingChanges(local.intF, local.original_intF, slot.intF);
+  LocalMemory::CopyRevertingChanges(local.strS, local.original_strS, slot.strS);
+  slot.local_names = local.local_names;
+
+  System& system = machine.system();
+  system.graphics().CopySavepointStateTo(slot.graphics, true);
+  slot.text_window = system.text().savepoint_active_window();
+  slot.text_cursor = system.text().savepoint_cursor_number();
+
+  // Like SoundSystem::save(), this is the music playing now.
+  SoundSystem& sound = system.sound();
+  if (sound.BgmStatus() == 1) {
+    slot.bgm_name = sound.GetBgmName();
+    slot.bgm_looping = sound.BgmLooping();
+  } else {
+    slot.bgm_name.clear();
+    slot.bgm_looping = false;
+  }
+
+  return slot.id;
+}
+
+bool QuickSaveRing::Contains(int id) const {
+  return id >= 0 && slots_[id % slots_.size()]->id == id;
+}
+
+bool QuickSaveRing::Load(RLMachine& machine, int id) {
+  if (!Contains(id))
+    return false;
+  Slot& slot = *slots_[id % slots_.size()];
+
+  // Resolve the scenarios first so a bad save can't leave a half loaded
+  // machine.
+  std::vector<StackFrame> call_stack;
+  call_stack.reserve(slot.call_stack.size());
+  for (const SavedFrame& saved : slot.call_stack) {
+    const libreallive::Scenario* scenario =
+        machine.archive().GetScenario(saved.scene_number);
+    if (scenario == NULL ||
+        saved.position > std::distance(scenario->begin(), scenario->end()))
+      return false;
+
+    call_stack.emplace_back(scenario, scenario->begin() + saved.position,
+                            saved.frame_type);
+    StackFrame& frame = call_stack.back();
+    std::copy(saved.intL, saved.intL + SIZE_OF_INT_PASSING_MEM, frame.intL);
+    frame.strK = saved.strK;
+  }
+
+  // Everything from here mirrors Serialization::loadGameFrom().
+  machine.Reset();
+
+  LocalMemory& local = machine.memory().local();
+  std::copy(slot.intA, slot.intA + SIZE_OF_MEM_BANK, local.intA);
+  std::copy(slot.intB, slot.intB + SIZE_OF_MEM_BANK, local.intB);
+  std::copy(slot.intC, slot.intC + SIZE_OF_MEM_BANK, local.intC);
+  std::copy(slot.intD, slot.intD + SIZE_OF_MEM_BANK, local.intD);
+  std::copy(slot.intE, slot.intE + SIZE_OF_MEM_BANK, local.intE);
+  std::copy(slot.intF, slot.intF + SIZE_OF_MEM_BANK, local.intF);
+  local.strS = slot.strS;
+  local.local_names = slot.local_names;
+
+  machine.line_ = slot.line;
+  machine.call_stack_.swap(call_stack);
+
+  System& system = machine.system();
+  GraphicsSystem& graphics = system.graphics();
+  bool restored_dcs = graphics.RestoreSavepointState(machine, slot.graphics);
+  system.text().set_active_window(slot.text_window);
+  system.text().SetKeyCursor(slot.text_cursor);
+  if (!slot.bgm_name.empty())
+    system.sound().BgmPlay(slot.bgm_name, slot.bgm_looping);
+
+  // Only saves taken after a graphics command since the savepoint lack
+  // copies of the DCs.
+  if (!restored_dcs)
+    graphics.ReplayGraphicsStack(machine);
+  graphics.ForceRefresh();
+
+  // The restored state is the savepoint, so saving again right away saves
+  // the same thing.
+  machine.MarkSavepoint();
+  return true;
+}
+
+int QuickSaveRing::size() const {
+  return std::min<int>(next_id_, slots_.size());
+}
@@ -0,0 +1,82 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+
+#ifndef SRC_MACHINE_QUICK_SAVE_RING_H_
+#define SRC_MACHINE_QUICK_SAVE_RING_H_
+
+#include <memory>
+#include <vector>
+
+class RLMachine;
+
+// Quick saves kept entirely in memory, for test automation that saves and
+// reloads constantly.
+//
+// Each save holds what a save game file would: the call stack, local memory,
+// the graphics objects and graphics stack, and the text window state, all as
+// of the last savepoint. Instead of going through boost::serialization and
+// zlib, they are copied into one of a fixed number of slots which are
+// allocated up front and reused, overwriting the oldest save once all are in
+// use. Slots also keep copies of the DCs, so loading copies everything back
+// without replaying the graphics stack. A save taken after a graphics command
+// that followed the savepoint can't use its current DCs, and replays the
+// stack on load instead, as loading a save game does.
+class QuickSaveRing {
+ public:
+  QuickSaveRing(int slots, int objects_in_layer);
+  ~QuickSaveRing();
+
+  // Captures |machine|'s state at its last savepoint into the next slot.
+  // Returns an id for Load(). Throws if no savepoint has been marked.
+  int Save(RLMachine& machine);
+
+  // Restores the save |id|, and marks the restored state as the savepoint.
+  // Returns false if |id| has been overwritten or never existed. Like loading
+  // a save game, this replaces the call stack, so must not be called while an
+  // instruction is executing; use QuickLoadLongOperation from there.
+  bool Load(RLMachine& machine, int id);
+
+  // Whether save |id| can still be loaded.
+  bool Contains(int id) const;
+
+  // The id of the most recent save, or -1 if there isn't one.
+  int latest() const { return next_id_ - 1; }
+
+  // The number of saves that can be loaded.
+  int size() const;
+  int capacity() const { return slots_.size(); }
+
+ private:
+  struct Slot;
+
+  std::vector<std::unique_ptr<Slot>> slots_;
+
+  // The id the next save gets. Save |id| lives in slot |id % capacity()|.
+  int next_id_ = 0;
+};
+
+#endif  // SRC_MACHINE_QUICK_SAVE_RING_H_
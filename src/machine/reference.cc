@@ -72,18 +72,22 @@ StringAccessor::StringAccessor(MemoryReferenceIterator<StringAccessor>* i)
 StringAccessor::~StringAccessor() {}
 
 StringAccessor::operator std::string() const {
+  return value().as_string();
+}
+
+StringPiece StringAccessor::value() const {
   return it->memory_->GetStringValue(it->type_, it->location_);
 }
 
-StringAccessor& StringAccessor::operator=(const std::string& new_value) {
+StringAccessor& StringAccessor::operator=(StringPiece new_value) {
   it->memory_->SetStringValue(it->type_, it->location_, new_value);
   return *this;
 }
 
-bool StringAccessor::operator==(const std::string& rhs) {
-  return operator std::string() == rhs;
+bool StringAccessor::operator==(StringPiece rhs) {
+  return value() == rhs;
 }
 
 StringAccessor& StringAccessor::operator=(const StringAccessor& rhs) {
-  return operator=(rhs.operator std::string());
+  return operator=(rhs.value());
 }
@@ -31,6 +31,8 @@
 #include <string>
 #include <iterator>
 
+#include "machine/string_bank.h"
+
 template <typename T>
 class MemoryReferenceIterator;
 class Memory;
@@ -70,10 +72,14 @@ class StringAccessor {
 
   operator std::string() const;
 
-  StringAccessor& operator=(const std::string& new_value);
+  // The current value, without copying it. Valid until the location is next
+  // written.
+  StringPiece value() const;
+
+  StringAccessor& operator=(StringPiece new_value);
   StringAccessor& operator=(const StringAccessor& new_value);
 
-  bool operator==(const std::string& rhs);
+  bool operator==(StringPiece rhs);
 
  private:
   // Pointer to the real memory reference that we work with whenever
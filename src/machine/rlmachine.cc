@@ -35,7 +35,9 @@
 #include <boost/filesystem/fstream.hpp>
 #include <boost/filesystem/path.hpp>
 
+#include <atomic>
 #include <functional>
+#include <set>
 #include <string>
 #include <sstream>
 #include <iostream>
@@ -53,11 +55,16 @@
 #include "machine/long_operation.h"
 #include "machine/memory.h"
 #include "machine/opcode_log.h"
+#include "machine/image_prefetcher.h"
+#include "machine/parameter_preparser.h"
+#include "machine/quick_save_ring.h"
 #include "machine/reallive_dll.h"
 #include "machine/rlmodule.h"
 #include "machine/rloperation.h"
+#include "machine/save_writer.h"
 #include "machine/serialization.h"
 #include "machine/stack_frame.h"
+#include "systems/base/event_system.h"
 #include "systems/base/graphics_system.h"
 #include "systems/base/system.h"
 #include "systems/base/system_error.h"
@@ -94,6 +101,10 @@ bool IsNotLongOp(StackFrame& frame) {
   return frame.frame_type != StackFrame::TYPE_LONGOP;
 }
 
+// Source of RLMachine::dispatch_epoch_. Zero is never handed out, so it can
+// never match an element that hasn't cached anything.
+std::atomic<unsigned int> g_next_dispatch_epoch(1);
+
 }  // namespace
 
 // -----------------------------------------------------------------------
@@ -103,7 +114,8 @@ bool IsNotLongOp(StackFrame& frame) {
 RLMachine::RLMachine(System& in_system, libreallive::Archive& in_archive)
     : memory_(new Memory(*this, in_system.gameexe())),
       archive_(in_archive),
-      system_(in_system) {
+      system_(in_system),
+      dispatch_epoch_(g_next_dispatch_epoch++) {
   // Search in the Gameexe for #SEEN_START and place us there
   Gameexe& gameexe = in_system.gameexe();
   libreallive::Scenario* scenario = NULL;
@@ -168,7 +180,12 @@ void RLMachine::AttachModule(RLModule* module) {
     throw rlvm::Exception(ss.str());
   }
 
+  // The preparser's worker reads |modules_|.
+  if (preparser_)
+    preparser_->WaitUntilIdle();
+
   modules_.emplace(packed_module, std::unique_ptr<RLModule>(module));
+  dispatch_epoch_ = g_next_dispatch_epoch++;
 }
 
 int RLMachine::GetIntValue(const libreallive::IntMemRef& ref) {
@@ -179,11 +196,11 @@ void RLMachine::SetIntValue(const libreallive::IntMemRef& ref, int value) {
   memory_->SetIntValue(ref, value);
 }
 
-const std::string& RLMachine::GetStringValue(int type, int location) {
+StringPiece RLMachine::GetStringValue(int type, int location) {
   return memory_->GetStringValue(type, location);
 }
 
-void RLMachine::SetStringValue(int type, int number, const std::string& value) {
+void RLMachine::SetStringValue(int type, int number, StringPiece value) {
   memory_->SetStringValue(type, number, value);
 }
 
@@ -246,6 +263,21 @@ void RLMachine::ExecuteNextInstruction() {
   if (halted() == true) {
     return;
   } else {
+    // Switching scenarios is the only time a scenario can become unused.
+    if (call_stack_.back().scenario != last_trimmed_scenario_) {
+      if (preparser_)
+        preparser_->QueueScenario(call_stack_.back().scenario);
+      TrimScenarioCache();
+    }
+    if (preparser_)
+      preparser_->InstallFinished();
+    if (save_writer_)
+      save_writer_->ReportFinished();
+    if (image_prefetcher_ &&
+        call_stack_.back().frame_type != StackFrame::TYPE_LONGOP) {
+      image_prefetcher_->Scan(call_stack_.back());
+    }
+
     try {
       if (call_stack_.back().frame_type == StackFrame::TYPE_LONGOP) {
         delay_stack_modifications_ = true;
@@ -260,6 +292,8 @@ void RLMachine::ExecuteNextInstruction() {
           (action)();
         }
         delayed_modifications_.clear();
+      } else if (fuse_instructions_) {
+        RunFusedElements();
       } else {
         (*(call_stack_.back().ip))->RunOnMachine(*this);
       }
@@ -310,12 +344,66 @@ void RLMachine::ExecuteNextInstruction() {
   }
 }
 
+void RLMachine::RunFusedElements() {
+  size_t depth = call_stack_.size();
+  const libreallive::Scenario* scenario = call_stack_.back().scenario;
+  while (true) {
+    libreallive::Scenario::const_iterator ip = call_stack_.back().ip;
+    libreallive::Scenario::Fusion fusion = scenario->GetFusion(ip);
+
+    // A line marker without line actions only sets |line_|, which doesn't
+    // need the full MetaElement::RunOnMachine().
+    if (fusion == libreallive::Scenario::FUSABLE_LINE_MARKER &&
+        !on_line_actions_ && !replaying_graphics_stack_) {
+      line_ = static_cast<const libreallive::MetaElement*>(*ip)->value();
+      if (++call_stack_.back().ip == scenario->end()) {
+        halted_ = true;
+        break;
+      }
+      continue;
+    }
+
+    (*ip)->RunOnMachine(*this);
+
+    // Line actions and savepoints may do anything, so stop as soon as the
+    // element did something other than step forward.
+    if (halted_ || fusion == libreallive::Scenario::NOT_FUSABLE ||
+        call_stack_.size() != depth)
+      break;
+    const StackFrame& frame = call_stack_.back();
+    if (frame.scenario != scenario || frame.ip != ip + 1)
+      break;
+  }
+}
+
 void RLMachine::ExecuteUntilHalted() {
   while (!halted()) {
     ExecuteNextInstruction();
   }
 }
 
+RLMachine::BatchResult RLMachine::ExecuteBatch(unsigned int budget_ms) {
+  EventSystem& event = system_.event();
+  unsigned int start_ticks = event.GetTicks();
+  int until_clock_check = kInstructionsPerClockCheck;
+  while (true) {
+    ExecuteNextInstruction();
+
+    if (halted_)
+      return BATCH_HALTED;
+    if (call_stack_.back().frame_type == StackFrame::TYPE_LONGOP)
+      return BATCH_LONG_OPERATION;
+    if (system_.force_wait())
+      return BATCH_FORCE_WAIT;
+
+    if (--until_clock_check == 0) {
+      if (event.GetTicks() - start_ticks >= budget_ms)
+        return BATCH_BUDGET_SPENT;
+      until_clock_check = kInstructionsPerClockCheck;
+    }
+  }
+}
+
 void RLMachine::AdvanceInstructionPointer() {
   if (!replaying_graphics_stack()) {
     std::vector<StackFrame>::reverse_iterator it =
@@ -338,14 +426,23 @@ std::string RLMachine::GetCommandName(const libreallive::CommandElement& f) {
   return name;
 }
 
-void RLMachine::ExecuteCommand(const libreallive::CommandElement& f) {
+RLOperation* RLMachine::GetOperation(const libreallive::CommandElement& f) {
   ModuleMap::iterator it =
       modules_.find(PackModuleNumber(f.modtype(), f.module()));
-  if (it != modules_.end()) {
-    it->second->DispatchFunction(*this, f);
-  } else {
-    throw rlvm::UnimplementedOpcode(*this, f);
+  return it != modules_.end() ? it->second->GetOperation(f) : NULL;
+}
+
+void RLMachine::ExecuteCommand(const libreallive::CommandElement& f) {
+  RLOperation* op = f.GetCachedOperation(dispatch_epoch_);
+  if (!op) {
+    op = GetOperation(f);
+    if (!op)
+      throw rlvm::UnimplementedOpcode(*this, f);
+    if (cache_dispatch_)
+      f.SetCachedOperation(dispatch_epoch_, op);
   }
+
+  RLModule::DispatchOperation(*this, *op, f);
 }
 
 void RLMachine::Jump(int scenario_num, int entrypoint) {
@@ -512,6 +609,7 @@ void RLMachine::ClearLongOperationsOffBackOfStack() {
 }
 
 void RLMachine::Reset() {
+  halted_ = false;
   call_stack_.clear();
   savepoint_call_stack_.clear();
   system().Reset();
@@ -666,6 +764,44 @@ void RLMachine::RecordUndefinedOpcodeCounts() {
   undefined_log_.reset(new OpcodeLog);
 }
 
+void RLMachine::EnableParameterPreparsing() {
+  if (preparser_)
+    return;
+
+  preparser_.reset(new ParameterPreparser(*this));
+  for (auto const& frame : call_stack_)
+    preparser_->QueueScenario(frame.scenario);
+}
+
+void RLMachine::EnableImagePrefetch(int lookahead) {
+  image_prefetcher_.reset(
+      new ImagePrefetcher(system().graphics(), lookahead));
+}
+
+SaveWriter& RLMachine::save_writer() {
+  if (!save_writer_)
+    save_writer_.reset(new SaveWriter);
+  return *save_writer_;
+}
+
+void RLMachine::WaitForPendingSaves() {
+  if (save_writer_) {
+    save_writer_->WaitUntilIdle();
+    save_writer_->ReportFinished();
+  }
+}
+
+QuickSaveRing& RLMachine::quick_saves() {
+  if (!quick_saves_)
+    SetQuickSaveSlots(kDefaultQuickSaveSlots);
+  return *quick_saves_;
+}
+
+void RLMachine::SetQuickSaveSlots(int slots) {
+  quick_saves_.reset(
+      new QuickSaveRing(slots, system().graphics().GetObjectLayerSize()));
+}
+
 void RLMachine::Halt() { halted_ = true; }
 
 void RLMachine::SetHaltOnException(bool halt_on_exception) {
@@ -693,6 +829,19 @@ void RLMachine::AddLineAction(const int seen,
   (*on_line_actions_)[std::make_pair(seen, line)] = function;
 }
 
+void RLMachine::TrimScenarioCache() {
+  std::set<int> pinned;
+  for (auto const& frame : call_stack_)
+    pinned.insert(frame.scenario->scene_number());
+  for (auto const& frame : savepoint_call_stack_)
+    pinned.insert(frame.scenario->scene_number());
+  if (preparser_)
+    preparser_->AddPinnedScenarios(pinned);
+
+  archive_.TrimCache(pinned);
+  last_trimmed_scenario_ = call_stack_.back().scenario;
+}
+
 template <class Archive>
 void RLMachine::save(Archive& ar, unsigned int version) const {
   int line_num = line_number();
@@ -40,17 +40,23 @@
 
 #include "libreallive/bytecode_fwd.h"
 #include "libreallive/scenario.h"
+#include "machine/string_bank.h"
 
 namespace libreallive {
 class Archive;
 class IntMemRef;
 };
 
+class ImagePrefetcher;
 class LongOperation;
 class Memory;
 class OpcodeLog;
+class ParameterPreparser;
+class QuickSaveRing;
 class RLModule;
+class RLOperation;
 class RealLiveDLL;
+class SaveWriter;
 class System;
 struct StackFrame;
 
@@ -98,6 +104,16 @@ class RLMachine {
   void set_tracing_on() { tracing_ = true; }
   bool is_tracing_on() const { return tracing_; }
 
+  // Whether ExecuteCommand() remembers the RLOperation each command resolved
+  // to on the command itself. On by default; benchmarks turn it off to
+  // measure the uncached lookups.
+  void set_cache_dispatch(bool in) { cache_dispatch_ = in; }
+
+  // Whether ExecuteNextInstruction() goes straight on past line and kidoku
+  // markers and expressions to the element after them, instead of returning
+  // after each one. On by default; benchmarks turn it off to compare.
+  void set_fuse_instructions(bool in) { fuse_instructions_ = in; }
+
   // Registers a given module with this RLMachine instance. A module is a set
   // of different functions registered as one unit. Takes ownership of
   // |module|.
@@ -113,6 +129,11 @@ class RLMachine {
   // an implicit savepoint.
   void MarkSavepoint();
 
+  // The call stack as of the last savepoint, which is what a save game holds.
+  const std::vector<StackFrame>& savepoint_call_stack() const {
+    return savepoint_call_stack_;
+  }
+
   // Checks to see if we should set a savepoint on the start of a
   // textout when all text windows are empty (aka, when a message starts)
   bool ShouldSetMessageSavepoint() const;
@@ -152,10 +173,10 @@ class RLMachine {
   void SetIntValue(const libreallive::IntMemRef& ref, int value);
 
   // Returns the string value of a string memory bank
-  const std::string& GetStringValue(int type, int location);
+  StringPiece GetStringValue(int type, int location);
 
   // Sets the string value of one of the string banks
-  void SetStringValue(int type, int number, const std::string& value);
+  void SetStringValue(int type, int number, StringPiece value);
 
   // Reinitializes all memory to a pristine, default state as specified in the
   // Gameexe.ini file.
@@ -268,7 +289,9 @@ class RLMachine {
 
   // -----------------------------------------------------------------------
 
-  // Executes the next instruction in the bytecode in
+  // Executes the next instruction in the bytecode in. Line and kidoku
+  // markers and expressions are run together with whatever follows them; see
+  // set_fuse_instructions().
   void ExecuteNextInstruction();
 
   // Call executeNextInstruction() repeatedly until the RLMachine is
@@ -278,6 +301,27 @@ class RLMachine {
   // fire between RLMachine instructions.
   void ExecuteUntilHalted();
 
+  // Why ExecuteBatch() returned.
+  enum BatchResult {
+    // The machine is halted.
+    BATCH_HALTED,
+    // A LongOperation is on top of the call stack.
+    BATCH_LONG_OPERATION,
+    // The system wants a chance to redraw; see System::force_wait().
+    BATCH_FORCE_WAIT,
+    // The time budget ran out.
+    BATCH_BUDGET_SPENT
+  };
+
+  // Executes at least one instruction, and then keeps going until the machine
+  // halts, a LongOperation is pushed, the system asks to redraw or
+  // |budget_ms| has passed. The clock is only read every
+  // |kInstructionsPerClockCheck| instructions, so a batch can overrun its
+  // budget by that many.
+  BatchResult ExecuteBatch(unsigned int budget_ms);
+
+  static const int kInstructionsPerClockCheck = 16;
+
   // Increments the stack pointer in the current frame. If we have run
   // off the end of the current scenario, set the halted bit.
   void AdvanceInstructionPointer();
@@ -285,6 +329,9 @@ class RLMachine {
   // Returns the command name of |f|.
   std::string GetCommandName(const libreallive::CommandElement& f);
 
+  // Returns the operation that implements |f|, or NULL.
+  RLOperation* GetOperation(const libreallive::CommandElement& f);
+
   // Pauses execution and notifies the System. Every call to
   // executeNextInstruction() will return immediately and the System's internal
   // timer will stop ticking.
@@ -303,6 +350,39 @@ class RLMachine {
   // results to stderr on machine destruction.
   void RecordUndefinedOpcodeCounts();
 
+  // Parses and type checks the parameters of every command in each scenario
+  // on a background thread as the scenario is loaded, instead of on first
+  // dispatch. Call after all modules have been attached.
+  void EnableParameterPreparsing();
+
+  // The preparser, or NULL if preparsing isn't enabled.
+  ParameterPreparser* parameter_preparser() { return preparser_.get(); }
+
+  // Before each instruction, looks up to |lookahead| bytecode elements ahead
+  // for images that are about to be loaded and starts decoding them. Needs
+  // background image decoding enabled in the GraphicsSystem.
+  void EnableImagePrefetch(int lookahead);
+
+  // The prefetcher, or NULL if image prefetching isn't enabled.
+  ImagePrefetcher* image_prefetcher() { return image_prefetcher_.get(); }
+
+  // Writes save files in the background. Created on first use.
+  SaveWriter& save_writer();
+
+  // Blocks until every queued save file is on disk and reports the results.
+  // Anything that reads save files calls this first.
+  void WaitForPendingSaves();
+
+  // Saves kept in memory for test automation. Created on first use with
+  // |kDefaultQuickSaveSlots| slots.
+  QuickSaveRing& quick_saves();
+
+  // Replaces the quick save ring with one of |slots| slots, discarding any
+  // quick saves.
+  void SetQuickSaveSlots(int slots);
+
+  static const int kDefaultQuickSaveSlots = 10;
+
   // ---------------------------------------------------------------------
 
   // Force the machine to halt. This should terminate the execution of
@@ -336,8 +416,8 @@ class RLMachine {
   // Clears all LongOperations from the back of the stack.
   void ClearLongOperationsOffBackOfStack();
 
-  // Clears all call stacks and other data. Does not clear any local memory, as
-  // this should only be called right before a load.
+  // Clears all call stacks and other data, including the halted bit. Does not
+  // clear any local memory, as this should only be called right before a load.
   void Reset();
 
   // Resets pieces of local memory. Correspondingly does NOT clear the call
@@ -409,6 +489,13 @@ class RLMachine {
   // Whether we should print out all commands to the console.
   bool tracing_ = false;
 
+  // Tags the RLOperations cached on CommandElements. Every machine takes a
+  // fresh epoch when it's constructed and whenever a module is attached, so
+  // stale entries simply stop matching.
+  unsigned int dispatch_epoch_;
+  bool cache_dispatch_ = true;
+  bool fuse_instructions_ = true;
+
   // The actions that were delayed when |delay_stack_modifications_| is on.
   std::vector<std::function<void(void)>> delayed_modifications_;
 
@@ -421,6 +508,37 @@ class RLMachine {
   // Currently loaded "DLLs".
   DLLMap loaded_dlls_;
 
+  // The scenario that was executing the last time we trimmed the archive's
+  // scenario cache.
+  const libreallive::Scenario* last_trimmed_scenario_ = NULL;
+
+  // Lets the archive evict parsed scenarios that nothing on the call stack or
+  // the savepoint call stack points into. Only safe to call between
+  // instructions.
+  void TrimScenarioCache();
+
+  // Runs the element at the instruction pointer, and then the ones after it
+  // for as long as they are fusable and leave the top stack frame where it
+  // was, merely advanced by one.
+  void RunFusedElements();
+
+  // (Optional) Parses command parameters in the background. Declared after
+  // |modules_| so that its worker stops before the operations it calls are
+  // destroyed.
+  std::unique_ptr<ParameterPreparser> preparser_;
+
+  // (Optional) Starts decoding upcoming images; see EnableImagePrefetch().
+  std::unique_ptr<ImagePrefetcher> image_prefetcher_;
+
+  // (Optional) Writes save files in the background; see save_writer().
+  std::unique_ptr<SaveWriter> save_writer_;
+
+  // (Optional) In-memory saves; see quick_saves().
+  std::unique_ptr<QuickSaveRing> quick_saves_;
+
+  // Copies the call stack in and out of memory, like save() and load().
+  friend class QuickSaveRing;
+
   // boost::serialization support
   friend class boost::serialization::access;
 
@@ -137,32 +137,45 @@ std::string RLModule::GetCommandName(RLMachine& machine,
   return name;
 }
 
+RLOperation* RLModule::GetOperation(const libreallive::CommandElement& f) {
+  OpcodeMap::iterator it =
+      stored_operations_.find(PackOpcodeNumber(f.opcode(), f.overload()));
+  return it != stored_operations_.end() ? it->second.get() : NULL;
+}
+
 void RLModule::DispatchFunction(RLMachine& machine,
                                 const libreallive::CommandElement& f) {
   OpcodeMap::iterator it =
       stored_operations_.find(PackOpcodeNumber(f.opcode(), f.overload()));
   if (it != stored_operations_.end()) {
-    try {
-      if (machine.is_tracing_on()) {
-        std::cerr << "(SEEN" << std::setw(4) << std::setfill('0')
-                  << machine.SceneNumber()
-                  << ")(Line " << std::setw(4) << std::setfill('0')
-                  << machine.line_number() << "): " << it->second->name();
-        libreallive::PrintParameterString(std::cerr,
-                                          f.GetUnparsedParameters());
-        std::cerr << std::endl;
-      }
-      it->second->DispatchFunction(machine, f);
-    }
-    catch (rlvm::Exception& e) {
-      e.setOperation(it->second.get());
-      throw;
-    }
+    DispatchOperation(machine, *it->second, f);
   } else {
     throw rlvm::UnimplementedOpcode(machine, f);
   }
 }
 
+// static
+void RLModule::DispatchOperation(RLMachine& machine,
+                                 RLOperation& op,
+                                 const libreallive::CommandElement& f) {
+  try {
+    if (machine.is_tracing_on()) {
+      std::cerr << "(SEEN" << std::setw(4) << std::setfill('0')
+                << machine.SceneNumber()
+                << ")(Line " << std::setw(4) << std::setfill('0')
+                << machine.line_number() << "): " << op.name();
+      libreallive::PrintParameterString(std::cerr,
+                                        f.GetUnparsedParameters());
+      std::cerr << std::endl;
+    }
+    op.DispatchFunction(machine, f);
+  }
+  catch (rlvm::Exception& e) {
+    e.setOperation(&op);
+    throw;
+  }
+}
+
 std::ostream& operator<<(std::ostream& os, const RLModule& module) {
   os << "mod<" << module.module_name() << "," << module.module_type() << ":"
      << module.module_number() << ">";
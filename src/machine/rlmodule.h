@@ -130,9 +130,18 @@ class RLModule {
   void DispatchFunction(RLMachine& machine,
                         const libreallive::CommandElement& f);
 
+  // Executes |f| with |op|, which must be the operation that implements it.
+  // Used by RLMachine once it has cached the lookup.
+  static void DispatchOperation(RLMachine& machine,
+                                RLOperation& op,
+                                const libreallive::CommandElement& f);
+
   std::string GetCommandName(RLMachine& machine,
                              const libreallive::CommandElement& f);
 
+  // Returns the operation that implements |f|, or NULL.
+  RLOperation* GetOperation(const libreallive::CommandElement& f);
+
   OpcodeMap::iterator begin() { return stored_operations_.begin(); }
   OpcodeMap::iterator end() { return stored_operations_.end(); }
 
@@ -198,11 +198,17 @@ StrConstant_T::type StrConstant_T::getData(
   // people hold references to the inner buffer. Now we have one screwed up
   // LRUCache data structure, and probably screwed up other places.
   //
-  // So to fix this, we break the COW semantics here by forcing a copy. I'd
-  // prefer to do this in RLMachine or Memory, but I can't because they return
-  // references.
-  string tmp = p[position++].GetStringValue(machine);
-  return string(tmp.data(), tmp.size());
+  // So to fix this, we break the COW semantics here by forcing a copy. String
+  // memory now hands out StringPieces, and building a string from one's bytes
+  // always gives it a buffer of its own.
+  return p[position++].GetStringValue(machine).as_string();
+}
+
+StrConstantView_T::type StrConstantView_T::getData(
+    RLMachine& machine,
+    const libreallive::ExpressionPiecesVector& p,
+    unsigned int& position) {
+  return p[position++].GetStringValue(machine);
 }
 
 void StrConstant_T::ParseParameters(
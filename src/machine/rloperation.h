@@ -36,6 +36,7 @@
 #include "libreallive/bytecode_fwd.h"
 #include "libreallive/expression.h"
 #include "machine/rloperation/references.h"
+#include "machine/string_bank.h"
 
 class MappedRLModule;
 class RLModule;
@@ -194,6 +195,24 @@ struct StrConstant_T {
   enum { is_complex = false };
 };
 
+// Type definition for a constant string value that is passed to the
+// operation as a StringPiece instead of a copy.
+//
+// The piece points either at an interned constant or into string memory, so
+// it is only valid until the operation returns, and an operation has to be
+// done reading it before it writes string memory. It can only be used directly
+// as a parameter of RLOpcode or RLStoreOpcode, not inside Argc_T, Complex_T or
+// Special_T.
+struct StrConstantView_T : public StrConstant_T {
+  // The output type of this type struct
+  typedef StringPiece type;
+
+  // Convert the incoming parameter objects into the resulting type
+  static type getData(RLMachine& machine,
+                      const libreallive::ExpressionPiecesVector& p,
+                      unsigned int& position);
+};
+
 struct empty_struct {};
 
 // Defines a null type for the Special parameter.
@@ -347,9 +366,10 @@ class RLOpcode : public RLNormalOpcode<Args...> {
  private:
   template<int... Indexes>
   void DispatchImpl(RLMachine& machine,
-                    const std::tuple<typename Args::type...>& args,
+                    std::tuple<typename Args::type...>& args,
                     internal::index_tuple<Indexes...>) {
-    operator()(machine, std::get<Indexes>(args)...);
+    // Parameters that are passed by value are moved out of |args|.
+    operator()(machine, std::move(std::get<Indexes>(args))...);
   }
 };
 
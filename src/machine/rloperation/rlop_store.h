@@ -41,9 +41,10 @@ class RLStoreOpcode : public RLNormalOpcode<Args...> {
  private:
   template<int... Indexes>
   void DispatchImpl(RLMachine& machine,
-                    const std::tuple<typename Args::type...>& args,
+                    std::tuple<typename Args::type...>& args,
                     internal::index_tuple<Indexes...>) {
-    int store = operator()(machine, std::get<Indexes>(args)...);
+    // Parameters that are passed by value are moved out of |args|.
+    int store = operator()(machine, std::move(std::get<Indexes>(args))...);
     machine.set_store_register(store);
   }
 };
@@ -26,7 +26,9 @@
 
 #include "machine/rlvm_instance.h"
 
+#include <chrono>
 #include <iostream>
+#include <memory>
 #include <string>
 
 #include "libreallive/gameexe.h"
@@ -34,6 +36,7 @@
 #include "machine/dump_scenario.h"
 #include "machine/game_hacks.h"
 #include "machine/memory.h"
+#include "machine/parameter_preparser.h"
 #include "machine/rlmachine.h"
 #include "machine/serialization.h"
 #include "modules/module_sys_save.h"
@@ -42,7 +45,9 @@
 //#include "platforms/gcn/gcn_platform.h"
 #include "systems/base/event_system.h"
 #include "systems/base/graphics_system.h"
+#include "systems/base/image_decoder.h"
 #include "systems/base/system_error.h"
+#include "systems/null/null_system.h"
 #include "systems/sdl/sdl_system.h"
 #include "utf8cpp/utf8.h"
 #include "utilities/exception.h"
@@ -50,6 +55,7 @@
 #include "utilities/find_font_file.h"
 #include "utilities/gettext.h"
 #include "utilities/string_utilities.h"
+#include "utilities/worker_pool.h"
 
 namespace fs = boost::filesystem;
 
@@ -61,6 +67,11 @@ const char* siglus_exes[] = {"siglus.exe",       "siglusengine-ch.exe",
                              "siglusengine.exe", "siglusenginechs.exe",
                              NULL};
 
+// How many bytecode elements ahead of the instruction pointer to look for
+// images with --prefetch-images. Every source line is a line marker and at
+// least one command, so this is a couple dozen lines.
+const int kImagePrefetchLookahead = 64;
+
 RLVMInstance::RLVMInstance()
     : seen_start_(-1),
       memory_(false),
@@ -68,7 +79,16 @@ RLVMInstance::RLVMInstance()
       count_undefined_copcodes_(false),
       tracing_(false),
       load_save_(-1),
-      dump_seen_(-1) {
+      dump_seen_(-1),
+      preload_scenarios_(false),
+      prefetch_scenarios_(false),
+      scenario_cache_mb_(0),
+      preparse_parameters_(false),
+      decode_images_(false),
+      prefetch_images_(false),
+      image_cache_mb_(0),
+      headless_(false),
+      turbo_(false) {
   srand(time(NULL));
 }
 
@@ -93,6 +113,9 @@ void RLVMInstance::Run(const boost::filesystem::path& gamerootPath) {
     if (memory_)
       gameexe("MEMORY") = 1;
 
+    if (image_cache_mb_ > 0)
+      gameexe("__IMAGE_CACHE_MB") = image_cache_mb_;
+
     if (!custom_font_.empty()) {
       if (!fs::exists(custom_font_)) {
         throw rlvm::UserPresentableError(
@@ -104,9 +127,36 @@ void RLVMInstance::Run(const boost::filesystem::path& gamerootPath) {
       gameexe("__GAMEFONT") = custom_font_;
     }
 
+    std::unique_ptr<System> system;
+    NullSystem* null_system = nullptr;
+    if (headless_) {
+      null_system = new NullSystem(gameexe);
+      system.reset(null_system);
+      if (!decision_file_.empty())
+        null_system->LoadDecisions(decision_file_);
+    } else {
+      system.reset(new SDLSystem(gameexe));
+    }
+
+    // Nobody can click through text without a window, so headless runs
+    // always skip.
+    if (turbo_ || headless_)
+      system->set_force_fast_forward();
+
+    if (decode_images_ || prefetch_images_) {
+      system->graphics().EnableBackgroundImageDecoding(
+          WorkerPool::DefaultThreadCount());
+    }
+
     libreallive::Archive arc(seenPath.string(), gameexe("REGNAME"));
-    SDLSystem sdlSystem(gameexe);
-    RLMachine rlmachine(sdlSystem, arc);
+    if (preload_scenarios_)
+      arc.DecodeAllScenariosInBackground(WorkerPool::DefaultThreadCount());
+    if (prefetch_scenarios_)
+      arc.EnablePrefetch(WorkerPool::DefaultThreadCount());
+    if (scenario_cache_mb_ > 0)
+      arc.set_cache_budget(static_cast<size_t>(scenario_cache_mb_) << 20);
+
+    RLMachine rlmachine(*system, arc);
     AddAllModules(rlmachine);
     AddGameHacks(rlmachine);
 
@@ -118,8 +168,8 @@ void RLVMInstance::Run(const boost::filesystem::path& gamerootPath) {
 
     // Validate our font file
     // TODO(erg): Remove this when we switch to native font selection dialogs.
-    fs::path fontFile = FindFontFile(sdlSystem);
-    if (fontFile.empty() || !fs::exists(fontFile)) {
+    fs::path fontFile = headless_ ? fs::path() : FindFontFile(*system);
+    if (!headless_ && (fontFile.empty() || !fs::exists(fontFile))) {
       throw rlvm::UserPresentableError(
           _("Could not find msgothic.ttc or a suitable fallback font."),
           _("Please place a copy of msgothic.ttc in either your home directory "
@@ -141,7 +191,16 @@ void RLVMInstance::Run(const boost::filesystem::path& gamerootPath) {
     if (tracing_)
       rlmachine.set_tracing_on();
 
-    Serialization::loadGlobalMemory(rlmachine);
+    if (preparse_parameters_)
+      rlmachine.EnableParameterPreparsing();
+
+    if (prefetch_images_)
+      rlmachine.EnableImagePrefetch(kImagePrefetchLookahead);
+
+    // Headless runs start from fresh global memory, so that replays don't
+    // depend on (or change) what the player has already read.
+    if (!headless_)
+      Serialization::loadGlobalMemory(rlmachine);
 
     // Now to preform a quick integrity check. If the user opened the Japanese
     // version of CLANNAD (or any other game), and then installed a patch, our
@@ -153,36 +212,94 @@ void RLVMInstance::Run(const boost::filesystem::path& gamerootPath) {
     if (load_save_ != -1)
       Sys_load()(rlmachine, load_save_);
 
+    std::chrono::steady_clock::time_point run_start =
+        std::chrono::steady_clock::now();
     while (!rlmachine.halted()) {
       // Give SDL a chance to respond to events, redraw the screen,
       // etc.
-      sdlSystem.Run(rlmachine);
+      system->Run(rlmachine);
 
       // Run the rlmachine through as many instructions as we can in a 10ms time
       // slice. Bail out if we switch to long operation mode, or if the screen
       // is marked as dirty.
-      unsigned int start_ticks = sdlSystem.event().GetTicks();
-      unsigned int end_ticks = start_ticks;
-      do {
-        rlmachine.ExecuteNextInstruction();
-        end_ticks = sdlSystem.event().GetTicks();
-      } while (!rlmachine.CurrentLongOperation() &&
-               !sdlSystem.force_wait() &&
-               (end_ticks - start_ticks < 10));
+      unsigned int start_ticks = system->event().GetTicks();
+      rlmachine.ExecuteBatch(10);
+      unsigned int end_ticks = system->event().GetTicks();
 
       // Sleep to be nice to the processor and to give the GPU a chance to
-      // catch up.
-      if (!sdlSystem.ShouldFastForward()) {
+      // catch up. The headless clock is virtual, so there waiting only moves
+      // game time along, and must happen even while skipping.
+      if (headless_ || !system->ShouldFastForward()) {
         int real_sleep_time = 10 - (end_ticks - start_ticks);
         if (real_sleep_time < 1)
           real_sleep_time = 1;
-        sdlSystem.event().Wait(real_sleep_time);
+        system->event().Wait(real_sleep_time);
       }
 
-      sdlSystem.set_force_wait(false);
+      system->set_force_wait(false);
+    }
+
+    if (headless_) {
+      std::chrono::milliseconds elapsed =
+          std::chrono::duration_cast<std::chrono::milliseconds>(
+              std::chrono::steady_clock::now() - run_start);
+      std::cerr << "Headless run: stopped at SEEN" << rlmachine.SceneNumber()
+                << " line " << rlmachine.line_number() << " after "
+                << null_system->decisions_made() << " decisions, "
+                << system->event().GetTicks() << " ms of game time in "
+                << elapsed.count() << " ms" << std::endl;
+    } else {
+      Serialization::saveGlobalMemory(rlmachine);
     }
+    rlmachine.WaitForPendingSaves();
 
-    Serialization::saveGlobalMemory(rlmachine);
+    if (prefetch_scenarios_) {
+      libreallive::Archive::PrefetchStats stats = arc.GetPrefetchStats();
+      std::cerr << "Scenario prefetch: " << stats.hits << " hits, "
+                << stats.waits << " waits, " << stats.misses << " misses"
+                << std::endl;
+    }
+
+    if (preparse_parameters_) {
+      const ParameterPreparser::Stats& stats =
+          rlmachine.parameter_preparser()->stats();
+      std::cerr << "Parameter preparsing: " << stats.scenarios
+                << " scenarios, " << stats.commands << " commands, "
+                << stats.errors << " type errors" << std::endl;
+    }
+
+    if (image_cache_mb_ > 0) {
+      const ImageCache::Stats& stats = system->graphics().image_cache().stats();
+      std::cerr << "Image cache: " << stats.hits << " hits in " << stats.lookups
+                << " lookups (" << stats.hit_ratio() * 100 << "%), "
+                << stats.entries << " images in " << stats.bytes
+                << " bytes, " << stats.evictions << " evictions ("
+                << stats.evicted_bytes << " bytes)" << std::endl;
+    }
+
+    if (prefetch_images_) {
+      GraphicsSystem::PrefetchStats stats =
+          system->graphics().GetPrefetchStats();
+      std::cerr << "Image prefetch: " << stats.prefetches << " prefetches, "
+                << stats.hits << " hits, " << stats.wasted << " wasted"
+                << std::endl;
+    }
+
+    if (decode_images_ || prefetch_images_) {
+      const ImageDecoder::Stats& stats =
+          system->graphics().image_decoder()->stats();
+      std::cerr << "Image decoding: " << stats.decodes << " images, "
+                << stats.waits << " waits, " << stats.wait_ms
+                << " ms spent waiting" << std::endl;
+    }
+
+    if (scenario_cache_mb_ > 0) {
+      libreallive::Archive::CacheStats stats = arc.GetCacheStats();
+      std::cerr << "Scenario cache: " << stats.scenarios << " scenarios in "
+                << stats.bytes << " bytes, " << stats.evictions
+                << " evictions (" << stats.evicted_bytes << " bytes)"
+                << std::endl;
+    }
   }
   catch (rlvm::UserPresentableError& e) {
     ReportFatalError(e.message_text(), e.informative_text());
@@ -220,11 +337,11 @@ void RLVMInstance::DoUserNameCheck(RLMachine& machine) {
     // Iterate over all the names in both global and local memory banks.
     GlobalMemory& g = machine.memory().global();
     for (int i = 0; i < SIZE_OF_NAME_BANK; ++i)
-      cp932toUTF8(g.global_names[i], encoding);
+      cp932toUTF8(g.global_names.Get(i).as_string(), encoding);
 
     LocalMemory& l = machine.memory().local();
     for (int i = 0; i < SIZE_OF_NAME_BANK; ++i)
-      cp932toUTF8(l.local_names[i], encoding);
+      cp932toUTF8(l.local_names.Get(i).as_string(), encoding);
   }
   catch (...) {
     // We've failed to interpret one of the name strings as a string in the
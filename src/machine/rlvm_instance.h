@@ -51,6 +51,18 @@ class RLVMInstance {
   void set_tracing() { tracing_ = true; }
   void set_load_save(int in) { load_save_ = in; }
   void set_custom_font(const std::string& font) { custom_font_ = font; }
+  void set_preload_scenarios() { preload_scenarios_ = true; }
+  void set_prefetch_scenarios() { prefetch_scenarios_ = true; }
+  void set_scenario_cache_mb(int in) { scenario_cache_mb_ = in; }
+  void set_preparse_parameters() { preparse_parameters_ = true; }
+  void set_decode_images() { decode_images_ = true; }
+  void set_prefetch_images() { prefetch_images_ = true; }
+  void set_image_cache_mb(int in) { image_cache_mb_ = in; }
+  void set_headless() { headless_ = true; }
+  void set_turbo() { turbo_ = true; }
+  void set_decision_file(const boost::filesystem::path& in) {
+    decision_file_ = in;
+  }
 
   void set_dump_seen(int in) { dump_seen_ = in; }
 
@@ -110,6 +122,44 @@ class RLVMInstance {
 
   // Dumps pseudo-kepago of the current seen to stdout and exit if not -1.
   int dump_seen_;
+
+  // Whether we decode every scenario on background threads at startup instead
+  // of on first use.
+  bool preload_scenarios_;
+
+  // Whether we decode the scenarios reachable from the current one in the
+  // background, and report how often that kept ahead of the interpreter.
+  bool prefetch_scenarios_;
+
+  // Caps the memory used by parsed scenarios if positive, and reports cache
+  // evictions on exit.
+  int scenario_cache_mb_;
+
+  // Whether command parameters are parsed and type checked in the background
+  // as each scenario is loaded.
+  bool preparse_parameters_;
+
+  // Whether images are decoded on background threads, and how often drawing
+  // had to wait on them is reported on exit.
+  bool decode_images_;
+
+  // Whether images named a little ahead of the instruction pointer are
+  // decoded before they're needed. Implies |decode_images_|.
+  bool prefetch_images_;
+
+  // Overrides the memory budget of the image cache if positive, and reports
+  // how well the cache did on exit.
+  int image_cache_mb_;
+
+  // Whether we run without a window or sound on a virtual clock (see
+  // NullSystem), reporting how long the run took on exit.
+  bool headless_;
+
+  // Whether we skip through text and waits as fast as possible.
+  bool turbo_;
+
+  // The selections a headless run makes, one per line, if not empty.
+  boost::filesystem::path decision_file_;
 };
 
 #endif  // SRC_MACHINE_RLVM_INSTANCE_H_
@@ -0,0 +1,141 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+#include "machine/save_data.h"
+
+#include <algorithm>
+#include <istream>
+#include <string>
+#include <vector>
+
+#include "utilities/exception.h"
+
+namespace {
+
+void Store32(char* out, uint32_t value) {
+  for (int i = 0; i < 4; ++i)
+    out[i] = (value >> (i * 8)) & 0xff;
+}
+
+uint32_t Load32(const char* in) {
+  const unsigned char* bytes = reinterpret_cast<const unsigned char*>(in);
+  return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) |
+         (uint32_t(bytes[3]) << 24);
+}
+
+}  // namespace
+
+void SaveDataWriter::WriteInt32(int32_t value) {
+  WriteUint32(static_cast<uint32_t>(value));
+}
+
+void SaveDataWriter::WriteUint32(uint32_t value) {
+  char bytes[4];
+  Store32(bytes, value);
+  out_.append(bytes, sizeof(bytes));
+}
+
+void SaveDataWriter::WriteInt64(int64_t value) {
+  uint64_t bits = static_cast<uint64_t>(value);
+  WriteUint32(bits & 0xffffffff);
+  WriteUint32(bits >> 32);
+}
+
+void SaveDataWriter::WriteString(StringPiece value) {
+  WriteUint32(value.size());
+  value.AppendToString(&out_);
+}
+
+void SaveDataWriter::WriteIntBank(const int* values, size_t count) {
+  WriteUint32(count);
+  size_t start = out_.size();
+  out_.resize(start + count * 4);
+  char* out = &out_[start];
+  for (size_t i = 0; i < count; ++i)
+    Store32(out + i * 4, static_cast<uint32_t>(values[i]));
+}
+
+void SaveDataWriter::WriteStringTable(const StringBank& bank) {
+  WriteUint32(bank.size());
+  for (int i = 0; i < bank.size(); ++i)
+    WriteString(bank.Get(i));
+}
+
+int32_t SaveDataReader::ReadInt32() {
+  return static_cast<int32_t>(ReadUint32());
+}
+
+uint32_t SaveDataReader::ReadUint32() {
+  char bytes[4];
+  Fill(bytes, sizeof(bytes));
+  return Load32(bytes);
+}
+
+int64_t SaveDataReader::ReadInt64() {
+  uint64_t low = ReadUint32();
+  uint64_t high = ReadUint32();
+  return static_cast<int64_t>(low | (high << 32));
+}
+
+std::string SaveDataReader::ReadString() {
+  // Read in pieces, so that a damaged length fails at the end of the file
+  // instead of allocating up front.
+  const size_t kPiece = 64 * 1024;
+  size_t remaining = ReadUint32();
+  std::string value;
+  while (remaining) {
+    size_t piece = std::min(remaining, kPiece);
+    size_t start = value.size();
+    value.resize(start + piece);
+    Fill(&value[start], piece);
+    remaining -= piece;
+  }
+  return value;
+}
+
+void SaveDataReader::ReadIntBank(int* values, size_t count) {
+  ExpectCount(count);
+  std::vector<char> bytes(count * 4);
+  Fill(bytes.data(), bytes.size());
+  for (size_t i = 0; i < count; ++i)
+    values[i] = static_cast<int32_t>(Load32(&bytes[i * 4]));
+}
+
+void SaveDataReader::ReadStringTable(StringBank& bank) {
+  ExpectCount(bank.size());
+  for (int i = 0; i < bank.size(); ++i)
+    bank.Set(i, ReadString());
+}
+
+void SaveDataReader::Fill(char* out, size_t bytes) {
+  if (!in_.read(out, bytes))
+    throw rlvm::Exception("Truncated save file");
+}
+
+void SaveDataReader::ExpectCount(size_t count) {
+  if (ReadUint32() != count)
+    throw rlvm::Exception("Save file memory bank has the wrong size");
+}
@@ -0,0 +1,83 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+#ifndef SRC_MACHINE_SAVE_DATA_H_
+#define SRC_MACHINE_SAVE_DATA_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+#include "machine/string_bank.h"
+
+// Fields of the binary save format (see Serialization::SaveFormat). Every
+// field has a fixed width and is little-endian, so a file reads back the same
+// on any machine and with any compiler or boost version.
+
+// Appends fields to a string.
+class SaveDataWriter {
+ public:
+  explicit SaveDataWriter(std::string& out) : out_(out) {}
+
+  void WriteInt32(int32_t value);
+  void WriteUint32(uint32_t value);
+  void WriteInt64(int64_t value);
+
+  // A u32 length followed by the bytes of |value|.
+  void WriteString(StringPiece value);
+
+  // A u32 count followed by |count| i32 values.
+  void WriteIntBank(const int* values, size_t count);
+
+  // A u32 count followed by every string in |bank|.
+  void WriteStringTable(const StringBank& bank);
+
+ private:
+  std::string& out_;
+};
+
+// Reads fields written by SaveDataWriter. Throws rlvm::Exception if the data
+// runs out or a bank or table isn't the expected size.
+class SaveDataReader {
+ public:
+  explicit SaveDataReader(std::istream& in) : in_(in) {}
+
+  int32_t ReadInt32();
+  uint32_t ReadUint32();
+  int64_t ReadInt64();
+  std::string ReadString();
+  void ReadIntBank(int* values, size_t count);
+  void ReadStringTable(StringBank& bank);
+
+ private:
+  void Fill(char* out, size_t bytes);
+  void ExpectCount(size_t count);
+
+  std::istream& in_;
+};
+
+#endif  // SRC_MACHINE_SAVE_DATA_H_
@@ -0,0 +1,204 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+
+#include "machine/save_writer.h"
+
+#include <boost/filesystem/operations.hpp>
+
+#include <cstdio>
+#include <exception>
+#include <iostream>
+#include <sstream>
+#include <utility>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "machine/serialization.h"
+#include "utilities/worker_pool.h"
+
+namespace fs = boost::filesystem;
+
+namespace {
+
+// Flushes |file|'s data all the way to the disk.
+bool SyncFile(FILE* file) {
+#if defined(_WIN32)
+  return _commit(_fileno(file)) == 0;
+#else
+  return fsync(fileno(file)) == 0;
+#endif
+}
+
+// Makes a rename in |directory| durable. Only meaningful on POSIX.
+void SyncDirectory(const fs::path& directory) {
+#if !defined(_WIN32)
+  int fd = open(directory.string().c_str(), O_RDONLY);
+  if (fd >= 0) {
+    fsync(fd);
+    close(fd);
+  }
+#endif
+}
+
+}  // namespace
+
+SaveWriter::SaveWriter() : pool_(new WorkerPool(1)) {}
+
+SaveWriter::~SaveWriter() {
+  // WorkerPool discards tasks that haven't started, and these are the player's
+  // save files.
+  pool_->WaitUntilIdle();
+}
+
+void SaveWriter::QueueWrite(const fs::path& path,
+                            std::string snapshot,
+                            const fs::path& superseded) {
+  // std::function needs a copyable functor, so the snapshot is moved into a
+  // shared_ptr instead of being captured.
+  std::shared_ptr<std::string> data =
+      std::make_shared<std::string>(std::move(snapshot));
+  Post(path, [path, data, superseded] {
+    return WriteFile(path, *data, superseded);
+  });
+}
+
+void SaveWriter::QueueWrite(const fs::path& path,
+                            std::shared_ptr<const void> state,
+                            std::function<std::string()> serialize) {
+  auto job = [path, serialize] {
+    std::string snapshot;
+    try {
+      snapshot = serialize();
+    }
+    catch (std::exception& e) {
+      return std::string("could not serialize: ") + e.what();
+    }
+    return WriteFile(path, snapshot, fs::path());
+  };
+  Post(path, job, std::move(state));
+}
+
+void SaveWriter::QueueAppend(const fs::path& path, std::string data) {
+  std::shared_ptr<std::string> shared =
+      std::make_shared<std::string>(std::move(data));
+  Post(path, [path, shared] { return AppendFile(path, *shared); });
+}
+
+void SaveWriter::ReportFinished() {
+  std::vector<std::string> finished = finished_.TakeFinished();
+  in_flight_.erase(in_flight_.begin(), in_flight_.begin() + finished.size());
+  for (const std::string& result : finished) {
+    if (result.empty()) {
+      stats_.writes++;
+    } else {
+      std::cerr << "WARNING: Could not write save file " << result
+                << std::endl;
+      stats_.failures++;
+      errors_.push_back(result);
+    }
+  }
+}
+
+void SaveWriter::WaitUntilIdle() { pool_->WaitUntilIdle(); }
+
+void SaveWriter::Post(const fs::path& path,
+                      std::function<std::string()> job,
+                      std::shared_ptr<const void> state) {
+  in_flight_.push_back(std::move(state));
+  finished_.Post(*pool_, [path, job] {
+    std::string result = job();
+    if (!result.empty())
+      result = path.string() + ": " + result;
+    return result;
+  });
+}
+
+// static
+std::string SaveWriter::WriteFile(const fs::path& path,
+                                  const std::string& snapshot,
+                                  const fs::path& superseded) {
+  std::ostringstream compressed;
+  Serialization::writeSnapshotTo(compressed, snapshot);
+  const std::string data = compressed.str();
+
+  fs::path temporary = path;
+  temporary += ".tmp";
+
+  FILE* file = fopen(temporary.string().c_str(), "wb");
+  if (!file)
+    return "could not open " + temporary.string();
+
+  bool written = fwrite(data.data(), 1, data.size(), file) == data.size() &&
+                 fflush(file) == 0 && SyncFile(file);
+  written = (fclose(file) == 0) && written;
+
+  boost::system::error_code ec;
+  if (!written) {
+    fs::remove(temporary, ec);
+    return "could not write " + temporary.string();
+  }
+
+  fs::rename(temporary, path, ec);
+  if (ec) {
+    fs::remove(temporary, ec);
+    return ec.message();
+  }
+
+  // Only removed once the new file is in place, so that a failed rename
+  // doesn't lose it along with the file it supplements.
+  if (!superseded.empty())
+    fs::remove(superseded, ec);
+
+  SyncDirectory(path.parent_path());
+  return std::string();
+}
+
+// static
+std::string SaveWriter::AppendFile(const fs::path& path,
+                                   const std::string& data) {
+  boost::system::error_code ec;
+  bool created = !fs::exists(path, ec);
+
+  FILE* file = fopen(path.string().c_str(), "ab");
+  if (!file)
+    return "could not open " + path.string();
+
+  bool written = fwrite(data.data(), 1, data.size(), file) == data.size() &&
+                 fflush(file) == 0 && SyncFile(file);
+  written = (fclose(file) == 0) && written;
+  if (!written)
+    return "could not append to " + path.string();
+
+  if (created)
+    SyncDirectory(path.parent_path());
+  return std::string();
+}
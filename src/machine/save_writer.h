@@ -0,0 +1,139 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+
+#ifndef SRC_MACHINE_SAVE_WRITER_H_
+#define SRC_MACHINE_SAVE_WRITER_H_
+
+#include <boost/filesystem/path.hpp>
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "utilities/finished_queue.h"
+
+class WorkerPool;
+
+// Writes save games and the global memory file on a background thread.
+//
+// The interpreter thread only copies the state out of the machine (see
+// Serialization::takeGameSnapshot()). The worker serializes it into an
+// uncompressed binary payload, compresses that, writes it to a temporary file
+// next to the destination, fsyncs it and renames it over the destination, so
+// a crash at any point leaves either the previous file or the new one on
+// disk, never a partial file. Writes run in the order they were queued.
+//
+// Results are handed back to the interpreter thread by ReportFinished().
+class SaveWriter {
+ public:
+  SaveWriter();
+
+  // Finishes every queued write.
+  ~SaveWriter();
+
+  // Queues |snapshot| to be written to |path| as a binary format save file.
+  // If |superseded| is given, that file is deleted once the new file has been
+  // renamed into place. Readers of |superseded| must cope with it outliving
+  // the write after a crash; see GlobalMemoryJournal.
+  void QueueWrite(const boost::filesystem::path& path,
+                  std::string snapshot,
+                  const boost::filesystem::path& superseded =
+                      boost::filesystem::path());
+
+  // Queues the payload returned by |serialize|, which runs on the worker, to
+  // be written to |path| as above. |serialize| may only read |state|, which
+  // is held until ReportFinished() accounts for the write so that it's
+  // released on this thread; save game snapshots hold graphics objects, whose
+  // surfaces belong to the main thread.
+  void QueueWrite(const boost::filesystem::path& path,
+                  std::shared_ptr<const void> state,
+                  std::function<std::string()> serialize);
+
+  // Queues |data| to be appended to |path|, which is created if it doesn't
+  // exist. Used for the global memory journal.
+  void QueueAppend(const boost::filesystem::path& path, std::string data);
+
+  // Accounts for every write the worker has finished, printing the ones that
+  // failed. Only takes a lock when there is something to report.
+  void ReportFinished();
+
+  // Blocks until every queued write is on disk (or has failed). Doesn't
+  // report them.
+  void WaitUntilIdle();
+
+  // Whether there are queued writes that haven't been reported yet.
+  bool has_pending_writes() const { return finished_.pending() > 0; }
+
+  struct Stats {
+    Stats() : writes(0), failures(0) {}
+
+    // Files that were written successfully.
+    int writes;
+
+    // Writes that failed and left the previous file in place.
+    int failures;
+  };
+  const Stats& stats() const { return stats_; }
+
+  // Every failed write reported so far, formatted like
+  // "<path>: <message>".
+  const std::vector<std::string>& errors() const { return errors_; }
+
+ private:
+  // Runs |job| on |pool_| and records its result against |path|. |state| is
+  // kept alive until the result has been reported.
+  void Post(const boost::filesystem::path& path,
+            std::function<std::string()> job,
+            std::shared_ptr<const void> state = nullptr);
+
+  // These run on |pool_|. They return an empty string on success and the
+  // reason for the failure otherwise.
+  static std::string WriteFile(const boost::filesystem::path& path,
+                               const std::string& snapshot,
+                               const boost::filesystem::path& superseded);
+  static std::string AppendFile(const boost::filesystem::path& path,
+                                const std::string& data);
+
+  // Results of writes, as returned by WriteFile() and prefixed with their
+  // path when they failed.
+  FinishedQueue<std::string> finished_;
+
+  // The |state| of every write that hasn't been reported, in the order they
+  // were posted, which is also the order they finish in.
+  std::deque<std::shared_ptr<const void>> in_flight_;
+
+  Stats stats_;
+  std::vector<std::string> errors_;
+
+  // Declared last so its thread is joined before anything it touches goes
+  // away.
+  std::unique_ptr<WorkerPool> pool_;
+};
+
+#endif  // SRC_MACHINE_SAVE_WRITER_H_
@@ -29,6 +29,13 @@
 #define SRC_MACHINE_SERIALIZATION_H_
 
 #include <boost/filesystem/path.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/stream.hpp>
+
+#include <iosfwd>
+#include <memory>
+#include <string>
 
 #include "machine/save_game_header.h"
 
@@ -46,16 +53,90 @@ namespace Serialization {
 //          here; this is a likely location for errors
 extern RLMachine* g_current_machine;
 
+// The on-disk formats of save games and global memory. Both are zlib
+// compressed. SAVE_FORMAT_TEXT is a bare boost text archive, which is what
+// every rlvm before the binary format wrote; it's still loaded, but only
+// written on request. SAVE_FORMAT_BINARY is a magic and format version
+// header followed by fixed width little-endian fields (see SaveDataWriter);
+// the object graphs inside it are still boost text archives.
+enum SaveFormat {
+  SAVE_FORMAT_TEXT,
+  SAVE_FORMAT_BINARY
+};
+
+// Writes the header that identifies |format|. Text files have none.
+void writeSaveFormat(std::ostream& oss, SaveFormat format);
+
+// Reads the header written by writeSaveFormat() and leaves |iss| at the start
+// of the compressed archive. Throws if the file was written by a newer
+// version of the binary format.
+SaveFormat readSaveFormat(std::istream& iss);
+
+// The zlib settings files in |format| are written with. The binary format
+// trades a little size for the fastest compression level, since it's already
+// much smaller than text.
+boost::iostreams::zlib_params compressionParamsFor(SaveFormat format);
+
+// Writes |snapshot|, the uncompressed payload from snapshotGame() or
+// snapshotGlobalMemory(), to |oss| as a complete binary format file. Doesn't
+// touch the machine, so it's safe to call on a worker thread.
+void writeSnapshotTo(std::ostream& oss, const std::string& snapshot);
+
+// Save files are read through a memory mapping instead of an ifstream.
+typedef boost::iostreams::stream<boost::iostreams::mapped_file_source>
+    MappedFileStream;
+
+// Maps |path| and opens |stream| over it. Returns false if the file doesn't
+// exist or can't be mapped.
+bool openMappedFile(const boost::filesystem::path& path,
+                    MappedFileStream& stream);
+
+boost::filesystem::path buildGlobalMemoryFilename(RLMachine& machine);
+boost::filesystem::path buildGlobalJournalFilename(RLMachine& machine);
+
+// Queues the changes to global memory since the last save to be written by
+// the machine's SaveWriter. Once loadGlobalMemory() has run, these are
+// usually appended to the journal file; otherwise, or when the journal has
+// grown too large, the whole global memory file is rewritten and the journal
+// deleted. See GlobalMemoryJournal.
 void saveGlobalMemory(RLMachine& machine);
-void saveGlobalMemoryTo(std::ostream& oss, RLMachine& machine);
+void saveGlobalMemoryTo(std::ostream& oss,
+                        RLMachine& machine,
+                        SaveFormat format = SAVE_FORMAT_BINARY);
 
+// Serializes global memory into an uncompressed binary payload. This is the
+// only part of saveGlobalMemory() that happens on the interpreter thread.
+std::string snapshotGlobalMemory(RLMachine& machine);
+
+// Loads the global memory file and replays the journal on top of it.
 void loadGlobalMemory(RLMachine& machine);
 void loadGlobalMemoryFrom(std::istream& iss, RLMachine& machine);
 
 boost::filesystem::path buildSaveGameFilename(RLMachine& machine, int slot);
 
+// Queues a save game to be written to |slot| (or |path|) by the machine's
+// SaveWriter.
 void saveGameForSlot(RLMachine& machine, int slot);
-void saveGameTo(std::ostream& oss, RLMachine& machine);
+void queueSaveGame(RLMachine& machine, const boost::filesystem::path& path);
+void saveGameTo(std::ostream& oss,
+                RLMachine& machine,
+                SaveFormat format = SAVE_FORMAT_BINARY);
+
+// Copies of everything a save game holds, so that it can be serialized off
+// the interpreter thread.
+struct GameSnapshot;
+
+// Takes a GameSnapshot of |machine|. This is the only part of
+// saveGameForSlot() that happens on the interpreter thread. The snapshot
+// holds graphics objects, so it must be destroyed on this thread too.
+std::shared_ptr<const GameSnapshot> takeGameSnapshot(RLMachine& machine);
+
+// Serializes |snapshot| into an uncompressed binary payload. Doesn't touch the
+// machine, so it's safe to call on a worker thread.
+std::string serializeGameSnapshot(const GameSnapshot& snapshot);
+
+// Both of the above, for saving on the interpreter thread.
+std::string snapshotGame(RLMachine& machine);
 
 SaveGameHeader loadHeaderForSlot(RLMachine& machine, int slot);
 SaveGameHeader loadHeaderFrom(std::istream& iss);
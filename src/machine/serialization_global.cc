@@ -27,9 +27,9 @@
 
 #include "machine/serialization.h"
 
-// include headers that implement a archive in simple text format
-#include <boost/archive/text_oarchive.hpp>
+// include headers that implement archives in simple text format
 #include <boost/archive/text_iarchive.hpp>
+#include <boost/archive/text_oarchive.hpp>
 #include <boost/serialization/split_free.hpp>
 #include <boost/serialization/vector.hpp>
 #include <boost/serialization/set.hpp>
@@ -42,10 +42,16 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "libreallive/intmemref.h"
+#include "machine/global_memory_journal.h"
 #include "machine/memory.h"
 #include "machine/rlmachine.h"
+#include "machine/save_data.h"
+#include "machine/save_writer.h"
 #include "systems/base/event_system.h"
 #include "systems/base/graphics_system.h"
 #include "systems/base/sound_system.h"
@@ -70,43 +76,226 @@ fs::path buildGlobalMemoryFilename(RLMachine& machine) {
   return machine.system().GameSaveDirectory() / "global.sav.gz";
 }
 
+fs::path buildGlobalJournalFilename(RLMachine& machine) {
+  return machine.system().GameSaveDirectory() / "global.journal";
+}
+
+namespace {
+
+template <typename OArchive>
+void saveSettingsToArchive(OArchive& oa, RLMachine& machine) {
+  System& sys = machine.system();
+  oa << const_cast<const SystemGlobals&>(sys.globals())
+     << const_cast<const GraphicsSystemGlobals&>(sys.graphics().globals())
+     << const_cast<const EventSystemGlobals&>(sys.event().globals())
+     << const_cast<const TextSystemGlobals&>(sys.text().globals())
+     << const_cast<const SoundSystemGlobals&>(sys.sound().globals());
+}
+
+template <typename OArchive>
+void saveGlobalMemoryToArchive(OArchive& oa, RLMachine& machine) {
+  oa << CURRENT_GLOBAL_VERSION
+     << const_cast<const GlobalMemory&>(machine.memory().global());
+  saveSettingsToArchive(oa, machine);
+}
+
+// The parts of the global memory file that the journal doesn't track, as a
+// boost text archive. A save only appends to the journal if these haven't
+// changed since the checkpoint.
+std::string snapshotSettings(RLMachine& machine) {
+  std::ostringstream oss;
+  {
+    boost::archive::text_oarchive oa(oss);
+    saveSettingsToArchive(oa, machine);
+  }
+  return oss.str();
+}
+
+void loadSettings(const std::string& settings, RLMachine& machine) {
+  System& sys = machine.system();
+  std::istringstream iss(settings);
+  boost::archive::text_iarchive ia(iss);
+  ia >> sys.globals() >> sys.graphics().globals() >> sys.event().globals() >>
+      sys.text().globals() >> sys.sound().globals();
+  sys.sound().RestoreFromGlobals();
+}
+
+// Binary global memory files hold, in order:
+// - i32 global version,
+// - u32 journal generation (see GlobalMemoryJournal::generation()),
+// - intG, intZ, strM and the global names,
+// - u32 count of scenarios with kidoku data, then for each an i32 scenario
+//   number, a u32 bit count and the bits packed eight to a byte, lowest
+//   first,
+// - a string holding the settings from snapshotSettings().
+
+void writeKidokuData(SaveDataWriter& out,
+                     const std::map<int, boost::dynamic_bitset<>>& kidoku) {
+  out.WriteUint32(kidoku.size());
+  std::string packed;
+  for (auto const& scenario : kidoku) {
+    const boost::dynamic_bitset<>& bits = scenario.second;
+    packed.assign((bits.size() + 7) / 8, '\0');
+    for (size_t i = bits.find_first(); i != bits.npos; i = bits.find_next(i))
+      packed[i / 8] |= static_cast<char>(1 << (i % 8));
+
+    out.WriteInt32(scenario.first);
+    out.WriteUint32(bits.size());
+    out.WriteString(packed);
+  }
+}
+
+void readKidokuData(SaveDataReader& in,
+                    std::map<int, boost::dynamic_bitset<>>& kidoku) {
+  kidoku.clear();
+  uint32_t count = in.ReadUint32();
+  for (uint32_t n = 0; n < count; ++n) {
+    int scenario = in.ReadInt32();
+    uint32_t size = in.ReadUint32();
+    std::string packed = in.ReadString();
+    if (packed.size() != (size + 7) / 8)
+      throw rlvm::Exception("Damaged kidoku data in global memory file");
+
+    boost::dynamic_bitset<>& bits = kidoku[scenario];
+    bits.resize(size);
+    for (size_t byte = 0; byte < packed.size(); ++byte) {
+      unsigned char value = packed[byte];
+      for (int bit = 0; value; ++bit, value >>= 1) {
+        if (value & 1)
+          bits.set(byte * 8 + bit);
+      }
+    }
+  }
+}
+
+// Replays the journal file, if there is one, on top of the global memory that
+// was just loaded.
+void replayGlobalJournal(RLMachine& machine) {
+  GlobalMemory& global = machine.memory().global();
+  SaveWriter& writer = machine.save_writer();
+
+  fs::path journal = buildGlobalJournalFilename(machine);
+  boost::system::error_code ec;
+  size_t journal_size = fs::exists(journal, ec) ? fs::file_size(journal, ec) : 0;
+  size_t applied = 0;
+  if (journal_size > 0) {
+    fs::ifstream file(journal, std::ios::binary);
+    applied = GlobalMemoryJournal::Replay(file, global.journal.generation(),
+                                          global);
+  }
+
+  // A journal with a torn last record (a crash during an append) or from
+  // another checkpoint (a crash before it was deleted) can't be appended to;
+  // the next save writes a checkpoint and deletes it.
+  if (applied == journal_size) {
+    global.journal.MarkLoaded(
+        snapshotSettings(machine), applied, writer.stats().failures);
+  } else {
+    std::cerr << "WARNING: Ignoring the last " << (journal_size - applied)
+              << " bytes of " << journal << std::endl;
+  }
+}
+
+template <typename IArchive>
+void loadGlobalMemoryFromArchive(IArchive& ia, RLMachine& machine) {
+  System& sys = machine.system();
+  int version;
+  ia >> version;
+
+  // Load global memory.
+  ia >> machine.memory().global();
+
+  // When Karmic Koala came out, support for all boost earlier than 1.36 was
+  // dropped. For years, I had used boost 1.35 on Ubuntu. It turns out that
+  // boost 1.35 had a serious bug in it, where it wouldn't save vectors of
+  // primitive data types correctly. These global data files no longer load
+  // correctly.
+  //
+  // After flirting with moving to Google protobuf (can't; doesn't handle
+  // complex object graphs like GraphicsObject and its copy-on-write stuff),
+  // and then trying to fix the problem in a forked copy of the serialization
+  // headers which was unsuccessful, I'm just saying to hell with the user's
+  // settings. Most people don't change these values and save games and global
+  // memory still work (per above.)
+  if (version == CURRENT_GLOBAL_VERSION) {
+    ia >> sys.globals() >> sys.graphics().globals() >> sys.event().globals() >>
+        sys.text().globals() >> sys.sound().globals();
+
+    // Restore options which may have System specific implementations. (This
+    // will probably expand as more of RealLive is implemented).
+    sys.sound().RestoreFromGlobals();
+  }
+}
+
+}  // namespace
+
 void saveGlobalMemory(RLMachine& machine) {
-  fs::path home = buildGlobalMemoryFilename(machine);
-  fs::ofstream file(home, std::ios::binary);
-  if (!file) {
-    throw rlvm::Exception(_("Could not open global memory file."));
+  GlobalMemoryJournal& journal = machine.memory().global().journal;
+  SaveWriter& writer = machine.save_writer();
+  writer.ReportFinished();
+
+  std::string settings = snapshotSettings(machine);
+  if (journal.CanAppend(settings, writer.stats().failures)) {
+    std::string records = journal.TakePending();
+    if (!records.empty())
+      writer.QueueAppend(buildGlobalJournalFilename(machine),
+                         std::move(records));
+    return;
   }
 
-  saveGlobalMemoryTo(file, machine);
+  journal.MarkCheckpointed(settings, writer.stats().failures);
+  writer.QueueWrite(buildGlobalMemoryFilename(machine),
+                    snapshotGlobalMemory(machine),
+                    buildGlobalJournalFilename(machine));
 }
 
-void saveGlobalMemoryTo(std::ostream& oss, RLMachine& machine) {
+void saveGlobalMemoryTo(std::ostream& oss,
+                        RLMachine& machine,
+                        SaveFormat save_format) {
+  if (save_format == SAVE_FORMAT_BINARY) {
+    writeSnapshotTo(oss, snapshotGlobalMemory(machine));
+    return;
+  }
+
   boost::iostreams::filtering_stream<boost::iostreams::output> filtered_output;
-  filtered_output.push(boost::iostreams::zlib_compressor());
+  filtered_output.push(boost::iostreams::zlib_compressor(
+      compressionParamsFor(save_format)));
   filtered_output.push(oss);
 
   boost::archive::text_oarchive oa(filtered_output);
-  System& sys = machine.system();
+  saveGlobalMemoryToArchive(oa, machine);
+}
 
-  oa << CURRENT_GLOBAL_VERSION
-     << const_cast<const GlobalMemory&>(machine.memory().global())
-     << const_cast<const SystemGlobals&>(sys.globals())
-     << const_cast<const GraphicsSystemGlobals&>(sys.graphics().globals())
-     << const_cast<const EventSystemGlobals&>(sys.event().globals())
-     << const_cast<const TextSystemGlobals&>(sys.text().globals())
-     << const_cast<const SoundSystemGlobals&>(sys.sound().globals());
+std::string snapshotGlobalMemory(RLMachine& machine) {
+  const GlobalMemory& global = machine.memory().global();
+
+  std::string snapshot;
+  SaveDataWriter out(snapshot);
+  out.WriteInt32(CURRENT_GLOBAL_VERSION);
+  out.WriteUint32(global.journal.generation());
+  out.WriteIntBank(global.intG, SIZE_OF_MEM_BANK);
+  out.WriteIntBank(global.intZ, SIZE_OF_MEM_BANK);
+  out.WriteStringTable(global.strM);
+  out.WriteStringTable(global.global_names);
+  writeKidokuData(out, global.kidoku_data);
+  out.WriteString(snapshotSettings(machine));
+  return snapshot;
 }
 
 void loadGlobalMemory(RLMachine& machine) {
+  machine.WaitForPendingSaves();
+  machine.memory().global().journal.Enable();
+
   fs::path home = buildGlobalMemoryFilename(machine);
-  fs::ifstream file(home, std::ios::binary);
+  MappedFileStream file;
 
   // If we were able to open the file for reading, load it. Don't
   // complain if we're unable to, since this may be the first run on
   // this certain game and it may not exist yet.
-  if (file) {
+  if (openMappedFile(home, file)) {
     try {
       loadGlobalMemoryFrom(file, machine);
+      replayGlobalJournal(machine);
     }
     catch (...) {
       // Swallow ALL exceptions during file reading. If loading the global
@@ -129,37 +318,29 @@ void loadGlobalMemory(RLMachine& machine) {
 }
 
 void loadGlobalMemoryFrom(std::istream& iss, RLMachine& machine) {
+  SaveFormat save_format = readSaveFormat(iss);
+
   boost::iostreams::filtering_stream<boost::iostreams::input> filtered_input;
   filtered_input.push(boost::iostreams::zlib_decompressor());
   filtered_input.push(iss);
 
-  boost::archive::text_iarchive ia(filtered_input);
-  System& sys = machine.system();
-  int version;
-  ia >> version;
-
-  // Load global memory.
-  ia >> machine.memory().global();
-
-  // When Karmic Koala came out, support for all boost earlier than 1.36 was
-  // dropped. For years, I had used boost 1.35 on Ubuntu. It turns out that
-  // boost 1.35 had a serious bug in it, where it wouldn't save vectors of
-  // primitive data types correctly. These global data files no longer load
-  // correctly.
-  //
-  // After flirting with moving to Google protobuf (can't; doesn't handle
-  // complex object graphs like GraphicsObject and its copy-on-write stuff),
-  // and then trying to fix the problem in a forked copy of the serialization
-  // headers which was unsuccessful, I'm just saying to hell with the user's
-  // settings. Most people don't change these values and save games and global
-  // memory still work (per above.)
-  if (version == CURRENT_GLOBAL_VERSION) {
-    ia >> sys.globals() >> sys.graphics().globals() >> sys.event().globals() >>
-        sys.text().globals() >> sys.sound().globals();
-
-    // Restore options which may have System specific implementations. (This
-    // will probably expand as more of RealLive is implemented).
-    sys.sound().RestoreFromGlobals();
+  if (save_format == SAVE_FORMAT_BINARY) {
+    GlobalMemory& global = machine.memory().global();
+    SaveDataReader in(filtered_input);
+    if (in.ReadInt32() != CURRENT_GLOBAL_VERSION)
+      throw rlvm::Exception("Unknown global memory version");
+    global.journal.set_generation(in.ReadUint32());
+    in.ReadIntBank(global.intG, SIZE_OF_MEM_BANK);
+    in.ReadIntBank(global.intZ, SIZE_OF_MEM_BANK);
+    in.ReadStringTable(global.strM);
+    in.ReadStringTable(global.global_names);
+    readKidokuData(in, global.kidoku_data);
+    loadSettings(in.ReadString(), machine);
+  } else {
+    // Text files predate the journal, so no journal extends them.
+    machine.memory().global().journal.set_generation(0);
+    boost::archive::text_iarchive ia(filtered_input);
+    loadGlobalMemoryFromArchive(ia, machine);
   }
 }
 
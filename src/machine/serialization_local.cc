@@ -25,21 +25,28 @@
 //
 // -----------------------------------------------------------------------
 
-// include headers that implement a archive in simple text format
-#include <boost/archive/text_oarchive.hpp>
+// include headers that implement archives in simple text format
 #include <boost/archive/text_iarchive.hpp>
+#include <boost/archive/text_oarchive.hpp>
+#include <boost/serialization/deque.hpp>
 #include <boost/serialization/split_free.hpp>
 #include <boost/serialization/vector.hpp>
 #include <boost/serialization/export.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/date_time/posix_time/time_serialize.hpp>
 #include <boost/filesystem/path.hpp>
 #include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
 #include <boost/iostreams/filtering_stream.hpp>
 #include <boost/iostreams/filter/zlib.hpp>
+#include <algorithm>
+#include <cstdint>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <exception>
+#include <limits>
+#include <memory>
 #include <stdexcept>
 #include <string>
 
@@ -47,7 +54,9 @@
 #include "libreallive/intmemref.h"
 #include "machine/memory.h"
 #include "machine/rlmachine.h"
+#include "machine/save_data.h"
 #include "machine/save_game_header.h"
+#include "machine/save_writer.h"
 #include "machine/serialization.h"
 #include "machine/stack_frame.h"
 #include "systems/base/anm_graphics_object_data.h"
@@ -71,6 +80,92 @@ RLMachine* g_current_machine = NULL;
 
 const int CURRENT_LOCAL_VERSION = 2;
 
+// Identifies a binary save file. Text save files are bare zlib streams, which
+// start with 0x78 and so can never match.
+const char BINARY_FORMAT_MAGIC[8] = {'R', 'L', 'V', 'M', 'S', 'A', 'V', 'E'};
+
+// Bump this when the layout of binary files changes.
+// - 1 held a boost binary archive, which depends on the byte order and type
+//   sizes of the machine that wrote it.
+// - 2 is written field by field through SaveDataWriter.
+// - 3 added the journal generation to global memory files.
+// Older versions were only ever written by development builds, and aren't
+// read.
+const uint32_t CURRENT_BINARY_FORMAT_VERSION = 3;
+
+void writeSaveFormat(std::ostream& oss, SaveFormat save_format) {
+  if (save_format == SAVE_FORMAT_TEXT)
+    return;
+
+  char version[4];
+  for (int i = 0; i < 4; ++i)
+    version[i] = (CURRENT_BINARY_FORMAT_VERSION >> (i * 8)) & 0xff;
+  oss.write(BINARY_FORMAT_MAGIC, sizeof(BINARY_FORMAT_MAGIC));
+  oss.write(version, sizeof(version));
+}
+
+SaveFormat readSaveFormat(std::istream& iss) {
+  std::streampos start = iss.tellg();
+  char magic[sizeof(BINARY_FORMAT_MAGIC)];
+  if (!iss.read(magic, sizeof(magic)) ||
+      !std::equal(magic, magic + sizeof(magic), BINARY_FORMAT_MAGIC)) {
+    iss.clear();
+    iss.seekg(start);
+    return SAVE_FORMAT_TEXT;
+  }
+
+  unsigned char version[4];
+  if (!iss.read(reinterpret_cast<char*>(version), sizeof(version)))
+    throw rlvm::Exception("Truncated save file header");
+  uint32_t file_version = version[0] | (version[1] << 8) |
+                          (version[2] << 16) | (uint32_t(version[3]) << 24);
+  if (file_version > CURRENT_BINARY_FORMAT_VERSION) {
+    throw rlvm::Exception(str(
+        format("Save file format version %1% is newer than this rlvm") %
+        file_version));
+  }
+  if (file_version < CURRENT_BINARY_FORMAT_VERSION) {
+    throw rlvm::Exception(str(
+        format("Save file format version %1% is no longer supported") %
+        file_version));
+  }
+
+  return SAVE_FORMAT_BINARY;
+}
+
+boost::iostreams::zlib_params compressionParamsFor(SaveFormat save_format) {
+  if (save_format == SAVE_FORMAT_BINARY)
+    return boost::iostreams::zlib_params(boost::iostreams::zlib::best_speed);
+  return boost::iostreams::zlib_params();
+}
+
+void writeSnapshotTo(std::ostream& oss, const std::string& snapshot) {
+  writeSaveFormat(oss, SAVE_FORMAT_BINARY);
+
+  boost::iostreams::filtering_stream<boost::iostreams::output> filtered_output;
+  filtered_output.push(boost::iostreams::zlib_compressor(
+      compressionParamsFor(SAVE_FORMAT_BINARY)));
+  filtered_output.push(oss);
+  filtered_output.write(snapshot.data(), snapshot.size());
+}
+
+bool openMappedFile(const fs::path& path, MappedFileStream& stream) {
+  // mapped_file_source throws instead of setting a fail bit, and can't map
+  // empty files at all.
+  boost::system::error_code ec;
+  if (!fs::exists(path, ec) || fs::file_size(path, ec) == 0 || ec)
+    return false;
+
+  try {
+    stream.open(boost::iostreams::mapped_file_source(path.string()));
+  }
+  catch (std::exception&) {
+    return false;
+  }
+
+  return stream.is_open();
+}
+
 }  // namespace Serialization
 
 namespace {
@@ -83,46 +178,298 @@ void checkInFileOpened(TYPE& file, const fs::path& home) {
   }
 }
 
-}  // namespace
-
-namespace Serialization {
-
-void saveGameForSlot(RLMachine& machine, int slot) {
-  fs::path path = buildSaveGameFilename(machine, slot);
-  fs::ofstream file(path, std::ios::binary);
-  checkInFileOpened(file, path);
-
-  saveGameTo(file, machine);
+void checkInFileOpened(bool opened, const fs::path& home) {
+  if (!opened) {
+    throw rlvm::Exception(
+        str(format(_("Could not open save game file %1%")) % home));
+  }
 }
 
-void saveGameTo(std::ostream& oss, RLMachine& machine) {
-  boost::iostreams::filtering_stream<boost::iostreams::output> filtered_output;
-  filtered_output.push(boost::iostreams::zlib_compressor());
-  filtered_output.push(oss);
+// Writes a text format save game's contents to |oa|.
+void saveGameToArchive(boost::archive::text_oarchive& oa,
+                       const SaveGameHeader& header,
+                       RLMachine& machine) {
+  oa << Serialization::CURRENT_LOCAL_VERSION << header
+     << const_cast<const LocalMemory&>(machine.memory().local())
+     << const_cast<const RLMachine&>(machine)
+     << const_cast<const System&>(machine.system())
+     << const_cast<const GraphicsSystem&>(machine.system().graphics())
+     << const_cast<const TextSystem&>(machine.system().text())
+     << const_cast<const SoundSystem&>(machine.system().sound());
+}
 
+// Writes a text format save game to |oss|, uncompressed.
+void serializeGameAsText(std::ostream& oss, RLMachine& machine) {
   const SaveGameHeader header(machine.system().graphics().window_subtitle());
 
-  g_current_machine = &machine;
+  Serialization::g_current_machine = &machine;
 
   try {
-    boost::archive::text_oarchive oa(filtered_output);
-    oa << CURRENT_LOCAL_VERSION << header
-       << const_cast<const LocalMemory&>(machine.memory().local())
-       << const_cast<const RLMachine&>(machine)
-       << const_cast<const System&>(machine.system())
-       << const_cast<const GraphicsSystem&>(machine.system().graphics())
-       << const_cast<const TextSystem&>(machine.system().text())
-       << const_cast<const SoundSystem&>(machine.system().sound());
+    boost::archive::text_oarchive oa(oss);
+    saveGameToArchive(oa, header, machine);
   }
   catch (std::exception& e) {
     std::cerr << "--- WARNING: ERROR DURING SAVING FILE: " << e.what() << " ---"
               << std::endl;
 
-    g_current_machine = NULL;
+    Serialization::g_current_machine = NULL;
     throw e;
   }
 
-  g_current_machine = NULL;
+  Serialization::g_current_machine = NULL;
+}
+
+// Reads a text format save game's contents from |ia| into |machine|.
+void loadGameFromArchive(boost::archive::text_iarchive& ia,
+                         RLMachine& machine) {
+  int version;
+  SaveGameHeader header;
+  ia >> version >> header >> machine.memory().local() >> machine >>
+      machine.system() >> machine.system().graphics() >>
+      machine.system().text() >> machine.system().sound();
+}
+
+// Binary save games hold, in order:
+// - i32 local version and the SaveGameHeader,
+// - the local integer banks and strS as of the last savepoint, then the
+//   local names,
+// - a string holding a boost text archive of everything else: the call
+//   stack, the graphics stack and objects, and the text and sound state.
+//   These are object graphs that boost::serialization already knows how to
+//   walk, and its text archives, unlike its binary ones, don't depend on the
+//   machine that wrote them.
+
+const boost::posix_time::ptime kSaveTimeEpoch(
+    boost::gregorian::date(1970, 1, 1));
+
+void writeHeader(SaveDataWriter& out, const SaveGameHeader& header) {
+  out.WriteInt32(Serialization::CURRENT_LOCAL_VERSION);
+  out.WriteString(header.title);
+  if (header.save_time.is_special()) {
+    out.WriteInt64(std::numeric_limits<int64_t>::min());
+  } else {
+    out.WriteInt64((header.save_time - kSaveTimeEpoch).total_microseconds());
+  }
+}
+
+SaveGameHeader readHeader(SaveDataReader& in) {
+  int version = in.ReadInt32();
+  if (version != Serialization::CURRENT_LOCAL_VERSION)
+    throw rlvm::Exception("Unknown save game version");
+
+  SaveGameHeader header;
+  header.title = in.ReadString();
+  int64_t save_time = in.ReadInt64();
+  if (save_time == std::numeric_limits<int64_t>::min()) {
+    header.save_time = boost::posix_time::not_a_date_time;
+  } else {
+    header.save_time =
+        kSaveTimeEpoch + boost::posix_time::microseconds(save_time);
+  }
+  return header;
+}
+
+// Writes one of |local|'s integer banks as it was at the last savepoint.
+void writeIntBankRevertingChanges(SaveDataWriter& out,
+                                  const int (&bank)[SIZE_OF_MEM_BANK],
+                                  const OriginalValues<int>& original) {
+  int merged[SIZE_OF_MEM_BANK];
+  LocalMemory::CopyRevertingChanges(bank, original, merged);
+  out.WriteIntBank(merged, SIZE_OF_MEM_BANK);
+}
+
+void writeLocalMemory(SaveDataWriter& out, const LocalMemory& local) {
+  writeIntBankRevertingChanges(out, local.intA, local.original_intA);
+  writeIntBankRevertingChanges(out, local.intB, local.original_intB);
+  writeIntBankRevertingChanges(out, local.intC, local.original_intC);
+  writeIntBankRevertingChanges(out, local.intD, local.original_intD);
+  writeIntBankRevertingChanges(out, local.intE, local.original_intE);
+  writeIntBankRevertingChanges(out, local.intF, local.original_intF);
+
+  out.WriteUint32(SIZE_OF_MEM_BANK);
+  for (int i = 0; i < SIZE_OF_MEM_BANK; ++i)
+    out.WriteString(local.original_strS.Original(local.strS, i));
+
+  out.WriteStringTable(local.local_names);
+}
+
+void readLocalMemory(SaveDataReader& in, LocalMemory& local) {
+  in.ReadIntBank(local.intA, SIZE_OF_MEM_BANK);
+  in.ReadIntBank(local.intB, SIZE_OF_MEM_BANK);
+  in.ReadIntBank(local.intC, SIZE_OF_MEM_BANK);
+  in.ReadIntBank(local.intD, SIZE_OF_MEM_BANK);
+  in.ReadIntBank(local.intE, SIZE_OF_MEM_BANK);
+  in.ReadIntBank(local.intF, SIZE_OF_MEM_BANK);
+  in.ReadStringTable(local.strS);
+  in.ReadStringTable(local.local_names);
+}
+
+// A GameSnapshot's object graphs are archived through these stand-ins for
+// RLMachine, System, GraphicsSystem, TextSystem and SoundSystem, which write
+// the same archive as those classes' save() methods from copies of the state
+// they read. Each must keep the class version of the class it stands in for.
+
+struct MachineSnapshot {
+  int line = 0;
+  std::vector<StackFrame> call_stack;
+
+  template <class Archive>
+  void serialize(Archive& ar, unsigned int version) {
+    ar& line& call_stack;
+  }
+};
+
+struct SystemSnapshot {
+  template <class Archive>
+  void serialize(Archive& ar, unsigned int version) {}
+};
+
+struct GraphicsSnapshot {
+  explicit GraphicsSnapshot(int objects_in_layer) : state(objects_in_layer) {}
+
+  GraphicsSystem::SavepointState state;
+
+  template <class Archive>
+  void serialize(Archive& ar, unsigned int version) {
+    ar& state.subtitle& state.default_grp_name& state.default_bgr_name&
+        state.graphics_stack& state.background_objects&
+            state.foreground_objects;
+  }
+};
+
+struct TextSnapshot {
+  int active_window = 0;
+  int cursor_number = 0;
+
+  template <class Archive>
+  void serialize(Archive& ar, unsigned int version) {
+    ar& active_window& cursor_number;
+  }
+};
+
+struct SoundSnapshot {
+  std::string bgm_name;
+  bool bgm_looping = false;
+
+  template <class Archive>
+  void serialize(Archive& ar, unsigned int version) {
+    ar& bgm_name& bgm_looping;
+  }
+};
+
+}  // namespace
+
+BOOST_CLASS_VERSION(GraphicsSnapshot, 1)
+
+namespace Serialization {
+
+struct GameSnapshot {
+  explicit GameSnapshot(int objects_in_layer) : graphics(objects_in_layer) {}
+
+  // The header and local memory, which are cheap enough to write out while
+  // taking the snapshot.
+  std::string payload;
+
+  MachineSnapshot machine;
+  SystemSnapshot system;
+  GraphicsSnapshot graphics;
+  TextSnapshot text;
+  SoundSnapshot sound;
+};
+
+}  // namespace Serialization
+
+namespace {
+
+std::string serializeObjectGraphs(
+    const Serialization::GameSnapshot& snapshot) {
+  std::ostringstream oss;
+  {
+    boost::archive::text_oarchive oa(oss);
+    oa << snapshot.machine << snapshot.system << snapshot.graphics
+       << snapshot.text << snapshot.sound;
+  }
+  return oss.str();
+}
+
+void loadObjectGraphs(const std::string& archive, RLMachine& machine) {
+  std::istringstream iss(archive);
+  boost::archive::text_iarchive ia(iss);
+  ia >> machine >> machine.system() >> machine.system().graphics() >>
+      machine.system().text() >> machine.system().sound();
+}
+
+}  // namespace
+
+namespace Serialization {
+
+void saveGameForSlot(RLMachine& machine, int slot) {
+  queueSaveGame(machine, buildSaveGameFilename(machine, slot));
+}
+
+void queueSaveGame(RLMachine& machine, const fs::path& path) {
+  std::shared_ptr<const GameSnapshot> snapshot = takeGameSnapshot(machine);
+  const GameSnapshot* state = snapshot.get();
+  machine.save_writer().QueueWrite(
+      path, snapshot, [state] { return serializeGameSnapshot(*state); });
+}
+
+void saveGameTo(std::ostream& oss,
+                RLMachine& machine,
+                SaveFormat save_format) {
+  if (save_format == SAVE_FORMAT_BINARY) {
+    writeSnapshotTo(oss, snapshotGame(machine));
+    return;
+  }
+
+  boost::iostreams::filtering_stream<boost::iostreams::output> filtered_output;
+  filtered_output.push(boost::iostreams::zlib_compressor(
+      compressionParamsFor(save_format)));
+  filtered_output.push(oss);
+  serializeGameAsText(filtered_output, machine);
+}
+
+std::shared_ptr<const GameSnapshot> takeGameSnapshot(RLMachine& machine) {
+  System& system = machine.system();
+  GraphicsSystem& graphics = system.graphics();
+  std::shared_ptr<GameSnapshot> snapshot =
+      std::make_shared<GameSnapshot>(graphics.GetObjectLayerSize());
+
+  SaveDataWriter out(snapshot->payload);
+  writeHeader(out, SaveGameHeader(graphics.window_subtitle()));
+  writeLocalMemory(out, machine.memory().local());
+
+  // Long operations aren't saved, and the copies mustn't keep them alive.
+  snapshot->machine.line = machine.line_number();
+  snapshot->machine.call_stack = machine.savepoint_call_stack();
+  for (StackFrame& frame : snapshot->machine.call_stack)
+    frame.long_op.reset();
+
+  // Save games replay the graphics stack on load, so the DCs aren't needed.
+  graphics.CopySavepointStateTo(snapshot->graphics.state, false);
+
+  snapshot->text.active_window = system.text().savepoint_active_window();
+  snapshot->text.cursor_number = system.text().savepoint_cursor_number();
+
+  // Like SoundSystem::save(), this is the music playing now.
+  SoundSystem& sound = system.sound();
+  if (sound.BgmStatus() == 1) {
+    snapshot->sound.bgm_name = sound.GetBgmName();
+    snapshot->sound.bgm_looping = sound.BgmLooping();
+  }
+
+  return snapshot;
+}
+
+std::string serializeGameSnapshot(const GameSnapshot& snapshot) {
+  std::string payload = snapshot.payload;
+  SaveDataWriter out(payload);
+  out.WriteString(serializeObjectGraphs(snapshot));
+  return payload;
+}
+
+std::string snapshotGame(RLMachine& machine) {
+  return serializeGameSnapshot(*takeGameSnapshot(machine));
 }
 
 fs::path buildSaveGameFilename(RLMachine& machine, int slot) {
@@ -133,65 +480,79 @@ fs::path buildSaveGameFilename(RLMachine& machine, int slot) {
 }
 
 SaveGameHeader loadHeaderForSlot(RLMachine& machine, int slot) {
+  machine.WaitForPendingSaves();
   fs::path path = buildSaveGameFilename(machine, slot);
-  fs::ifstream file(path, std::ios::binary);
-  checkInFileOpened(file, path);
+  MappedFileStream file;
+  checkInFileOpened(openMappedFile(path, file), path);
 
   return loadHeaderFrom(file);
 }
 
 SaveGameHeader loadHeaderFrom(std::istream& iss) {
+  SaveFormat save_format = readSaveFormat(iss);
+
   boost::iostreams::filtering_stream<boost::iostreams::input> filtered_input;
   filtered_input.push(boost::iostreams::zlib_decompressor());
   filtered_input.push(iss);
 
+  // Only load the header
+  if (save_format == SAVE_FORMAT_BINARY) {
+    SaveDataReader in(filtered_input);
+    return readHeader(in);
+  }
+
   int version;
   SaveGameHeader header;
-
-  // Only load the header
   boost::archive::text_iarchive ia(filtered_input);
   ia >> version >> header;
-
   return header;
 }
 
 void loadLocalMemoryForSlot(RLMachine& machine, int slot, Memory& memory) {
+  machine.WaitForPendingSaves();
   fs::path path = buildSaveGameFilename(machine, slot);
-  fs::ifstream file(path, std::ios::binary);
-  checkInFileOpened(file, path);
+  MappedFileStream file;
+  checkInFileOpened(openMappedFile(path, file), path);
 
   loadLocalMemoryFrom(file, memory);
 }
 
 void loadLocalMemoryFrom(std::istream& iss, Memory& memory) {
+  SaveFormat save_format = readSaveFormat(iss);
+
   boost::iostreams::filtering_stream<boost::iostreams::input> filtered_input;
   filtered_input.push(boost::iostreams::zlib_decompressor());
   filtered_input.push(iss);
 
-  int version;
-  SaveGameHeader header;
-
-  // Only load the header
-  boost::archive::text_iarchive ia(filtered_input);
-  ia >> version >> header >> memory.local();
+  // Only load the header and local memory
+  if (save_format == SAVE_FORMAT_BINARY) {
+    SaveDataReader in(filtered_input);
+    readHeader(in);
+    readLocalMemory(in, memory.local());
+  } else {
+    int version;
+    SaveGameHeader header;
+    boost::archive::text_iarchive ia(filtered_input);
+    ia >> version >> header >> memory.local();
+  }
 }
 
 void loadGameForSlot(RLMachine& machine, int slot) {
+  machine.WaitForPendingSaves();
   fs::path path = buildSaveGameFilename(machine, slot);
-  fs::ifstream file(path, std::ios::binary);
-  checkInFileOpened(file, path);
+  MappedFileStream file;
+  checkInFileOpened(openMappedFile(path, file), path);
 
   loadGameFrom(file, machine);
 }
 
 void loadGameFrom(std::istream& iss, RLMachine& machine) {
+  SaveFormat save_format = readSaveFormat(iss);
+
   boost::iostreams::filtering_stream<boost::iostreams::input> filtered_input;
   filtered_input.push(boost::iostreams::zlib_decompressor());
   filtered_input.push(iss);
 
-  int version;
-  SaveGameHeader header;
-
   g_current_machine = &machine;
 
   try {
@@ -199,10 +560,15 @@ void loadGameFrom(std::istream& iss, RLMachine& machine) {
     // often hold references to objects in the System heiarchy.
     machine.Reset();
 
-    boost::archive::text_iarchive ia(filtered_input);
-    ia >> version >> header >> machine.memory().local() >> machine >>
-        machine.system() >> machine.system().graphics() >>
-        machine.system().text() >> machine.system().sound();
+    if (save_format == SAVE_FORMAT_BINARY) {
+      SaveDataReader in(filtered_input);
+      readHeader(in);
+      readLocalMemory(in, machine.memory().local());
+      loadObjectGraphs(in.ReadString(), machine);
+    } else {
+      boost::archive::text_iarchive ia(filtered_input);
+      loadGameFromArchive(ia, machine);
+    }
 
     machine.system().graphics().ReplayGraphicsStack(machine);
 
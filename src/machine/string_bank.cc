@@ -0,0 +1,198 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+
+#include "machine/string_bank.h"
+
+#include <algorithm>
+#include <mutex>
+#include <ostream>
+#include <unordered_set>
+
+namespace {
+
+// Returns the smallest size class whose blocks hold |bytes|.
+int SizeClassFor(size_t bytes, size_t min_block_size) {
+  int size_class = 0;
+  while ((min_block_size << size_class) < bytes)
+    ++size_class;
+  return size_class;
+}
+
+}  // namespace
+
+// -----------------------------------------------------------------------
+// StringPiece
+// -----------------------------------------------------------------------
+
+bool operator==(StringPiece lhs, StringPiece rhs) {
+  return lhs.size() == rhs.size() &&
+         (lhs.data() == rhs.data() ||
+          memcmp(lhs.data(), rhs.data(), lhs.size()) == 0);
+}
+
+std::ostream& operator<<(std::ostream& os, StringPiece piece) {
+  return os.write(piece.data(), piece.size());
+}
+
+StringPiece InternString(const std::string& value) {
+  static std::mutex mutex;
+  static std::unordered_set<std::string>* table =
+      new std::unordered_set<std::string>;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  // Elements of an unordered_set don't move when it rehashes.
+  const std::string& interned = *table->insert(value).first;
+  return StringPiece(interned.c_str(), interned.size(), true);
+}
+
+// -----------------------------------------------------------------------
+// StringBank
+// -----------------------------------------------------------------------
+
+StringBank::StringBank(int size) : slots_(new Slot[size]), size_(size) {
+  std::fill(free_blocks_, free_blocks_ + kArenaSizeClasses, nullptr);
+  for (int i = 0; i < size_; ++i) {
+    slots_[i].inline_data[0] = '\0';
+    slots_[i].size = 0;
+    slots_[i].kind = SLOT_INLINE;
+  }
+}
+
+StringBank::StringBank(const StringBank& rhs) : StringBank(rhs.size_) {
+  for (int i = 0; i < size_; ++i)
+    Set(i, rhs.Get(i));
+}
+
+StringBank& StringBank::operator=(const StringBank& rhs) {
+  if (this != &rhs) {
+    for (int i = 0; i < size_; ++i)
+      Set(i, rhs.Get(i));
+  }
+  return *this;
+}
+
+StringBank::~StringBank() {
+  // Arena blocks go with |arena_|; only heap blocks need freeing.
+  for (int i = 0; i < size_; ++i)
+    Release(slots_[i]);
+}
+
+StringPiece StringBank::Get(int index) const {
+  const Slot& slot = slots_[index];
+  switch (slot.kind) {
+    case SLOT_BLOCK:
+      return StringPiece(slot.block, slot.size, false);
+    case SLOT_INTERNED:
+      return StringPiece(slot.interned, slot.size, true);
+    case SLOT_INLINE:
+    default:
+      return StringPiece(slot.inline_data, slot.size, false);
+  }
+}
+
+void StringBank::Set(int index, StringPiece value) {
+  Slot& slot = slots_[index];
+  size_t size = value.size();
+
+  if (value.interned()) {
+    Release(slot);
+    slot.interned = value.data();
+    slot.size = size;
+    slot.kind = SLOT_INTERNED;
+    return;
+  }
+
+  // |value| may point into this slot's inline data or block, so the old
+  // block is only freed after the copy, and copies use memmove.
+  if (slot.kind == SLOT_BLOCK &&
+      size < (kMinBlockSize << slot.size_class) &&
+      size > kInlineCapacity) {
+    memmove(slot.block, value.data(), size);
+    slot.block[size] = '\0';
+    slot.size = size;
+    return;
+  }
+
+  char* old_block = slot.kind == SLOT_BLOCK ? slot.block : nullptr;
+  int old_size_class = slot.size_class;
+
+  if (size <= kInlineCapacity) {
+    memmove(slot.inline_data, value.data(), size);
+    slot.inline_data[size] = '\0';
+    slot.kind = SLOT_INLINE;
+  } else {
+    int size_class = SizeClassFor(size + 1, kMinBlockSize);
+    char* block = AllocateBlock(size_class);
+    memcpy(block, value.data(), size);
+    block[size] = '\0';
+    slot.block = block;
+    slot.size_class = size_class;
+    slot.kind = SLOT_BLOCK;
+  }
+  slot.size = size;
+
+  if (old_block)
+    FreeBlock(old_block, old_size_class);
+}
+
+void StringBank::Clear() {
+  for (int i = 0; i < size_; ++i)
+    Release(slots_[i]);
+}
+
+char* StringBank::AllocateBlock(int size_class) {
+  size_t bytes = kMinBlockSize << size_class;
+  if (size_class >= kArenaSizeClasses)
+    return new char[bytes];
+
+  char*& free_list = free_blocks_[size_class];
+  if (free_list) {
+    char* block = free_list;
+    memcpy(&free_list, block, sizeof(char*));
+    return block;
+  }
+  return static_cast<char*>(arena_.Allocate(bytes, alignof(char*)));
+}
+
+void StringBank::FreeBlock(char* block, int size_class) {
+  if (size_class >= kArenaSizeClasses) {
+    delete[] block;
+    return;
+  }
+
+  // Free blocks are linked through their first bytes.
+  memcpy(block, &free_blocks_[size_class], sizeof(char*));
+  free_blocks_[size_class] = block;
+}
+
+void StringBank::Release(Slot& slot) {
+  if (slot.kind == SLOT_BLOCK)
+    FreeBlock(slot.block, slot.size_class);
+  slot.inline_data[0] = '\0';
+  slot.size = 0;
+  slot.kind = SLOT_INLINE;
+}
@@ -0,0 +1,151 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+
+#ifndef SRC_MACHINE_STRING_BANK_H_
+#define SRC_MACHINE_STRING_BANK_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iosfwd>
+#include <memory>
+#include <string>
+
+#include "libreallive/arena.h"
+
+// A read-only view of a string in string memory, a bytecode constant or a
+// std::string. The bytes are always followed by a NUL, so c_str() is safe. A
+// view into string memory is valid until that location is next written; views
+// of interned constants are valid for the life of the process.
+class StringPiece {
+ public:
+  StringPiece() : data_(""), size_(0), interned_(false) {}
+  StringPiece(const std::string& str)  // NOLINT: implicit on purpose
+      : data_(str.c_str()), size_(str.size()), interned_(false) {}
+  StringPiece(const char* str)  // NOLINT: implicit on purpose
+      : data_(str), size_(strlen(str)), interned_(false) {}
+
+  // |data| must have a NUL at |data[size]|.
+  StringPiece(const char* data, size_t size, bool interned)
+      : data_(data), size_(size), interned_(interned) {}
+
+  const char* data() const { return data_; }
+  const char* c_str() const { return data_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  const char* begin() const { return data_; }
+  const char* end() const { return data_ + size_; }
+  char operator[](size_t i) const { return data_[i]; }
+
+  // Whether this views a string from InternString(), which string memory can
+  // point at instead of copying.
+  bool interned() const { return interned_; }
+
+  std::string as_string() const { return std::string(data_, size_); }
+  void AppendToString(std::string* out) const { out->append(data_, size_); }
+
+ private:
+  const char* data_;
+  size_t size_;
+  bool interned_;
+};
+
+bool operator==(StringPiece lhs, StringPiece rhs);
+inline bool operator!=(StringPiece lhs, StringPiece rhs) {
+  return !(lhs == rhs);
+}
+std::ostream& operator<<(std::ostream& os, StringPiece piece);
+
+// Returns the process wide copy of |value|. Bytecode string constants are
+// interned when they're parsed, so that assigning one to string memory
+// stores a pointer instead of copying. Interned strings are never freed; there
+// are only as many as there are distinct constants in the scenarios. Safe to
+// call from the parameter preparser's threads.
+StringPiece InternString(const std::string& value);
+
+// A fixed size bank of string memory, such as strS[], strM[] or the \#NAME
+// tables. Values up to kInlineCapacity bytes live in the slot itself. Longer
+// values live in blocks carved out of an Arena, which go on a free list for
+// their size class when the slot is overwritten, so a bank stops touching the
+// heap once it has grown to its working size. A slot assigned an interned
+// constant just points at it.
+class StringBank {
+ public:
+  static const size_t kInlineCapacity = 23;
+
+  explicit StringBank(int size);
+  StringBank(const StringBank& rhs);
+  StringBank& operator=(const StringBank& rhs);
+  ~StringBank();
+
+  int size() const { return size_; }
+
+  // Returns the value at |index|, valid until |index| is next written.
+  StringPiece Get(int index) const;
+
+  // Sets the value at |index|. |value| may point into this bank, including
+  // into the slot being written.
+  void Set(int index, StringPiece value);
+
+  // Empties every slot.
+  void Clear();
+
+ private:
+  enum SlotKind : uint8_t { SLOT_INLINE, SLOT_BLOCK, SLOT_INTERNED };
+
+  struct Slot {
+    union {
+      char inline_data[kInlineCapacity + 1];
+      char* block;
+      const char* interned;
+    };
+    uint32_t size;
+    SlotKind kind;
+    // The block's capacity is kMinBlockSize << size_class.
+    uint8_t size_class;
+  };
+
+  static const size_t kMinBlockSize = 32;
+  // Blocks of these size classes come from |arena_| and are recycled; larger
+  // ones come from the heap and are freed when their slot is overwritten.
+  static const int kArenaSizeClasses = 12;
+
+  char* AllocateBlock(int size_class);
+  void FreeBlock(char* block, int size_class);
+
+  // Frees the slot's block, if it has one, and makes it an empty inline slot.
+  void Release(Slot& slot);
+
+  std::unique_ptr<Slot[]> slots_;
+  int size_;
+
+  libreallive::Arena arena_;
+  char* free_blocks_[kArenaSizeClasses];
+};
+
+#endif  // SRC_MACHINE_STRING_BANK_H_
@@ -1445,7 +1445,7 @@ void ReplayGraphicsStackCommand(RLMachine& machine,
     for (auto const& command : stack) {
       if (command != "") {
         // Parse the string as a chunk of Reallive bytecode.
-        libreallive::ConstructionData cdata(0, libreallive::pointer_t());
+        libreallive::ConstructionData cdata(0);
         libreallive::BytecodeElement* element =
             libreallive::BytecodeElement::Read(
                 command.c_str(), command.c_str() + command.size(), cdata);
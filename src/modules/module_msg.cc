@@ -93,9 +93,10 @@ struct SetFontColour : public RLOpcode<DefaultIntValue_T<0>> {
   }
 };
 
-struct doruby_display : public RLOpcode<StrConstant_T> {
-  void operator()(RLMachine& machine, std::string cpStr) {
-    std::string utf8str = cp932toUTF8(cpStr, machine.GetTextEncoding());
+struct doruby_display : public RLOpcode<StrConstantView_T> {
+  void operator()(RLMachine& machine, StringPiece cpStr) {
+    std::string utf8str =
+        cp932toUTF8(cpStr.as_string(), machine.GetTextEncoding());
     machine.system().text().GetCurrentPage().DisplayRubyText(utf8str);
   }
 };
@@ -189,10 +190,10 @@ struct TextOffset : public RLOpcode<IntConstant_T, IntConstant_T> {
   }
 };
 
-struct FaceOpen : public RLOpcode<StrConstant_T, DefaultIntValue_T<0>> {
-  void operator()(RLMachine& machine, std::string file, int index) {
+struct FaceOpen : public RLOpcode<StrConstantView_T, DefaultIntValue_T<0>> {
+  void operator()(RLMachine& machine, StringPiece file, int index) {
     TextPage& page = machine.system().text().GetCurrentPage();
-    page.FaceOpen(file, index);
+    page.FaceOpen(file.as_string(), index);
   }
 };
 
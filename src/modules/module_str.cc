@@ -82,10 +82,10 @@ std::string rl_itoa_implementation(int number, int length, char fill) {
 // Implement op<1:Str:00000, 0>, fun strcpy(str, strC).
 //
 // Assigns the string value val to the string variable dest.
-struct strcpy_0 : public RLOpcode<StrReference_T, StrConstant_T> {
+struct strcpy_0 : public RLOpcode<StrReference_T, StrConstantView_T> {
   void operator()(RLMachine& machine,
                   StringReferenceIterator dest,
-                  std::string val) {
+                  StringPiece val) {
     *dest = val;
   }
 };
@@ -94,12 +94,13 @@ struct strcpy_0 : public RLOpcode<StrReference_T, StrConstant_T> {
 //
 // Assigns the first count characters of val to the string variable dest.
 struct strcpy_1
-    : public RLOpcode<StrReference_T, StrConstant_T, IntConstant_T> {
+    : public RLOpcode<StrReference_T, StrConstantView_T, IntConstant_T> {
   void operator()(RLMachine& machine,
                   StringReferenceIterator dest,
-                  std::string val,
+                  StringPiece val,
                   int count) {
-    *dest = val.substr(0, count);
+    *dest = std::string(val.data(),
+                        std::min(val.size(), static_cast<size_t>(count)));
   }
 };
 
@@ -126,20 +127,20 @@ struct strclear_1 : public RLOpcode<StrReference_T, StrReference_T> {
 
 // Implement op<1:Str:00002, 0>, fun strcat(str, strC). Concatenates
 // the string into the memory location of the first.
-struct Str_strcat : public RLOpcode<StrReference_T, StrConstant_T> {
+struct Str_strcat : public RLOpcode<StrReference_T, StrConstantView_T> {
   void operator()(RLMachine& machine,
                   StringReferenceIterator it,
-                  std::string append) {
+                  StringPiece append) {
     std::string s = *it;
-    s += append;
+    append.AppendToString(&s);
     *it = s;
   }
 };
 
 // Implement op<1:Str:00003, 0>, fun strlen(strC). Returns the length
 // of value; Double-byte characters are counted as two bytes.
-struct Str_strlen : public RLStoreOpcode<StrConstant_T> {
-  int operator()(RLMachine& machine, std::string value) {
+struct Str_strlen : public RLStoreOpcode<StrConstantView_T> {
+  int operator()(RLMachine& machine, StringPiece value) {
     return value.size();
   }
 };
@@ -150,8 +151,9 @@ struct Str_strlen : public RLStoreOpcode<StrConstant_T> {
 // strings in JIS X 0208.
 //
 // TODO(erg): THIS NEEDS TO HANDLE JSX ORDERING, NOT JUST ASCII!
-struct Str_strcmp : public RLStoreOpcode<StrConstant_T, StrConstant_T> {
-  int operator()(RLMachine& machine, std::string lhs, std::string rhs) {
+struct Str_strcmp
+    : public RLStoreOpcode<StrConstantView_T, StrConstantView_T> {
+  int operator()(RLMachine& machine, StringPiece lhs, StringPiece rhs) {
     return strcmp(lhs.c_str(), rhs.c_str());
   }
 };
@@ -160,10 +162,10 @@ struct Str_strcmp : public RLStoreOpcode<StrConstant_T, StrConstant_T> {
 //
 // Returns the substring, starting at offset.
 struct strsub_0
-    : public RLOpcode<StrReference_T, StrConstant_T, IntConstant_T> {
+    : public RLOpcode<StrReference_T, StrConstantView_T, IntConstant_T> {
   void operator()(RLMachine& machine,
                   StringReferenceIterator dest,
-                  std::string source,
+                  StringPiece source,
                   int offset) {
     const char* str = source.c_str();
     std::string output;
@@ -195,12 +197,12 @@ struct strsub_0
 //
 // Returns the substring of length length, starting at offset.
 struct strsub_1 : public RLOpcode<StrReference_T,
-                                     StrConstant_T,
+                                     StrConstantView_T,
                                      IntConstant_T,
                                      IntConstant_T> {
   void operator()(RLMachine& machine,
                   StringReferenceIterator dest,
-                  std::string source,
+                  StringPiece source,
                   int offset,
                   int length) {
     const char* str = source.c_str();
@@ -230,7 +232,7 @@ struct strsub_1 : public RLOpcode<StrReference_T,
 struct strrsub_0 : public strsub_0 {
   void operator()(RLMachine& machine,
                   StringReferenceIterator dest,
-                  std::string source,
+                  StringPiece source,
                   int offsetFromBack) {
     int offset = strcharlen(source.c_str()) - offsetFromBack;
     return strsub_0::operator()(machine, dest, source, offset);
@@ -241,7 +243,7 @@ struct strrsub_0 : public strsub_0 {
 struct strrsub_1 : public strsub_1 {
   void operator()(RLMachine& machine,
                   StringReferenceIterator dest,
-                  std::string source,
+                  StringPiece source,
                   int offsetFromBack,
                   int length) {
     if (length > offsetFromBack) {
@@ -257,8 +259,8 @@ struct strrsub_1 : public strsub_1 {
 // Implements op<1:Str:00007, 0>, fun strcharlen(strC). Returns the
 // number of characters (as opposed to bytes) in a string. This
 // function deals with Shift_JIS characters properly.
-struct Str_strcharlen : public RLStoreOpcode<StrConstant_T> {
-  int operator()(RLMachine& machine, std::string val) {
+struct Str_strcharlen : public RLStoreOpcode<StrConstantView_T> {
+  int operator()(RLMachine& machine, StringPiece val) {
     return strcharlen(val.c_str());
   }
 };
@@ -293,11 +295,11 @@ struct hantozen_0 : public RLOpcode<StrReference_T> {
 // Implements op<1:Str:00010, 1>, fun hantozen(strC, >str).
 //
 // Changes half width characters to their full width equivalents.
-struct hantozen_1 : public RLOpcode<StrConstant_T, StrReference_T> {
+struct hantozen_1 : public RLOpcode<StrConstantView_T, StrReference_T> {
   void operator()(RLMachine& machine,
-                  std::string input,
+                  StringPiece input,
                   StringReferenceIterator dest) {
-    *dest = hantozen_cp932(input, machine.GetTextEncoding());
+    *dest = hantozen_cp932(input.as_string(), machine.GetTextEncoding());
   }
 };
 
@@ -313,11 +315,11 @@ struct zentohan_0 : public RLOpcode<StrReference_T> {
 // Implements op<1:Str:00011, 1>, fun zentohan(strC, >str).
 //
 // Changes full width characters to their half width equivalents.
-struct zentohan_1 : public RLOpcode<StrConstant_T, StrReference_T> {
+struct zentohan_1 : public RLOpcode<StrConstantView_T, StrReference_T> {
   void operator()(RLMachine& machine,
-                  std::string input,
+                  StringPiece input,
                   StringReferenceIterator dest) {
-    *dest = zentohan_cp932(input, machine.GetTextEncoding());
+    *dest = zentohan_cp932(input.as_string(), machine.GetTextEncoding());
   }
 };
 
@@ -480,9 +482,9 @@ struct itoa_1
 // Returns the value of the integer represented by string, or 0 if string does
 // not represent an integer. Leading whitespace is ignored, as is anything
 // following the last decimal digit.
-struct Str_atoi : public RLStoreOpcode<StrConstant_T> {
-  int operator()(RLMachine& machine, std::string word) {
-    std::stringstream ss(word);
+struct Str_atoi : public RLStoreOpcode<StrConstantView_T> {
+  int operator()(RLMachine& machine, StringPiece word) {
+    std::stringstream ss(word.as_string());
     int out;
     ss >> out;
     if (ss)
@@ -532,13 +534,15 @@ struct Str_digit
 //
 // Returns the offset of the first instance of substring in str, or -1 if
 // substring is not found.
-struct Str_strpos : public RLStoreOpcode<StrConstant_T, StrConstant_T> {
-  int operator()(RLMachine& machine, std::string str, std::string substring) {
-    size_t pos = str.find(substring);
-    if (pos == std::string::npos)
+struct Str_strpos
+    : public RLStoreOpcode<StrConstantView_T, StrConstantView_T> {
+  int operator()(RLMachine& machine, StringPiece str, StringPiece substring) {
+    const char* pos =
+        std::search(str.begin(), str.end(), substring.begin(), substring.end());
+    if (pos == str.end() && !substring.empty())
       return -1;
     else
-      return pos;
+      return pos - str.begin();
   }
 };
 
@@ -547,13 +551,16 @@ struct Str_strpos : public RLStoreOpcode<StrConstant_T, StrConstant_T> {
 // As strpos, but returns the offset of the last instance of substring. If
 // substring appears only once, or not at all, in string, the behaviour is
 // identical with that of strpos.
-struct Str_strlpos : public RLStoreOpcode<StrConstant_T, StrConstant_T> {
-  int operator()(RLMachine& machine, std::string str, std::string substring) {
-    size_t pos = str.rfind(substring);
-    if (pos == std::string::npos)
+struct Str_strlpos
+    : public RLStoreOpcode<StrConstantView_T, StrConstantView_T> {
+  int operator()(RLMachine& machine, StringPiece str, StringPiece substring) {
+    // An empty |substring| matches at the end, as with std::string::rfind().
+    const char* pos = std::find_end(
+        str.begin(), str.end(), substring.begin(), substring.end());
+    if (pos == str.end() && !substring.empty())
       return -1;
     else
-      return pos;
+      return pos - str.begin();
   }
 };
 
@@ -608,7 +615,7 @@ struct Str_intout : public RLOpcode<IntConstant_T> {
 // Returns 0 if the string variable var is empty, otherwise 1.
 struct Str_strused : public RLStoreOpcode<StrReference_T> {
   int operator()(RLMachine& machine, StringReferenceIterator it) {
-    return std::string(*it) != "";
+    return !(*it).value().empty();
   }
 };
 
@@ -67,6 +67,7 @@ namespace {
 
 struct SaveExists : public RLStoreOpcode<IntConstant_T> {
   int operator()(RLMachine& machine, int slot) {
+    machine.WaitForPendingSaves();
     fs::path saveFile = Serialization::buildSaveGameFilename(machine, slot);
     return fs::exists(saveFile) ? 1 : 0;
   }
@@ -267,6 +268,7 @@ struct GetSaveFlag : public RLStoreOpcode<IntConstant_T, GetSaveFlagList> {
 // been saved.
 struct LatestSave : public RLStoreOpcode<> {
   int operator()(RLMachine& machine) {
+    machine.WaitForPendingSaves();
     fs::path saveDir = machine.system().GameSaveDirectory();
     int latestSlot = -1;
     time_t latestTime = std::numeric_limits<time_t>::min();
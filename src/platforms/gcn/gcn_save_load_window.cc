@@ -77,6 +77,8 @@ class SaveGameListModel : public gcn::ListModel {
 
 SaveGameListModel::SaveGameListModel(const std::string& no_data,
                                      RLMachine& machine) {
+  machine.WaitForPendingSaves();
+
   int latestSlot = -1;
   time_t latestTime = std::numeric_limits<time_t>::min();
 
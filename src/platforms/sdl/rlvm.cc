@@ -87,7 +87,23 @@ int main(int argc, char* argv[]) {
   opts.add_options()("help", "Produce help message")(
       "help-debug", "Print help message for people working on rlvm")(
       "version", "Display version and license information")(
-      "font", po::value<string>(), "Specifies TrueType font to use.");
+      "font", po::value<string>(), "Specifies TrueType font to use.")(
+      "preload-scenarios",
+      "Decode all scenarios on background threads at startup")(
+      "prefetch-scenarios",
+      "Decode the scenarios the current one can jump to in the background")(
+      "scenario-cache-mb", po::value<int>(),
+      "Limit the memory used by parsed scenarios to roughly this many MB")(
+      "preparse-parameters",
+      "Parse and type check command parameters in the background when each "
+      "scenario is loaded")(
+      "decode-images",
+      "Decode images on background threads, waiting only when they're drawn")(
+      "prefetch-images",
+      "Start decoding images named a few lines ahead of the current one "
+      "(implies --decode-images)")(
+      "image-cache-mb", po::value<int>(),
+      "Keep up to this many MB of recently used images (default 64)");
 
   po::options_description debugOpts("Debugging Options");
   debugOpts.add_options()(
@@ -98,7 +114,13 @@ int main(int argc, char* argv[]) {
       "undefined-opcodes", "Display a message on undefined opcodes")(
       "count-undefined",
       "On exit, present a summary table about how many times each undefined "
-      "opcode was called")("trace", "Prints opcodes as they are run)");
+      "opcode was called")("trace", "Prints opcodes as they are run)")(
+      "turbo", "Skip through text and waits as fast as possible")(
+      "headless",
+      "Run without a window or sound on a virtual clock, as fast as "
+      "possible, and report the time taken on exit (implies --turbo)")(
+      "decisions", po::value<string>(),
+      "With --headless, a file of selections to make, one per line");
 
   // Declare the final option to be game-root
   po::options_description hidden("Hidden");
@@ -216,6 +238,36 @@ int main(int argc, char* argv[]) {
   if (vm.count("font"))
     instance.set_custom_font(vm["font"].as<string>());
 
+  if (vm.count("preload-scenarios"))
+    instance.set_preload_scenarios();
+
+  if (vm.count("prefetch-scenarios"))
+    instance.set_prefetch_scenarios();
+
+  if (vm.count("scenario-cache-mb"))
+    instance.set_scenario_cache_mb(vm["scenario-cache-mb"].as<int>());
+
+  if (vm.count("preparse-parameters"))
+    instance.set_preparse_parameters();
+
+  if (vm.count("decode-images"))
+    instance.set_decode_images();
+
+  if (vm.count("prefetch-images"))
+    instance.set_prefetch_images();
+
+  if (vm.count("image-cache-mb"))
+    instance.set_image_cache_mb(vm["image-cache-mb"].as<int>());
+
+  if (vm.count("turbo"))
+    instance.set_turbo();
+
+  if (vm.count("headless"))
+    instance.set_headless();
+
+  if (vm.count("decisions"))
+    instance.set_decision_file(vm["decisions"].as<string>());
+
   instance.Run(gamerootPath);
 
   return 0;
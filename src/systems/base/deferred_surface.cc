@@ -0,0 +1,151 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+#include "systems/base/deferred_surface.h"
+
+#include <chrono>
+#include <future>
+#include <utility>
+
+#include "systems/base/graphics_system.h"
+
+DeferredSurface::DeferredSurface(GraphicsSystem& graphics,
+                                 ImageDecoder& decoder,
+                                 std::shared_ptr<const DecodedImage> header,
+                                 ImageDecoder::Pixels pixels)
+    : graphics_(graphics),
+      decoder_(decoder),
+      header_(std::move(header)),
+      pixels_(std::move(pixels)) {}
+
+DeferredSurface::~DeferredSurface() {}
+
+Surface& DeferredSurface::Resolve() const {
+  if (!surface_) {
+    surface_ = graphics_.BuildSurfaceFromImage(*decoder_.Wait(pixels_));
+    pixels_ = ImageDecoder::Pixels();
+  }
+
+  return *surface_;
+}
+
+void DeferredSurface::EnsureUploaded() const {
+  if (!surface_ && pixels_.wait_for(std::chrono::seconds(0)) !=
+                       std::future_status::ready) {
+    return;
+  }
+
+  Resolve().EnsureUploaded();
+}
+
+void DeferredSurface::Fill(const RGBAColour& colour) {
+  Resolve().Fill(colour);
+}
+
+void DeferredSurface::Fill(const RGBAColour& colour, const Rect& area) {
+  Resolve().Fill(colour, area);
+}
+
+void DeferredSurface::ToneCurve(const ToneCurveRGBMap effect,
+                                const Rect& area) {
+  Resolve().ToneCurve(effect, area);
+}
+
+void DeferredSurface::Invert(const Rect& area) { Resolve().Invert(area); }
+
+void DeferredSurface::Mono(const Rect& area) { Resolve().Mono(area); }
+
+void DeferredSurface::ApplyColour(const RGBColour& colour, const Rect& area) {
+  Resolve().ApplyColour(colour, area);
+}
+
+void DeferredSurface::SetIsMask(const bool is) { Resolve().SetIsMask(is); }
+
+Size DeferredSurface::GetSize() const { return header_->size; }
+
+void DeferredSurface::Dump() { Resolve().Dump(); }
+
+void DeferredSurface::BlitToSurface(Surface& dest_surface,
+                                    const Rect& src,
+                                    const Rect& dst,
+                                    int alpha,
+                                    bool use_src_alpha) const {
+  Resolve().BlitToSurface(dest_surface, src, dst, alpha, use_src_alpha);
+}
+
+void DeferredSurface::RenderToScreen(const Rect& src,
+                                     const Rect& dst,
+                                     int alpha) const {
+  Resolve().RenderToScreen(src, dst, alpha);
+}
+
+void DeferredSurface::RenderToScreenAsColorMask(const Rect& src,
+                                                const Rect& dst,
+                                                const RGBAColour& colour,
+                                                int filter) const {
+  Resolve().RenderToScreenAsColorMask(src, dst, colour, filter);
+}
+
+void DeferredSurface::RenderToScreen(const Rect& src,
+                                     const Rect& dst,
+                                     const int opacity[4]) const {
+  Resolve().RenderToScreen(src, dst, opacity);
+}
+
+void DeferredSurface::RenderToScreenAsObject(const GraphicsObject& rp,
+                                             const Rect& src,
+                                             const Rect& dst,
+                                             int alpha) const {
+  Resolve().RenderToScreenAsObject(rp, src, dst, alpha);
+}
+
+int DeferredSurface::GetNumPatterns() const {
+  return header_->region_table.size();
+}
+
+const Surface::GrpRect& DeferredSurface::GetPattern(int patt_no) const {
+  if (patt_no >= 0 && patt_no < header_->region_table.size())
+    return header_->region_table[patt_no];
+  else
+    return header_->region_table[0];
+}
+
+void DeferredSurface::GetDCPixel(const Point& pos,
+                                 int& r,
+                                 int& g,
+                                 int& b) const {
+  Resolve().GetDCPixel(pos, r, g, b);
+}
+
+std::shared_ptr<Surface> DeferredSurface::ClipAsColorMask(
+    const Rect& clip_rect,
+    int r,
+    int g,
+    int b) const {
+  return Resolve().ClipAsColorMask(clip_rect, r, g, b);
+}
+
+Surface* DeferredSurface::Clone() const { return Resolve().Clone(); }
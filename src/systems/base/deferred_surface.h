@@ -0,0 +1,118 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+#ifndef SRC_SYSTEMS_BASE_DEFERRED_SURFACE_H_
+#define SRC_SYSTEMS_BASE_DEFERRED_SURFACE_H_
+
+#include <memory>
+
+#include "systems/base/image_decoder.h"
+#include "systems/base/surface.h"
+
+class GraphicsSystem;
+
+// A Surface for an image file whose pixels an ImageDecoder may still be
+// decoding.
+//
+// The size and region table come from the image header, so graphics objects
+// can be created and positioned right away. Anything that touches the pixels
+// first waits for the decoder and has the GraphicsSystem build a real surface,
+// which every later call is forwarded to. Building happens on the calling
+// thread, since the platform surfaces and textures belong to it.
+class DeferredSurface : public Surface {
+ public:
+  DeferredSurface(GraphicsSystem& graphics,
+                  ImageDecoder& decoder,
+                  std::shared_ptr<const DecodedImage> header,
+                  ImageDecoder::Pixels pixels);
+  virtual ~DeferredSurface();
+
+  // Whether the real surface has been built yet.
+  bool is_resolved() const { return surface_ != nullptr; }
+
+  // Returns the real surface, waiting on the decoder if it isn't done.
+  Surface& Resolve() const;
+
+  // Uploads only if the decoder has already finished; otherwise that is left
+  // to the first draw so that loading an image never blocks.
+  virtual void EnsureUploaded() const override;
+
+  virtual void Fill(const RGBAColour& colour) override;
+  virtual void Fill(const RGBAColour& colour, const Rect& area) override;
+  virtual void ToneCurve(const ToneCurveRGBMap effect,
+                         const Rect& area) override;
+  virtual void Invert(const Rect& area) override;
+  virtual void Mono(const Rect& area) override;
+  virtual void ApplyColour(const RGBColour& colour, const Rect& area) override;
+  virtual void SetIsMask(const bool is) override;
+  virtual Size GetSize() const override;
+  virtual void Dump() override;
+  virtual void BlitToSurface(Surface& dest_surface,
+                             const Rect& src,
+                             const Rect& dst,
+                             int alpha = 255,
+                             bool use_src_alpha = true) const override;
+  virtual void RenderToScreen(const Rect& src,
+                              const Rect& dst,
+                              int alpha = 255) const override;
+  virtual void RenderToScreenAsColorMask(const Rect& src,
+                                         const Rect& dst,
+                                         const RGBAColour& colour,
+                                         int filter) const override;
+  virtual void RenderToScreen(const Rect& src,
+                              const Rect& dst,
+                              const int opacity[4]) const override;
+  virtual void RenderToScreenAsObject(const GraphicsObject& rp,
+                                      const Rect& src,
+                                      const Rect& dst,
+                                      int alpha) const override;
+  virtual int GetNumPatterns() const override;
+  virtual const GrpRect& GetPattern(int patt_no) const override;
+  virtual void GetDCPixel(const Point& pos,
+                          int& r,
+                          int& g,
+                          int& b) const override;
+  virtual std::shared_ptr<Surface> ClipAsColorMask(const Rect& clip_rect,
+                                                   int r,
+                                                   int g,
+                                                   int b) const override;
+  virtual Surface* Clone() const override;
+
+ private:
+  GraphicsSystem& graphics_;
+  ImageDecoder& decoder_;
+
+  // The size and regions of the image.
+  std::shared_ptr<const DecodedImage> header_;
+
+  // Released once |surface_| has been built so the decoded pixels don't stay
+  // around next to the surface's own copy.
+  mutable ImageDecoder::Pixels pixels_;
+
+  mutable std::shared_ptr<Surface> surface_;
+};
+
+#endif  // SRC_SYSTEMS_BASE_DEFERRED_SURFACE_H_
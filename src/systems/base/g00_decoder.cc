@@ -0,0 +1,575 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+#include "systems/base/g00_decoder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RLVM_G00_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#include "systems/base/image_decoder.h"
+#include "systems/base/rect.h"
+#include "xclannad/endian.hpp"
+
+namespace {
+
+const uint32_t kOpaque = 0xff000000;
+
+// A type 2 block has this much header before its first part, and each part
+// this much before its pixels.
+const size_t kBlockHeaderSize = 0x74;
+const size_t kPartHeaderSize = 0x5c;
+
+// -----------------------------------------------------------------------
+
+// Widens as many groups of eight literal type 0 pixels as start at |*src|
+// (a 0xff flag byte followed by 24 bytes of BGR) into opaque 32-bit pixels at
+// |*dst|, advancing both. Stops at the first group containing a back
+// reference, or when fewer than kGroupSlack bytes of input or eight pixels of
+// output remain.
+typedef void (*ExpandFunction)(const unsigned char** src,
+                               const unsigned char* src_end,
+                               uint32_t** dst,
+                               const uint32_t* dst_end);
+
+// Room the expanders need after the start of a group: the widest load they
+// make is 32 bytes, starting just past the flag byte.
+const ptrdiff_t kGroupSlack = 1 + 32;
+
+// Whether any of |count| pixels has an alpha below 0xff.
+typedef bool (*TransparencyFunction)(const uint32_t* pixels, size_t count);
+
+void ExpandScalar(const unsigned char** src,
+                  const unsigned char* src_end,
+                  uint32_t** dst,
+                  const uint32_t* dst_end) {
+  const unsigned char* s = *src;
+  uint32_t* d = *dst;
+  while (src_end - s >= kGroupSlack && dst_end - d >= 8 && *s == 0xff) {
+    ++s;
+    for (int i = 0; i < 8; ++i, s += 3)
+      d[i] = s[0] | (s[1] << 8) | (s[2] << 16) | kOpaque;
+    d += 8;
+  }
+  *src = s;
+  *dst = d;
+}
+
+bool HasTransparencyScalar(const uint32_t* pixels, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    if ((pixels[i] & kOpaque) != kOpaque)
+      return true;
+  }
+  return false;
+}
+
+#ifdef RLVM_G00_X86_SIMD
+__attribute__((target("ssse3"))) void ExpandSSSE3(
+    const unsigned char** src,
+    const unsigned char* src_end,
+    uint32_t** dst,
+    const uint32_t* dst_end) {
+  // Spreads the first twelve bytes of a load over four pixels, leaving their
+  // alpha bytes zero.
+  const __m128i shuffle =
+      _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+  const __m128i alpha = _mm_set1_epi32(static_cast<int>(kOpaque));
+
+  const unsigned char* s = *src;
+  uint32_t* d = *dst;
+  while (src_end - s >= kGroupSlack && dst_end - d >= 8 && *s == 0xff) {
+    __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 1));
+    __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 13));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(d),
+                     _mm_or_si128(_mm_shuffle_epi8(low, shuffle), alpha));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(d + 4),
+                     _mm_or_si128(_mm_shuffle_epi8(high, shuffle), alpha));
+    s += 25;
+    d += 8;
+  }
+  *src = s;
+  *dst = d;
+}
+
+__attribute__((target("ssse3"))) bool HasTransparencySSSE3(
+    const uint32_t* pixels,
+    size_t count) {
+  const __m128i alpha = _mm_set1_epi32(static_cast<int>(kOpaque));
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    const __m128i* p = reinterpret_cast<const __m128i*>(pixels + i);
+    __m128i all = _mm_and_si128(
+        _mm_and_si128(_mm_loadu_si128(p), _mm_loadu_si128(p + 1)),
+        _mm_and_si128(_mm_loadu_si128(p + 2), _mm_loadu_si128(p + 3)));
+    __m128i opaque = _mm_cmpeq_epi32(_mm_and_si128(all, alpha), alpha);
+    if (_mm_movemask_epi8(opaque) != 0xffff)
+      return true;
+  }
+  return HasTransparencyScalar(pixels + i, count - i);
+}
+
+__attribute__((target("avx2"))) void ExpandAVX2(const unsigned char** src,
+                                                const unsigned char* src_end,
+                                                uint32_t** dst,
+                                                const uint32_t* dst_end) {
+  // Moves the group's first twelve bytes into the low lane and the next
+  // twelve into the high one, since the byte shuffle can't cross lanes.
+  const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 0, 3, 4, 5, 0);
+  const __m256i shuffle = _mm256_setr_epi8(
+      0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+      0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+  const __m256i alpha = _mm256_set1_epi32(static_cast<int>(kOpaque));
+
+  const unsigned char* s = *src;
+  uint32_t* d = *dst;
+  while (src_end - s >= kGroupSlack && dst_end - d >= 8 && *s == 0xff) {
+    __m256i group =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + 1));
+    group = _mm256_permutevar8x32_epi32(group, lanes);
+    _mm256_storeu_si256(
+        reinterpret_cast<__m256i*>(d),
+        _mm256_or_si256(_mm256_shuffle_epi8(group, shuffle), alpha));
+    s += 25;
+    d += 8;
+  }
+  *src = s;
+  *dst = d;
+}
+
+__attribute__((target("avx2"))) bool HasTransparencyAVX2(
+    const uint32_t* pixels,
+    size_t count) {
+  const __m256i alpha = _mm256_set1_epi32(static_cast<int>(kOpaque));
+  size_t i = 0;
+  for (; i + 32 <= count; i += 32) {
+    const __m256i* p = reinterpret_cast<const __m256i*>(pixels + i);
+    __m256i all = _mm256_and_si256(
+        _mm256_and_si256(_mm256_loadu_si256(p), _mm256_loadu_si256(p + 1)),
+        _mm256_and_si256(_mm256_loadu_si256(p + 2),
+                         _mm256_loadu_si256(p + 3)));
+    __m256i opaque = _mm256_cmpeq_epi32(_mm256_and_si256(all, alpha), alpha);
+    if (_mm256_movemask_epi8(opaque) != -1)
+      return true;
+  }
+  return HasTransparencyScalar(pixels + i, count - i);
+}
+#endif
+
+struct PixelFunctions {
+  ExpandFunction expand;
+  TransparencyFunction has_transparency;
+};
+
+// The selected G00Implementation, or -1 before the first call to
+// GetG00Implementation().
+std::atomic<int> g_g00_implementation(-1);
+
+PixelFunctions GetPixelFunctions() {
+  switch (GetG00Implementation()) {
+#ifdef RLVM_G00_X86_SIMD
+    case G00_SSSE3:
+      return {ExpandSSSE3, HasTransparencySSSE3};
+    case G00_AVX2:
+      return {ExpandAVX2, HasTransparencyAVX2};
+#endif
+    default:
+      return {ExpandScalar, HasTransparencyScalar};
+  }
+}
+
+// -----------------------------------------------------------------------
+
+// The byte oriented LZ stream that type 1 and 2 images are compressed with.
+// Each flag byte describes the next eight items, low bit first: a set bit is
+// a literal byte and a clear bit is a 16 bit back reference whose top 12
+// bits are a distance and bottom 4 bits a length less two. Decompression can
+// stop and resume, so callers only need to expand as much as they read.
+class ByteStream {
+ public:
+  ByteStream(const char* src,
+             const char* src_end,
+             unsigned char* out,
+             size_t length)
+      : src_(reinterpret_cast<const unsigned char*>(src)),
+        src_end_(reinterpret_cast<const unsigned char*>(src_end)),
+        out_(out),
+        dst_(out),
+        out_end_(out + length) {}
+
+  // Decompresses until at least |length| bytes are out or the input runs
+  // out. Returns false if a back reference points before the start.
+  bool DecompressTo(size_t length);
+
+  size_t decompressed() const { return dst_ - out_; }
+
+ private:
+  const unsigned char* src_;
+  const unsigned char* src_end_;
+  unsigned char* out_;
+  unsigned char* dst_;
+  unsigned char* out_end_;
+
+  // What's left of the current flag byte.
+  unsigned int flag_ = 0;
+  int flag_bits_ = 0;
+};
+
+bool ByteStream::DecompressTo(size_t length) {
+  // Works on copies of the members: the output is written through a char
+  // pointer, which would otherwise force them to be reloaded after every
+  // byte.
+  const unsigned char* src = src_;
+  const unsigned char* src_end = src_end_;
+  unsigned char* dst = dst_;
+  unsigned char* target = out_ + std::min<size_t>(length, out_end_ - out_);
+  unsigned int flag = flag_;
+  int flag_bits = flag_bits_;
+  bool ok = true;
+
+  while (dst < target && src < src_end) {
+    if (flag_bits == 0) {
+      // Runs of eight literals are common in the pixel data.
+      if (*src == 0xff && src_end - src > 8 && out_end_ - dst >= 8) {
+        memcpy(dst, src + 1, 8);
+        src += 9;
+        dst += 8;
+        continue;
+      }
+
+      flag = *src++;
+      flag_bits = 8;
+      continue;
+    }
+
+    bool literal = flag & 1;
+    flag >>= 1;
+    flag_bits--;
+    if (literal) {
+      *dst++ = *src++;
+      continue;
+    }
+
+    if (src_end - src < 2) {
+      src = src_end;
+      break;
+    }
+    unsigned int code = src[0] | (src[1] << 8);
+    src += 2;
+    size_t distance = code >> 4;
+    size_t count = std::min<size_t>((code & 0xf) + 2, out_end_ - dst);
+    if (distance > static_cast<size_t>(dst - out_)) {
+      ok = false;
+      break;
+    }
+
+    // The copy may overlap what it's producing, so it has to go forwards.
+    // Repeats of the previous pixel are the most common case, and once the
+    // source is at least four bytes back it can go a pixel at a time. That
+    // may write up to three bytes past |count|, which the following items
+    // overwrite.
+    const unsigned char* from = dst - distance;
+    if (distance >= 4 && out_end_ - dst >= 20) {
+      for (size_t i = 0; i < count; i += 4)
+        memcpy(dst + i, from + i, 4);
+    } else {
+      for (size_t i = 0; i < count; ++i)
+        dst[i] = from[i];
+    }
+    dst += count;
+  }
+
+  src_ = src;
+  dst_ = dst;
+  flag_ = flag;
+  flag_bits_ = flag_bits;
+  return ok;
+}
+
+// -----------------------------------------------------------------------
+
+// Type 0: 24-bit pixels in an LZ stream whose back references count whole
+// pixels, so it can be expanded straight into the 32-bit output.
+bool DecodeType0(const char* data,
+                 size_t length,
+                 ExpandFunction expand,
+                 uint32_t* out,
+                 size_t pixels) {
+  if (length < 13)
+    return false;
+
+  size_t stream_pixels =
+      static_cast<uint32_t>(read_little_endian_int(data + 9)) / 3;
+  const unsigned char* src = reinterpret_cast<const unsigned char*>(data) + 13;
+  const unsigned char* src_end =
+      reinterpret_cast<const unsigned char*>(data) + length;
+  uint32_t* dst = out;
+  uint32_t* dst_end = out + std::min(pixels, stream_pixels);
+
+  while (dst < dst_end && src < src_end) {
+    expand(&src, src_end, &dst, dst_end);
+    if (dst == dst_end || src == src_end)
+      break;
+
+    // Flag bits are in the same order as ByteStream's, but a back reference
+    // is (distance << 4 | length - 1) in pixels.
+    unsigned int flag = *src++;
+    for (int bit = 0; bit < 8 && dst < dst_end && src < src_end;
+         ++bit, flag >>= 1) {
+      if (flag & 1) {
+        if (src_end - src < 3) {
+          src = src_end;
+          break;
+        }
+        *dst++ = src[0] | (src[1] << 8) | (src[2] << 16) | kOpaque;
+        src += 3;
+        continue;
+      }
+
+      if (src_end - src < 2) {
+        src = src_end;
+        break;
+      }
+      unsigned int code = src[0] | (src[1] << 8);
+      src += 2;
+      size_t distance = code >> 4;
+      size_t count = std::min<size_t>((code & 0xf) + 1, dst_end - dst);
+      if (distance > static_cast<size_t>(dst - out))
+        return false;
+
+      if (distance == 0) {
+        std::fill(dst, dst + count, kOpaque);
+      } else {
+        const uint32_t* from = dst - distance;
+        for (size_t i = 0; i < count; ++i)
+          dst[i] = from[i];
+      }
+      dst += count;
+    }
+  }
+
+  // Whatever a short stream doesn't cover is left black.
+  std::fill(dst, out + pixels, kOpaque);
+  return true;
+}
+
+// Type 1: a palette followed by one byte per pixel, all in one ByteStream.
+bool DecodeType1(const char* data,
+                 size_t length,
+                 uint32_t* out,
+                 size_t pixels) {
+  if (length < 13)
+    return false;
+
+  // The palette can't have more than 0xffff entries, so anything much longer
+  // than that plus the pixels is a corrupt header.
+  size_t size = static_cast<uint32_t>(read_little_endian_int(data + 9));
+  size = std::min(size + 1, 2 + 0xffff * 4 + pixels + 1);
+  std::vector<unsigned char> buffer(std::max<size_t>(size, 2));
+  ByteStream stream(data + 13, data + length, buffer.data(), size);
+  if (!stream.DecompressTo(size))
+    return false;
+
+  const char* decompressed = reinterpret_cast<const char*>(buffer.data());
+  size_t colours = read_little_endian_short(decompressed);
+  uint32_t palette[256] = {0};
+  for (size_t i = 0; i < std::min<size_t>(colours, 256); ++i) {
+    if (2 + i * 4 + 4 > size)
+      break;
+    palette[i] = read_little_endian_int(decompressed + 2 + i * 4);
+  }
+
+  size_t i = 0;
+  for (size_t index = 2 + colours * 4; i < pixels && index < size;
+       ++i, ++index) {
+    out[i] = palette[buffer[index]];
+  }
+  std::fill(out + i, out + pixels, 0);
+  return true;
+}
+
+// A rectangle of pixels from a type 2 block, positioned on the canvas.
+struct Part {
+  const unsigned char* pixels;
+  Rect rect;
+};
+
+// Copies |part| onto the |width| by |height| canvas, dropping whatever falls
+// outside it.
+void CopyPart(const Part& part, int width, int height, uint32_t* out) {
+  const Rect& rect = part.rect;
+  int x1 = std::max(rect.x(), 0);
+  int x2 = std::min(rect.x2(), width);
+  if (x1 >= x2)
+    return;
+
+  for (int row = std::max(rect.y(), 0); row < std::min(rect.y2(), height);
+       ++row) {
+    memcpy(out + static_cast<size_t>(row) * width + x1,
+           part.pixels +
+               (static_cast<size_t>(row - rect.y()) * rect.width() +
+                (x1 - rect.x())) * 4,
+           (x2 - x1) * 4);
+  }
+}
+
+// Type 2: a ByteStream holding an index of blocks, one per region, each
+// holding rectangular parts of 32-bit pixels positioned relative to their
+// region. Every block the region table refers to is decoded; the stream
+// stops there, and each block's parts are copied onto the canvas as soon as
+// it's out.
+bool DecodeType2(const char* data,
+                 size_t length,
+                 const DecodedImage& image,
+                 uint32_t* out) {
+  int width = image.size.width();
+  int height = image.size.height();
+  std::fill(out, out + static_cast<size_t>(width) * height, 0);
+  if (length < 9)
+    return false;
+
+  size_t region_count =
+      static_cast<uint32_t>(read_little_endian_int(data + 5));
+  if (region_count > (length - 9) / 24)
+    return false;
+  const char* head = data + 9 + region_count * 24;
+  if (data + length - head < 8)
+    return false;
+
+  size_t size = static_cast<uint32_t>(read_little_endian_int(head + 4));
+  std::vector<unsigned char> buffer(size);
+  ByteStream stream(head + 8, data + length, buffer.data(), size);
+  if (size < 4 || !stream.DecompressTo(4))
+    return false;
+
+  const char* index = reinterpret_cast<const char*>(buffer.data());
+  size_t blocks = static_cast<uint32_t>(read_little_endian_int(index));
+  blocks = std::min(std::min(blocks, region_count), image.region_table.size());
+  if (4 + blocks * 8 > size || !stream.DecompressTo(4 + blocks * 8))
+    return false;
+
+  for (size_t i = 0; i < blocks; ++i) {
+    size_t offset = static_cast<uint32_t>(read_little_endian_int(
+        index + 4 + i * 8));
+    size_t block_length = static_cast<uint32_t>(read_little_endian_int(
+        index + 8 + i * 8));
+    if (block_length <= kBlockHeaderSize)
+      continue;
+    if (offset + block_length > size ||
+        !stream.DecompressTo(offset + block_length)) {
+      return false;
+    }
+
+    const Rect& region = image.region_table[i].rect;
+    const unsigned char* part = buffer.data() + offset + kBlockHeaderSize;
+    const unsigned char* block_end = buffer.data() + offset + block_length;
+    while (block_end - part >= static_cast<ptrdiff_t>(kPartHeaderSize)) {
+      const char* header = reinterpret_cast<const char*>(part);
+      int x = read_little_endian_short(header) + region.x();
+      int y = read_little_endian_short(header + 2) + region.y();
+      int w = read_little_endian_short(header + 6);
+      int h = read_little_endian_short(header + 8);
+      part += kPartHeaderSize;
+
+      size_t bytes = static_cast<size_t>(w) * h * 4;
+      if (bytes > static_cast<size_t>(block_end - part))
+        return false;
+      CopyPart({part, Rect(x, y, Size(w, h))}, width, height, out);
+      part += bytes;
+    }
+  }
+
+  return true;
+}
+
+}  // namespace
+
+bool IsG00Image(const char* data, size_t length) {
+  // GRPCONV tries PDT and BMP first, which start with 'P' and 'B'.
+  return length >= 10 && (data[0] == 0 || data[0] == 1 || data[0] == 2);
+}
+
+bool DecodeG00(const char* data, size_t length, DecodedImage* image) {
+  PixelFunctions functions = GetPixelFunctions();
+  uint32_t* out = reinterpret_cast<uint32_t*>(image->pixels.get());
+  size_t pixels =
+      static_cast<size_t>(image->size.width()) * image->size.height();
+
+  image->is_mask = false;
+  switch (data[0]) {
+    case 0:
+      return DecodeType0(data, length, functions.expand, out, pixels);
+    case 1:
+      return DecodeType1(data, length, out, pixels);
+    case 2:
+      if (!DecodeType2(data, length, *image, out))
+        return false;
+      image->is_mask = functions.has_transparency(out, pixels);
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool IsG00ImplementationSupported(G00Implementation implementation) {
+  switch (implementation) {
+    case G00_SCALAR:
+      return true;
+#ifdef RLVM_G00_X86_SIMD
+    case G00_SSSE3:
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("ssse3");
+    case G00_AVX2:
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("avx2");
+#endif
+    default:
+      return false;
+  }
+}
+
+G00Implementation GetG00Implementation() {
+  int implementation = g_g00_implementation.load(std::memory_order_relaxed);
+  if (implementation < 0) {
+    implementation = G00_SCALAR;
+    if (IsG00ImplementationSupported(G00_AVX2))
+      implementation = G00_AVX2;
+    else if (IsG00ImplementationSupported(G00_SSSE3))
+      implementation = G00_SSSE3;
+    g_g00_implementation.store(implementation, std::memory_order_relaxed);
+  }
+  return static_cast<G00Implementation>(implementation);
+}
+
+void SetG00Implementation(G00Implementation implementation) {
+  g_g00_implementation.store(implementation, std::memory_order_relaxed);
+}
@@ -0,0 +1,65 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+#ifndef SRC_SYSTEMS_BASE_G00_DECODER_H_
+#define SRC_SYSTEMS_BASE_G00_DECODER_H_
+
+#include <cstddef>
+
+struct DecodedImage;
+
+// Decoders for G00, the image format nearly every RealLive game keeps its
+// graphics in, that write straight into DecodedImage's 32-bit pixels.
+//
+// GRPCONV decompresses each image into a scratch buffer and then converts
+// that a pixel at a time. Here type 0's 24-bit colours are widened as they
+// come out of the LZ stream, with runs of literals expanded by vector
+// shuffles. Type 2 images are decoded whole, every region at once: their
+// blocks all come out of one LZ stream, so reaching any pattern means
+// decompressing everything before it anyway.
+
+// Whether |data| is a G00 image rather than one of the other formats GRPCONV
+// reads.
+bool IsG00Image(const char* data, size_t length);
+
+// Decodes the G00 image in |data| into |image->pixels|, which must already be
+// allocated for |image->size|. The size and region table must have been read
+// from the same file. Returns false if the file is corrupt.
+bool DecodeG00(const char* data, size_t length, DecodedImage* image);
+
+// Instruction sets DecodeG00() can use for widening pixels and looking for
+// transparent ones.
+enum G00Implementation { G00_SCALAR, G00_SSSE3, G00_AVX2 };
+
+// Whether |implementation| can run on this CPU.
+bool IsG00ImplementationSupported(G00Implementation implementation);
+
+// The implementation DecodeG00() uses. Defaults to the fastest supported one;
+// tests and benchmarks can override it.
+G00Implementation GetG00Implementation();
+void SetG00Implementation(G00Implementation implementation);
+
+#endif  // SRC_SYSTEMS_BASE_G00_DECODER_H_
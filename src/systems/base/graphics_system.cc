@@ -54,6 +54,7 @@
 #include "modules/module_grp.h"
 #include "systems/base/anm_graphics_object_data.h"
 #include "systems/base/cgm_table.h"
+#include "systems/base/deferred_surface.h"
 #include "systems/base/event_system.h"
 #include "systems/base/graphics_object.h"
 #include "systems/base/graphics_object_data.h"
@@ -61,6 +62,7 @@
 #include "systems/base/graphics_stack_frame.h"
 #include "systems/base/hik_renderer.h"
 #include "systems/base/hik_script.h"
+#include "systems/base/image_decoder.h"
 #include "systems/base/mouse_cursor.h"
 #include "systems/base/object_mutator.h"
 #include "systems/base/object_settings.h"
@@ -83,6 +85,14 @@ using std::vector;
 
 namespace fs = boost::filesystem;
 
+namespace {
+
+// Memory for recently loaded images when the Gameexe doesn't say otherwise:
+// about 25 full screen CGs at 640x480, or 8 at 1280x720.
+const int kDefaultImageCacheMB = 64;
+
+}  // namespace
+
 // -----------------------------------------------------------------------
 // GraphicsSystem::GraphicsObjectSettings
 // -----------------------------------------------------------------------
@@ -238,7 +248,8 @@ GraphicsSystem::GraphicsSystem(System& system, Gameexe& gameexe)
       system_(system),
       preloaded_hik_scripts_(32),
       preloaded_g00_(256),
-      image_cache_(10) {}
+      image_cache_(static_cast<size_t>(gameexe("__IMAGE_CACHE_MB").ToInt(
+                       kDefaultImageCacheMB)) << 20) {}
 
 // -----------------------------------------------------------------------
 
@@ -617,9 +628,9 @@ std::shared_ptr<HIKScript> GraphicsSystem::GetHIKScript(
 
 void GraphicsSystem::PreloadG00(int slot, const std::string& name) {
   // We first check our implicit cache just in case so we don't load it twice.
-  std::shared_ptr<const Surface> surface = image_cache_.fetch(name);
+  std::shared_ptr<const Surface> surface = image_cache_.Fetch(name);
   if (!surface)
-    surface = LoadSurfaceFromFile(name);
+    surface = LoadSurface(name);
 
   if (surface)
     surface->EnsureUploaded();
@@ -665,18 +676,110 @@ std::shared_ptr<const Surface> GraphicsSystem::GetSurfaceNamed(
     return cached_surface;
 
   // First check to see if this surface is already in our internal cache
-  cached_surface = image_cache_.fetch(short_filename);
+  cached_surface = image_cache_.Fetch(short_filename);
+  if (unused_prefetches_.erase(short_filename)) {
+    if (cached_surface)
+      prefetch_stats_.hits++;
+    else
+      prefetch_stats_.wasted++;
+  }
   if (cached_surface)
     return cached_surface;
 
-  std::shared_ptr<const Surface> surface_to_ret =
-      LoadSurfaceFromFile(short_filename);
-  image_cache_.insert(short_filename, surface_to_ret);
+  std::shared_ptr<const Surface> surface_to_ret = LoadSurface(short_filename);
+  image_cache_.Insert(short_filename, surface_to_ret);
   return surface_to_ret;
 }
 
 // -----------------------------------------------------------------------
 
+void GraphicsSystem::EnableBackgroundImageDecoding(int thread_count) {
+  image_decoder_.reset(new ImageDecoder(thread_count));
+}
+
+// -----------------------------------------------------------------------
+
+std::shared_ptr<const Surface> GraphicsSystem::LoadSurface(
+    const std::string& short_filename) {
+  // Tone curve variants ("NAME?010") are modified by the platform loader right
+  // after decoding, so those always load synchronously.
+  if (!image_decoder_ || short_filename.find('?') != std::string::npos)
+    return LoadSurfaceFromFile(short_filename);
+
+  boost::filesystem::path filename =
+      system().FindFile(short_filename, IMAGE_FILETYPES);
+  if (filename.empty()) {
+    ostringstream oss;
+    oss << "Could not find image file \"" << short_filename << "\".";
+    throw rlvm::Exception(oss.str());
+  }
+
+  return DecodeInBackground(filename);
+}
+
+// -----------------------------------------------------------------------
+
+std::shared_ptr<const Surface> GraphicsSystem::DecodeInBackground(
+    const boost::filesystem::path& filename) {
+  ImageDecoder::Pixels pixels;
+  std::shared_ptr<const DecodedImage> header =
+      image_decoder_->Decode(filename, &pixels);
+  return std::make_shared<DeferredSurface>(
+      *this, *image_decoder_, header, pixels);
+}
+
+// -----------------------------------------------------------------------
+
+bool GraphicsSystem::PrefetchSurface(const std::string& short_filename) {
+  if (!image_decoder_ || short_filename.find('?') != std::string::npos ||
+      image_cache_.Contains(short_filename) ||
+      GetPreloadedG00(short_filename)) {
+    return false;
+  }
+
+  boost::filesystem::path filename =
+      system().FindFile(short_filename, IMAGE_FILETYPES);
+  if (filename.empty())
+    return false;
+
+  std::shared_ptr<const Surface> surface;
+  try {
+    surface = DecodeInBackground(filename);
+  } catch (std::exception& e) {
+    // The command that names this image will report the problem when it
+    // runs, if it runs at all.
+    return false;
+  }
+
+  SweepUnusedPrefetches();
+  image_cache_.Insert(short_filename, surface);
+  unused_prefetches_.insert(short_filename);
+  prefetch_stats_.prefetches++;
+  return true;
+}
+
+// -----------------------------------------------------------------------
+
+GraphicsSystem::PrefetchStats GraphicsSystem::GetPrefetchStats() {
+  SweepUnusedPrefetches();
+  return prefetch_stats_;
+}
+
+// -----------------------------------------------------------------------
+
+void GraphicsSystem::SweepUnusedPrefetches() {
+  for (auto it = unused_prefetches_.begin(); it != unused_prefetches_.end();) {
+    if (image_cache_.Contains(*it)) {
+      ++it;
+    } else {
+      prefetch_stats_.wasted++;
+      it = unused_prefetches_.erase(it);
+    }
+  }
+}
+
+// -----------------------------------------------------------------------
+
 void GraphicsSystem::ClearAndPromoteObjects() {
   typedef LazyArray<GraphicsObject>::full_iterator FullIterator;
 
@@ -799,6 +902,78 @@ void GraphicsSystem::TakeSavepointSnapshot() {
 
 // -----------------------------------------------------------------------
 
+GraphicsSystem::SavepointState::SavepointState(int objects_in_layer)
+    : foreground_objects(objects_in_layer),
+      background_objects(objects_in_layer) {}
+
+GraphicsSystem::SavepointState::~SavepointState() {}
+
+void GraphicsSystem::CopySavepointStateTo(SavepointState& state,
+                                          bool copy_dcs) {
+  state.subtitle = subtitle_;
+  state.default_grp_name = default_grp_name_;
+  state.default_bgr_name = default_bgr_name_;
+  state.graphics_stack = graphics_object_impl_->saved_graphics_stack;
+  graphics_object_impl_->saved_foreground_objects.CopyTo(
+      state.foreground_objects);
+  graphics_object_impl_->saved_background_objects.CopyTo(
+      state.background_objects);
+
+  state.has_dcs = copy_dcs &&
+                  !graphics_object_impl_->use_old_graphics_stack &&
+                  graphics_object_impl_->graphics_stack ==
+                      graphics_object_impl_->saved_graphics_stack;
+  if (!state.has_dcs)
+    return;
+
+  for (int i = 0; i < 16; ++i) {
+    std::shared_ptr<Surface>& copy = state.dcs[i];
+    if (!IsDCAllocated(i)) {
+      copy.reset();
+      continue;
+    }
+
+    std::shared_ptr<Surface> dc = GetDC(i);
+    if (copy && copy->GetSize() == dc->GetSize())
+      dc->BlitToSurface(*copy, dc->GetRect(), dc->GetRect(), 255, false);
+    else
+      copy.reset(dc->Clone());
+  }
+}
+
+bool GraphicsSystem::RestoreSavepointState(RLMachine& machine,
+                                           SavepointState& state) {
+  default_grp_name_ = state.default_grp_name;
+  default_bgr_name_ = state.default_bgr_name;
+  graphics_object_impl_->use_old_graphics_stack = false;
+  graphics_object_impl_->graphics_stack = state.graphics_stack;
+  state.foreground_objects.CopyTo(graphics_object_impl_->foreground_objects);
+  state.background_objects.CopyTo(graphics_object_impl_->background_objects);
+
+  SetWindowSubtitle(state.subtitle, machine.GetTextEncoding());
+
+  if (!state.has_dcs)
+    return false;
+
+  for (int i = 0; i < 16; ++i) {
+    const std::shared_ptr<Surface>& copy = state.dcs[i];
+    if (!copy) {
+      if (i > 1 && IsDCAllocated(i))
+        FreeDC(i);
+      continue;
+    }
+
+    Size size = copy->GetSize();
+    if (i > 0 && (!IsDCAllocated(i) || GetDC(i)->GetSize() != size))
+      AllocateDC(i, size);
+    copy->BlitToSurface(*GetDC(i), copy->GetRect(), copy->GetRect(), 255,
+                        false);
+  }
+  return true;
+}
+
+// -----------------------------------------------------------------------
+
 void GraphicsSystem::ClearAllDCs() {
   GetDC(0)->Fill(RGBAColour::Black());
 
@@ -33,6 +33,7 @@
 #include <boost/serialization/split_member.hpp>
 #include <boost/serialization/version.hpp>
 
+#include <deque>
 #include <iosfwd>
 #include <map>
 #include <memory>
@@ -44,19 +45,21 @@
 
 #include "systems/base/cgm_table.h"
 #include "systems/base/event_listener.h"
+#include "systems/base/image_cache.h"
 #include "systems/base/rect.h"
 #include "systems/base/tone_curve.h"
 
 #include "utilities/lazy_array.h"
-#include "lru_cache.hpp"
 
 class ColourFilter;
+struct DecodedImage;
 class Gameexe;
 class GraphicsObject;
 class GraphicsObjectData;
 class GraphicsStackFrame;
 class HIKRenderer;
 class HIKScript;
+class ImageDecoder;
 class MouseCursor;
 class Renderable;
 class RGBAColour;
@@ -356,6 +359,9 @@ class GraphicsSystem : public EventListener {
   virtual void SetMinimumSizeForDC(int dc, Size size) = 0;
   virtual void FreeDC(int dc) = 0;
 
+  // Whether |dc| currently has a surface. Unlike GetDC(), never allocates.
+  virtual bool IsDCAllocated(int dc) = 0;
+
   // Loads an image, optionally marking that this image has been loaded (if it
   // is in the game's CGM table).
   std::shared_ptr<const Surface> GetSurfaceNamedAndMarkViewed(
@@ -373,6 +379,41 @@ class GraphicsSystem : public EventListener {
 
   virtual std::shared_ptr<Surface> BuildSurface(const Size& size) = 0;
 
+  // Builds a platform surface holding the pixels of |image|.
+  virtual std::shared_ptr<Surface> BuildSurfaceFromImage(
+      const DecodedImage& image) = 0;
+
+  // Makes GetSurfaceNamed() hand pixel decoding to |thread_count| background
+  // threads and return a surface that only waits for them when it's drawn.
+  void EnableBackgroundImageDecoding(int thread_count);
+
+  // The background decoder, or NULL if images are loaded synchronously.
+  ImageDecoder* image_decoder() { return image_decoder_.get(); }
+
+  // Starts decoding |short_filename| in the background and puts it in the
+  // image cache so that a later GetSurfaceNamed() finds it there. Does
+  // nothing if background decoding isn't enabled, if the image is already
+  // cached or preloaded, or if it can't be found. Never throws. Returns
+  // whether a decode was started.
+  bool PrefetchSurface(const std::string& short_filename);
+
+  struct PrefetchStats {
+    PrefetchStats() : prefetches(0), hits(0), wasted(0) {}
+
+    // Decodes started by PrefetchSurface().
+    int prefetches;
+
+    // Prefetched images that GetSurfaceNamed() later found in the cache.
+    int hits;
+
+    // Prefetched images that were evicted from the cache before anything
+    // asked for them.
+    int wasted;
+  };
+  PrefetchStats GetPrefetchStats();
+
+  const ImageCache& image_cache() const { return image_cache_; }
+
   virtual ColourFilter* BuildColourFiller() = 0;
 
   // Clears and promotes objects.
@@ -419,6 +460,37 @@ class GraphicsSystem : public EventListener {
   // relativly cheap operation.)
   void TakeSavepointSnapshot();
 
+  // The graphics state that a save game holds: the objects at the last
+  // savepoint and the commands that rebuild its DCs, along with copies of
+  // the DCs themselves. Lets QuickSaveRing keep saves in memory without going
+  // through boost::serialization, and save games serialize it off the
+  // interpreter thread.
+  struct SavepointState {
+    explicit SavepointState(int objects_in_layer);
+    ~SavepointState();
+
+    std::string subtitle;
+    std::string default_grp_name;
+    std::string default_bgr_name;
+    std::deque<std::string> graphics_stack;
+    LazyArray<GraphicsObject> foreground_objects;
+    LazyArray<GraphicsObject> background_objects;
+
+    // Whether |dcs| holds the DCs as |graphics_stack| builds them. Null
+    // entries are DCs that weren't allocated. The surfaces are reused by
+    // later copies of the same size.
+    bool has_dcs = false;
+    std::shared_ptr<Surface> dcs[16];
+  };
+
+  // In-memory equivalents of save() and load(). The DCs are only copied when
+  // |copy_dcs| is set and the graphics stack hasn't changed since the
+  // savepoint, since they are otherwise ahead of it. RestoreSavepointState()
+  // returns whether it put the DCs back; if not, the caller must call
+  // ReplayGraphicsStack(), as after load().
+  void CopySavepointStateTo(SavepointState& state, bool copy_dcs);
+  bool RestoreSavepointState(RLMachine& machine, SavepointState& state);
+
   // Sets DC0 to black and frees up DCs 1 through 16.
   void ClearAllDCs();
 
@@ -475,6 +547,18 @@ class GraphicsSystem : public EventListener {
   virtual std::shared_ptr<const Surface> LoadSurfaceFromFile(
       const std::string& short_filename) = 0;
 
+  // Loads an image through |image_decoder_| when background decoding is
+  // enabled, and through LoadSurfaceFromFile() otherwise.
+  std::shared_ptr<const Surface> LoadSurface(const std::string& short_filename);
+
+  // Hands |filename| to |image_decoder_| and wraps the result.
+  std::shared_ptr<const Surface> DecodeInBackground(
+      const boost::filesystem::path& filename);
+
+  // Moves prefetched images that have fallen out of |image_cache_| unused
+  // from |unused_prefetches_| to the wasted count.
+  void SweepUnusedPrefetches();
+
   // Default grp name (used in grp* and rec* functions where filename
   // is '???')
   std::string default_grp_name_;
@@ -573,10 +657,17 @@ class GraphicsSystem : public EventListener {
   typedef LazyArray<G00ArrayItem> G00ScriptList;
   G00ScriptList preloaded_g00_;
 
-  // LRU cache filled with the last fifteen accessed images.
-  //
-  // This cache's contents are assumed to be immutable.
-  LRUCache<std::string, std::shared_ptr<const Surface>> image_cache_;
+  // Decodes images off the interpreter thread. Declared before the caches so
+  // it outlives the surfaces waiting on it.
+  std::unique_ptr<ImageDecoder> image_decoder_;
+
+  // Recently loaded images, up to \#__IMAGE_CACHE_MB megabytes of them.
+  ImageCache image_cache_;
+
+  // Names that PrefetchSurface() put in |image_cache_| which nothing has
+  // asked for yet.
+  std::set<std::string> unused_prefetches_;
+  PrefetchStats prefetch_stats_;
 
   // Possible background script which drives graphics to the screen.
   std::unique_ptr<HIKRenderer> hik_renderer_;
@@ -0,0 +1,91 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+#include "systems/base/image_cache.h"
+
+#include <iterator>
+
+#include "systems/base/rect.h"
+#include "systems/base/surface.h"
+
+ImageCache::ImageCache(size_t budget) : budget_(budget) {}
+
+ImageCache::~ImageCache() {}
+
+std::shared_ptr<const Surface> ImageCache::Fetch(const std::string& name) {
+  stats_.lookups++;
+  auto it = index_.find(name);
+  if (it == index_.end())
+    return std::shared_ptr<const Surface>();
+
+  stats_.hits++;
+  entries_.splice(entries_.begin(), entries_, it->second);
+  return it->second->surface;
+}
+
+bool ImageCache::Contains(const std::string& name) const {
+  return index_.find(name) != index_.end();
+}
+
+void ImageCache::Insert(const std::string& name,
+                        const std::shared_ptr<const Surface>& surface) {
+  auto existing = index_.find(name);
+  if (existing != index_.end())
+    Remove(existing->second);
+
+  Entry entry = {name, surface, surface ? EstimateBytes(*surface) : 0};
+  entries_.push_front(entry);
+  index_[name] = entries_.begin();
+  stats_.entries++;
+  stats_.bytes += entry.bytes;
+
+  while (stats_.bytes > budget_ && entries_.size() > 1) {
+    EntryList::iterator oldest = std::prev(entries_.end());
+    stats_.evictions++;
+    stats_.evicted_bytes += oldest->bytes;
+    Remove(oldest);
+  }
+}
+
+void ImageCache::Clear() {
+  entries_.clear();
+  index_.clear();
+  stats_.entries = 0;
+  stats_.bytes = 0;
+}
+
+// static
+size_t ImageCache::EstimateBytes(const Surface& surface) {
+  Size size = surface.GetSize();
+  return static_cast<size_t>(size.width()) * size.height() * 4 * 2;
+}
+
+void ImageCache::Remove(EntryList::iterator it) {
+  stats_.entries--;
+  stats_.bytes -= it->bytes;
+  index_.erase(it->name);
+  entries_.erase(it);
+}
@@ -0,0 +1,118 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+#ifndef SRC_SYSTEMS_BASE_IMAGE_CACHE_H_
+#define SRC_SYSTEMS_BASE_IMAGE_CACHE_H_
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+class Surface;
+
+// The GraphicsSystem's cache of recently loaded images, keyed by file name.
+//
+// Entries are charged by how much memory their pixels take rather than
+// counted, so that one full screen CG costs as much as a few hundred button
+// sprites. When the cache is over its budget, the least recently used images
+// are dropped until it fits again; the image that was just inserted is never
+// dropped, even when it alone is over the budget.
+//
+// This cache's contents are assumed to be immutable.
+class ImageCache {
+ public:
+  explicit ImageCache(size_t budget);
+  ~ImageCache();
+
+  size_t budget() const { return budget_; }
+
+  // Returns the cached image and marks it as recently used, or returns NULL.
+  // Counts towards the hit ratio.
+  std::shared_ptr<const Surface> Fetch(const std::string& name);
+
+  // Whether |name| is cached. Doesn't count as a use.
+  bool Contains(const std::string& name) const;
+
+  // Adds or replaces |name|, and evicts older images if that puts the cache
+  // over its budget.
+  void Insert(const std::string& name,
+              const std::shared_ptr<const Surface>& surface);
+
+  void Clear();
+
+  // The bytes charged for |surface|: its 32-bit pixels once in the platform
+  // surface and once more as an uploaded texture.
+  static size_t EstimateBytes(const Surface& surface);
+
+  struct Stats {
+    Stats()
+        : lookups(0),
+          hits(0),
+          entries(0),
+          bytes(0),
+          evictions(0),
+          evicted_bytes(0) {}
+
+    double hit_ratio() const {
+      return lookups ? static_cast<double>(hits) / lookups : 0;
+    }
+
+    // Calls to Fetch(), and how many of them found their image.
+    int lookups;
+    int hits;
+
+    // What's resident right now.
+    int entries;
+    size_t bytes;
+
+    // Images dropped to stay under the budget.
+    int evictions;
+    size_t evicted_bytes;
+  };
+  const Stats& stats() const { return stats_; }
+
+ private:
+  struct Entry {
+    std::string name;
+    std::shared_ptr<const Surface> surface;
+    size_t bytes;
+  };
+  typedef std::list<Entry> EntryList;
+
+  void Remove(EntryList::iterator it);
+
+  const size_t budget_;
+
+  // Most recently used first.
+  EntryList entries_;
+  std::unordered_map<std::string, EntryList::iterator> index_;
+
+  Stats stats_;
+};
+
+#endif  // SRC_SYSTEMS_BASE_IMAGE_CACHE_H_
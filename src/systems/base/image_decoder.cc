@@ -0,0 +1,217 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+#include "systems/base/image_decoder.h"
+
+#include <chrono>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "systems/base/g00_decoder.h"
+#include "systems/base/system_error.h"
+#include "utilities/exception.h"
+#include "utilities/worker_pool.h"
+#include "xclannad/file.h"
+
+namespace {
+
+// The contents of an image file and the converter parsing them. GRPCONV
+// keeps pointers into |data|, so both have to be kept alive together until
+// the pixels are decoded.
+struct ImageFile {
+  std::vector<char> data;
+  std::unique_ptr<GRPCONV> converter;
+};
+
+std::shared_ptr<ImageFile> OpenImageFile(const boost::filesystem::path& path) {
+  std::ifstream stream(path.string().c_str(), std::ios::binary);
+  if (!stream) {
+    std::ostringstream oss;
+    oss << "Could not open file: " << path;
+    throw rlvm::Exception(oss.str());
+  }
+
+  stream.seekg(0, std::ios::end);
+  size_t size = stream.tellg();
+  stream.seekg(0, std::ios::beg);
+
+  std::shared_ptr<ImageFile> file = std::make_shared<ImageFile>();
+  // One extra byte so the decoders can harmlessly peek past the end.
+  file->data.resize(size + 1);
+  stream.read(file->data.data(), size);
+
+  file->converter.reset(
+      GRPCONV::AssignConverter(file->data.data(), size, "???"));
+  if (!file->converter)
+    throw SystemError("Failure in GRPCONV.");
+
+  return file;
+}
+
+// Copies the size and the type 2 information out of the converter, or creates
+// one default region if none exist.
+void ReadHeader(GRPCONV& conv, DecodedImage* image) {
+  image->size = Size(conv.Width(), conv.Height());
+  for (const GRPCONV::REGION& region : conv.region_table) {
+    Surface::GrpRect rect;
+    rect.rect =
+        Rect(Point(region.x1, region.y1), Point(region.x2 + 1, region.y2 + 1));
+    rect.originX = region.origin_x;
+    rect.originY = region.origin_y;
+    image->region_table.push_back(rect);
+  }
+
+  if (image->region_table.empty()) {
+    Surface::GrpRect rect;
+    rect.rect = Rect(Point(0, 0), image->size);
+    rect.originX = 0;
+    rect.originY = 0;
+    image->region_table.push_back(rect);
+  }
+}
+
+// Decodes the pixels, G00s with DecodeG00() and everything else with the
+// converter. Images whose converter claims an alpha channel but which are
+// entirely opaque are treated as not having one. If decoding fails, |pixels|
+// is left null.
+void DecodePixels(const ImageFile& file, DecodedImage* image) {
+  GRPCONV& conv = *file.converter;
+  int len = conv.Width() * conv.Height();
+  image->pixels.reset(new char[len * 4 + 1024]);
+
+  size_t size = file.data.size() - 1;
+  if (IsG00Image(file.data.data(), size)) {
+    if (!DecodeG00(file.data.data(), size, image))
+      image->pixels.reset();
+    return;
+  }
+
+  if (!conv.Read(image->pixels.get())) {
+    image->pixels.reset();
+    return;
+  }
+
+  image->is_mask = false;
+  if (conv.IsMask()) {
+    const unsigned int* d =
+        reinterpret_cast<const unsigned int*>(image->pixels.get());
+    for (int i = 0; i < len; ++i) {
+      if ((d[i] & 0xff000000) != 0xff000000) {
+        image->is_mask = true;
+        break;
+      }
+    }
+  }
+}
+
+}  // namespace
+
+std::shared_ptr<DecodedImage> DecodeImageFile(
+    const boost::filesystem::path& path) {
+  std::shared_ptr<ImageFile> file = OpenImageFile(path);
+  std::shared_ptr<DecodedImage> image = std::make_shared<DecodedImage>();
+  ReadHeader(*file->converter, image.get());
+  DecodePixels(*file, image.get());
+  return image;
+}
+
+std::shared_ptr<DecodedImage> ReadImageHeader(
+    const boost::filesystem::path& path) {
+  std::shared_ptr<ImageFile> file = OpenImageFile(path);
+  std::shared_ptr<DecodedImage> image = std::make_shared<DecodedImage>();
+  ReadHeader(*file->converter, image.get());
+  return image;
+}
+
+// -----------------------------------------------------------------------
+// ImageDecoder
+// -----------------------------------------------------------------------
+
+ImageDecoder::ImageDecoder(int thread_count) {
+  if (thread_count > 0)
+    pool_.reset(new WorkerPool(thread_count));
+}
+
+ImageDecoder::~ImageDecoder() {}
+
+int ImageDecoder::thread_count() const {
+  return pool_ ? pool_->thread_count() : 0;
+}
+
+std::shared_ptr<const DecodedImage> ImageDecoder::Decode(
+    const boost::filesystem::path& path,
+    Pixels* pixels) {
+  std::shared_ptr<ImageFile> file = OpenImageFile(path);
+  std::shared_ptr<DecodedImage> header = std::make_shared<DecodedImage>();
+  ReadHeader(*file->converter, header.get());
+  stats_.decodes++;
+
+  typedef std::promise<std::shared_ptr<const DecodedImage>> Promise;
+  std::shared_ptr<Promise> promise = std::make_shared<Promise>();
+  *pixels = promise->get_future().share();
+
+  std::function<void(void)> task = [file, header, promise]() {
+    try {
+      std::shared_ptr<DecodedImage> image = std::make_shared<DecodedImage>();
+      image->size = header->size;
+      image->region_table = header->region_table;
+      DecodePixels(*file, image.get());
+      promise->set_value(image);
+    } catch (...) {
+      promise->set_exception(std::current_exception());
+    }
+  };
+
+  if (pool_)
+    pool_->PostTask(std::move(task));
+  else
+    task();
+
+  return header;
+}
+
+std::shared_ptr<const DecodedImage> ImageDecoder::Wait(const Pixels& pixels) {
+  if (pixels.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+    auto start = std::chrono::steady_clock::now();
+    pixels.wait();
+    stats_.waits++;
+    stats_.wait_ms += std::chrono::duration<double, std::milli>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+  }
+
+  return pixels.get();
+}
+
+void ImageDecoder::WaitUntilIdle() {
+  if (pool_)
+    pool_->WaitUntilIdle();
+}
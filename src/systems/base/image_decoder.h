@@ -0,0 +1,119 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+#ifndef SRC_SYSTEMS_BASE_IMAGE_DECODER_H_
+#define SRC_SYSTEMS_BASE_IMAGE_DECODER_H_
+
+#include <boost/filesystem/path.hpp>
+
+#include <future>
+#include <memory>
+#include <vector>
+
+#include "systems/base/rect.h"
+#include "systems/base/surface.h"
+
+class WorkerPool;
+
+// An image file decoded into CPU memory. The graphics systems turn these into
+// their own surfaces with GraphicsSystem::BuildSurfaceFromImage().
+struct DecodedImage {
+  Size size;
+
+  // The type 2 region table of a G00, or a single region covering the whole
+  // image for every other format.
+  std::vector<Surface::GrpRect> region_table;
+
+  // Whether the image has an alpha channel that isn't fully opaque.
+  bool is_mask = false;
+
+  // 32-bit pixels in the order GRPCONV writes them, with some slack at the
+  // end that the converters may scribble on. Null when only the header was
+  // read.
+  std::unique_ptr<char[]> pixels;
+};
+
+// Reads |path| and decodes its pixels. Throws rlvm::Exception if the file
+// can't be read, and SystemError if it isn't an image we understand.
+std::shared_ptr<DecodedImage> DecodeImageFile(
+    const boost::filesystem::path& path);
+
+// Reads the size and region table of |path| without decoding any pixels.
+std::shared_ptr<DecodedImage> ReadImageHeader(
+    const boost::filesystem::path& path);
+
+// Decodes image files on background threads.
+//
+// The file is read and its header parsed on the calling thread, so the size
+// and regions of an image are available immediately; only the pixel decoding,
+// which is the expensive part of loading a full screen CG, is handed to the
+// workers. Callers block on the future when they actually need the pixels.
+class ImageDecoder {
+ public:
+  typedef std::shared_future<std::shared_ptr<const DecodedImage>> Pixels;
+
+  struct Stats {
+    // Number of images handed to Decode().
+    int decodes = 0;
+
+    // Number of images whose pixels were requested before they were ready.
+    int waits = 0;
+
+    // Total time spent blocked in Wait(), in milliseconds.
+    double wait_ms = 0;
+  };
+
+  // Decodes on |thread_count| worker threads. When |thread_count| is zero,
+  // Decode() does all the work itself before returning.
+  explicit ImageDecoder(int thread_count);
+  ~ImageDecoder();
+
+  int thread_count() const;
+
+  // Reads |path| and starts decoding its pixels. The returned header has no
+  // pixels; they arrive through |pixels|. Throws the same errors as
+  // ReadImageHeader() for missing or unrecognized files; errors during pixel
+  // decoding are rethrown by Wait().
+  std::shared_ptr<const DecodedImage> Decode(
+      const boost::filesystem::path& path,
+      Pixels* pixels);
+
+  // Blocks until |pixels| is ready and returns the decoded image.
+  std::shared_ptr<const DecodedImage> Wait(const Pixels& pixels);
+
+  // Blocks until every image handed to Decode() has been decoded.
+  void WaitUntilIdle();
+
+  const Stats& stats() const { return stats_; }
+
+ private:
+  std::unique_ptr<WorkerPool> pool_;
+
+  // Only touched from the interpreter thread.
+  Stats stats_;
+};
+
+#endif  // SRC_SYSTEMS_BASE_IMAGE_DECODER_H_
@@ -885,9 +885,9 @@ void parseNames(const Memory& memory,
 
       int index = Memory::ConvertLetterIndexToInt(strindex);
       if (type == LOWER_BYTE_FULLWIDTH_ASTERISK)
-        output += memory.GetName(index);
+        memory.GetName(index).AppendToString(&output);
       else
-        output += memory.GetLocalName(index);
+        memory.GetLocalName(index).AppendToString(&output);
     } else {
       CopyOneShiftJisCharacter(cur, output);
     }
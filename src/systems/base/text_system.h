@@ -217,6 +217,8 @@ class TextSystem : public EventListener {
 
   // Save pieces of state that would be saved to disk.
   void TakeSavepointSnapshot();
+  int savepoint_active_window() const { return savepoint_active_window_; }
+  int savepoint_cursor_number() const { return savepoint_cursor_number_; }
 
   // Returns a surface with |utf8str| rendered with the other specified
   // properties. Will search |utf8str| for object text syntax and will change
@@ -0,0 +1,68 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+#include "systems/null/null_event_system.h"
+
+// -----------------------------------------------------------------------
+// NullEventSystem
+// -----------------------------------------------------------------------
+NullEventSystem::NullEventSystem(Gameexe& gexe)
+    : EventSystem(gexe), ticks_(0) {}
+
+NullEventSystem::~NullEventSystem() {}
+
+void NullEventSystem::ExecuteEventSystem(RLMachine& machine) {}
+
+unsigned int NullEventSystem::GetTicks() const { return ticks_++; }
+
+void NullEventSystem::Wait(unsigned int milliseconds) const {
+  ticks_ += milliseconds;
+}
+
+bool NullEventSystem::ShiftPressed() const { return false; }
+
+bool NullEventSystem::CtrlPressed() const { return false; }
+
+Point NullEventSystem::GetCursorPos() { return Point(0, 0); }
+
+void NullEventSystem::GetCursorPos(Point& position,
+                                   int& button1,
+                                   int& button2) {
+  position = Point(0, 0);
+  button1 = 0;
+  button2 = 0;
+}
+
+void NullEventSystem::FlushMouseClicks() {}
+
+unsigned int NullEventSystem::TimeOfLastMouseMove() { return 0; }
+
+void NullEventSystem::InjectMouseMovement(RLMachine& machine,
+                                          const Point& loc) {}
+
+void NullEventSystem::InjectMouseDown(RLMachine& machine) {}
+
+void NullEventSystem::InjectMouseUp(RLMachine& machine) {}
@@ -0,0 +1,65 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+#ifndef SRC_SYSTEMS_NULL_NULL_EVENT_SYSTEM_H_
+#define SRC_SYSTEMS_NULL_NULL_EVENT_SYSTEM_H_
+
+#include "systems/base/event_system.h"
+
+// An event system with no input devices and a virtual clock, used to run
+// games headless. Time only passes when something looks at the clock or
+// waits: every GetTicks() advances it by a millisecond and Wait() advances it
+// by the requested amount without sleeping. Timed operations like effects and
+// frame counters therefore finish as fast as the interpreter can get to them,
+// and a run with the same input always sees the same times.
+class NullEventSystem : public EventSystem {
+ public:
+  explicit NullEventSystem(Gameexe& gexe);
+  virtual ~NullEventSystem();
+
+  // Implementation of EventSystem:
+  virtual void ExecuteEventSystem(RLMachine& machine) override;
+  virtual unsigned int GetTicks() const override;
+  virtual void Wait(unsigned int milliseconds) const override;
+  virtual bool ShiftPressed() const override;
+  virtual bool CtrlPressed() const override;
+  virtual Point GetCursorPos() override;
+  virtual void GetCursorPos(Point& position,
+                            int& button1,
+                            int& button2) override;
+  virtual void FlushMouseClicks() override;
+  virtual unsigned int TimeOfLastMouseMove() override;
+  virtual void InjectMouseMovement(RLMachine& machine,
+                                   const Point& loc) override;
+  virtual void InjectMouseDown(RLMachine& machine) override;
+  virtual void InjectMouseUp(RLMachine& machine) override;
+
+ private:
+  // The virtual time in milliseconds.
+  mutable unsigned int ticks_;
+};
+
+#endif  // SRC_SYSTEMS_NULL_NULL_EVENT_SYSTEM_H_
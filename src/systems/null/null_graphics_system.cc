@@ -0,0 +1,160 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+#include "systems/null/null_graphics_system.h"
+
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include "systems/base/colour_filter.h"
+#include "systems/base/image_decoder.h"
+#include "systems/base/system.h"
+#include "systems/null/null_surface.h"
+#include "utilities/exception.h"
+#include "utilities/graphics.h"
+
+namespace {
+
+class NullColourFilter : public ColourFilter {
+ public:
+  virtual void Fill(const GraphicsObject& go,
+                    const Rect& screen_rect,
+                    const RGBAColour& colour) override {}
+};
+
+}  // namespace
+
+// -----------------------------------------------------------------------
+// NullGraphicsSystem
+// -----------------------------------------------------------------------
+NullGraphicsSystem::NullGraphicsSystem(System& system, Gameexe& gameexe)
+    : GraphicsSystem(system, gameexe) {
+  SetScreenSize(GetScreenSize(gameexe));
+
+  for (int i = 0; i < 16; ++i)
+    display_contexts_[i] = std::make_shared<NullSurface>(Size());
+  display_contexts_[0]->set_size(screen_size());
+  display_contexts_[1]->set_size(screen_size());
+
+  haikei_ = std::make_shared<NullSurface>(screen_size());
+}
+
+NullGraphicsSystem::~NullGraphicsSystem() {}
+
+void NullGraphicsSystem::ExecuteGraphicsSystem(RLMachine& machine) {
+  // There's no screen to draw, so any pending refresh is finished as soon as
+  // it's asked for.
+  if (screen_needs_refresh())
+    OnScreenRefreshed();
+
+  GraphicsSystem::ExecuteGraphicsSystem(machine);
+}
+
+void NullGraphicsSystem::BeginFrame() {}
+
+void NullGraphicsSystem::EndFrame() {}
+
+std::shared_ptr<Surface> NullGraphicsSystem::EndFrameToSurface() {
+  return std::make_shared<NullSurface>(screen_size());
+}
+
+void NullGraphicsSystem::AllocateDC(int dc, Size size) {
+  if (dc >= 16)
+    throw rlvm::Exception("Invalid DC number in NullGraphicsSystem");
+
+  // We can't reallocate the screen!
+  if (dc == 0)
+    throw rlvm::Exception("Attempting to reallocate DC 0!");
+
+  // DC 1 is a special case and must always be at least the size of
+  // the screen.
+  if (dc == 1) {
+    Size dc0_size = display_contexts_[0]->GetSize();
+    if (size.width() < dc0_size.width())
+      size.set_width(dc0_size.width());
+    if (size.height() < dc0_size.height())
+      size.set_height(dc0_size.height());
+  }
+
+  display_contexts_[dc]->set_size(size);
+}
+
+void NullGraphicsSystem::SetMinimumSizeForDC(int dc, Size size) {
+  Size current = display_contexts_[dc]->GetSize();
+  if (current.width() < size.width() || current.height() < size.height())
+    AllocateDC(dc, current.SizeUnion(size));
+}
+
+void NullGraphicsSystem::FreeDC(int dc) {
+  if (dc == 0) {
+    throw rlvm::Exception("Attempt to deallocate DC[0]");
+  } else if (dc == 1) {
+    // DC[1] never gets freed; it only gets blanked, which is a no-op here.
+  } else {
+    display_contexts_[dc]->set_size(Size());
+  }
+}
+
+bool NullGraphicsSystem::IsDCAllocated(int dc) {
+  return !display_contexts_[dc]->GetSize().is_empty();
+}
+
+std::shared_ptr<Surface> NullGraphicsSystem::GetHaikei() { return haikei_; }
+
+std::shared_ptr<Surface> NullGraphicsSystem::GetDC(int dc) {
+  if (dc >= 16)
+    throw rlvm::Exception("Invalid DC number in NullGraphicsSystem");
+
+  return display_contexts_[dc];
+}
+
+std::shared_ptr<Surface> NullGraphicsSystem::BuildSurface(const Size& size) {
+  return std::make_shared<NullSurface>(size);
+}
+
+std::shared_ptr<Surface> NullGraphicsSystem::BuildSurfaceFromImage(
+    const DecodedImage& image) {
+  return std::make_shared<NullSurface>(image.size, image.region_table);
+}
+
+ColourFilter* NullGraphicsSystem::BuildColourFiller() {
+  return new NullColourFilter;
+}
+
+std::shared_ptr<const Surface> NullGraphicsSystem::LoadSurfaceFromFile(
+    const std::string& short_filename) {
+  boost::filesystem::path filename =
+      system().FindFile(short_filename, IMAGE_FILETYPES);
+  if (filename.empty()) {
+    std::ostringstream oss;
+    oss << "Could not find image file \"" << short_filename << "\".";
+    throw rlvm::Exception(oss.str());
+  }
+
+  // Only the header is parsed; the pixels would never be looked at.
+  return BuildSurfaceFromImage(*ReadImageHeader(filename));
+}
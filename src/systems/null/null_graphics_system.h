@@ -0,0 +1,71 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+#ifndef SRC_SYSTEMS_NULL_NULL_GRAPHICS_SYSTEM_H_
+#define SRC_SYSTEMS_NULL_NULL_GRAPHICS_SYSTEM_H_
+
+#include <memory>
+#include <string>
+
+#include "systems/base/graphics_system.h"
+
+class NullSurface;
+class System;
+
+// A graphics system that keeps track of everything a game sets up but never
+// draws any of it. Images are sized from their headers without decoding their
+// pixels.
+class NullGraphicsSystem : public GraphicsSystem {
+ public:
+  NullGraphicsSystem(System& system, Gameexe& gameexe);
+  virtual ~NullGraphicsSystem();
+
+  // Implementation of GraphicsSystem:
+  virtual void ExecuteGraphicsSystem(RLMachine& machine) override;
+  virtual void BeginFrame() override;
+  virtual void EndFrame() override;
+  virtual std::shared_ptr<Surface> EndFrameToSurface() override;
+  virtual void AllocateDC(int dc, Size size) override;
+  virtual void SetMinimumSizeForDC(int dc, Size size) override;
+  virtual void FreeDC(int dc) override;
+  virtual bool IsDCAllocated(int dc) override;
+  virtual std::shared_ptr<Surface> GetHaikei() override;
+  virtual std::shared_ptr<Surface> GetDC(int dc) override;
+  virtual std::shared_ptr<Surface> BuildSurface(const Size& size) override;
+  virtual std::shared_ptr<Surface> BuildSurfaceFromImage(
+      const DecodedImage& image) override;
+  virtual ColourFilter* BuildColourFiller() override;
+
+ private:
+  virtual std::shared_ptr<const Surface> LoadSurfaceFromFile(
+      const std::string& short_filename) override;
+
+  std::shared_ptr<NullSurface> haikei_;
+
+  std::shared_ptr<NullSurface> display_contexts_[16];
+};
+
+#endif  // SRC_SYSTEMS_NULL_NULL_GRAPHICS_SYSTEM_H_
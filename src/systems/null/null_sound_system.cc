@@ -0,0 +1,101 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+#include "systems/null/null_sound_system.h"
+
+#include <string>
+
+// -----------------------------------------------------------------------
+// NullSoundSystem
+// -----------------------------------------------------------------------
+NullSoundSystem::NullSoundSystem(System& system)
+    : SoundSystem(system), bgm_looping_(false) {}
+
+NullSoundSystem::~NullSoundSystem() {}
+
+int NullSoundSystem::BgmStatus() const { return 0; }
+
+void NullSoundSystem::BgmPlay(const std::string& bgm_name, bool loop) {
+  bgm_name_ = bgm_name;
+  bgm_looping_ = loop;
+}
+
+void NullSoundSystem::BgmPlay(const std::string& bgm_name,
+                              bool loop,
+                              int fade_in_ms) {
+  BgmPlay(bgm_name, loop);
+}
+
+void NullSoundSystem::BgmPlay(const std::string& bgm_name,
+                              bool loop,
+                              int fade_in_ms,
+                              int fade_out_ms) {
+  BgmPlay(bgm_name, loop);
+}
+
+void NullSoundSystem::BgmStop() {
+  bgm_name_.clear();
+  bgm_looping_ = false;
+}
+
+void NullSoundSystem::BgmPause() {}
+
+void NullSoundSystem::BgmUnPause() {}
+
+void NullSoundSystem::BgmFadeOut(int fade_out_ms) { BgmStop(); }
+
+std::string NullSoundSystem::GetBgmName() const { return bgm_name_; }
+
+bool NullSoundSystem::BgmLooping() const { return bgm_looping_; }
+
+void NullSoundSystem::WavPlay(const std::string& wav_file, bool loop) {}
+
+void NullSoundSystem::WavPlay(const std::string& wav_file,
+                              bool loop,
+                              const int channel) {}
+
+void NullSoundSystem::WavPlay(const std::string& wav_file,
+                              bool loop,
+                              const int channel,
+                              const int fadein_ms) {}
+
+bool NullSoundSystem::WavPlaying(const int channel) { return false; }
+
+void NullSoundSystem::WavStop(const int channel) {}
+
+void NullSoundSystem::WavStopAll() {}
+
+void NullSoundSystem::WavFadeOut(const int channel, const int fadetime) {}
+
+void NullSoundSystem::PlaySe(const int se_num) {}
+
+bool NullSoundSystem::HasSe(const int se_num) { return false; }
+
+bool NullSoundSystem::KoePlaying() const { return false; }
+
+void NullSoundSystem::KoeStop() {}
+
+void NullSoundSystem::KoePlayImpl(int id) {}
@@ -0,0 +1,111 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+#include "systems/null/null_surface.h"
+
+#include <memory>
+#include <vector>
+
+// -----------------------------------------------------------------------
+// NullSurface
+// -----------------------------------------------------------------------
+NullSurface::NullSurface(const Size& size) { set_size(size); }
+
+NullSurface::NullSurface(const Size& size,
+                         const std::vector<GrpRect>& region_table)
+    : size_(size), region_table_(region_table) {}
+
+NullSurface::~NullSurface() {}
+
+void NullSurface::set_size(const Size& size) {
+  size_ = size;
+
+  GrpRect rect;
+  rect.rect = Rect(Point(0, 0), size);
+  rect.originX = 0;
+  rect.originY = 0;
+  region_table_.assign(1, rect);
+}
+
+void NullSurface::Fill(const RGBAColour& colour) {}
+
+void NullSurface::Fill(const RGBAColour& colour, const Rect& area) {}
+
+void NullSurface::ToneCurve(const ToneCurveRGBMap effect, const Rect& area) {}
+
+void NullSurface::Invert(const Rect& area) {}
+
+void NullSurface::Mono(const Rect& area) {}
+
+void NullSurface::ApplyColour(const RGBColour& colour, const Rect& area) {}
+
+Size NullSurface::GetSize() const { return size_; }
+
+void NullSurface::BlitToSurface(Surface& dest_surface,
+                                const Rect& src,
+                                const Rect& dst,
+                                int alpha,
+                                bool use_src_alpha) const {}
+
+void NullSurface::RenderToScreen(const Rect& src,
+                                 const Rect& dst,
+                                 int alpha) const {}
+
+void NullSurface::RenderToScreenAsColorMask(const Rect& src,
+                                            const Rect& dst,
+                                            const RGBAColour& colour,
+                                            int filter) const {}
+
+void NullSurface::RenderToScreen(const Rect& src,
+                                 const Rect& dst,
+                                 const int opacity[4]) const {}
+
+void NullSurface::RenderToScreenAsObject(const GraphicsObject& rp,
+                                         const Rect& src,
+                                         const Rect& dst,
+                                         int alpha) const {}
+
+int NullSurface::GetNumPatterns() const { return region_table_.size(); }
+
+const Surface::GrpRect& NullSurface::GetPattern(int patt_no) const {
+  if (patt_no >= 0 && patt_no < region_table_.size())
+    return region_table_[patt_no];
+  else
+    return region_table_[0];
+}
+
+void NullSurface::GetDCPixel(const Point& pos, int& r, int& g, int& b) const {
+  r = g = b = 0;
+}
+
+std::shared_ptr<Surface> NullSurface::ClipAsColorMask(const Rect& clip_rect,
+                                                      int r,
+                                                      int g,
+                                                      int b) const {
+  return std::make_shared<NullSurface>(clip_rect.size());
+}
+
+Surface* NullSurface::Clone() const { return new NullSurface(*this); }
@@ -0,0 +1,96 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+#ifndef SRC_SYSTEMS_NULL_NULL_SURFACE_H_
+#define SRC_SYSTEMS_NULL_NULL_SURFACE_H_
+
+#include <memory>
+#include <vector>
+
+#include "systems/base/surface.h"
+
+// A surface with a size and a pattern table but no pixels. Drawing to or from
+// it does nothing, and every pixel reads as black.
+class NullSurface : public Surface {
+ public:
+  explicit NullSurface(const Size& size);
+  // |region_table| must not be empty.
+  NullSurface(const Size& size, const std::vector<GrpRect>& region_table);
+  virtual ~NullSurface();
+
+  // Resizes the surface, replacing its pattern table with a single region
+  // covering the new size.
+  void set_size(const Size& size);
+
+  // Implementation of Surface:
+  virtual void Fill(const RGBAColour& colour) override;
+  virtual void Fill(const RGBAColour& colour, const Rect& area) override;
+  virtual void ToneCurve(const ToneCurveRGBMap effect,
+                         const Rect& area) override;
+  virtual void Invert(const Rect& area) override;
+  virtual void Mono(const Rect& area) override;
+  virtual void ApplyColour(const RGBColour& colour, const Rect& area) override;
+  virtual Size GetSize() const override;
+  virtual void BlitToSurface(Surface& dest_surface,
+                             const Rect& src,
+                             const Rect& dst,
+                             int alpha = 255,
+                             bool use_src_alpha = true) const override;
+  virtual void RenderToScreen(const Rect& src,
+                              const Rect& dst,
+                              int alpha = 255) const override;
+  virtual void RenderToScreenAsColorMask(const Rect& src,
+                                         const Rect& dst,
+                                         const RGBAColour& colour,
+                                         int filter) const override;
+  virtual void RenderToScreen(const Rect& src,
+                              const Rect& dst,
+                              const int opacity[4]) const override;
+  virtual void RenderToScreenAsObject(const GraphicsObject& rp,
+                                      const Rect& src,
+                                      const Rect& dst,
+                                      int alpha) const override;
+  virtual int GetNumPatterns() const override;
+  virtual const GrpRect& GetPattern(int patt_no) const override;
+  virtual void GetDCPixel(const Point& pos,
+                          int& r,
+                          int& g,
+                          int& b) const override;
+  virtual std::shared_ptr<Surface> ClipAsColorMask(const Rect& clip_rect,
+                                                   int r,
+                                                   int g,
+                                                   int b) const override;
+  virtual Surface* Clone() const override;
+
+ private:
+  Size size_;
+
+  // The type 2 regions of the image this surface stands in for, or a single
+  // region covering the whole surface. Never empty.
+  std::vector<GrpRect> region_table_;
+};
+
+#endif  // SRC_SYSTEMS_NULL_NULL_SURFACE_H_
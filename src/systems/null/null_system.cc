@@ -0,0 +1,125 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+#include "systems/null/null_system.h"
+
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "long_operations/select_long_operation.h"
+#include "machine/long_operation.h"
+#include "machine/rlmachine.h"
+#include "utilities/exception.h"
+
+// -----------------------------------------------------------------------
+// NullSystem
+// -----------------------------------------------------------------------
+NullSystem::NullSystem(Gameexe& gameexe)
+    : System(),
+      gameexe_(gameexe),
+      graphics_system_(*this, gameexe),
+      event_system_(gameexe),
+      text_system_(*this, gameexe),
+      sound_system_(*this),
+      next_decision_(0) {}
+
+NullSystem::~NullSystem() {}
+
+void NullSystem::SetDecisions(const std::vector<std::string>& decisions) {
+  decisions_ = decisions;
+  next_decision_ = 0;
+}
+
+void NullSystem::LoadDecisions(const boost::filesystem::path& path) {
+  std::ifstream file(path.string().c_str());
+  if (!file) {
+    std::ostringstream oss;
+    oss << "Could not open decision file " << path;
+    throw rlvm::Exception(oss.str());
+  }
+
+  std::vector<std::string> decisions;
+  std::string line;
+  while (std::getline(file, line)) {
+    if (!line.empty() && line[line.size() - 1] == '\r')
+      line.erase(line.size() - 1);
+    if (line.empty() || line[0] == '#')
+      continue;
+    decisions.push_back(line);
+  }
+
+  SetDecisions(decisions);
+}
+
+void NullSystem::Run(RLMachine& machine) {
+  event_system_.ExecuteEventSystem(machine);
+  text_system_.ExecuteTextSystem();
+  sound_system_.ExecuteSoundSystem();
+  graphics_system_.ExecuteGraphicsSystem(machine);
+
+  std::shared_ptr<LongOperation> operation = machine.CurrentLongOperation();
+  if (SelectLongOperation* select =
+          dynamic_cast<SelectLongOperation*>(operation.get())) {
+    MakeDecision(machine, *select);
+  }
+}
+
+GraphicsSystem& NullSystem::graphics() { return graphics_system_; }
+
+EventSystem& NullSystem::event() { return event_system_; }
+
+Gameexe& NullSystem::gameexe() { return gameexe_; }
+
+TextSystem& NullSystem::text() { return text_system_; }
+
+SoundSystem& NullSystem::sound() { return sound_system_; }
+
+void NullSystem::MakeDecision(RLMachine& machine,
+                              SelectLongOperation& select) {
+  if (next_decision_ < decisions_.size()) {
+    const std::string& decision = decisions_[next_decision_];
+    if (select.SelectByText(decision)) {
+      std::cerr << "Selected '" << decision << "'" << std::endl;
+      next_decision_++;
+      return;
+    }
+
+    std::cerr << "Couldn't select decision " << next_decision_ << " ('"
+              << decision << "')";
+  } else {
+    std::cerr << "Ran out of decisions";
+  }
+
+  std::cerr << " at SEEN" << machine.SceneNumber() << " line "
+            << machine.line_number() << ". Options are:" << std::endl;
+  for (const std::string& option : select.GetOptions())
+    std::cerr << "- \"" << option << "\"" << std::endl;
+  machine.Halt();
+}
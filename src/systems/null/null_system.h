@@ -0,0 +1,87 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+#ifndef SRC_SYSTEMS_NULL_NULL_SYSTEM_H_
+#define SRC_SYSTEMS_NULL_NULL_SYSTEM_H_
+
+#include <boost/filesystem/path.hpp>
+
+#include <string>
+#include <vector>
+
+#include "systems/base/system.h"
+#include "systems/null/null_event_system.h"
+#include "systems/null/null_graphics_system.h"
+#include "systems/null/null_sound_system.h"
+#include "systems/null/null_text_system.h"
+
+class SelectLongOperation;
+
+// A System with no window, no sound and a virtual clock (see
+// NullEventSystem), which replays a game as fast as the interpreter runs.
+// The only input is a list of decisions: each time the game puts up a
+// selection, the next decision is chosen by its text. The machine is halted
+// when the game asks for a decision the list can't provide.
+class NullSystem : public System {
+ public:
+  explicit NullSystem(Gameexe& gameexe);
+  virtual ~NullSystem();
+
+  // Sets the text of the options to choose, in order.
+  void SetDecisions(const std::vector<std::string>& decisions);
+
+  // Reads the decisions from a UTF-8 text file with one decision per line.
+  // Blank lines and lines starting with '#' are skipped.
+  void LoadDecisions(const boost::filesystem::path& path);
+
+  // How many decisions have been made so far.
+  int decisions_made() const { return next_decision_; }
+
+  // Implementation of System:
+  virtual void Run(RLMachine& machine) override;
+  virtual GraphicsSystem& graphics() override;
+  virtual EventSystem& event() override;
+  virtual Gameexe& gameexe() override;
+  virtual TextSystem& text() override;
+  virtual SoundSystem& sound() override;
+
+ private:
+  // Chooses the next decision in |select|, or halts |machine| if that isn't
+  // possible.
+  void MakeDecision(RLMachine& machine, SelectLongOperation& select);
+
+  Gameexe& gameexe_;
+
+  NullGraphicsSystem graphics_system_;
+  NullEventSystem event_system_;
+  NullTextSystem text_system_;
+  NullSoundSystem sound_system_;
+
+  std::vector<std::string> decisions_;
+  int next_decision_;
+};
+
+#endif  // SRC_SYSTEMS_NULL_NULL_SYSTEM_H_
@@ -0,0 +1,70 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+#include "systems/null/null_text_system.h"
+
+#include <memory>
+#include <string>
+
+#include "systems/null/null_text_window.h"
+
+// -----------------------------------------------------------------------
+// NullTextSystem
+// -----------------------------------------------------------------------
+NullTextSystem::NullTextSystem(System& system, Gameexe& gameexe)
+    : TextSystem(system, gameexe) {}
+
+NullTextSystem::~NullTextSystem() {}
+
+std::shared_ptr<TextWindow> NullTextSystem::GetTextWindow(int text_window) {
+  WindowMap::iterator it = text_window_.find(text_window);
+  if (it == text_window_.end()) {
+    it = text_window_.emplace(text_window,
+                              std::shared_ptr<TextWindow>(new NullTextWindow(
+                                  system(), text_window))).first;
+  }
+
+  return it->second;
+}
+
+Size NullTextSystem::RenderGlyphOnto(
+    const std::string& current,
+    int font_size,
+    bool italic,
+    const RGBColour& font_colour,
+    const RGBColour* shadow_colour,
+    int insertion_point_x,
+    int insertion_point_y,
+    const std::shared_ptr<Surface>& destination) {
+  // Single byte UTF-8 characters are ASCII, and so half width.
+  return Size(current.size() == 1 ? font_size / 2 : font_size, font_size);
+}
+
+int NullTextSystem::GetCharWidth(int size, uint16_t codepoint) {
+  return codepoint < 0x80 ? size / 2 : size;
+}
+
+bool NullTextSystem::FontIsMonospaced() { return true; }
@@ -0,0 +1,61 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+#ifndef SRC_SYSTEMS_NULL_NULL_TEXT_SYSTEM_H_
+#define SRC_SYSTEMS_NULL_NULL_TEXT_SYSTEM_H_
+
+#include <memory>
+#include <string>
+
+#include "systems/base/text_system.h"
+
+class System;
+
+// A text system with no fonts. Text goes through all the usual layout in the
+// text windows, with every character assumed to be a full or half em wide,
+// but no glyphs are drawn.
+class NullTextSystem : public TextSystem {
+ public:
+  NullTextSystem(System& system, Gameexe& gameexe);
+  virtual ~NullTextSystem();
+
+  // Implementation of TextSystem:
+  virtual std::shared_ptr<TextWindow> GetTextWindow(
+      int text_window_number) override;
+  virtual Size RenderGlyphOnto(
+      const std::string& current,
+      int font_size,
+      bool italic,
+      const RGBColour& font_colour,
+      const RGBColour* shadow_colour,
+      int insertion_point_x,
+      int insertion_point_y,
+      const std::shared_ptr<Surface>& destination) override;
+  virtual int GetCharWidth(int size, uint16_t codepoint) override;
+  virtual bool FontIsMonospaced() override;
+};
+
+#endif  // SRC_SYSTEMS_NULL_NULL_TEXT_SYSTEM_H_
@@ -0,0 +1,66 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+#include "systems/null/null_text_window.h"
+
+#include <memory>
+#include <string>
+
+#include "systems/null/null_surface.h"
+
+// -----------------------------------------------------------------------
+// NullTextWindow
+// -----------------------------------------------------------------------
+NullTextWindow::NullTextWindow(System& system, int window_num)
+    : TextWindow(system, window_num) {
+  ClearWin();
+}
+
+NullTextWindow::~NullTextWindow() {}
+
+std::shared_ptr<Surface> NullTextWindow::GetTextSurface() { return surface_; }
+
+std::shared_ptr<Surface> NullTextWindow::GetNameSurface() {
+  return name_surface_;
+}
+
+void NullTextWindow::ClearWin() {
+  TextWindow::ClearWin();
+
+  if (!surface_)
+    surface_ = std::make_shared<NullSurface>(GetTextSurfaceSize());
+  name_surface_.reset();
+}
+
+void NullTextWindow::RenderNameInBox(const std::string& utf8str) {
+  name_surface_ = std::make_shared<NullSurface>(
+      Size(utf8str.size() * font_size_in_pixels() / 2, font_size_in_pixels()));
+}
+
+void NullTextWindow::DisplayRubyText(const std::string& utf8str) {}
+
+void NullTextWindow::AddSelectionItem(const std::string& utf8str,
+                                      int selection_id) {}
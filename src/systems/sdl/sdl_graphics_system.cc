@@ -51,6 +51,7 @@
 #include "systems/base/colour.h"
 #include "systems/base/event_system.h"
 #include "systems/base/graphics_object.h"
+#include "systems/base/image_decoder.h"
 #include "systems/base/mouse_cursor.h"
 #include "systems/base/renderable.h"
 #include "systems/base/system.h"
@@ -68,7 +69,6 @@
 #include "utilities/graphics.h"
 #include "utilities/lazy_array.h"
 #include "utilities/string_utilities.h"
-#include "xclannad/file.h"
 
 // -----------------------------------------------------------------------
 // Private Interface
@@ -478,6 +478,10 @@ void SDLGraphicsSystem::FreeDC(int dc) {
   }
 }
 
+bool SDLGraphicsSystem::IsDCAllocated(int dc) {
+  return display_contexts_[dc]->allocated();
+}
+
 void SDLGraphicsSystem::VerifySurfaceExists(int dc, const std::string& caller) {
   if (dc >= 16) {
     std::ostringstream ss;
@@ -542,15 +546,17 @@ static SDL_Surface* newSurfaceFromRGBAData(int w,
   return surf;
 }
 
-// Helper function for load_surface_from_file; invoked in a stl loop.
-static SDLSurface::GrpRect xclannadRegionToGrpRect(
-    const GRPCONV::REGION& region) {
-  SDLSurface::GrpRect rect;
-  rect.rect =
-      Rect(Point(region.x1, region.y1), Point(region.x2 + 1, region.y2 + 1));
-  rect.originX = region.origin_x;
-  rect.originY = region.origin_y;
-  return rect;
+std::shared_ptr<Surface> SDLGraphicsSystem::BuildSurfaceFromImage(
+    const DecodedImage& image) {
+  SDL_Surface* s = 0;
+  if (image.pixels) {
+    s = newSurfaceFromRGBAData(image.size.width(),
+                               image.size.height(),
+                               image.pixels.get(),
+                               image.is_mask ? ALPHA_MASK : NO_MASK);
+  }
+
+  return std::shared_ptr<Surface>(new SDLSurface(this, s, image.region_table));
 }
 
 std::shared_ptr<const Surface> SDLGraphicsSystem::LoadSurfaceFromFile(
@@ -563,67 +569,8 @@ std::shared_ptr<const Surface> SDLGraphicsSystem::LoadSurfaceFromFile(
     throw rlvm::Exception(oss.str());
   }
 
-  // Glue code to allow my stuff to work with Jagarl's loader
-  FILE* file = fopen(filename.string().c_str(), "rb");
-  if (!file) {
-    std::ostringstream oss;
-    oss << "Could not open file: " << filename;
-    throw rlvm::Exception(oss.str());
-  }
-
-  fseek(file, 0, SEEK_END);
-  size_t size = ftell(file);
-  std::unique_ptr<char[]> d(new char[size + 1]);
-  fseek(file, 0, SEEK_SET);
-  fread(d.get(), size, 1, file);
-  fclose(file);
-
-  std::unique_ptr<GRPCONV> conv(
-      GRPCONV::AssignConverter(d.get(), size, "???"));
-  if (conv == 0) {
-    throw SystemError("Failure in GRPCONV.");
-  }
-  // do not free until SDL_FreeSurface() is called on the surface using it
-  char* mem = (char*)malloc(conv->Width() * conv->Height() * 4 + 1024);
-  SDL_Surface* s = 0;
-  if (conv->Read(mem)) {
-    MaskType is_mask = conv->IsMask() ? ALPHA_MASK : NO_MASK;
-    if (is_mask == ALPHA_MASK) {
-      int len = conv->Width() * conv->Height();
-      unsigned int* d = (unsigned int*)mem;
-      int i;
-      for (i = 0; i < len; i++) {
-        if ((*d & 0xff000000) != 0xff000000)
-          break;
-        d++;
-      }
-      if (i == len) {
-        is_mask = NO_MASK;
-      }
-    }
-
-    s = newSurfaceFromRGBAData(conv->Width(), conv->Height(), mem, is_mask);
-  }
-  free(mem);
-
-  // Grab the Type-2 information out of the converter or create one
-  // default region if none exist
-  std::vector<SDLSurface::GrpRect> region_table;
-  if (conv->region_table.size()) {
-    std::transform(conv->region_table.begin(),
-                   conv->region_table.end(),
-                   std::back_inserter(region_table),
-                   xclannadRegionToGrpRect);
-  } else {
-    SDLSurface::GrpRect rect;
-    rect.rect = Rect(Point(0, 0), Size(conv->Width(), conv->Height()));
-    rect.originX = 0;
-    rect.originY = 0;
-    region_table.push_back(rect);
-  }
-
-  std::shared_ptr<Surface> surface_to_ret(
-      new SDLSurface(this, s, region_table));
+  std::shared_ptr<DecodedImage> image = DecodeImageFile(filename);
+  std::shared_ptr<Surface> surface_to_ret = BuildSurfaceFromImage(*image);
   // handle tone curve effect loading
   if (short_filename.find("?") != short_filename.npos) {
     std::string effect_no_str =
@@ -639,7 +586,7 @@ std::shared_ptr<const Surface> SDLGraphicsSystem::LoadSurfaceFromFile(
     }
     surface_to_ret.get()->ToneCurve(
         globals().tone_curves.GetEffect(effect_no / 10 - 1),
-        Rect(Point(0, 0), Size(conv->Width(), conv->Height())));
+        Rect(Point(0, 0), image->size));
   }
 
   return surface_to_ret;
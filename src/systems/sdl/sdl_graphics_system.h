@@ -77,6 +77,7 @@ class SDLGraphicsSystem : public GraphicsSystem, public NotificationObserver {
   virtual void AllocateDC(int dc, Size screen_size) override;
   virtual void SetMinimumSizeForDC(int dc, Size size) override;
   virtual void FreeDC(int dc) override;
+  virtual bool IsDCAllocated(int dc) override;
 
   virtual std::shared_ptr<const Surface> LoadSurfaceFromFile(
       const std::string& short_filename) override;
@@ -84,6 +85,8 @@ class SDLGraphicsSystem : public GraphicsSystem, public NotificationObserver {
   virtual std::shared_ptr<Surface> GetHaikei() override;
   virtual std::shared_ptr<Surface> GetDC(int dc) override;
   virtual std::shared_ptr<Surface> BuildSurface(const Size& size) override;
+  virtual std::shared_ptr<Surface> BuildSurfaceFromImage(
+      const DecodedImage& image) override;
 
   virtual ColourFilter* BuildColourFiller() override;
 
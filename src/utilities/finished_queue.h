@@ -0,0 +1,91 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+#ifndef SRC_UTILITIES_FINISHED_QUEUE_H_
+#define SRC_UTILITIES_FINISHED_QUEUE_H_
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "utilities/worker_pool.h"
+
+// Hands the results of jobs run on a WorkerPool back to the interpreter
+// thread. Post() and TakeFinished() are called on the interpreter thread; the
+// job runs on the pool and queues its result under a lock.
+template <typename T>
+class FinishedQueue {
+ public:
+  FinishedQueue() : has_finished_(false) {}
+
+  // Runs |job| on |pool|. Its result is returned by a later TakeFinished().
+  void Post(WorkerPool& pool, std::function<T()> job) {
+    pending_++;
+    pool.PostTask([this, job] {
+      T result = job();
+      std::lock_guard<std::mutex> lock(mutex_);
+      finished_.push_back(std::move(result));
+      has_finished_.store(true, std::memory_order_release);
+    });
+  }
+
+  // Returns the results of every job that has finished since the last call,
+  // in the order they finished. Only takes the lock when there are some.
+  std::vector<T> TakeFinished() {
+    std::vector<T> finished;
+    if (!has_finished_.load(std::memory_order_acquire))
+      return finished;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      finished.swap(finished_);
+      has_finished_.store(false, std::memory_order_relaxed);
+    }
+    pending_ -= finished.size();
+    return finished;
+  }
+
+  // Jobs posted whose results haven't been taken yet.
+  int pending() const { return pending_; }
+
+ private:
+  int pending_ = 0;
+
+  // Results of finished jobs. Guarded by |mutex_|.
+  std::mutex mutex_;
+  std::vector<T> finished_;
+
+  // Whether |finished_| is non-empty, so that the interpreter can check
+  // without taking the lock.
+  std::atomic<bool> has_finished_;
+
+  FinishedQueue(const FinishedQueue&) = delete;
+  FinishedQueue& operator=(const FinishedQueue&) = delete;
+};
+
+#endif  // SRC_UTILITIES_FINISHED_QUEUE_H_
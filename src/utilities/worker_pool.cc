@@ -0,0 +1,93 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+#include "utilities/worker_pool.h"
+
+#include <algorithm>
+#include <utility>
+
+WorkerPool::WorkerPool(int thread_count) {
+  thread_count = std::max(thread_count, 1);
+  threads_.reserve(thread_count);
+  for (int i = 0; i < thread_count; ++i)
+    threads_.emplace_back(&WorkerPool::ThreadMain, this);
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shutting_down_ = true;
+    tasks_.clear();
+  }
+  task_available_.notify_all();
+
+  for (std::thread& thread : threads_)
+    thread.join();
+}
+
+void WorkerPool::PostTask(std::function<void(void)> task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.push_back(std::move(task));
+  }
+  task_available_.notify_one();
+}
+
+void WorkerPool::WaitUntilIdle() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_.wait(lock, [this] { return tasks_.empty() && running_ == 0; });
+}
+
+// static
+int WorkerPool::DefaultThreadCount() {
+  return std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+}
+
+void WorkerPool::ThreadMain() {
+  while (true) {
+    std::function<void(void)> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      task_available_.wait(
+          lock, [this] { return shutting_down_ || !tasks_.empty(); });
+      if (shutting_down_)
+        return;
+
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+      running_++;
+    }
+
+    task();
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      running_--;
+      if (running_ == 0 && tasks_.empty())
+        idle_.notify_all();
+    }
+  }
+}
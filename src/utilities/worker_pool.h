@@ -0,0 +1,84 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+#ifndef SRC_UTILITIES_WORKER_POOL_H_
+#define SRC_UTILITIES_WORKER_POOL_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of background threads that run posted tasks in FIFO order.
+//
+// rlvm is otherwise single threaded; this exists so that expensive work that
+// doesn't touch the RLMachine (decompressing scenarios, decoding images,
+// writing save files) can be moved off of the interpreter thread. Tasks must
+// not throw, and must do their own synchronization with whatever they hand
+// results back to.
+class WorkerPool {
+ public:
+  explicit WorkerPool(int thread_count);
+
+  // Discards all tasks that haven't started yet and joins the worker threads
+  // after they finish whatever they are currently running.
+  ~WorkerPool();
+
+  int thread_count() const { return threads_.size(); }
+
+  // Queues |task| to be run on one of the worker threads.
+  void PostTask(std::function<void(void)> task);
+
+  // Blocks until every posted task has finished running.
+  void WaitUntilIdle();
+
+  // The number of hardware threads, with a floor of one.
+  static int DefaultThreadCount();
+
+ private:
+  void ThreadMain();
+
+  std::mutex mutex_;
+
+  // Signaled when a task is posted or when we're shutting down.
+  std::condition_variable task_available_;
+
+  // Signaled when the last running task finishes and the queue is empty.
+  std::condition_variable idle_;
+
+  std::deque<std::function<void(void)>> tasks_;
+
+  // Number of tasks currently executing on worker threads.
+  int running_ = 0;
+
+  bool shutting_down_ = false;
+
+  std::vector<std::thread> threads_;
+};
+
+#endif  // SRC_UTILITIES_WORKER_POOL_H_
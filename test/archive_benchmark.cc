@@ -0,0 +1,173 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+// -----------------------------------------------------------------------
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "benchmark_utils.h"
+#include "libreallive/archive.h"
+#include "libreallive/compression.h"
+#include "test_utils.h"
+#include "utilities/worker_pool.h"
+
+using libreallive::Archive;
+using namespace libreallive::compression;
+
+namespace {
+
+const int kRounds = 20;
+
+typedef std::vector<std::unique_ptr<Archive>> ArchiveList;
+
+ArchiveList OpenAllArchives(const std::vector<std::string>& seens) {
+  ArchiveList archives;
+  for (const std::string& seen : seens)
+    archives.emplace_back(new Archive(seen));
+  return archives;
+}
+
+void TouchAllScenarios(const ArchiveList& archives) {
+  for (const std::unique_ptr<Archive>& archive : archives) {
+    for (auto const& entry : *archive)
+      archive->GetScenario(entry.first);
+  }
+}
+
+}  // namespace
+
+// Compares the startup cost of the three scenario decoding strategies over
+// every test SEEN. "startup" is how long the interpreter thread is blocked
+// before it can run the first instruction; "total" includes touching every
+// scenario afterwards, which is where lazy decoding pays its cost.
+TEST(ArchiveBenchmark, ScenarioDecodingStartup) {
+  std::vector<std::string> seens = locateAllTestSEENs();
+  const int threads = WorkerPool::DefaultThreadCount();
+
+  double lazy_startup = 0, lazy_total = 0;
+  double serial_startup = 0, serial_total = 0;
+  double parallel_startup = 0, parallel_total = 0;
+  for (int round = 0; round < kRounds; ++round) {
+    {
+      BenchmarkTimer timer;
+      ArchiveList archives = OpenAllArchives(seens);
+      lazy_startup += timer.ElapsedMs();
+      TouchAllScenarios(archives);
+      lazy_total += timer.ElapsedMs();
+    }
+
+    {
+      BenchmarkTimer timer;
+      ArchiveList archives = OpenAllArchives(seens);
+      for (const std::unique_ptr<Archive>& archive : archives)
+        archive->DecodeAllScenarios();
+      serial_startup += timer.ElapsedMs();
+      TouchAllScenarios(archives);
+      serial_total += timer.ElapsedMs();
+    }
+
+    {
+      BenchmarkTimer timer;
+      ArchiveList archives = OpenAllArchives(seens);
+      for (const std::unique_ptr<Archive>& archive : archives)
+        archive->DecodeAllScenariosInBackground(threads);
+      parallel_startup += timer.ElapsedMs();
+      TouchAllScenarios(archives);
+      parallel_total += timer.ElapsedMs();
+    }
+  }
+
+  PrintBenchmarkResult("lazy: startup", lazy_startup / kRounds, "ms");
+  PrintBenchmarkResult("lazy: total", lazy_total / kRounds, "ms");
+  PrintBenchmarkResult("eager serial: startup", serial_startup / kRounds, "ms");
+  PrintBenchmarkResult("eager serial: total", serial_total / kRounds, "ms");
+  PrintBenchmarkResult("eager parallel: startup",
+                       parallel_startup / kRounds, "ms");
+  PrintBenchmarkResult("eager parallel: total",
+                       parallel_total / kRounds, "ms");
+}
+
+// Compares Decompress() with each supported xor implementation against the
+// original byte at a time decoder, over every scenario in the test SEENs.
+TEST(ArchiveBenchmark, DecompressThroughput) {
+  const int kDecompressRounds = 500;
+  ArchiveList archives = OpenAllArchives(locateAllTestSEENs());
+
+  struct Compressed {
+    const char* data;
+    size_t length;
+    size_t decompressed_length;
+  };
+  std::vector<Compressed> inputs;
+  size_t total_bytes = 0;
+  for (const std::unique_ptr<Archive>& archive : archives) {
+    for (auto const& entry : *archive) {
+      const char* data = entry.second.data;
+      Compressed input = {data + libreallive::read_i32(data + 0x20),
+                          static_cast<size_t>(
+                              libreallive::read_i32(data + 0x28)),
+                          static_cast<size_t>(
+                              libreallive::read_i32(data + 0x24))};
+      inputs.push_back(input);
+      total_bytes += input.decompressed_length;
+    }
+  }
+
+  std::vector<char> output;
+  auto run = [&](const std::string& name, bool reference) {
+    BenchmarkTimer timer;
+    for (int round = 0; round < kDecompressRounds; ++round) {
+      for (const Compressed& input : inputs) {
+        output.resize(input.decompressed_length);
+        if (reference) {
+          DecompressReference(input.data, input.length, output.data(),
+                              output.size(), NULL);
+        } else {
+          Decompress(input.data, input.length, output.data(), output.size(),
+                     NULL);
+        }
+      }
+    }
+    double seconds = timer.ElapsedMs() / 1000.0;
+    PrintBenchmarkResult(name, total_bytes * kDecompressRounds /
+                                   (seconds * 1024 * 1024), "MB/s");
+  };
+
+  run("reference", true);
+
+  const char* const kNames[] = {"scalar", "sse2", "avx2"};
+  XorImplementation original = GetXorImplementation();
+  for (int i = XOR_SCALAR; i <= XOR_AVX2; ++i) {
+    XorImplementation implementation = static_cast<XorImplementation>(i);
+    if (!IsXorImplementationSupported(implementation))
+      continue;
+    SetXorImplementation(implementation);
+    run(kNames[i], false);
+  }
+  SetXorImplementation(original);
+}
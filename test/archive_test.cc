@@ -0,0 +1,129 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+
+#include "gtest/gtest.h"
+
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
+
+#include <iterator>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+#include "libreallive/archive.h"
+#include "libreallive/bytecode.h"
+#include "libreallive/defs.h"
+#include "libreallive/scenario.h"
+#include "test_utils.h"
+
+using libreallive::Archive;
+using libreallive::Scenario;
+namespace fs = boost::filesystem;
+
+namespace {
+
+// Checks that |actual| was parsed into the same elements as |expected|.
+void ExpectSameScenario(const Scenario& expected, const Scenario& actual) {
+  ASSERT_EQ(std::distance(expected.begin(), expected.end()),
+            std::distance(actual.begin(), actual.end()));
+
+  Scenario::const_iterator it = actual.begin();
+  for (const libreallive::BytecodeElement* element : expected) {
+    EXPECT_EQ(typeid(*element), typeid(**it));
+    EXPECT_EQ(element->GetBytecodeLength(), (*it)->GetBytecodeLength());
+    ++it;
+  }
+}
+
+}  // namespace
+
+// Every scenario decoded on the worker pool must come out the same as when
+// it's parsed on first access. The scenarios are requested as soon as they're
+// queued, so GetScenario() either claims them or waits on a worker.
+TEST(ArchiveTest, BackgroundDecodingMatchesLazyDecoding) {
+  for (const std::string& seen : locateAllTestSEENs()) {
+    Archive lazy(seen);
+    Archive background(seen);
+    background.DecodeAllScenariosInBackground(2);
+
+    int scenarios = 0;
+    for (auto const& entry : lazy) {
+      Scenario* expected = lazy.GetScenario(entry.first);
+      Scenario* actual = background.GetScenario(entry.first);
+      ASSERT_NE(nullptr, expected) << seen;
+      ASSERT_NE(nullptr, actual) << seen;
+      EXPECT_EQ(expected->scene_number(), actual->scene_number());
+      ExpectSameScenario(*expected, *actual);
+      scenarios++;
+    }
+
+    background.WaitForBackgroundDecoding();
+    Archive::PrefetchStats stats = background.GetPrefetchStats();
+    EXPECT_EQ(scenarios, stats.hits + stats.waits + stats.misses) << seen;
+    EXPECT_EQ(scenarios, background.GetCacheStats().scenarios) << seen;
+  }
+}
+
+// A scenario that fails to parse on a worker reports the error from
+// GetScenario(), like a lazily parsed one does, without being parsed again.
+TEST(ArchiveTest, BackgroundDecodeErrorIsRethrown) {
+  std::string data;
+  {
+    fs::ifstream in(locateTestCase("Module_Jmp_SEEN/farcallTest_0.TXT"),
+                    std::ios::binary);
+    data.assign(std::istreambuf_iterator<char>(in),
+                std::istreambuf_iterator<char>());
+  }
+
+  // Scenario 2 claims to come from an unknown compiler.
+  const int offset = libreallive::read_i32(data.data() + 2 * 8);
+  ASSERT_NE(0, offset);
+  data[offset + 4] = 0x7f;
+
+  fs::path path =
+      fs::temp_directory_path() / fs::unique_path("rlvm-archive-%%%%-%%%%");
+  {
+    fs::ofstream out(path, std::ios::binary);
+    out.write(data.data(), data.size());
+  }
+
+  {
+    Archive archive(path.string());
+    archive.DecodeAllScenariosInBackground(2);
+    archive.WaitForBackgroundDecoding();
+
+    EXPECT_NE(nullptr, archive.GetScenario(1));
+    EXPECT_THROW(archive.GetScenario(2), libreallive::Error);
+    EXPECT_THROW(archive.GetScenario(2), libreallive::Error);
+
+    // Both errors came from the worker's decode.
+    Archive::PrefetchStats stats = archive.GetPrefetchStats();
+    EXPECT_EQ(0, stats.misses);
+  }
+  fs::remove(path);
+}
@@ -0,0 +1,111 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+// -----------------------------------------------------------------------
+
+#ifndef TEST_BENCHMARK_UTILS_H_
+#define TEST_BENCHMARK_UTILS_H_
+
+#include <chrono>
+#include <cstddef>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+// Wall clock timer for the benchmarks in rlvm_benchmarks.
+class BenchmarkTimer {
+ public:
+  BenchmarkTimer() : start_(std::chrono::steady_clock::now()) {}
+
+  // Milliseconds since construction.
+  double ElapsedMs() const {
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start_).count();
+  }
+
+ private:
+  std::chrono::steady_clock::time_point start_;
+};
+
+// CPU time used by the calling thread, for timing work on one thread while
+// others compete with it for the same cores.
+class ThreadCpuTimer {
+ public:
+  ThreadCpuTimer() : start_(Now()) {}
+
+  // Milliseconds of this thread's CPU time since construction.
+  double ElapsedMs() const { return Now() - start_; }
+
+ private:
+  static double Now() {
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+  }
+
+  double start_;
+};
+
+// Heap allocations made by the whole process so far. These are counted by the
+// replacement global operator new in rlvm_benchmarks.cc, so they're only
+// available in the benchmark binary.
+struct AllocationCounts {
+  // Number and total size of allocations.
+  size_t count;
+  size_t bytes;
+
+  // Bytes allocated but not yet freed.
+  size_t live_bytes;
+};
+AllocationCounts GetAllocationCounts();
+
+// Allocations made between construction and the call to Get().
+class AllocationCounter {
+ public:
+  AllocationCounter() : start_(GetAllocationCounts()) {}
+
+  AllocationCounts Get() const {
+    AllocationCounts now = GetAllocationCounts();
+    AllocationCounts out = {now.count - start_.count,
+                            now.bytes - start_.bytes,
+                            now.live_bytes - start_.live_bytes};
+    return out;
+  }
+
+ private:
+  AllocationCounts start_;
+};
+
+// Prints one row of benchmark output in a format that's easy to grep.
+inline void PrintBenchmarkResult(const std::string& name,
+                                 double value,
+                                 const std::string& unit) {
+  std::cout << "[ BENCH    ] " << std::left << std::setw(48) << name
+            << std::right << std::fixed << std::setprecision(3)
+            << std::setw(14) << value << " " << unit << std::endl;
+}
+
+#endif  // TEST_BENCHMARK_UTILS_H_
@@ -0,0 +1,353 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+
+#include <forward_list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "benchmark_utils.h"
+#include "libreallive/arena.h"
+#include "libreallive/archive.h"
+#include "libreallive/bytecode.h"
+#include "libreallive/compression.h"
+#include "libreallive/expression.h"
+#include "libreallive/intmemref.h"
+#include "libreallive/scenario.h"
+#include "machine/rlmachine.h"
+#include "test_system/test_system.h"
+#include "test_utils.h"
+
+using namespace libreallive;
+
+namespace {
+
+const int kWalkRounds = 200;
+const int kParseRounds = 200;
+const int kExpressionRounds = 20000;
+
+// The decompressed bytecode and kidoku table of one scenario, so both
+// storage layouts can be built from exactly the same input.
+struct RawScript {
+  std::vector<char> bytecode;
+  std::vector<unsigned long> kidoku_table;
+};
+
+std::vector<RawScript> ReadRawScripts(const std::vector<std::string>& seens) {
+  std::vector<RawScript> out;
+  for (const std::string& seen : seens) {
+    Archive archive(seen);
+    for (auto const& entry : archive) {
+      const char* data = entry.second.data;
+      Header header(data, entry.second.length);
+      if (header.use_xor_2_)
+        continue;
+
+      RawScript raw;
+      const int kidoku_offs = read_i32(data + 0x08);
+      const size_t kidoku_length = read_i32(data + 0x0c);
+      for (size_t i = 0; i < kidoku_length; ++i)
+        raw.kidoku_table.push_back(read_i32(data + kidoku_offs + i * 4));
+
+      raw.bytecode.resize(read_i32(data + 0x24));
+      compression::Decompress(data + read_i32(data + 0x20),
+                              read_i32(data + 0x28),
+                              raw.bytecode.data(),
+                              raw.bytecode.size(),
+                              NULL);
+      out.push_back(std::move(raw));
+    }
+  }
+  return out;
+}
+
+std::vector<RawScript> ReadAllRawScripts() {
+  return ReadRawScripts(locateAllTestSEENs());
+}
+
+// Calls |callback| with every element of |raw| in order, allocating them
+// through |arena| if it's non-NULL.
+template <typename Callback>
+void ReadElements(const RawScript& raw, Arena* arena, Callback callback) {
+  ConstructionData cdata(raw.kidoku_table.size(), arena);
+  cdata.kidoku_table = raw.kidoku_table;
+
+  const char* stream = raw.bytecode.data();
+  const char* end = stream + raw.bytecode.size();
+  while (stream < end) {
+    BytecodeElement* element = BytecodeElement::Read(stream, end, cdata);
+    callback(element);
+    size_t l = element->GetBytecodeLength();
+    stream += l ? l : 1;
+  }
+}
+
+// The previous layout: one heap allocation per element, linked together.
+typedef std::forward_list<std::unique_ptr<BytecodeElement>> ElementList;
+
+// The current layout: elements packed into an Arena, indexed by a vector.
+struct PackedElements {
+  Arena arena;
+  std::vector<BytecodeElement*> elements;
+
+  ~PackedElements() {
+    for (BytecodeElement* element : elements)
+      element->~BytecodeElement();
+  }
+};
+
+// Stands in for the dispatch loop: visit every element in order and make one
+// virtual call on it.
+template <typename Container>
+size_t WalkElements(const Container& elements) {
+  size_t total = 0;
+  for (int round = 0; round < kWalkRounds; ++round) {
+    for (auto const& element : elements)
+      total += element->GetBytecodeLength();
+  }
+  return total;
+}
+
+// One integer expression from the bytecode, both as the parser's tree and
+// compiled.
+struct ExpressionPair {
+  ExpressionPiece tree;
+  ExpressionPiece compiled;
+};
+
+// Reparses every expression statement and integer command parameter in
+// |raw|, keeping the ones that compile.
+void CollectExpressions(const RawScript& raw,
+                        std::vector<ExpressionPair>* out) {
+  std::vector<std::unique_ptr<BytecodeElement>> elements;
+  const char* stream = raw.bytecode.data();
+  ReadElements(raw, NULL, [&](BytecodeElement* element) {
+    elements.emplace_back(element);
+    std::vector<std::string> sources;
+    if (dynamic_cast<ExpressionElement*>(element)) {
+      sources.push_back(std::string(stream, element->GetBytecodeLength()));
+    } else if (CommandElement* command =
+                   dynamic_cast<CommandElement*>(element)) {
+      sources = command->GetUnparsedParameters();
+    }
+    size_t l = element->GetBytecodeLength();
+    stream += l ? l : 1;
+
+    for (const std::string& source : sources) {
+      const char* src = source.c_str();
+      ExpressionPiece tree = dynamic_cast<ExpressionElement*>(element)
+                                 ? GetAssignment(src)
+                                 : GetData(src);
+      ExpressionPiece compiled(tree);
+      compiled.Compile();
+      if (compiled.IsCompiled())
+        out->push_back(ExpressionPair{std::move(tree), std::move(compiled)});
+    }
+  });
+}
+
+// Evaluates every expression kExpressionRounds times, returning the elapsed
+// milliseconds.
+double EvaluateExpressions(const std::vector<ExpressionPair>& expressions,
+                           bool compiled,
+                           RLMachine& machine) {
+  BenchmarkTimer timer;
+  for (int round = 0; round < kExpressionRounds; ++round) {
+    for (const ExpressionPair& pair : expressions)
+      (compiled ? pair.compiled : pair.tree).GetIntegerValue(machine);
+  }
+  return timer.ElapsedMs();
+}
+
+void PrintAllocations(const std::string& name, const AllocationCounts& counts) {
+  PrintBenchmarkResult(name + ": allocations", counts.count, "");
+  PrintBenchmarkResult(name + ": heap in use", counts.live_bytes / 1024.0,
+                       "KiB");
+}
+
+}  // namespace
+
+// Compares building and walking every test scenario as a forward_list of
+// individually allocated elements against the arena-backed vector that Script
+// now uses.
+TEST(BytecodeBenchmark, ElementStorage) {
+  std::vector<RawScript> scripts = ReadAllRawScripts();
+  size_t bytecode_size = 0;
+  for (const RawScript& raw : scripts)
+    bytecode_size += raw.bytecode.size();
+
+  size_t element_count = 0;
+  size_t list_walked = 0, packed_walked = 0;
+  double list_build_ms, list_walk_ms, packed_build_ms, packed_walk_ms;
+  AllocationCounts list_allocations, packed_allocations;
+  size_t arena_reserved = 0, arena_used = 0;
+
+  {
+    std::vector<ElementList> lists(scripts.size());
+    AllocationCounter counter;
+    BenchmarkTimer timer;
+    for (size_t i = 0; i < scripts.size(); ++i) {
+      ElementList::iterator it = lists[i].before_begin();
+      ReadElements(scripts[i], NULL, [&](BytecodeElement* element) {
+        it = lists[i].emplace_after(it, element);
+        element_count++;
+      });
+    }
+    list_build_ms = timer.ElapsedMs();
+    list_allocations = counter.Get();
+
+    BenchmarkTimer walk_timer;
+    for (const ElementList& list : lists)
+      list_walked += WalkElements(list);
+    list_walk_ms = walk_timer.ElapsedMs();
+  }
+
+  {
+    std::vector<std::unique_ptr<PackedElements>> packed;
+    AllocationCounter counter;
+    BenchmarkTimer timer;
+    for (const RawScript& raw : scripts) {
+      packed.emplace_back(new PackedElements);
+      PackedElements* p = packed.back().get();
+      p->arena.Reserve(raw.bytecode.size() * 4);
+      ReadElements(raw, &p->arena, [&](BytecodeElement* element) {
+        p->elements.push_back(element);
+      });
+      p->elements.shrink_to_fit();
+    }
+    packed_build_ms = timer.ElapsedMs();
+    packed_allocations = counter.Get();
+
+    for (const std::unique_ptr<PackedElements>& p : packed) {
+      arena_reserved += p->arena.bytes_reserved();
+      arena_used += p->arena.bytes_used();
+    }
+
+    BenchmarkTimer walk_timer;
+    for (const std::unique_ptr<PackedElements>& p : packed)
+      packed_walked += WalkElements(p->elements);
+    packed_walk_ms = walk_timer.ElapsedMs();
+  }
+
+  EXPECT_EQ(list_walked, packed_walked);
+
+  PrintBenchmarkResult("scenarios", scripts.size(), "");
+  PrintBenchmarkResult("elements", element_count, "");
+  PrintBenchmarkResult("bytecode", bytecode_size / 1024.0, "KiB");
+  PrintBenchmarkResult("forward_list: build", list_build_ms, "ms");
+  PrintAllocations("forward_list", list_allocations);
+  PrintBenchmarkResult("forward_list: walk", list_walk_ms, "ms");
+  PrintBenchmarkResult("arena: build", packed_build_ms, "ms");
+  PrintAllocations("arena", packed_allocations);
+  PrintBenchmarkResult("arena: reserved", arena_reserved / 1024.0, "KiB");
+  PrintBenchmarkResult("arena: used", arena_used / 1024.0, "KiB");
+  PrintBenchmarkResult("arena: walk", packed_walk_ms, "ms");
+}
+
+// Parses every test scenario with each element and its strings on the heap,
+// and again with everything in a per-script Arena, which is what Script does.
+TEST(BytecodeBenchmark, ParseAllScenarios) {
+  std::vector<RawScript> scripts = ReadAllRawScripts();
+
+  AllocationCounter heap_counter;
+  BenchmarkTimer heap_timer;
+  for (int round = 0; round < kParseRounds; ++round) {
+    for (const RawScript& raw : scripts) {
+      std::vector<std::unique_ptr<BytecodeElement>> elements;
+      ReadElements(raw, NULL, [&](BytecodeElement* element) {
+        elements.emplace_back(element);
+      });
+    }
+  }
+  double heap_ms = heap_timer.ElapsedMs();
+  AllocationCounts heap_allocations = heap_counter.Get();
+
+  AllocationCounter arena_counter;
+  BenchmarkTimer arena_timer;
+  for (int round = 0; round < kParseRounds; ++round) {
+    for (const RawScript& raw : scripts) {
+      PackedElements packed;
+      packed.arena.Reserve(raw.bytecode.size() * 4);
+      ReadElements(raw, &packed.arena, [&](BytecodeElement* element) {
+        packed.elements.push_back(element);
+      });
+    }
+  }
+  double arena_ms = arena_timer.ElapsedMs();
+  AllocationCounts arena_allocations = arena_counter.Get();
+
+  PrintBenchmarkResult("heap: parse", heap_ms / kParseRounds, "ms");
+  PrintBenchmarkResult("heap: allocations per parse",
+                       heap_allocations.count / kParseRounds, "");
+  PrintBenchmarkResult("arena: parse", arena_ms / kParseRounds, "ms");
+  PrintBenchmarkResult("arena: allocations per parse",
+                       arena_allocations.count / kParseRounds, "");
+}
+
+// Evaluates the expressions in test/ExpressionTest_SEEN by walking the parsed
+// tree and by running the compiled postfix program, which is what
+// ExpressionElement and the cached command parameters now do.
+TEST(BytecodeBenchmark, ExpressionEvaluation) {
+  const std::vector<std::string> seens = {
+      locateTestCase("ExpressionTest_SEEN/basicOperators.TXT"),
+      locateTestCase("ExpressionTest_SEEN/comparisonOperators.TXT"),
+      locateTestCase("ExpressionTest_SEEN/logicalOperators.TXT"),
+      locateTestCase("ExpressionTest_SEEN/previousErrors.TXT")};
+  std::vector<ExpressionPair> expressions;
+  for (const RawScript& raw : ReadRawScripts(seens))
+    CollectExpressions(raw, &expressions);
+  ASSERT_FALSE(expressions.empty());
+
+  libreallive::Archive arc(seens[0]);
+  TestSystem tree_system, compiled_system;
+  RLMachine tree_machine(tree_system, arc);
+  RLMachine compiled_machine(compiled_system, arc);
+  double tree_ms = EvaluateExpressions(expressions, false, tree_machine);
+  double compiled_ms =
+      EvaluateExpressions(expressions, true, compiled_machine);
+
+  // Both machines must have ended up in the same state.
+  EXPECT_EQ(tree_machine.store_register(), compiled_machine.store_register());
+  for (char bank : std::string("ABCDEFGZ")) {
+    for (int i = 0; i < 100; ++i) {
+      EXPECT_EQ(tree_machine.GetIntValue(IntMemRef(bank, i)),
+                compiled_machine.GetIntValue(IntMemRef(bank, i)))
+          << "int" << bank << "[" << i << "]";
+    }
+  }
+
+  double evaluations = double(expressions.size()) * kExpressionRounds;
+  PrintBenchmarkResult("expressions", expressions.size(), "");
+  PrintBenchmarkResult("tree: evaluate", tree_ms, "ms");
+  PrintBenchmarkResult("tree: per expression",
+                       tree_ms * 1e6 / evaluations, "ns");
+  PrintBenchmarkResult("compiled: evaluate", compiled_ms, "ms");
+  PrintBenchmarkResult("compiled: per expression",
+                       compiled_ms * 1e6 / evaluations, "ns");
+  PrintBenchmarkResult("speedup", tree_ms / compiled_ms, "x");
+}
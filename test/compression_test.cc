@@ -0,0 +1,170 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "libreallive/archive.h"
+#include "libreallive/compression.h"
+#include "libreallive/scenario.h"
+
+#include "test_utils.h"
+
+using namespace libreallive;
+using namespace libreallive::compression;
+
+namespace {
+
+const XorImplementation kAllImplementations[] = {XOR_SCALAR, XOR_SSE2,
+                                                 XOR_AVX2};
+
+// Decompresses |compressed| with each supported xor implementation and
+// checks the output against DecompressReference().
+void CheckImplementations(const char* compressed,
+                          size_t compressed_length,
+                          size_t length,
+                          const XorKey* per_game_xor_key,
+                          const std::string& description) {
+  std::vector<char> expected(length);
+  DecompressReference(compressed, compressed_length, expected.data(), length,
+                      per_game_xor_key);
+
+  XorImplementation original = GetXorImplementation();
+  for (XorImplementation implementation : kAllImplementations) {
+    if (!IsXorImplementationSupported(implementation))
+      continue;
+
+    SetXorImplementation(implementation);
+    std::vector<char> actual(length);
+    Decompress(compressed, compressed_length, actual.data(), length,
+               per_game_xor_key);
+    EXPECT_TRUE(expected == actual) << "Mismatch in " << description
+                                    << " with xor implementation "
+                                    << implementation;
+  }
+  SetXorImplementation(original);
+}
+
+// Runs CheckImplementations() over every scenario in the test SEENs.
+void CheckAgainstReference(const XorKey* per_game_xor_key) {
+  int scenarios = 0;
+  for (const std::string& seen : locateAllTestSEENs()) {
+    Archive archive(seen);
+    for (auto const& entry : archive) {
+      const char* data = entry.second.data;
+      CheckImplementations(data + read_i32(data + 0x20),
+                           read_i32(data + 0x28), read_i32(data + 0x24),
+                           per_game_xor_key,
+                           seen + " scenario " + std::to_string(entry.first));
+      scenarios++;
+    }
+  }
+
+  EXPECT_LT(0, scenarios);
+}
+
+// Builds compressed data, scrambled like a scenario's, of at least
+// |min_length| bytes after the eight byte header. Flag bytes mix literals and
+// back references of every length. The data ends on a whole item at a length
+// that isn't a multiple of 16, so the vector xor passes finish on a scalar
+// tail. Returns the decompressed length in |length|.
+std::vector<char> BuildCompressedData(size_t min_length, size_t* length) {
+  std::vector<char> plain(8, 0);
+  size_t output = 0;
+  unsigned int random = 12345;
+  while (plain.size() - 8 < min_length || (plain.size() - 8) % 16 == 0) {
+    random = random * 1103515245 + 12345;
+    unsigned char flag = output == 0 ? 0xff : (random >> 16) & 0xff;
+    plain.push_back(flag);
+    for (int bit = 1; bit != 256; bit <<= 1) {
+      random = random * 1103515245 + 12345;
+      if (flag & bit) {
+        plain.push_back((random >> 16) & 0xff);
+        output++;
+      } else {
+        size_t distance = 1 + (random >> 8) % std::min<size_t>(output, 4095);
+        size_t count = (random >> 20) & 0x0f;
+        int encoded = (distance << 4) | count;
+        plain.push_back(encoded & 0xff);
+        plain.push_back((encoded >> 8) & 0xff);
+        output += count + 2;
+      }
+
+      if (plain.size() - 8 >= min_length && (plain.size() - 8) % 16 != 0)
+        break;
+    }
+  }
+
+  for (size_t i = 8; i < plain.size(); ++i)
+    plain[i] ^= xor_mask[i & 0xff];
+  *length = output;
+  return plain;
+}
+
+}  // namespace
+
+TEST(CompressionTest, MatchesReference) {
+  CheckAgainstReference(NULL);
+}
+
+// None of the test SEENs use a per-game key, but the second xor pass doesn't
+// care whether the key is the right one.
+TEST(CompressionTest, MatchesReferenceWithPerGameKey) {
+  CheckAgainstReference(little_busters_xor_mask);
+}
+
+// The test SEENs are all too short for the AVX2 xor pass (see
+// kMinAVX2Length in compression.cc), so this builds a scenario that isn't. The
+// per-game key covers all of the output, starting at an odd offset.
+TEST(CompressionTest, MatchesReferenceOnLongInput) {
+  size_t length = 0;
+  std::vector<char> compressed = BuildCompressedData(4096 + 100, &length);
+  ASSERT_LE(4096u + 100, compressed.size() - 8);
+  ASSERT_NE(0u, (compressed.size() - 8) % 16);
+
+  const XorKey whole_output_key[] = {
+      {{0x01, 0x23, 0x45, 0x67, 0x09, 0x2b, 0x4d, 0x6f, 0x10, 0x32, 0x54, 0x76,
+        0x18, 0x3a, 0x5c, 0x7e},
+       3,
+       static_cast<int>(length)},
+      {{0x0}, -1, -1}};
+  ASSERT_LE(4096u + 3, length);
+
+  CheckImplementations(compressed.data(), compressed.size(), length, NULL,
+                       "long synthetic scenario");
+  CheckImplementations(compressed.data(), compressed.size(), length,
+                       whole_output_key,
+                       "long synthetic scenario with a per-game key");
+}
+
+TEST(CompressionTest, ScalarIsAlwaysSupported) {
+  EXPECT_TRUE(IsXorImplementationSupported(XOR_SCALAR));
+  EXPECT_TRUE(IsXorImplementationSupported(GetXorImplementation()));
+}
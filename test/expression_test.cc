@@ -28,6 +28,7 @@
 #include "gtest/gtest.h"
 
 #include "libreallive/archive.h"
+#include "libreallive/arena.h"
 #include "libreallive/expression.h"
 #include "libreallive/intmemref.h"
 #include "machine/rlmachine.h"
@@ -148,3 +149,114 @@ TEST(ExpressionTest, ParseQuotedEnglishString) {
 
   ASSERT_EQ(16, libreallive::NextString(s.c_str()));
 }
+
+namespace {
+
+// Helpers for writing expression bytecode by hand.
+string Int(int value) {
+  string s("$\xff");
+  for (int i = 0; i < 4; ++i)
+    s.push_back(static_cast<char>((value >> (i * 8)) & 0xff));
+  return s;
+}
+
+string Ref(int type, const string& location) {
+  return string("$") + static_cast<char>(type) + "[" + location + "]";
+}
+
+string Op(int op) { return string("\\") + static_cast<char>(op); }
+
+const string kStoreRegister("$\xc8");
+
+}  // namespace
+
+// Every expression the compiler accepts has to behave exactly like the tree
+// walker, including the assignment side effects and division by zero.
+TEST(ExpressionTest, CompiledMatchesTreeWalk) {
+  const string a0 = Ref(0, Int(0)), a1 = Ref(0, Int(1)), a2 = Ref(0, Int(2)),
+               a3 = Ref(0, Int(3)), a4 = Ref(0, Int(4)), a5 = Ref(0, Int(5));
+  const vector<string> expressions = {
+      // intA[intA[0]] += intA[1] * -intA[2]
+      Ref(0, a0) + Op(0x14) + a1 + Op(0x02) + Op(0x01) + a2,
+      // intB[intA[3] + 1] = (intA[0] == 3) || (intA[1] < intA[2])
+      Ref(1, a3 + Op(0x00) + Int(1)) + Op(0x1e) + "(" + a0 + Op(0x28) +
+          Int(3) + ")" + Op(0x3d) + "(" + a1 + Op(0x2b) + a2 + ")",
+      // store = intA[4] << 2 ^ intA[1]
+      kStoreRegister + Op(0x1e) + a4 + Op(0x08) + Int(2) + Op(0x07) + a1,
+      // intA[4] /= intA[5], where intA[5] is 0
+      a4 + Op(0x17) + a5,
+      // intA[intA[3]] %= intA[5] + intA[1]
+      Ref(0, a3) + Op(0x18) + a5 + Op(0x00) + a1,
+      // intB[2] = intA[0] && intA[5] != -4
+      Ref(1, Int(2)) + Op(0x1e) + a0 + Op(0x3c) + a5 + Op(0x29) + Op(0x01) +
+          Int(4),
+      // store -= intA[2] >> 1 - -(3 * 2)
+      kStoreRegister + Op(0x15) + a2 + Op(0x09) + Int(1) + Op(0x01) +
+          Op(0x01) + "(" + Int(3) + Op(0x02) + Int(2) + ")",
+  };
+  const int seed[] = {3, 7, -2, 1, 9, 0};
+
+  for (const string& expression : expressions) {
+    const char* src = expression.c_str();
+    ExpressionPiece tree = GetAssignment(src);
+    ExpressionPiece compiled(tree);
+    compiled.Compile();
+    ASSERT_FALSE(tree.IsCompiled());
+    ASSERT_TRUE(compiled.IsCompiled()) << tree.GetDebugString();
+
+    TestSystem tree_system, compiled_system;
+    libreallive::Archive arc(
+        locateTestCase("ExpressionTest_SEEN/basicOperators.TXT"));
+    RLMachine tree_machine(tree_system, arc);
+    RLMachine compiled_machine(compiled_system, arc);
+    for (int i = 0; i < 6; ++i) {
+      tree_machine.SetIntValue(IntMemRef('A', i), seed[i]);
+      compiled_machine.SetIntValue(IntMemRef('A', i), seed[i]);
+    }
+
+    EXPECT_EQ(tree.GetIntegerValue(tree_machine),
+              compiled.GetIntegerValue(compiled_machine))
+        << tree.GetDebugString();
+    EXPECT_EQ(tree_machine.store_register(),
+              compiled_machine.store_register())
+        << tree.GetDebugString();
+    for (int i = 0; i < 10; ++i) {
+      EXPECT_EQ(tree_machine.GetIntValue(IntMemRef('A', i)),
+                compiled_machine.GetIntValue(IntMemRef('A', i)))
+          << "intA[" << i << "] after " << tree.GetDebugString();
+      EXPECT_EQ(tree_machine.GetIntValue(IntMemRef('B', i)),
+                compiled_machine.GetIntValue(IntMemRef('B', i)))
+          << "intB[" << i << "] after " << tree.GetDebugString();
+    }
+  }
+}
+
+// Parsing into an arena must build the same tree as parsing onto the heap,
+// and copies of an arena parsed tree must survive the arena.
+TEST(ExpressionTest, ArenaParseMatchesHeapParse) {
+  const string a0 = Ref(0, Int(0)), a1 = Ref(0, Int(1));
+  const vector<string> expressions = {
+      // intA[intA[0]] += intA[1] * -intA[2]
+      Ref(0, a0) + Op(0x14) + a1 + Op(0x02) + Op(0x01) + Ref(0, Int(2)),
+      // store = (intA[0] == 3) || !intA[1]
+      kStoreRegister + Op(0x1e) + "(" + a0 + Op(0x28) + Int(3) + ")" +
+          Op(0x3d) + a1 + Op(0x28) + Int(0),
+  };
+
+  for (const string& expression : expressions) {
+    const char* heap_src = expression.c_str();
+    ExpressionPiece heap_tree = GetAssignment(heap_src);
+
+    std::unique_ptr<Arena> arena(new Arena);
+    const char* arena_src = expression.c_str();
+    ExpressionPiece arena_tree = GetAssignment(arena_src, arena.get());
+    EXPECT_EQ(heap_src, arena_src);
+    EXPECT_EQ(heap_tree.GetDebugString(), arena_tree.GetDebugString());
+    EXPECT_LT(0u, arena->bytes_used());
+
+    ExpressionPiece copy(arena_tree);
+    arena_tree = ExpressionPiece::IntConstant(0);
+    arena.reset();
+    EXPECT_EQ(heap_tree.GetDebugString(), copy.GetDebugString());
+  }
+}
@@ -0,0 +1,257 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+#include "gtest/gtest.h"
+
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
+
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "systems/base/g00_decoder.h"
+#include "systems/base/image_decoder.h"
+#include "test_utils.h"
+#include "xclannad/file.h"
+
+namespace fs = boost::filesystem;
+
+namespace {
+
+const G00Implementation kAllImplementations[] = {G00_SCALAR, G00_SSSE3,
+                                                 G00_AVX2};
+
+// Runs of one to |max_run| noisy pixels. With runs of one, every group of
+// eight is literals; longer runs mix in back references. |alpha| is or-ed
+// into every pixel.
+std::vector<int> MakePixels(int count,
+                            unsigned int seed,
+                            int alpha,
+                            int max_run = 8) {
+  std::vector<int> pixels;
+  while (pixels.size() < static_cast<size_t>(count)) {
+    seed = seed * 1103515245 + 12345;
+    int run = 1 + (seed >> 8) % max_run;
+    int colour = ((seed >> 4) & 0xffffff) | alpha;
+    for (int i = 0; i < run; ++i)
+      pixels.push_back(colour);
+  }
+  pixels.resize(count);
+  return pixels;
+}
+
+G00Part MakePart(int x, int y, int width, int height, unsigned int seed) {
+  G00Part part = {x, y, width, height,
+                  MakePixels(width * height, seed, 0x80000000)};
+  return part;
+}
+
+class G00DecoderTest : public ::testing::Test {
+ protected:
+  G00DecoderTest()
+      : directory(fs::temp_directory_path() /
+                  fs::unique_path("rlvm-g00-%%%%-%%%%")),
+        original(GetG00Implementation()) {
+    fs::create_directories(directory);
+  }
+
+  ~G00DecoderTest() {
+    SetG00Implementation(original);
+    fs::remove_all(directory);
+  }
+
+  std::string Path(const std::string& name) {
+    return (directory / name).string();
+  }
+
+  // Decodes |name| with GRPCONV, then under each supported implementation
+  // both with DecodeImageFile() and on an ImageDecoder's pool, and checks
+  // that the pixels and transparency match.
+  void CheckAgainstGRPCONV(const std::string& name) {
+    fs::ifstream stream(Path(name), std::ios::binary);
+    std::vector<char> data((std::istreambuf_iterator<char>(stream)),
+                           std::istreambuf_iterator<char>());
+    size_t size = data.size();
+    data.push_back(0);
+    std::unique_ptr<GRPCONV> conv(
+        GRPCONV::AssignConverter(data.data(), size, "???"));
+    ASSERT_TRUE(conv != nullptr);
+
+    size_t bytes = conv->Width() * conv->Height() * 4;
+    std::vector<char> expected(bytes + 1024);
+    ASSERT_TRUE(conv->Read(expected.data()));
+    bool expected_mask = false;
+    for (size_t i = 0; conv->IsMask() && i < bytes; i += 4)
+      expected_mask |= static_cast<unsigned char>(expected[i + 3]) != 0xff;
+
+    ImageDecoder decoder(2);
+    int implementations = 0;
+    for (G00Implementation implementation : kAllImplementations) {
+      if (!IsG00ImplementationSupported(implementation))
+        continue;
+
+      SetG00Implementation(implementation);
+      ImageDecoder::Pixels pixels;
+      decoder.Decode(Path(name), &pixels);
+      std::shared_ptr<const DecodedImage> images[] = {
+          DecodeImageFile(Path(name)), decoder.Wait(pixels)};
+      for (const std::shared_ptr<const DecodedImage>& image : images) {
+        ASSERT_TRUE(image->pixels != nullptr) << "with implementation "
+                                           << implementation;
+        EXPECT_EQ(0, memcmp(expected.data(), image->pixels.get(), bytes))
+            << "Mismatch in " << name << " with implementation "
+            << implementation;
+        EXPECT_EQ(expected_mask, image->is_mask)
+            << "Mismatch in " << name << " with implementation "
+            << implementation;
+      }
+      implementations++;
+    }
+    EXPECT_LT(0, implementations);
+  }
+
+  fs::path directory;
+  G00Implementation original;
+};
+
+}  // namespace
+
+TEST_F(G00DecoderTest, ScalarIsAlwaysSupported) {
+  EXPECT_TRUE(IsG00ImplementationSupported(G00_SCALAR));
+  EXPECT_TRUE(IsG00ImplementationSupported(GetG00Implementation()));
+}
+
+TEST_F(G00DecoderTest, Type0MatchesGRPCONV) {
+  // An odd width, so rows don't line up with groups of eight pixels.
+  WriteType0G00(Path("cg.g00"), 203, 117, MakePixels(203 * 117, 1, 0));
+  CheckAgainstGRPCONV("cg.g00");
+}
+
+TEST_F(G00DecoderTest, Type0NoiseMatchesGRPCONV) {
+  // Nothing but groups of eight literals, which the vector expanders take.
+  WriteType0G00(Path("noise.g00"), 99, 50, MakePixels(99 * 50, 11, 0, 1));
+  CheckAgainstGRPCONV("noise.g00");
+}
+
+TEST_F(G00DecoderTest, Type0SolidColourMatchesGRPCONV) {
+  // Nothing but overlapping back references after the first pixel.
+  WriteType0G00(Path("solid.g00"), 64, 48, std::vector<int>(64 * 48, 0x336699));
+  CheckAgainstGRPCONV("solid.g00");
+}
+
+TEST_F(G00DecoderTest, Type0TinyImageMatchesGRPCONV) {
+  // Too short for the vector expanders to ever run.
+  WriteType0G00(Path("tiny.g00"), 3, 2, MakePixels(6, 2, 0));
+  CheckAgainstGRPCONV("tiny.g00");
+}
+
+TEST_F(G00DecoderTest, Type1MatchesGRPCONV) {
+  std::vector<int> palette;
+  for (int i = 0; i < 200; ++i)
+    palette.push_back(0xff000000 | (i * 0x010305));
+  std::vector<unsigned char> indices;
+  for (int colour : MakePixels(97 * 61, 3, 0))
+    indices.push_back(colour % palette.size());
+
+  WriteType1G00(Path("paletted.g00"), 97, 61, palette, indices);
+  CheckAgainstGRPCONV("paletted.g00");
+}
+
+TEST_F(G00DecoderTest, Type2SpriteSheetMatchesGRPCONV) {
+  // Regions of different sizes with several parts each, one with no parts at
+  // all, and gaps between them that stay transparent.
+  std::vector<G00Region> regions = {
+      {0, 0, 63, 63, {MakePart(0, 0, 64, 32, 4), MakePart(8, 32, 40, 32, 5)}},
+      {64, 0, 127, 63, {MakePart(3, 5, 57, 51, 6)}},
+      {0, 64, 31, 95, {}},
+      {32, 64, 126, 99, {MakePart(0, 0, 95, 36, 7), MakePart(90, 30, 5, 6, 8)}},
+  };
+  WriteType2G00(Path("sheet.g00"), 128, 100, regions);
+  CheckAgainstGRPCONV("sheet.g00");
+}
+
+TEST_F(G00DecoderTest, Type2LargeSheetMatchesGRPCONV) {
+  // Sixteen full 128x128 cells, so the stream has to be decompressed a
+  // block at a time well past its first buffer's worth.
+  std::vector<G00Region> regions;
+  for (int i = 0; i < 16; ++i) {
+    int x = (i % 4) * 128;
+    int y = (i / 4) * 128;
+    regions.push_back(
+        {x, y, x + 127, y + 127, {MakePart(0, 0, 128, 128, 20 + i)}});
+  }
+  WriteType2G00(Path("large.g00"), 512, 512, regions);
+  CheckAgainstGRPCONV("large.g00");
+}
+
+TEST_F(G00DecoderTest, Type2OverlappingRegionsMatchGRPCONV) {
+  // The second and third regions cover the same pixels, and the third has to
+  // end up on top.
+  std::vector<G00Region> regions = {
+      {0, 0, 127, 127, {MakePart(0, 0, 128, 128, 40)}},
+      {128, 0, 255, 127, {MakePart(0, 0, 128, 128, 41)}},
+      {128, 0, 255, 127, {MakePart(0, 0, 128, 128, 42)}},
+  };
+  WriteType2G00(Path("overlap.g00"), 256, 128, regions);
+  CheckAgainstGRPCONV("overlap.g00");
+}
+
+TEST_F(G00DecoderTest, Type2OpaqueImageMatchesGRPCONV) {
+  // A single part covering the whole image with no transparent pixels, which
+  // isn't treated as a mask.
+  G00Part part = {0, 0, 40, 30, MakePixels(40 * 30, 9, 0xff000000)};
+  WriteType2G00(Path("opaque.g00"), 40, 30, {{0, 0, 39, 29, {part}}});
+  CheckAgainstGRPCONV("opaque.g00");
+}
+
+TEST_F(G00DecoderTest, Type2StackedFramesMatchGRPCONV) {
+  // Every region covers the whole image, so GRPCONV stacks them into one
+  // canvas three times as tall.
+  std::vector<G00Region> regions;
+  for (int i = 0; i < 3; ++i)
+    regions.push_back({0, 0, 31, 23, {MakePart(0, 0, 32, 24, 10 + i)}});
+  WriteType2G00(Path("frames.g00"), 32, 24, regions);
+  CheckAgainstGRPCONV("frames.g00");
+}
+
+TEST_F(G00DecoderTest, RejectsBackReferenceBeforeStart) {
+  // A type 0 image whose first item refers back five pixels.
+  const char data[] = {0,  2, 0, 2, 0, 11, 0, 0, 0,
+                       12, 0, 0, 0, 0, 0x50, 0};
+  fs::ofstream file(Path("corrupt.g00"), std::ios::binary);
+  file.write(data, sizeof(data));
+  file.close();
+
+  for (G00Implementation implementation : kAllImplementations) {
+    if (!IsG00ImplementationSupported(implementation))
+      continue;
+    SetG00Implementation(implementation);
+    EXPECT_TRUE(DecodeImageFile(Path("corrupt.g00"))->pixels == nullptr);
+  }
+}
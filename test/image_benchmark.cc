@@ -0,0 +1,286 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "benchmark_utils.h"
+#include "systems/base/g00_decoder.h"
+#include "systems/base/graphics_system.h"
+#include "systems/base/image_decoder.h"
+#include "systems/base/rect.h"
+#include "systems/base/surface.h"
+#include "test_system/test_system.h"
+#include "test_utils.h"
+#include "utilities/worker_pool.h"
+#include "xclannad/file.h"
+
+namespace fs = boost::filesystem;
+
+namespace {
+
+const int kScenes = 6;
+const int kFramesPerScene = 10;
+const double kFrameBudgetMs = 1000.0 / 60;
+
+// Each scene opens a full screen background and two half screen character
+// sprites, the way a grpOpenBg followed by a couple of objOfFile calls does.
+const Size kBackgroundSize(1280, 720);
+const Size kSpriteSize(640, 720);
+
+// Fills an image with short runs of noisy colours, which compresses about as
+// well as a painted CG does. A |max_run| of one gives pure noise instead, which
+// doesn't compress at all.
+std::vector<int> MakeCGPixels(const Size& size,
+                              unsigned int seed,
+                              int max_run = 8) {
+  std::vector<int> pixels;
+  pixels.reserve(size.width() * size.height());
+  while (pixels.size() < static_cast<size_t>(size.width() * size.height())) {
+    seed = seed * 1103515245 + 12345;
+    int run = 1 + (seed >> 8) % max_run;
+    int colour = (seed >> 4) & 0xffffff;
+    for (int i = 0; i < run; ++i)
+      pixels.push_back(colour);
+  }
+  pixels.resize(size.width() * size.height());
+  return pixels;
+}
+
+std::string ImageName(int scene, int image) {
+  return "cg" + std::to_string(scene) + "_" + std::to_string(image);
+}
+
+struct FrameTimes {
+  std::vector<double> frames;
+
+  double Worst() const {
+    return *std::max_element(frames.begin(), frames.end());
+  }
+
+  int OverBudget() const {
+    return std::count_if(frames.begin(), frames.end(),
+                         [](double ms) { return ms > kFrameBudgetMs; });
+  }
+};
+
+// Plays through every scene at 60 frames per second. The images are loaded on
+// the first frame of a scene and drawn from the second on, like a fade that
+// starts on the event loop iteration after the load. Only the time the
+// interpreter thread spends working counts towards a frame; the rest of the
+// frame is slept away as the main loop would.
+FrameTimes ReplayScenes(const fs::path& gameroot, int decode_threads) {
+  TestSystem system;
+  system.gameexe()("__GAMEPATH") = gameroot.string() + "/";
+  GraphicsSystem& graphics = system.graphics();
+  graphics.EnableBackgroundImageDecoding(decode_threads);
+
+  FrameTimes times;
+  std::vector<std::shared_ptr<const Surface>> on_screen;
+  for (int scene = 0; scene < kScenes; ++scene) {
+    std::vector<std::shared_ptr<const Surface>> loaded;
+    for (int frame = 0; frame < kFramesPerScene; ++frame) {
+      BenchmarkTimer timer;
+      if (frame == 0) {
+        for (int image = 0; image < 3; ++image)
+          loaded.push_back(graphics.GetSurfaceNamed(ImageName(scene, image)));
+      } else if (frame == 1) {
+        on_screen.swap(loaded);
+      }
+
+      for (const std::shared_ptr<const Surface>& surface : on_screen)
+        surface->RenderToScreen(surface->GetRect(), surface->GetRect());
+
+      double elapsed = timer.ElapsedMs();
+      times.frames.push_back(elapsed);
+      if (elapsed < kFrameBudgetMs) {
+        std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(
+            kFrameBudgetMs - elapsed));
+      }
+    }
+  }
+
+  return times;
+}
+
+}  // namespace
+
+// Measures the frame time spikes of a CG heavy stretch of a game with images
+// decoded when they're loaded versus on background threads. The decoding
+// itself goes through the same code in both cases; the mock graphics system
+// only skips building real textures.
+TEST(ImageBenchmark, CGLoadFrameSpikes) {
+  fs::path gameroot =
+      fs::temp_directory_path() / fs::unique_path("rlvm-bench-%%%%-%%%%");
+  fs::create_directories(gameroot / "g00");
+  for (int scene = 0; scene < kScenes; ++scene) {
+    for (int image = 0; image < 3; ++image) {
+      Size size = image == 0 ? kBackgroundSize : kSpriteSize;
+      std::string path =
+          (gameroot / "g00" / (ImageName(scene, image) + ".g00")).string();
+      WriteType0G00(path, size.width(), size.height(),
+                    MakeCGPixels(size, scene * 3 + image));
+    }
+  }
+
+  const int threads = WorkerPool::DefaultThreadCount();
+  FrameTimes synchronous = ReplayScenes(gameroot, 0);
+  FrameTimes background = ReplayScenes(gameroot, threads);
+  fs::remove_all(gameroot);
+
+  PrintBenchmarkResult("synchronous decode: worst frame",
+                       synchronous.Worst(), "ms");
+  PrintBenchmarkResult("synchronous decode: frames over budget",
+                       synchronous.OverBudget(), "frames");
+  PrintBenchmarkResult(
+      "background decode (" + std::to_string(threads) + "t): worst frame",
+      background.Worst(), "ms");
+  PrintBenchmarkResult(
+      "background decode (" + std::to_string(threads) +
+          "t): frames over budget",
+      background.OverBudget(), "frames");
+}
+
+// Compares GRPCONV with DecodeG00() under each supported implementation, in
+// megabytes of 32-bit pixels produced per second. Both decode from files
+// already in memory into a buffer that's reused between rounds.
+TEST(ImageBenchmark, G00DecodeThroughput) {
+  const int kDecodeRounds = 20;
+  fs::path directory =
+      fs::temp_directory_path() / fs::unique_path("rlvm-bench-%%%%-%%%%");
+  fs::create_directories(directory);
+
+  std::vector<std::pair<std::string, fs::path>> files = {
+      {"type 0 CG", directory / "cg.g00"},
+      {"type 0 noise", directory / "noise.g00"},
+      {"type 2 sprite sheet", directory / "sheet.g00"}};
+  WriteType0G00(files[0].second.string(), kBackgroundSize.width(),
+                kBackgroundSize.height(), MakeCGPixels(kBackgroundSize, 1));
+  WriteType0G00(files[1].second.string(), kBackgroundSize.width(),
+                kBackgroundSize.height(), MakeCGPixels(kBackgroundSize, 2, 1));
+
+  // Sixteen 256x256 cells, each with a sprite that leaves a transparent
+  // border.
+  std::vector<G00Region> cells;
+  for (int i = 0; i < 16; ++i) {
+    int x = (i % 4) * 256;
+    int y = (i / 4) * 256;
+    std::vector<int> pixels = MakeCGPixels(Size(224, 240), 3 + i);
+    for (int& pixel : pixels)
+      pixel |= 0xff000000;
+    cells.push_back({x, y, x + 255, y + 255, {{16, 8, 224, 240, pixels}}});
+  }
+  WriteType2G00(files[2].second.string(), 1024, 1024, cells);
+
+  const char* const kNames[] = {"scalar", "ssse3", "avx2"};
+  G00Implementation original = GetG00Implementation();
+  for (const auto& file : files) {
+    fs::ifstream stream(file.second, std::ios::binary);
+    std::vector<char> data((std::istreambuf_iterator<char>(stream)),
+                           std::istreambuf_iterator<char>());
+    size_t size = data.size();
+    data.push_back(0);
+
+    std::shared_ptr<DecodedImage> image = ReadImageHeader(file.second);
+    size_t bytes = image->size.width() * image->size.height() * 4;
+    image->pixels.reset(new char[bytes + 1024]);
+    auto report = [&](const std::string& name, double ms) {
+      PrintBenchmarkResult(file.first + ": " + name,
+                           bytes * kDecodeRounds / (ms / 1000 * 1024 * 1024),
+                           "MB/s");
+    };
+
+    BenchmarkTimer grpconv_timer;
+    for (int round = 0; round < kDecodeRounds; ++round) {
+      std::unique_ptr<GRPCONV> conv(
+          GRPCONV::AssignConverter(data.data(), size, "???"));
+      conv->Read(image->pixels.get());
+    }
+    report("GRPCONV", grpconv_timer.ElapsedMs());
+
+    for (int i = G00_SCALAR; i <= G00_AVX2; ++i) {
+      G00Implementation implementation = static_cast<G00Implementation>(i);
+      if (!IsG00ImplementationSupported(implementation))
+        continue;
+      SetG00Implementation(implementation);
+
+      BenchmarkTimer timer;
+      for (int round = 0; round < kDecodeRounds; ++round)
+        DecodeG00(data.data(), size, image.get());
+      report(kNames[i], timer.ElapsedMs());
+    }
+  }
+  SetG00Implementation(original);
+  fs::remove_all(directory);
+}
+
+// Decodes a large type 2 sprite sheet, like the ones GAN and ANM animations
+// draw their frames from. The test data has no sprite sheets of its own, so
+// this one is generated: 64 cells of 256x256 on a 2048x2048 canvas.
+TEST(ImageBenchmark, G00SpriteSheetRegions) {
+  const int kDecodeRounds = 10;
+  fs::path directory =
+      fs::temp_directory_path() / fs::unique_path("rlvm-bench-%%%%-%%%%");
+  fs::create_directories(directory);
+  fs::path path = directory / "sheet.g00";
+
+  std::vector<G00Region> cells;
+  for (int i = 0; i < 64; ++i) {
+    int x = (i % 8) * 256;
+    int y = (i / 8) * 256;
+    std::vector<int> pixels = MakeCGPixels(Size(240, 248), 100 + i);
+    for (int& pixel : pixels)
+      pixel |= 0xff000000;
+    cells.push_back({x, y, x + 255, y + 255, {{8, 4, 240, 248, pixels}}});
+  }
+  WriteType2G00(path.string(), 2048, 2048, cells);
+
+  fs::ifstream stream(path, std::ios::binary);
+  std::vector<char> data((std::istreambuf_iterator<char>(stream)),
+                         std::istreambuf_iterator<char>());
+  size_t size = data.size();
+  data.push_back(0);
+  std::shared_ptr<DecodedImage> image = ReadImageHeader(path);
+  size_t bytes = image->size.width() * image->size.height() * 4;
+  image->pixels.reset(new char[bytes + 1024]);
+  fs::remove_all(directory);
+
+  BenchmarkTimer timer;
+  for (int round = 0; round < kDecodeRounds; ++round)
+    DecodeG00(data.data(), size, image.get());
+  PrintBenchmarkResult("2048x2048 sheet", timer.ElapsedMs() / kDecodeRounds,
+                       "ms");
+}
@@ -0,0 +1,143 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+#include "gtest/gtest.h"
+
+#include <memory>
+#include <string>
+
+#include "systems/base/image_cache.h"
+#include "systems/base/rect.h"
+#include "test_system/mock_surface.h"
+
+namespace {
+
+// A 10x10 surface is charged 800 bytes.
+std::shared_ptr<const Surface> MakeSurface(const std::string& name,
+                                           int width = 10,
+                                           int height = 10) {
+  return std::shared_ptr<const Surface>(
+      MockSurface::Create(name, Size(width, height)));
+}
+
+}  // namespace
+
+TEST(ImageCacheTest, ChargesPixelsAndTexture) {
+  EXPECT_EQ(800u, ImageCache::EstimateBytes(*MakeSurface("a")));
+  EXPECT_EQ(640u * 480 * 8,
+            ImageCache::EstimateBytes(*MakeSurface("cg", 640, 480)));
+}
+
+TEST(ImageCacheTest, EvictsLeastRecentlyUsedByBytes) {
+  ImageCache cache(2000);
+  cache.Insert("a", MakeSurface("a"));
+  cache.Insert("b", MakeSurface("b"));
+  EXPECT_EQ(1600u, cache.stats().bytes);
+
+  // A third image puts the cache over budget, so the oldest one goes.
+  cache.Insert("c", MakeSurface("c"));
+  EXPECT_FALSE(cache.Contains("a"));
+  EXPECT_TRUE(cache.Contains("b"));
+  EXPECT_TRUE(cache.Contains("c"));
+  EXPECT_EQ(2, cache.stats().entries);
+  EXPECT_EQ(1600u, cache.stats().bytes);
+  EXPECT_EQ(1, cache.stats().evictions);
+  EXPECT_EQ(800u, cache.stats().evicted_bytes);
+}
+
+TEST(ImageCacheTest, FetchMarksImageAsRecentlyUsed) {
+  ImageCache cache(2000);
+  cache.Insert("a", MakeSurface("a"));
+  cache.Insert("b", MakeSurface("b"));
+  EXPECT_TRUE(cache.Fetch("a") != nullptr);
+
+  cache.Insert("c", MakeSurface("c"));
+  EXPECT_TRUE(cache.Contains("a"));
+  EXPECT_FALSE(cache.Contains("b"));
+}
+
+TEST(ImageCacheTest, ContainsDoesNotMarkImageAsUsed) {
+  ImageCache cache(2000);
+  cache.Insert("a", MakeSurface("a"));
+  cache.Insert("b", MakeSurface("b"));
+  EXPECT_TRUE(cache.Contains("a"));
+
+  cache.Insert("c", MakeSurface("c"));
+  EXPECT_FALSE(cache.Contains("a"));
+  EXPECT_EQ(0, cache.stats().lookups);
+}
+
+TEST(ImageCacheTest, LargeImageEvictsSeveralSmallOnes) {
+  ImageCache cache(4000);
+  for (const char* name : {"a", "b", "c", "d"})
+    cache.Insert(name, MakeSurface(name));
+
+  cache.Insert("cg", MakeSurface("cg", 20, 20));
+  EXPECT_FALSE(cache.Contains("a"));
+  EXPECT_FALSE(cache.Contains("b"));
+  EXPECT_FALSE(cache.Contains("c"));
+  EXPECT_TRUE(cache.Contains("d"));
+  EXPECT_TRUE(cache.Contains("cg"));
+  EXPECT_EQ(3, cache.stats().evictions);
+}
+
+TEST(ImageCacheTest, KeepsImageLargerThanBudget) {
+  ImageCache cache(1000);
+  cache.Insert("a", MakeSurface("a"));
+  cache.Insert("cg", MakeSurface("cg", 20, 20));
+
+  EXPECT_FALSE(cache.Contains("a"));
+  EXPECT_TRUE(cache.Contains("cg"));
+  EXPECT_EQ(3200u, cache.stats().bytes);
+}
+
+TEST(ImageCacheTest, ReplacingImageRechargesIt) {
+  ImageCache cache(10000);
+  cache.Insert("a", MakeSurface("a"));
+  cache.Insert("a", MakeSurface("a", 20, 20));
+
+  EXPECT_EQ(1, cache.stats().entries);
+  EXPECT_EQ(3200u, cache.stats().bytes);
+  EXPECT_EQ(0, cache.stats().evictions);
+}
+
+TEST(ImageCacheTest, CountsHitRatio) {
+  ImageCache cache(10000);
+  cache.Insert("a", MakeSurface("a"));
+  EXPECT_TRUE(cache.Fetch("a") != nullptr);
+  EXPECT_TRUE(cache.Fetch("a") != nullptr);
+  EXPECT_TRUE(cache.Fetch("a") != nullptr);
+  EXPECT_TRUE(cache.Fetch("b") == nullptr);
+
+  EXPECT_EQ(4, cache.stats().lookups);
+  EXPECT_EQ(3, cache.stats().hits);
+  EXPECT_DOUBLE_EQ(0.75, cache.stats().hit_ratio());
+
+  cache.Clear();
+  EXPECT_FALSE(cache.Contains("a"));
+  EXPECT_EQ(0, cache.stats().entries);
+  EXPECT_EQ(0u, cache.stats().bytes);
+}
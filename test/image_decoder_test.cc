@@ -0,0 +1,180 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+#include "gtest/gtest.h"
+
+#include <boost/filesystem/operations.hpp>
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "libreallive/archive.h"
+#include "libreallive/gameexe.h"
+#include "machine/image_prefetcher.h"
+#include "machine/rlmachine.h"
+#include "modules/modules.h"
+#include "systems/base/deferred_surface.h"
+#include "systems/base/event_system.h"
+#include "systems/base/graphics_system.h"
+#include "systems/base/image_decoder.h"
+#include "systems/base/rect.h"
+#include "systems/null/null_system.h"
+#include "test_system/test_system.h"
+#include "test_utils.h"
+#include "utilities/exception.h"
+
+namespace fs = boost::filesystem;
+
+class ImageDecoderTest : public ::testing::Test {
+ protected:
+  ImageDecoderTest()
+      : gameroot(fs::temp_directory_path() /
+                 fs::unique_path("rlvm-image-%%%%-%%%%")) {
+    fs::create_directories(gameroot / "g00");
+
+    // A 5x3 image with a run of repeated pixels on its middle row.
+    pixels = {0x000000, 0x102030, 0xff0000, 0x00ff00, 0x0000ff,
+              0x123456, 0x123456, 0x123456, 0x123456, 0x654321,
+              0xffffff, 0x000001, 0x808080, 0x808081, 0x7f7f7f};
+    WriteType0G00((gameroot / "g00" / "cg01.g00").string(), 5, 3, pixels);
+  }
+
+  ~ImageDecoderTest() { fs::remove_all(gameroot); }
+
+  fs::path cg_path() const { return gameroot / "g00" / "cg01.g00"; }
+
+  fs::path gameroot;
+  std::vector<int> pixels;
+};
+
+TEST_F(ImageDecoderTest, DecodesType0Images) {
+  std::shared_ptr<DecodedImage> image = DecodeImageFile(cg_path());
+  ASSERT_TRUE(image != nullptr);
+  EXPECT_EQ(Size(5, 3), image->size);
+  EXPECT_FALSE(image->is_mask);
+  ASSERT_EQ(1, image->region_table.size());
+  EXPECT_EQ(Rect(0, 0, Size(5, 3)), image->region_table[0].rect);
+
+  ASSERT_TRUE(image->pixels != nullptr);
+  const unsigned int* decoded =
+      reinterpret_cast<const unsigned int*>(image->pixels.get());
+  for (size_t i = 0; i < pixels.size(); ++i)
+    EXPECT_EQ(pixels[i] | 0xff000000, decoded[i]) << "Pixel " << i;
+}
+
+TEST_F(ImageDecoderTest, BackgroundDecodingMatchesSynchronousDecoding) {
+  std::shared_ptr<DecodedImage> expected = DecodeImageFile(cg_path());
+
+  for (int threads : {0, 2}) {
+    ImageDecoder decoder(threads);
+    ImageDecoder::Pixels pixels;
+    std::shared_ptr<const DecodedImage> header =
+        decoder.Decode(cg_path(), &pixels);
+    EXPECT_EQ(Size(5, 3), header->size);
+    EXPECT_TRUE(header->pixels == nullptr);
+
+    std::shared_ptr<const DecodedImage> image = decoder.Wait(pixels);
+    ASSERT_TRUE(image->pixels != nullptr);
+    EXPECT_EQ(0, memcmp(expected->pixels.get(), image->pixels.get(),
+                        5 * 3 * 4));
+    EXPECT_EQ(1, decoder.stats().decodes);
+  }
+}
+
+TEST_F(ImageDecoderTest, MissingFilesThrowImmediately) {
+  ImageDecoder decoder(1);
+  ImageDecoder::Pixels pixels;
+  EXPECT_THROW(decoder.Decode(gameroot / "g00" / "nothere.g00", &pixels),
+               rlvm::Exception);
+  EXPECT_EQ(0, decoder.stats().decodes);
+}
+
+// Loading an image should only read its header; the pixels are waited on
+// when the surface is first drawn.
+TEST_F(ImageDecoderTest, GraphicsSystemDefersPixelsUntilDrawn) {
+  TestSystem system;
+  system.gameexe()("__GAMEPATH") = gameroot.string() + "/";
+  GraphicsSystem& graphics = system.graphics();
+  graphics.EnableBackgroundImageDecoding(1);
+
+  std::shared_ptr<const Surface> surface = graphics.GetSurfaceNamed("cg01");
+  const DeferredSurface* deferred =
+      dynamic_cast<const DeferredSurface*>(surface.get());
+  ASSERT_TRUE(deferred);
+  EXPECT_EQ(Size(5, 3), surface->GetSize());
+  EXPECT_EQ(1, surface->GetNumPatterns());
+  EXPECT_FALSE(deferred->is_resolved());
+
+  // The image cache hands back the same pending surface.
+  EXPECT_EQ(surface, graphics.GetSurfaceNamed("cg01"));
+
+  surface->RenderToScreen(Rect(0, 0, Size(5, 3)), Rect(0, 0, Size(5, 3)));
+  EXPECT_TRUE(deferred->is_resolved());
+  EXPECT_EQ(Size(5, 3), deferred->Resolve().GetSize());
+  EXPECT_EQ(1, graphics.image_decoder()->stats().decodes);
+}
+
+// graphics.TXT opens four backgrounds in a row with constant names. They
+// should all be decoding before the first grpOpen runs, and each grpOpen
+// should find its image waiting in the cache.
+TEST_F(ImageDecoderTest, PrefetchesImagesAheadOfTheInstructionPointer) {
+  for (const char* name : {"BG053", "FGNY02A", "BG002", "BG003B"}) {
+    WriteType0G00((gameroot / "g00" / (std::string(name) + ".g00")).string(),
+                  5, 3, pixels);
+  }
+
+  Gameexe gameexe;
+  gameexe("__GAMEPATH") = gameroot.string() + "/";
+  gameexe("FOLDNAME.G00") = "G00";
+  gameexe("REGNAME") = "rlvm-image-decoder-test";
+  gameexe("SCREENSIZE_MOD") = 0;
+  NullSystem system(gameexe);
+  system.graphics().EnableBackgroundImageDecoding(1);
+  libreallive::Archive arc(locateTestCase("Module_Jmp_SEEN/graphics.TXT"));
+  RLMachine machine(system, arc);
+  AddAllModules(machine);
+  machine.EnableImagePrefetch(64);
+
+  machine.ExecuteNextInstruction();
+  EXPECT_EQ(4, system.graphics().GetPrefetchStats().prefetches);
+
+  system.set_force_fast_forward();
+  for (int slices = 0; slices < 10000 && !machine.halted(); ++slices) {
+    system.Run(machine);
+    machine.ExecuteBatch(10);
+    system.event().Wait(10);
+    system.set_force_wait(false);
+  }
+  EXPECT_TRUE(machine.halted());
+
+  GraphicsSystem::PrefetchStats stats = system.graphics().GetPrefetchStats();
+  EXPECT_EQ(4, stats.prefetches);
+  EXPECT_EQ(4, stats.hits);
+  EXPECT_EQ(0, stats.wasted);
+  EXPECT_EQ(4, machine.image_prefetcher()->stats().commands);
+}
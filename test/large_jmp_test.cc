@@ -29,6 +29,7 @@
 
 #include "libreallive/archive.h"
 #include "libreallive/intmemref.h"
+#include "libreallive/scenario.h"
 #include "machine/rlmachine.h"
 #include "modules/module_jmp.h"
 #include "modules/module_msg.h"
@@ -579,6 +580,59 @@ TEST(LargeJmpTest, farcall) {
 
 // -----------------------------------------------------------------------
 
+// Tests that the farcall target in farcallTest_0 is decoded in the background
+// before the farcall is executed.
+TEST(LargeJmpTest, farcallPrefetch) {
+  libreallive::Archive arc(
+      locateTestCase("Module_Jmp_SEEN/farcallTest_0.TXT"));
+  arc.EnablePrefetch(1);
+  ASSERT_TRUE(arc.GetScenario(1));
+  arc.WaitForBackgroundDecoding();
+
+  TestSystem system;
+  RLMachine rlmachine(system, arc);
+  rlmachine.AttachModule(new JmpModule);
+  rlmachine.SetIntValue(IntMemRef('B', 0), 2);
+  rlmachine.ExecuteUntilHalted();
+
+  EXPECT_EQ(2, rlmachine.GetIntValue(IntMemRef('A', 1)))
+      << "We jumped somewhere unexpected!";
+
+  libreallive::Archive::PrefetchStats stats = arc.GetPrefetchStats();
+  EXPECT_EQ(1, stats.misses) << "Only SEEN0001 should be decoded on demand";
+  EXPECT_EQ(0, stats.waits);
+  EXPECT_LT(0, stats.hits);
+}
+
+// Tests that a scenario cache too small for anything only evicts SEEN0002
+// after the farcall returns, since SEEN0001 stays on the call stack.
+TEST(LargeJmpTest, farcallEvictsReturnedScenario) {
+  libreallive::Archive arc(
+      locateTestCase("Module_Jmp_SEEN/farcallTest_0.TXT"));
+  arc.set_cache_budget(1);
+
+  TestSystem system;
+  RLMachine rlmachine(system, arc);
+  rlmachine.AttachModule(new JmpModule);
+  rlmachine.SetIntValue(IntMemRef('B', 0), 2);
+  rlmachine.ExecuteUntilHalted();
+
+  EXPECT_EQ(2, rlmachine.GetIntValue(IntMemRef('A', 1)))
+      << "We jumped somewhere unexpected!";
+  EXPECT_EQ(1, rlmachine.GetIntValue(IntMemRef('A', 2)))
+      << "Postcondition not set! (We didn't return correctly!)";
+
+  libreallive::Archive::CacheStats stats = arc.GetCacheStats();
+  EXPECT_EQ(1, stats.evictions);
+  EXPECT_EQ(1u, stats.scenarios);
+  EXPECT_EQ(stats.bytes, arc.GetScenario(1)->ApproximateMemoryUsage());
+
+  // Evicted scenarios are parsed again on demand.
+  EXPECT_TRUE(arc.GetScenario(2));
+}
+
+// -----------------------------------------------------------------------
+
 // Tests gosub_with
 //
 // Corresponding kepago listing:
@@ -56,7 +56,7 @@ TEST(LargeModuleStrTest, strcpy0) {
   rlmachine.AttachModule(new StrModule);
   rlmachine.ExecuteUntilHalted();
 
-  string one = rlmachine.GetStringValue(STRS_LOCATION, 0);
+  string one = rlmachine.GetStringValue(STRS_LOCATION, 0).as_string();
   EXPECT_EQ("valid", one) << "strcpy_0 script failed to set value";
 }
 
@@ -73,7 +73,7 @@ TEST(LargeModuleStrTest, strcpy1) {
   rlmachine.AttachModule(new StrModule);
   rlmachine.ExecuteUntilHalted();
 
-  string one = rlmachine.GetStringValue(STRS_LOCATION, 0);
+  string one = rlmachine.GetStringValue(STRS_LOCATION, 0).as_string();
   EXPECT_EQ("va", one) << "strcpy_1 script failed to set value";
 }
 
@@ -92,13 +92,13 @@ TEST(LargeModuleStrTest, strclear0) {
   rlmachine.AttachModule(new StrModule);
   rlmachine.ExecuteUntilHalted();
 
-  string one = rlmachine.GetStringValue(STRS_LOCATION, 0);
+  string one = rlmachine.GetStringValue(STRS_LOCATION, 0).as_string();
   EXPECT_EQ("", one) << "strclear_0 script failed to unset value";
 
   // We include this check to make sure the machine is sane and that
   // the first assignment works, so strclear doesn't appear to work
   // because assignment failed.
-  string two = rlmachine.GetStringValue(STRS_LOCATION, 1);
+  string two = rlmachine.GetStringValue(STRS_LOCATION, 1).as_string();
   EXPECT_EQ("valid", two) << "strclear_0 script failed to set value";
 }
 
@@ -115,15 +115,15 @@ TEST(LargeModuleStrTest, strclear1) {
   rlmachine.AttachModule(new StrModule);
   rlmachine.ExecuteUntilHalted();
 
-  string one = rlmachine.GetStringValue(STRS_LOCATION, 0);
+  string one = rlmachine.GetStringValue(STRS_LOCATION, 0).as_string();
   EXPECT_EQ("", one) << "strclear_1 script failed to unset value";
-  string two = rlmachine.GetStringValue(STRS_LOCATION, 1);
+  string two = rlmachine.GetStringValue(STRS_LOCATION, 1).as_string();
   EXPECT_EQ("", two) << "strclear_1 script failed to unset value";
 
   // We include this check to make sure the machine is sane and that
   // the first assignment works, so strclear doesn't appear to work
   // because assignment failed.
-  string three = rlmachine.GetStringValue(STRS_LOCATION, 2);
+  string three = rlmachine.GetStringValue(STRS_LOCATION, 2).as_string();
   EXPECT_EQ("valid", three) << "strclear_1 script failed to set value";
 }
 
@@ -141,7 +141,7 @@ TEST(LargeModuleStrTest, strcat) {  // NOLINT
   rlmachine.AttachModule(new StrModule);
   rlmachine.ExecuteUntilHalted();
 
-  string one = rlmachine.GetStringValue(STRS_LOCATION, 0);
+  string one = rlmachine.GetStringValue(STRS_LOCATION, 0).as_string();
   EXPECT_EQ("valid", one) << "strcat script failed to set value";
 }
 
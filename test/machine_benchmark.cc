@@ -0,0 +1,869 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+
+#include <boost/filesystem/operations.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "benchmark_utils.h"
+#include "libreallive/archive.h"
+#include "libreallive/expression.h"
+#include "libreallive/intmemref.h"
+#include "libreallive/scenario.h"
+#include "machine/memory.h"
+#include "machine/quick_save_ring.h"
+#include "machine/rlmachine.h"
+#include "machine/save_writer.h"
+#include "machine/serialization.h"
+#include "machine/stack_frame.h"
+#include "modules/module_grp.h"
+#include "modules/module_obj_creation.h"
+#include "modules/modules.h"
+#include "systems/base/event_system.h"
+#include "systems/base/graphics_object.h"
+#include "systems/base/graphics_system.h"
+#include "systems/base/system.h"
+#include "test_system/test_event_system.h"
+#include "test_system/test_machine.h"
+#include "test_system/test_system.h"
+#include "test_utils.h"
+
+namespace fs = boost::filesystem;
+
+namespace {
+
+const int kRounds = 100;
+
+// Scripts that haven't halted after this many instructions are left out.
+const long kMaxInstructions = 1000000;
+
+// The SEENs that the large_* tests run, optionally only those for one module
+// ("Module_Mem_", etc).
+std::vector<std::string> LocateModuleSEENs(
+    const std::string& prefix = "Module_") {
+  std::vector<std::string> out;
+  for (const std::string& seen : locateAllTestSEENs()) {
+    if (seen.find(prefix) != std::string::npos)
+      out.push_back(seen);
+  }
+  return out;
+}
+
+// Silences the machine's error reporting to stdout while it's in scope.
+class ScopedSilence {
+ public:
+  ScopedSilence() : old_(std::cout.rdbuf(sink_.rdbuf())) {}
+  ~ScopedSilence() { std::cout.rdbuf(old_); }
+
+ private:
+  std::ostringstream sink_;
+  std::streambuf* old_;
+};
+
+// A machine with every module attached, which is rewound to the top of its
+// first scenario between runs.
+struct BenchmarkMachine {
+  explicit BenchmarkMachine(const std::string& seen)
+      : seen(seen), arc(seen), machine(system, arc) {
+    AddAllModules(machine);
+  }
+
+  void Rewind() {
+    libreallive::Scenario* scenario = arc.GetScenario(arc.begin()->first);
+    machine.Reset();
+    machine.HardResetMemory();
+    machine.PushStackFrame(
+        StackFrame(scenario, scenario->begin(), StackFrame::TYPE_ROOT));
+  }
+
+  std::string seen;
+  libreallive::Archive arc;
+  TestSystem system;
+  RLMachine machine;
+};
+
+// Returns how many instructions |machine| takes to halt, or -1 if it doesn't.
+// Each bytecode element counts as one instruction, even where the machine
+// would normally fuse several into one step.
+long CountInstructions(RLMachine& machine) {
+  machine.set_fuse_instructions(false);
+  long count = 0;
+  while (!machine.halted() && count < kMaxInstructions) {
+    machine.ExecuteNextInstruction();
+    count++;
+  }
+  machine.set_fuse_instructions(true);
+  return machine.halted() ? count : -1;
+}
+
+// Runs every machine to completion kRounds times and returns the milliseconds
+// spent in ExecuteUntilHalted().
+double TimeRuns(const std::vector<std::unique_ptr<BenchmarkMachine>>& machines,
+                bool cache_dispatch,
+                bool fuse_instructions = true) {
+  double ms = 0;
+  for (int round = 0; round < kRounds; ++round) {
+    for (const std::unique_ptr<BenchmarkMachine>& m : machines) {
+      m->Rewind();
+      m->machine.set_cache_dispatch(cache_dispatch);
+      m->machine.set_fuse_instructions(fuse_instructions);
+
+      BenchmarkTimer timer;
+      m->machine.ExecuteUntilHalted();
+      ms += timer.ElapsedMs();
+    }
+  }
+  return ms;
+}
+
+// A test clock that advances by |step| ticks every time it's read.
+class SteppedClock : public EventSystemMockHandler {
+ public:
+  explicit SteppedClock(unsigned int step) : step_(step), ticks_(0) {}
+
+  virtual unsigned int GetTicks() const override {
+    unsigned int ticks = ticks_;
+    ticks_ += step_;
+    return ticks;
+  }
+
+ private:
+  unsigned int step_;
+  mutable unsigned int ticks_;
+};
+
+// Returns how many commands one run of |seen| dispatches, counted from the
+// lines a tracing machine writes to stderr.
+long CountCommands(const std::string& seen) {
+  BenchmarkMachine m(seen);
+  m.machine.set_tracing_on();
+  std::ostringstream trace;
+  std::streambuf* old = std::cerr.rdbuf(trace.rdbuf());
+  CountInstructions(m.machine);
+  std::cerr.rdbuf(old);
+
+  const std::string& lines = trace.str();
+  return std::count(lines.begin(), lines.end(), '\n');
+}
+
+// Creates a machine for each of |seens| that halts and can be rewound, and
+// returns the total number of instructions one run of them all takes.
+long LoadMachines(const std::vector<std::string>& seens,
+                  std::vector<std::unique_ptr<BenchmarkMachine>>& machines) {
+  ScopedSilence silence;
+  long instructions = 0;
+  for (const std::string& seen : seens) {
+    std::unique_ptr<BenchmarkMachine> m(new BenchmarkMachine(seen));
+    long count = CountInstructions(m->machine);
+    if (count < 0)
+      continue;
+
+    // A script that halts inside a LongOperation leaves stack modifications
+    // pending, so it can't be rewound.
+    m->Rewind();
+    if (m->machine.GetStackSize() != 1)
+      continue;
+
+    instructions += count;
+    machines.push_back(std::move(m));
+  }
+  return instructions;
+}
+
+// Fills |machine| with roughly the state of a long visual novel partway
+// through: most local and global integers in use, a few hundred strings,
+// kidoku bits for every scenario and a screen's worth of objects.
+void FillMidgameState(RLMachine& machine) {
+  Memory& memory = machine.memory();
+  LocalMemory& local = memory.local();
+  GlobalMemory& global = memory.global();
+  for (int i = 0; i < SIZE_OF_MEM_BANK; ++i) {
+    if (i % 3) {
+      local.intA[i] = i;
+      local.intB[i] = i * 7;
+      local.intC[i] = i & 0xff;
+      local.intD[i] = 1 << (i % 31);
+      local.intE[i] = -i;
+      local.intF[i] = i % 2;
+      global.intG[i] = i * 13;
+      global.intZ[i] = i & 1;
+    }
+  }
+
+  // Lines of Shift_JIS text are about 40 bytes.
+  const std::string line(40, '\x82');
+  for (int i = 0; i < 300; ++i)
+    local.strS.Set(i, line);
+  for (int i = 0; i < 100; ++i)
+    global.strM.Set(i, line);
+  for (int i = 0; i < 10; ++i) {
+    memory.SetName(i, "name");
+    memory.SetLocalName(i, "name");
+  }
+
+  // About 200 scenarios with around a thousand kidoku markers each, half of
+  // which have been read.
+  for (int scenario = 0; scenario < 200; ++scenario) {
+    for (int kidoku = 0; kidoku < 1000; kidoku += 2)
+      memory.RecordKidoku(scenario, kidoku);
+  }
+
+  for (int i = 0; i < 64; ++i) {
+    GraphicsObject& obj = machine.system().graphics().GetObject(OBJ_FG, i);
+    obj.SetVisible(1);
+    obj.SetX(i * 10);
+    obj.SetY(i * 5);
+    obj.SetAlpha(200);
+  }
+
+  machine.MarkSavepoint();
+}
+
+}  // namespace
+
+// Instructions per second through ExecuteUntilHalted() over the large_* test
+// SEENs, with and without caching each command's RLOperation on the element.
+// Each script is rerun on the same machine, as a game reruns its scenarios.
+TEST(MachineBenchmark, DispatchThroughput) {
+  std::vector<std::unique_ptr<BenchmarkMachine>> machines;
+  long instructions = LoadMachines(LocateModuleSEENs(), machines);
+  ASSERT_FALSE(machines.empty());
+
+  double uncached_ms, cached_ms;
+  {
+    ScopedSilence silence;
+    uncached_ms = TimeRuns(machines, false);
+    cached_ms = TimeRuns(machines, true);
+  }
+
+  double total = double(instructions) * kRounds;
+  PrintBenchmarkResult("scripts", machines.size(), "");
+  PrintBenchmarkResult("instructions per run", instructions, "");
+  PrintBenchmarkResult("uncached: instructions/sec",
+                       total / (uncached_ms / 1000.0), "");
+  PrintBenchmarkResult("cached: instructions/sec",
+                       total / (cached_ms / 1000.0), "");
+  PrintBenchmarkResult("speedup", uncached_ms / cached_ms, "x");
+}
+
+// Instructions per second with and without fusing line and kidoku markers and
+// expressions into the step that follows them, over the large_* test SEENs and
+// over the expression tests, which are almost nothing but markers and
+// assignments. Both count every bytecode element as an instruction.
+TEST(MachineBenchmark, FusedInstructions) {
+  const struct {
+    const char* name;
+    const char* prefix;
+  } kSets[] = {{"modules", "Module_"}, {"expressions", "ExpressionTest_"}};
+
+  for (const auto& set : kSets) {
+    std::vector<std::unique_ptr<BenchmarkMachine>> machines;
+    long instructions = LoadMachines(LocateModuleSEENs(set.prefix), machines);
+    ASSERT_FALSE(machines.empty());
+
+    long steps = 0;
+    double unfused_ms = 1e300, fused_ms = 1e300;
+    {
+      ScopedSilence silence;
+      for (const std::unique_ptr<BenchmarkMachine>& m : machines) {
+        m->Rewind();
+        while (!m->machine.halted()) {
+          m->machine.ExecuteNextInstruction();
+          steps++;
+        }
+      }
+
+      // The difference is small next to the noise, so alternate the two and
+      // keep the best of each.
+      for (int trial = 0; trial < 5; ++trial) {
+        unfused_ms = std::min(unfused_ms, TimeRuns(machines, true, false));
+        fused_ms = std::min(fused_ms, TimeRuns(machines, true, true));
+      }
+    }
+
+    std::string name = set.name;
+    double total = double(instructions) * kRounds;
+    PrintBenchmarkResult(name + ": instructions per run", instructions, "");
+    PrintBenchmarkResult(name + ": fused steps per run", steps, "");
+    PrintBenchmarkResult(name + ": unfused instructions/sec",
+                         total / (unfused_ms / 1000.0), "");
+    PrintBenchmarkResult(name + ": fused instructions/sec",
+                         total / (fused_ms / 1000.0), "");
+    PrintBenchmarkResult(name + ": speedup", unfused_ms / fused_ms, "x");
+  }
+}
+
+// Instructions per second over the large_* test SEENs when driven the way the
+// main loop used to, reading the clock and checking for a LongOperation after
+// every instruction, and when driven by ExecuteBatch(). The old loop also
+// checks for halting here, since the test clock only ticks when it's read.
+TEST(MachineBenchmark, BatchExecution) {
+  std::vector<std::unique_ptr<BenchmarkMachine>> all_machines;
+  LoadMachines(LocateModuleSEENs(), all_machines);
+
+  // Scripts that wait on the clock themselves, such as frame counter loops,
+  // run a different number of instructions depending on how often the main
+  // loop reads it, so those whose length changes with the clock rate are left
+  // out.
+  std::vector<std::unique_ptr<BenchmarkMachine>> machines;
+  long instructions = 0;
+  for (std::unique_ptr<BenchmarkMachine>& m : all_machines) {
+    TestEventSystem& event =
+        dynamic_cast<TestEventSystem&>(m->system.event());
+    event.SetMockHandler(std::make_shared<SteppedClock>(1000));
+    m->Rewind();
+    long fast_clock_count = CountInstructions(m->machine);
+
+    event.SetMockHandler(std::make_shared<SteppedClock>(1));
+    m->Rewind();
+    long count = CountInstructions(m->machine);
+    if (count == fast_clock_count) {
+      instructions += count;
+      machines.push_back(std::move(m));
+    }
+  }
+  ASSERT_FALSE(machines.empty());
+
+  // The test clock ticks once per read, so this is a budget of clock reads.
+  // Each script is run both ways in turn, so that they see the same caches.
+  const unsigned int kBudget = 1u << 30;
+  double polled_ms = 0, batched_ms = 0;
+  {
+    ScopedSilence silence;
+    for (int round = 0; round < kRounds; ++round) {
+      for (const std::unique_ptr<BenchmarkMachine>& m : machines) {
+        RLMachine& machine = m->machine;
+        EventSystem& event = m->system.event();
+
+        m->Rewind();
+        BenchmarkTimer polled_timer;
+        while (!machine.halted()) {
+          unsigned int start_ticks = event.GetTicks();
+          unsigned int end_ticks = start_ticks;
+          do {
+            machine.ExecuteNextInstruction();
+            end_ticks = event.GetTicks();
+          } while (!machine.halted() && !machine.CurrentLongOperation() &&
+                   !m->system.force_wait() &&
+                   (end_ticks - start_ticks < kBudget));
+          m->system.set_force_wait(false);
+        }
+        polled_ms += polled_timer.ElapsedMs();
+
+        m->Rewind();
+        BenchmarkTimer batched_timer;
+        while (!machine.halted()) {
+          machine.ExecuteBatch(kBudget);
+          m->system.set_force_wait(false);
+        }
+        batched_ms += batched_timer.ElapsedMs();
+      }
+    }
+  }
+
+  double total = double(instructions) * kRounds;
+  PrintBenchmarkResult("scripts", machines.size(), "");
+  PrintBenchmarkResult("scripts waiting on the clock (skipped)",
+                       all_machines.size() - machines.size(), "");
+  PrintBenchmarkResult("instructions per run", instructions, "");
+  PrintBenchmarkResult("polled: instructions/sec",
+                       total / (polled_ms / 1000.0), "");
+  PrintBenchmarkResult("batched: instructions/sec",
+                       total / (batched_ms / 1000.0), "");
+  PrintBenchmarkResult("speedup", polled_ms / batched_ms, "x");
+}
+
+// Local integer writes between savepoints, which record the value each written
+// location had at the last savepoint. Scripts typically write the same few
+// variables over and over in loops, so most writes hit an already recorded
+// location.
+TEST(MachineBenchmark, SavepointMemoryWrites) {
+  const int kPasses = 200;
+  const int kWritesPerLocation = 4;
+
+  TestSystem system;
+  libreallive::Archive arc(locateTestCase("Module_Mem_SEEN/sum_0.TXT"));
+  RLMachine machine(system, arc);
+
+  BenchmarkTimer timer;
+  for (int pass = 0; pass < kPasses; ++pass) {
+    for (int bank = libreallive::INTA_LOCATION;
+         bank <= libreallive::INTF_LOCATION; ++bank) {
+      for (int location = 0; location < SIZE_OF_MEM_BANK; ++location) {
+        libreallive::IntMemRef ref(bank, 0, location);
+        for (int i = 0; i < kWritesPerLocation; ++i)
+          machine.SetIntValue(ref, pass + i);
+      }
+    }
+    machine.memory().TakeSavepointSnapshot();
+  }
+  double write_ms = timer.ElapsedMs();
+
+  std::vector<std::unique_ptr<BenchmarkMachine>> machines;
+  long instructions = LoadMachines(LocateModuleSEENs("Module_Mem_"), machines);
+  ASSERT_FALSE(machines.empty());
+  double script_ms;
+  {
+    ScopedSilence silence;
+    script_ms = TimeRuns(machines, true);
+  }
+
+  double writes = double(kPasses) * 6 * SIZE_OF_MEM_BANK * kWritesPerLocation;
+  PrintBenchmarkResult("writes/sec", writes / (write_ms / 1000.0), "");
+  PrintBenchmarkResult("Module_Mem scripts: instructions/sec",
+                       double(instructions) * kRounds / (script_ms / 1000.0),
+                       "");
+}
+
+// Save and load latency of a midgame save file and the global memory file, in
+// the old text format and the binary format.
+TEST(MachineBenchmark, SaveLoadLatency) {
+  const int kIterations = 20;
+
+  TestSystem system;
+  libreallive::Archive arc(locateTestCase("Module_Str_SEEN/strcpy_0.TXT"));
+  RLMachine machine(system, arc);
+  FillMidgameState(machine);
+
+  const Serialization::SaveFormat formats[] = {
+      Serialization::SAVE_FORMAT_TEXT, Serialization::SAVE_FORMAT_BINARY};
+  for (Serialization::SaveFormat format : formats) {
+    std::string name =
+        format == Serialization::SAVE_FORMAT_TEXT ? "text" : "binary";
+    std::string game, global;
+    double save_ms = 0, load_ms = 0, global_save_ms = 0, global_load_ms = 0;
+    for (int i = 0; i < kIterations; ++i) {
+      std::ostringstream game_out, global_out;
+      BenchmarkTimer save_timer;
+      Serialization::saveGameTo(game_out, machine, format);
+      save_ms += save_timer.ElapsedMs();
+
+      BenchmarkTimer global_save_timer;
+      Serialization::saveGlobalMemoryTo(global_out, machine, format);
+      global_save_ms += global_save_timer.ElapsedMs();
+
+      game = game_out.str();
+      global = global_out.str();
+      std::istringstream game_in(game), global_in(global);
+      RLMachine load_machine(system, arc);
+
+      BenchmarkTimer load_timer;
+      Serialization::loadGameFrom(game_in, load_machine);
+      load_ms += load_timer.ElapsedMs();
+
+      BenchmarkTimer global_load_timer;
+      Serialization::loadGlobalMemoryFrom(global_in, load_machine);
+      global_load_ms += global_load_timer.ElapsedMs();
+    }
+
+    PrintBenchmarkResult(name + ": save game", save_ms / kIterations, "ms");
+    PrintBenchmarkResult(name + ": load game", load_ms / kIterations, "ms");
+    PrintBenchmarkResult(name + ": save game size", game.size() / 1024.0,
+                         "KB");
+    PrintBenchmarkResult(name + ": save global memory",
+                         global_save_ms / kIterations, "ms");
+    PrintBenchmarkResult(name + ": load global memory",
+                         global_load_ms / kIterations, "ms");
+    PrintBenchmarkResult(name + ": global memory size",
+                         global.size() / 1024.0, "KB");
+  }
+}
+
+// Quick saves are copied into preallocated slots in memory rather than
+// serialized; compared against a binary save game round trip through a
+// string.
+TEST(MachineBenchmark, QuickSaveRoundTrip) {
+  const int kIterations = 50;
+
+  TestSystem system;
+  libreallive::Archive arc(locateTestCase("Module_Str_SEEN/strcpy_0.TXT"));
+  RLMachine machine(system, arc);
+  FillMidgameState(machine);
+
+  double save_ms = 0, load_ms = 0;
+  for (int i = 0; i < kIterations; ++i) {
+    BenchmarkTimer save_timer;
+    int id = machine.quick_saves().Save(machine);
+    save_ms += save_timer.ElapsedMs();
+
+    BenchmarkTimer load_timer;
+    EXPECT_TRUE(machine.quick_saves().Load(machine, id));
+    load_ms += load_timer.ElapsedMs();
+  }
+  EXPECT_EQ(1, machine.GetIntValue(libreallive::IntMemRef('A', 1)));
+
+  double serialized_save_ms = 0, serialized_load_ms = 0;
+  for (int i = 0; i < kIterations; ++i) {
+    std::ostringstream out;
+    BenchmarkTimer save_timer;
+    Serialization::saveGameTo(out, machine);
+    serialized_save_ms += save_timer.ElapsedMs();
+
+    std::istringstream in(out.str());
+    RLMachine load_machine(system, arc);
+    BenchmarkTimer load_timer;
+    Serialization::loadGameFrom(in, load_machine);
+    serialized_load_ms += load_timer.ElapsedMs();
+  }
+
+  PrintBenchmarkResult("serialized: save", serialized_save_ms / kIterations,
+                       "ms");
+  PrintBenchmarkResult("serialized: load", serialized_load_ms / kIterations,
+                       "ms");
+  PrintBenchmarkResult("quick save: save", save_ms / kIterations, "ms");
+  PrintBenchmarkResult("quick save: load", load_ms / kIterations, "ms");
+}
+
+// Quick loads with a scene on the graphics stack: a background in DC 1, sprite
+// sheets in DCs 2 to 7 with parts copied between them and characters loaded
+// into objects, all from G00 files. Loading blits the DC copies taken by the
+// save back; once a graphics command has run since the savepoint it has to
+// replay the stack instead, loading every file again. The mock surfaces don't
+// copy pixels, so the direct restore leaves out the blits. Replaying finds
+// every image in the image cache here; building the scene the first time is
+// what it costs once they've been evicted.
+TEST(MachineBenchmark, QuickSaveGraphicsStack) {
+  const int kIterations = 20;
+  fs::path gameroot =
+      fs::temp_directory_path() / fs::unique_path("rlvm-bench-%%%%-%%%%");
+  fs::create_directories(gameroot / "g00");
+
+  std::vector<std::string> files = {"bg"};
+  for (int i = 0; i < 6; ++i)
+    files.push_back("sheet" + std::to_string(i));
+  for (int i = 0; i < 4; ++i)
+    files.push_back("chara" + std::to_string(i));
+  for (size_t i = 0; i < files.size(); ++i) {
+    Size size = i == 0 ? Size(1280, 720) : Size(640, 720);
+    std::vector<int> pixels(size.width() * size.height());
+    for (size_t j = 0; j < pixels.size(); ++j)
+      pixels[j] = ((j / 7) * 0x010203 + i) & 0xffffff;
+    WriteType0G00((gameroot / "g00" / (files[i] + ".g00")).string(),
+                  size.width(), size.height(), pixels);
+  }
+
+  TestSystem system;
+  system.gameexe()("__GAMEPATH") = gameroot.string() + "/";
+  libreallive::Archive arc(locateTestCase("Module_Str_SEEN/strcpy_0.TXT"));
+  TestMachine machine(system, arc);
+  machine.AttachModule(new GrpModule);
+  machine.AttachModule(new ObjFgCreationModule);
+  FillMidgameState(machine);
+  GraphicsSystem& graphics = system.graphics();
+  // With no threads the decoder works synchronously, as loading normally does,
+  // but actually decodes the files, which the mock loader doesn't.
+  graphics.EnableBackgroundImageDecoding(0);
+
+  BenchmarkTimer scene_timer;
+  machine.Exe("grpLoad", 0, TestMachine::Arg("bg", 1));
+  for (int dc = 2; dc < 8; ++dc) {
+    machine.Exe("grpLoad", 0,
+                TestMachine::Arg("sheet" + std::to_string(dc - 2), dc));
+  }
+  for (int dc = 2; dc < 8; ++dc)
+    machine.Exe("grpCopy", 0, TestMachine::Arg(dc, 1));
+  for (int obj = 0; obj < 16; ++obj) {
+    machine.Exe("objOfFile", 0,
+                TestMachine::Arg(obj, "chara" + std::to_string(obj % 4)));
+  }
+  double scene_ms = scene_timer.ElapsedMs();
+
+  // Exe() steps the instruction pointer past each command as if it had been
+  // read from the scenario, which runs off the end of this one; start over at
+  // the top so the savepoint is somewhere a load can resume from.
+  libreallive::Scenario* scenario = arc.GetScenario(arc.begin()->first);
+  machine.PopStackFrame();
+  machine.PushStackFrame(
+      StackFrame(scenario, scenario->begin(), StackFrame::TYPE_ROOT));
+  machine.MarkSavepoint();
+  const int stack_size = graphics.StackSize();
+
+  double save_ms = 0, direct_ms = 0, replay_ms = 0;
+  for (int i = 0; i < kIterations; ++i) {
+    BenchmarkTimer save_timer;
+    int id = machine.quick_saves().Save(machine);
+    save_ms += save_timer.ElapsedMs();
+
+    BenchmarkTimer load_timer;
+    EXPECT_TRUE(machine.quick_saves().Load(machine, id));
+    direct_ms += load_timer.ElapsedMs();
+  }
+
+  for (int i = 0; i < kIterations; ++i) {
+    machine.Exe("grpCopy", 0, TestMachine::Arg(2, 8));
+    int id = machine.quick_saves().Save(machine);
+
+    BenchmarkTimer load_timer;
+    EXPECT_TRUE(machine.quick_saves().Load(machine, id));
+    replay_ms += load_timer.ElapsedMs();
+  }
+  EXPECT_EQ(stack_size, graphics.StackSize());
+  fs::remove_all(gameroot);
+
+  PrintBenchmarkResult("graphics stack commands", stack_size, "commands");
+  PrintBenchmarkResult("building the scene from cold", scene_ms, "ms");
+  PrintBenchmarkResult("quick save: save", save_ms / kIterations, "ms");
+  PrintBenchmarkResult("quick save: load, DC copies", direct_ms / kIterations,
+                       "ms");
+  PrintBenchmarkResult("quick save: load, replaying stack",
+                       replay_ms / kIterations, "ms");
+}
+
+// How long a save game plus global memory write holds up the interpreter when
+// the SaveWriter does the serialization, compression and disk I/O, against
+// waiting for it to finish (what saving did before). The asynchronous stall
+// is the interpreter thread's CPU time, so that it doesn't count the worker
+// when they share a core.
+TEST(MachineBenchmark, AsyncSaveStall) {
+  const int kIterations = 20;
+  fs::path dir =
+      fs::temp_directory_path() / fs::unique_path("rlvm-bench-%%%%-%%%%");
+  fs::create_directories(dir);
+
+  TestSystem system;
+  libreallive::Archive arc(locateTestCase("Module_Str_SEEN/strcpy_0.TXT"));
+  RLMachine machine(system, arc);
+  FillMidgameState(machine);
+
+  double game_ms = 0, global_ms = 0, sync_ms = 0;
+  for (int i = 0; i < kIterations; ++i) {
+    ThreadCpuTimer game_timer;
+    Serialization::queueSaveGame(machine, dir / "save000.sav.gz");
+    game_ms += game_timer.ElapsedMs();
+
+    ThreadCpuTimer global_timer;
+    machine.save_writer().QueueWrite(
+        dir / "global.sav.gz", Serialization::snapshotGlobalMemory(machine));
+    global_ms += global_timer.ElapsedMs();
+    machine.WaitForPendingSaves();
+
+    BenchmarkTimer sync_timer;
+    Serialization::queueSaveGame(machine, dir / "save000.sav.gz");
+    machine.save_writer().QueueWrite(
+        dir / "global.sav.gz", Serialization::snapshotGlobalMemory(machine));
+    machine.WaitForPendingSaves();
+    sync_ms += sync_timer.ElapsedMs();
+  }
+  EXPECT_EQ(0, machine.save_writer().stats().failures);
+
+  PrintBenchmarkResult("sync: interpreter stall per save",
+                       sync_ms / kIterations, "ms");
+  PrintBenchmarkResult("async: interpreter stall per save",
+                       (game_ms + global_ms) / kIterations, "ms");
+  PrintBenchmarkResult("async: of which save game snapshot",
+                       game_ms / kIterations, "ms");
+  PrintBenchmarkResult("async: of which global memory snapshot",
+                       global_ms / kIterations, "ms");
+
+  fs::remove_all(dir);
+}
+
+// Marking a line as read and saving global memory, which RealLive games do
+// constantly, either appends a few bytes to the global memory journal or
+// rewrites the whole global memory file.
+TEST(MachineBenchmark, JournaledGlobalSave) {
+  const int kIterations = 50;
+  fs::path home =
+      fs::temp_directory_path() / fs::unique_path("rlvm-bench-%%%%-%%%%");
+  fs::create_directories(home);
+
+  // System::GameSaveDirectory() is under $HOME.
+  const char* old_home = getenv("HOME");
+  std::string saved_home = old_home ? old_home : "";
+  setenv("HOME", home.string().c_str(), 1);
+
+  TestSystem system;
+  system.gameexe().SetStringAt("REGNAME", "rlvm_bench");
+  libreallive::Archive arc(locateTestCase("Module_Str_SEEN/strcpy_0.TXT"));
+  fs::path journal_path;
+  fs::path checkpoint_path;
+  double journal_ms = 0, checkpoint_ms = 0;
+  uintmax_t journal_bytes = 0, checkpoint_bytes = 0;
+  {
+    RLMachine machine(system, arc);
+    Serialization::loadGlobalMemory(machine);
+    FillMidgameState(machine);
+    Serialization::saveGlobalMemory(machine);
+    machine.WaitForPendingSaves();
+
+    journal_path = Serialization::buildGlobalJournalFilename(machine);
+    checkpoint_path = Serialization::buildGlobalMemoryFilename(machine);
+
+    for (int i = 0; i < kIterations; ++i) {
+      BenchmarkTimer timer;
+      machine.memory().RecordKidoku(500, i);
+      Serialization::saveGlobalMemory(machine);
+      machine.WaitForPendingSaves();
+      journal_ms += timer.ElapsedMs();
+    }
+    EXPECT_EQ(0, machine.save_writer().stats().failures);
+    journal_bytes = fs::file_size(journal_path);
+  }
+
+  // Startup replays the journal on top of the checkpoint.
+  {
+    RLMachine machine(system, arc);
+    Serialization::loadGlobalMemory(machine);
+    for (int i = 0; i < kIterations; ++i)
+      EXPECT_TRUE(machine.memory().HasBeenRead(500, i));
+    EXPECT_TRUE(machine.memory().HasBeenRead(199, 998));
+  }
+
+  // Without loadGlobalMemory(), the journal is off and every save is a
+  // checkpoint.
+  {
+    RLMachine machine(system, arc);
+    FillMidgameState(machine);
+    for (int i = 0; i < kIterations; ++i) {
+      BenchmarkTimer timer;
+      machine.memory().RecordKidoku(500, i);
+      Serialization::saveGlobalMemory(machine);
+      machine.WaitForPendingSaves();
+      checkpoint_ms += timer.ElapsedMs();
+    }
+    EXPECT_EQ(0, machine.save_writer().stats().failures);
+    EXPECT_FALSE(fs::exists(journal_path));
+    checkpoint_bytes = fs::file_size(checkpoint_path) * kIterations;
+  }
+
+  if (old_home)
+    setenv("HOME", saved_home.c_str(), 1);
+  else
+    unsetenv("HOME");
+  fs::remove_all(home);
+
+  PrintBenchmarkResult("checkpoint: bytes written per save",
+                       static_cast<double>(checkpoint_bytes) / kIterations,
+                       "bytes");
+  PrintBenchmarkResult("journal: bytes written per save",
+                       static_cast<double>(journal_bytes) / kIterations,
+                       "bytes");
+  PrintBenchmarkResult("checkpoint: time per save", checkpoint_ms / kIterations,
+                       "ms");
+  PrintBenchmarkResult("journal: time per save", journal_ms / kIterations,
+                       "ms");
+}
+
+// Heap allocations made while running the Module_Str scripts, which do little
+// but copy, concatenate and slice strings in string memory.
+TEST(MachineBenchmark, StringBankAllocations) {
+  std::vector<std::unique_ptr<BenchmarkMachine>> machines;
+  long instructions = LoadMachines(LocateModuleSEENs("Module_Str_"), machines);
+  ASSERT_FALSE(machines.empty());
+
+  // One untimed round so every scenario is parsed and every bank has grown
+  // to its working size.
+  size_t count = 0, bytes = 0;
+  double ms = 0;
+  {
+    ScopedSilence silence;
+    for (int round = 0; round <= kRounds; ++round) {
+      for (const std::unique_ptr<BenchmarkMachine>& m : machines) {
+        m->Rewind();
+
+        AllocationCounter counter;
+        BenchmarkTimer timer;
+        m->machine.ExecuteUntilHalted();
+        if (round > 0) {
+          ms += timer.ElapsedMs();
+          count += counter.Get().count;
+          bytes += counter.Get().bytes;
+        }
+      }
+    }
+  }
+
+  long commands = 0;
+  {
+    ScopedSilence silence;
+    for (const std::unique_ptr<BenchmarkMachine>& m : machines)
+      commands += CountCommands(m->seen);
+  }
+
+  double total = double(instructions) * kRounds;
+  PrintBenchmarkResult("scripts", machines.size(), "");
+  PrintBenchmarkResult("instructions per run", instructions, "");
+  PrintBenchmarkResult("commands per run", commands, "");
+  PrintBenchmarkResult("allocations per instruction", count / total, "");
+  PrintBenchmarkResult("allocations per command",
+                       count / (double(commands) * kRounds), "");
+  PrintBenchmarkResult("bytes allocated per instruction", bytes / total, "");
+  PrintBenchmarkResult("instructions/sec", total / (ms / 1000.0), "");
+}
+
+// The string memory writes behind StringBankAllocations, without the text
+// output that most of its allocations come from. Each pass starts from a fresh
+// local memory, as loading a game does, and assigns bytecode constants, copies
+// variables and stores computed strings.
+TEST(MachineBenchmark, StringMemoryWrites) {
+  const int kPasses = 200;
+  const int kLocations = 300;
+
+  TestSystem system;
+  libreallive::Archive arc(locateTestCase("Module_Str_SEEN/strcpy_0.TXT"));
+  RLMachine machine(system, arc);
+
+  libreallive::ExpressionPiece short_constant =
+      libreallive::ExpressionPiece::StrConstant("valid");
+  libreallive::ExpressionPiece long_constant =
+      libreallive::ExpressionPiece::StrConstant(
+          "A constant too long for any small string buffer");
+  const std::string computed(40, '\x82');
+
+  AllocationCounter counter;
+  BenchmarkTimer timer;
+  for (int pass = 0; pass < kPasses; ++pass) {
+    Memory memory(machine, 0);
+    for (int i = 0; i < kLocations; ++i) {
+      const libreallive::ExpressionPiece& constant =
+          i % 2 ? long_constant : short_constant;
+      memory.SetStringValue(libreallive::STRS_LOCATION, i,
+                            constant.GetStringValue(machine));
+      memory.SetStringValue(libreallive::STRS_LOCATION, kLocations + i,
+                            long_constant.GetStringValue(machine));
+      memory.SetStringValue(
+          libreallive::STRS_LOCATION, 2 * kLocations + i,
+          memory.GetStringValue(libreallive::STRS_LOCATION, kLocations + i));
+      memory.SetStringValue(libreallive::STRS_LOCATION, 3 * kLocations + i,
+                            computed);
+    }
+  }
+  double ms = timer.ElapsedMs();
+  AllocationCounts counts = counter.Get();
+
+  double writes = double(kPasses) * kLocations * 4;
+  PrintBenchmarkResult("allocations per write", counts.count / writes, "");
+  PrintBenchmarkResult("bytes allocated per write", counts.bytes / writes, "");
+  PrintBenchmarkResult("writes/sec", writes / (ms / 1000.0), "");
+}
@@ -26,6 +26,7 @@
 
 #include "gtest/gtest.h"
 
+#include "machine/quick_save_ring.h"
 #include "machine/rlmachine.h"
 #include "modules/module_grp.h"
 #include "systems/base/colour.h"
@@ -33,6 +34,8 @@
 
 #include "test_utils.h"
 
+using ::testing::_;
+
 class MediumGrpTest : public FullSystemTest {
  protected:
   MediumGrpTest() { rlmachine.AttachModule(new GrpModule); }
@@ -133,3 +136,39 @@ TEST_F(MediumGrpTest, TestFade_7) {
   rlmachine.Exe(
       "recFade", 7, TestMachine::Arg(10, 10, 20, 20, 128, 128, 128, 0));
 }
+
+// A quick save taken with nothing drawn since the savepoint carries copies of
+// the DCs, which are blitted back instead of loading the files again.
+TEST_F(MediumGrpTest, QuickLoadRestoresDCsWithoutReplay) {
+  std::shared_ptr<MockSurface> image(
+      MockSurface::Create("image", Size(200, 100)));
+  EXPECT_CALL(*image, BlitToSurface(_, _, _, _, _)).Times(1);
+  system.graphics().InjectSurface("image", image);
+
+  rlmachine.Exe("grpLoad", 0, TestMachine::Arg("image", 3));
+  rlmachine.MarkSavepoint();
+  int id = rlmachine.quick_saves().Save(rlmachine);
+
+  system.graphics().FreeDC(3);
+  ASSERT_TRUE(rlmachine.quick_saves().Load(rlmachine, id));
+  EXPECT_TRUE(system.graphics().IsDCAllocated(3));
+  EXPECT_EQ(Size(200, 100), system.graphics().GetDC(3)->GetSize());
+  EXPECT_EQ(1, system.graphics().StackSize());
+}
+
+// Once a graphics command has run since the savepoint, the DCs no longer match
+// the saved stack, so loading falls back to replaying it.
+TEST_F(MediumGrpTest, QuickLoadReplaysStackChangedSinceSavepoint) {
+  std::shared_ptr<MockSurface> image(
+      MockSurface::Create("image", Size(200, 100)));
+  EXPECT_CALL(*image, BlitToSurface(_, _, _, _, _)).Times(2);
+  system.graphics().InjectSurface("image", image);
+
+  rlmachine.Exe("grpLoad", 0, TestMachine::Arg("image", 3));
+  rlmachine.MarkSavepoint();
+  rlmachine.Exe("grpCopy", 0, TestMachine::Arg(3, 4));
+  int id = rlmachine.quick_saves().Save(rlmachine);
+
+  ASSERT_TRUE(rlmachine.quick_saves().Load(rlmachine, id));
+  EXPECT_EQ(1, system.graphics().StackSize());
+}
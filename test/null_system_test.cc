@@ -0,0 +1,145 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+#include "gtest/gtest.h"
+
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "libreallive/archive.h"
+#include "libreallive/gameexe.h"
+#include "machine/rlmachine.h"
+#include "modules/modules.h"
+#include "systems/base/event_system.h"
+#include "systems/base/graphics_system.h"
+#include "systems/base/surface.h"
+#include "systems/null/null_system.h"
+#include "test_utils.h"
+
+namespace fs = boost::filesystem;
+
+namespace {
+
+void PutLittleEndian(std::string& out, int value, int bytes) {
+  for (int i = 0; i < bytes; ++i)
+    out.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+}
+
+// Writes the header of a type 2 G00 with |regions| (x1, y1, x2, y2 each) and
+// no pixel data, which is all a NullSystem ever reads.
+void WriteG00(const fs::path& path,
+              int width,
+              int height,
+              const std::vector<std::vector<int>>& regions) {
+  std::string data(1, 2);
+  PutLittleEndian(data, width, 2);
+  PutLittleEndian(data, height, 2);
+  PutLittleEndian(data, regions.size(), 4);
+  for (const std::vector<int>& region : regions) {
+    for (int coordinate : region)
+      PutLittleEndian(data, coordinate, 4);
+    PutLittleEndian(data, 0, 4);
+    PutLittleEndian(data, 0, 4);
+  }
+  PutLittleEndian(data, 8, 4);
+  PutLittleEndian(data, 0, 4);
+
+  fs::ofstream file(path, std::ios::binary);
+  file.write(data.data(), data.size());
+}
+
+}  // namespace
+
+class NullSystemTest : public ::testing::Test {
+ protected:
+  NullSystemTest()
+      : gameroot(fs::temp_directory_path() /
+                 fs::unique_path("rlvm-null-%%%%-%%%%")) {
+    fs::create_directories(gameroot / "g00");
+    gameexe("__GAMEPATH") = gameroot.string() + "/";
+    gameexe("FOLDNAME.G00") = "G00";
+    gameexe("REGNAME") = "rlvm-null-system-test";
+    gameexe("SCREENSIZE_MOD") = 0;
+  }
+
+  ~NullSystemTest() { fs::remove_all(gameroot); }
+
+  fs::path gameroot;
+  Gameexe gameexe;
+};
+
+TEST_F(NullSystemTest, ClockOnlyMovesWhenReadOrWaitedOn) {
+  NullSystem system(gameexe);
+  EventSystem& event = system.event();
+
+  EXPECT_EQ(0, event.GetTicks());
+  EXPECT_EQ(1, event.GetTicks());
+  event.Wait(100);
+  EXPECT_EQ(102, event.GetTicks());
+}
+
+TEST_F(NullSystemTest, ImagesAreSizedFromTheirHeaders) {
+  WriteG00(gameroot / "g00" / "buttons.g00", 200, 100,
+           {{0, 0, 99, 49}, {100, 50, 199, 99}});
+  NullSystem system(gameexe);
+
+  std::shared_ptr<const Surface> surface =
+      system.graphics().GetSurfaceNamed("buttons");
+  ASSERT_TRUE(surface != nullptr);
+  EXPECT_EQ(Size(200, 100), surface->GetSize());
+  ASSERT_EQ(2, surface->GetNumPatterns());
+  EXPECT_EQ(Rect(100, 50, Size(100, 50)), surface->GetPattern(1).rect);
+}
+
+// graphics2.TXT spins on a frame counter for eight seconds of game time and
+// then pauses for a click. Driven the way the main loop drives it, it should
+// run to the end without any real waiting.
+TEST_F(NullSystemTest, RunsTimedScriptsToCompletion) {
+  WriteG00(gameroot / "g00" / "BG053.g00", 640, 480, {{0, 0, 639, 479}});
+  WriteG00(gameroot / "g00" / "CGAK10A.g00", 640, 480, {{0, 0, 639, 479}});
+
+  NullSystem system(gameexe);
+  system.set_force_fast_forward();
+  libreallive::Archive arc(locateTestCase("Module_Jmp_SEEN/graphics2.TXT"));
+  RLMachine machine(system, arc);
+  AddAllModules(machine);
+
+  int slices = 0;
+  while (!machine.halted() && slices < 100000) {
+    system.Run(machine);
+    machine.ExecuteBatch(10);
+    system.event().Wait(10);
+    system.set_force_wait(false);
+    slices++;
+  }
+
+  EXPECT_TRUE(machine.halted());
+  EXPECT_GE(system.event().GetTicks(), 8000);
+}
@@ -27,22 +27,45 @@
 
 #include "gtest/gtest.h"
 
+#include <boost/archive/text_oarchive.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
+
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <sstream>
 #include <utility>
 #include <string>
 #include <vector>
 
+#include "long_operations/pause_long_operation.h"
+#include "machine/global_memory_journal.h"
 #include "machine/memory.h"
+#include "machine/parameter_preparser.h"
+#include "machine/quick_save_ring.h"
 #include "machine/rlmachine.h"
+#include "machine/rlmodule.h"
+#include "machine/rloperation.h"
+#include "machine/save_writer.h"
 #include "machine/serialization.h"
 #include "modules/module_str.h"
+#include "systems/base/graphics_object.h"
+#include "systems/base/graphics_system.h"
+#include "systems/base/sound_system.h"
+#include "systems/base/system.h"
+#include "systems/base/text_system.h"
 #include "utilities/exception.h"
+#include "libreallive/bytecode.h"
 #include "libreallive/intmemref.h"
 #include "test_utils.h"
 
 using namespace std;
 using namespace libreallive;
 
+namespace fs = boost::filesystem;
+
 class RLMachineTest : public FullSystemTest {
  protected:
   void setIntMemoryCountingFrom(RLMachine& saveMachine,
@@ -276,3 +299,639 @@ TEST_F(RLMachineTest, SerializationOfSavepointValues) {
     verifyStrMemoryCountingFrom(loadMachine, STRS_LOCATION, 0);
   }
 }
+
+// Saves written in the old text format must still load.
+TEST_F(RLMachineTest, SerializationOfTextSaves) {
+  stringstream global_ss, local_ss;
+  libreallive::Archive arc(locateTestCase("Module_Str_SEEN/strcpy_0.TXT"));
+  {
+    RLMachine saveMachine(system, arc);
+    setIntMemoryCountingFrom(saveMachine, GLOBAL_INTEGER_BANKS, 0);
+    setIntMemoryCountingFrom(saveMachine, LOCAL_INTEGER_BANKS, 10);
+    setStrMemoryCountingFrom(saveMachine, STRS_LOCATION, 20);
+    saveMachine.MarkSavepoint();
+
+    Serialization::saveGlobalMemoryTo(
+        global_ss, saveMachine, Serialization::SAVE_FORMAT_TEXT);
+    Serialization::saveGameTo(
+        local_ss, saveMachine, Serialization::SAVE_FORMAT_TEXT);
+  }
+
+  EXPECT_EQ(Serialization::SAVE_FORMAT_TEXT,
+            Serialization::readSaveFormat(local_ss));
+
+  {
+    RLMachine loadMachine(system, arc);
+    Serialization::loadGlobalMemoryFrom(global_ss, loadMachine);
+    Serialization::loadGameFrom(local_ss, loadMachine);
+    verifyIntMemoryCountingFrom(loadMachine, GLOBAL_INTEGER_BANKS, 0);
+    verifyIntMemoryCountingFrom(loadMachine, LOCAL_INTEGER_BANKS, 10);
+    verifyStrMemoryCountingFrom(loadMachine, STRS_LOCATION, 20);
+  }
+}
+
+// Binary snapshots spell out their integers byte by byte, so they read back
+// the same on machines with a different byte order or int size.
+TEST_F(RLMachineTest, BinarySnapshotIsLittleEndian) {
+  libreallive::Archive arc(locateTestCase("Module_Str_SEEN/strcpy_0.TXT"));
+  RLMachine machine(system, arc);
+  machine.SetIntValue(IntMemRef('G', 0), 0x01020304);
+  machine.SetIntValue(IntMemRef('G', 1), -2);
+
+  std::string snapshot = Serialization::snapshotGlobalMemory(machine);
+  const unsigned char expected[] = {
+      3,    0,    0,    0,       // global version
+      0,    0,    0,    0,       // journal generation
+      0xd0, 0x07, 0x00, 0x00,    // intG count
+      0x04, 0x03, 0x02, 0x01,    // intG[0]
+      0xfe, 0xff, 0xff, 0xff};   // intG[1]
+  ASSERT_LE(sizeof(expected), snapshot.size());
+  EXPECT_EQ(0, memcmp(expected, snapshot.data(), sizeof(expected)));
+}
+
+// Save files on disk are read back through a memory mapping.
+TEST_F(RLMachineTest, SerializationThroughMappedFile) {
+  fs::path path =
+      fs::temp_directory_path() / fs::unique_path("rlvm-save-%%%%-%%%%");
+  libreallive::Archive arc(locateTestCase("Module_Str_SEEN/strcpy_0.TXT"));
+  {
+    RLMachine saveMachine(system, arc);
+    setIntMemoryCountingFrom(saveMachine, LOCAL_INTEGER_BANKS, 0);
+    saveMachine.MarkSavepoint();
+
+    fs::ofstream file(path, std::ios::binary);
+    Serialization::saveGameTo(file, saveMachine);
+  }
+
+  {
+    Serialization::MappedFileStream file;
+    ASSERT_TRUE(Serialization::openMappedFile(path, file));
+    RLMachine loadMachine(system, arc);
+    Serialization::loadGameFrom(file, loadMachine);
+    verifyIntMemoryCountingFrom(loadMachine, LOCAL_INTEGER_BANKS, 0);
+  }
+
+  fs::remove(path);
+
+  Serialization::MappedFileStream missing;
+  EXPECT_FALSE(Serialization::openMappedFile(path, missing));
+}
+
+// Saves are snapshotted on the interpreter thread, then serialized and written
+// to disk by the SaveWriter, which replaces the destination atomically.
+TEST_F(RLMachineTest, SaveWriterWritesSnapshots) {
+  fs::path path =
+      fs::temp_directory_path() / fs::unique_path("rlvm-save-%%%%-%%%%");
+  libreallive::Archive arc(locateTestCase("Module_Str_SEEN/strcpy_0.TXT"));
+  {
+    RLMachine saveMachine(system, arc);
+    GraphicsObject& obj = system.graphics().GetObject(OBJ_FG, 0);
+    setIntMemoryCountingFrom(saveMachine, LOCAL_INTEGER_BANKS, 0);
+    obj.SetX(10);
+    saveMachine.MarkSavepoint();
+    Serialization::queueSaveGame(saveMachine, path);
+
+    // Later changes aren't part of the queued snapshot.
+    setIntMemoryCountingFrom(saveMachine, LOCAL_INTEGER_BANKS, 5);
+    obj.SetX(20);
+    saveMachine.MarkSavepoint();
+
+    EXPECT_TRUE(saveMachine.save_writer().has_pending_writes());
+    saveMachine.WaitForPendingSaves();
+    EXPECT_FALSE(saveMachine.save_writer().has_pending_writes());
+    EXPECT_EQ(1, saveMachine.save_writer().stats().writes);
+  }
+
+  fs::path temporary = path;
+  temporary += ".tmp";
+  EXPECT_FALSE(fs::exists(temporary));
+
+  {
+    Serialization::MappedFileStream file;
+    ASSERT_TRUE(Serialization::openMappedFile(path, file));
+    RLMachine loadMachine(system, arc);
+    Serialization::loadGameFrom(file, loadMachine);
+    verifyIntMemoryCountingFrom(loadMachine, LOCAL_INTEGER_BANKS, 0);
+    EXPECT_EQ(10, system.graphics().GetObject(OBJ_FG, 0).x());
+  }
+
+  fs::remove(path);
+}
+
+// The SaveWriter serializes copies of the machine's state through stand-ins
+// for the classes that load it, which must write exactly what archiving the
+// classes themselves would.
+TEST_F(RLMachineTest, GameSnapshotArchivesLikeTheMachine) {
+  libreallive::Archive arc(locateTestCase("Module_Str_SEEN/strcpy_0.TXT"));
+  RLMachine machine(system, arc);
+  GraphicsSystem& graphics = system.graphics();
+  graphics.GetObject(OBJ_FG, 3).SetVisible(1);
+  graphics.GetObject(OBJ_FG, 3).SetX(40);
+  graphics.GetObject(OBJ_BG, 7).SetAlpha(128);
+  graphics.AddGraphicsStackCommand("command");
+  machine.MarkSavepoint();
+
+  std::ostringstream oss;
+  {
+    boost::archive::text_oarchive oa(oss);
+    oa << const_cast<const RLMachine&>(machine)
+       << const_cast<const System&>(machine.system())
+       << const_cast<const GraphicsSystem&>(machine.system().graphics())
+       << const_cast<const TextSystem&>(machine.system().text())
+       << const_cast<const SoundSystem&>(machine.system().sound());
+  }
+  const std::string archive = oss.str();
+
+  // The archive is the last thing in the payload.
+  std::string payload = Serialization::snapshotGame(machine);
+  ASSERT_GT(payload.size(), archive.size());
+  EXPECT_EQ(archive, payload.substr(payload.size() - archive.size()));
+}
+
+// A write that fails is reported and leaves the previous file alone.
+TEST_F(RLMachineTest, SaveWriterKeepsPreviousFileOnFailure) {
+  fs::path path =
+      fs::temp_directory_path() / fs::unique_path("rlvm-save-%%%%-%%%%");
+  fs::path temporary = path;
+  temporary += ".tmp";
+  {
+    fs::ofstream file(path, std::ios::binary);
+    file << "previous";
+  }
+  // Nothing can be opened for writing where a directory is in the way.
+  fs::create_directory(temporary);
+
+  libreallive::Archive arc(locateTestCase("Module_Str_SEEN/strcpy_0.TXT"));
+  RLMachine saveMachine(system, arc);
+  saveMachine.save_writer().QueueWrite(
+      path, Serialization::snapshotGame(saveMachine));
+  saveMachine.WaitForPendingSaves();
+
+  EXPECT_EQ(0, saveMachine.save_writer().stats().writes);
+  EXPECT_EQ(1, saveMachine.save_writer().stats().failures);
+  ASSERT_EQ(1u, saveMachine.save_writer().errors().size());
+
+  std::string contents;
+  fs::ifstream(path) >> contents;
+  EXPECT_EQ("previous", contents);
+
+  fs::remove(temporary);
+  fs::remove(path);
+}
+
+// Changes to global memory are journaled once the journal is enabled, and
+// replaying the journal reproduces them on top of an older copy.
+TEST_F(RLMachineTest, GlobalMemoryJournalReplaysChanges) {
+  libreallive::Archive arc(locateTestCase("Module_Str_SEEN/strcpy_0.TXT"));
+  RLMachine saveMachine(system, arc);
+  GlobalMemoryJournal& journal = saveMachine.memory().global().journal;
+
+  // Nothing is kept until the journal is enabled.
+  saveMachine.SetIntValue(IntMemRef('G', 1), 10);
+  EXPECT_TRUE(journal.TakePending().empty());
+
+  journal.Enable();
+  saveMachine.SetIntValue(IntMemRef('G', 2), 20);
+  saveMachine.SetIntValue(IntMemRef('Z', "4b", 9), 0xf);
+  saveMachine.SetIntValue(IntMemRef('A', 3), 30);
+  saveMachine.memory().SetStringValue(STRM_LOCATION, 4, "global");
+  saveMachine.memory().SetName(5, "name");
+  saveMachine.memory().RecordKidoku(6, 7);
+  saveMachine.memory().RecordKidoku(6, 7);
+
+  std::string records = journal.TakePending();
+  EXPECT_FALSE(records.empty());
+
+  RLMachine loadMachine(system, arc);
+  std::istringstream iss(records);
+  EXPECT_EQ(records.size(),
+            GlobalMemoryJournal::Replay(iss, journal.generation(),
+                                        loadMachine.memory().global()));
+
+  EXPECT_EQ(0, loadMachine.GetIntValue(IntMemRef('G', 1)));
+  EXPECT_EQ(20, loadMachine.GetIntValue(IntMemRef('G', 2)));
+  EXPECT_EQ(0xf, loadMachine.GetIntValue(IntMemRef('Z', "4b", 9)));
+  EXPECT_EQ(0, loadMachine.GetIntValue(IntMemRef('A', 3)));
+  EXPECT_EQ("global",
+            loadMachine.memory().GetStringValue(STRM_LOCATION, 4));
+  EXPECT_EQ("name", loadMachine.memory().GetName(5));
+  EXPECT_TRUE(loadMachine.memory().HasBeenRead(6, 7));
+
+  // The second RecordKidoku() of the same line didn't grow the journal.
+  saveMachine.memory().RecordKidoku(6, 7);
+  EXPECT_TRUE(journal.TakePending().empty());
+}
+
+// A journal whose last append was cut short replays every whole record before
+// the tear.
+TEST_F(RLMachineTest, GlobalMemoryJournalStopsAtTornRecord) {
+  libreallive::Archive arc(locateTestCase("Module_Str_SEEN/strcpy_0.TXT"));
+  RLMachine saveMachine(system, arc);
+  GlobalMemoryJournal& journal = saveMachine.memory().global().journal;
+  journal.Enable();
+
+  saveMachine.SetIntValue(IntMemRef('G', 2), 20);
+  std::string first = journal.TakePending();
+  saveMachine.SetIntValue(IntMemRef('G', 3), 30);
+  std::string second = journal.TakePending();
+
+  std::string torn = first + second.substr(0, second.size() - 2);
+  RLMachine loadMachine(system, arc);
+  std::istringstream iss(torn);
+  EXPECT_EQ(first.size(),
+            GlobalMemoryJournal::Replay(iss, journal.generation(),
+                                        loadMachine.memory().global()));
+  EXPECT_EQ(20, loadMachine.GetIntValue(IntMemRef('G', 2)));
+  EXPECT_EQ(0, loadMachine.GetIntValue(IntMemRef('G', 3)));
+
+  // Something that isn't a journal at all applies nothing.
+  std::istringstream garbage("not a journal");
+  EXPECT_EQ(
+      0u, GlobalMemoryJournal::Replay(garbage, journal.generation(),
+                                      loadMachine.memory().global()));
+}
+
+// Saves append to the journal until something it doesn't track changes, a
+// write fails, or it grows past the compaction threshold.
+TEST(GlobalMemoryJournalTest, AppendsOnlyOnTopOfMatchingCheckpoint) {
+  GlobalMemoryJournal journal;
+  journal.Enable();
+  EXPECT_FALSE(journal.CanAppend("settings", 0));
+
+  journal.MarkCheckpointed("settings", 0);
+  EXPECT_TRUE(journal.CanAppend("settings", 0));
+  EXPECT_FALSE(journal.CanAppend("changed settings", 0));
+  EXPECT_FALSE(journal.CanAppend("settings", 1));
+
+  std::string value(1024, 'x');
+  size_t written = 0;
+  while (written < GlobalMemoryJournal::kCompactionThreshold) {
+    journal.RecordString(0, value);
+    written += journal.TakePending().size();
+  }
+  journal.RecordString(0, value);
+  EXPECT_FALSE(journal.CanAppend("settings", 0));
+
+  journal.MarkCheckpointed("settings", 0);
+  EXPECT_TRUE(journal.CanAppend("settings", 0));
+  EXPECT_TRUE(journal.TakePending().empty());
+}
+
+// Appends accumulate in the journal file, and the checkpoint that supersedes
+// them deletes it.
+TEST_F(RLMachineTest, SaveWriterAppendsAndDeletesSupersededJournal) {
+  fs::path path =
+      fs::temp_directory_path() / fs::unique_path("rlvm-save-%%%%-%%%%");
+  fs::path journal = path;
+  journal += ".journal";
+
+  libreallive::Archive arc(locateTestCase("Module_Str_SEEN/strcpy_0.TXT"));
+  RLMachine saveMachine(system, arc);
+  saveMachine.save_writer().QueueAppend(journal, "abc");
+  saveMachine.save_writer().QueueAppend(journal, "def");
+  saveMachine.WaitForPendingSaves();
+  EXPECT_EQ(2, saveMachine.save_writer().stats().writes);
+
+  std::string contents;
+  fs::ifstream(journal) >> contents;
+  EXPECT_EQ("abcdef", contents);
+
+  saveMachine.save_writer().QueueWrite(
+      path, Serialization::snapshotGlobalMemory(saveMachine), journal);
+  saveMachine.WaitForPendingSaves();
+  EXPECT_EQ(3, saveMachine.save_writer().stats().writes);
+  EXPECT_TRUE(fs::exists(path));
+  EXPECT_FALSE(fs::exists(journal));
+
+  fs::remove(path);
+}
+
+// Each checkpoint starts a new generation, and a journal written on top of
+// an earlier checkpoint isn't replayed.
+TEST(GlobalMemoryJournalTest, IgnoresJournalsFromOtherCheckpoints) {
+  GlobalMemoryJournal journal;
+  journal.Enable();
+  journal.MarkCheckpointed("settings", 0);
+  uint32_t first = journal.generation();
+  journal.RecordInt(INTG_LOCATION, 1, 10);
+  std::string records = journal.TakePending();
+
+  journal.MarkCheckpointed("settings", 0);
+  EXPECT_NE(first, journal.generation());
+
+  std::unique_ptr<GlobalMemory> memory(new GlobalMemory);
+  std::istringstream stale(records);
+  EXPECT_EQ(0u, GlobalMemoryJournal::Replay(stale, journal.generation(),
+                                            *memory));
+  EXPECT_EQ(0, memory->intG[1]);
+
+  std::istringstream current(records);
+  EXPECT_EQ(records.size(),
+            GlobalMemoryJournal::Replay(current, first, *memory));
+  EXPECT_EQ(10, memory->intG[1]);
+}
+
+// A crash after a checkpoint is renamed into place, but before the journal it
+// supersedes is deleted, leaves that journal behind. Loading doesn't replay it
+// over the newer checkpoint.
+TEST_F(RLMachineTest, StaleGlobalJournalIsIgnoredAfterCrash) {
+  fs::path home =
+      fs::temp_directory_path() / fs::unique_path("rlvm-home-%%%%-%%%%");
+  fs::create_directories(home);
+
+  // System::GameSaveDirectory() is under $HOME.
+  const char* old_home = getenv("HOME");
+  std::string saved_home = old_home ? old_home : "";
+  setenv("HOME", home.string().c_str(), 1);
+  system.gameexe().SetStringAt("REGNAME", "rlvm_stale_journal_test");
+
+  libreallive::Archive arc(locateTestCase("Module_Str_SEEN/strcpy_0.TXT"));
+  fs::path journal_path;
+  std::string stale_journal;
+  {
+    RLMachine machine(system, arc);
+    Serialization::loadGlobalMemory(machine);
+    Serialization::saveGlobalMemory(machine);
+    machine.SetIntValue(IntMemRef('G', 0), 1);
+    Serialization::saveGlobalMemory(machine);
+    machine.WaitForPendingSaves();
+
+    journal_path = Serialization::buildGlobalJournalFilename(machine);
+    ASSERT_TRUE(fs::exists(journal_path));
+    std::ostringstream contents;
+    contents << fs::ifstream(journal_path, std::ios::binary).rdbuf();
+    stale_journal = contents.str();
+
+    // Changing a setting the journal doesn't track forces a checkpoint.
+    machine.SetIntValue(IntMemRef('G', 0), 2);
+    system.graphics().globals().show_weather ^= 1;
+    Serialization::saveGlobalMemory(machine);
+    machine.WaitForPendingSaves();
+    EXPECT_FALSE(fs::exists(journal_path));
+    EXPECT_EQ(0, machine.save_writer().stats().failures);
+  }
+
+  fs::ofstream(journal_path, std::ios::binary) << stale_journal;
+  {
+    RLMachine machine(system, arc);
+    Serialization::loadGlobalMemory(machine);
+    EXPECT_EQ(2, machine.GetIntValue(IntMemRef('G', 0)));
+  }
+
+  if (old_home)
+    setenv("HOME", saved_home.c_str(), 1);
+  else
+    unsetenv("HOME");
+  fs::remove_all(home);
+}
+
+// Writes through the bit-packed views (intA4b[], etc.) after a savepoint are
+// reverted in the save like whole-integer writes.
+TEST_F(RLMachineTest, SerializationOfSavepointBitValues) {
+  stringstream ss;
+  libreallive::Archive arc(locateTestCase("Module_Str_SEEN/strcpy_0.TXT"));
+  {
+    RLMachine saveMachine(system, arc);
+    saveMachine.SetIntValue(IntMemRef('A', 10), 0x1234);
+    saveMachine.MarkSavepoint();
+
+    saveMachine.SetIntValue(IntMemRef('A', "4b", 80), 0xf);
+    saveMachine.SetIntValue(IntMemRef('A', "4b", 81), 0xf);
+    saveMachine.SetIntValue(IntMemRef('A', 10), 7);
+    EXPECT_EQ(7, saveMachine.GetIntValue(IntMemRef('A', 10)));
+
+    Serialization::saveGameTo(ss, saveMachine);
+  }
+
+  {
+    RLMachine loadMachine(system, arc);
+    Serialization::loadGameFrom(ss, loadMachine);
+    EXPECT_EQ(0x1234, loadMachine.GetIntValue(IntMemRef('A', 10)));
+  }
+}
+
+// A quick save holds the state at the last savepoint, like a save game, and
+// loading it puts that state back.
+TEST_F(RLMachineTest, QuickSaveRestoresSavepointState) {
+  GraphicsSystem& graphics = system.graphics();
+  rlmachine.SetIntValue(IntMemRef('A', 10), 5);
+  rlmachine.SetStringValue(STRS_LOCATION, 3, "before");
+  graphics.GetObject(OBJ_FG, 1).SetX(10);
+  rlmachine.MarkSavepoint();
+  int savepoint_stack_size = rlmachine.GetStackSize();
+
+  rlmachine.SetIntValue(IntMemRef('A', 10), 7);
+  int id = rlmachine.quick_saves().Save(rlmachine);
+  EXPECT_EQ(id, rlmachine.quick_saves().latest());
+
+  rlmachine.SetStringValue(STRS_LOCATION, 3, "after");
+  graphics.GetObject(OBJ_FG, 1).SetX(20);
+  graphics.GetObject(OBJ_FG, 2).SetVisible(1);
+  rlmachine.MarkSavepoint();
+
+  ASSERT_TRUE(rlmachine.quick_saves().Load(rlmachine, id));
+  EXPECT_EQ(5, rlmachine.GetIntValue(IntMemRef('A', 10)));
+  EXPECT_EQ("before", rlmachine.memory().GetStringValue(STRS_LOCATION, 3));
+  EXPECT_EQ(10, graphics.GetObject(OBJ_FG, 1).x());
+  EXPECT_EQ(0, graphics.GetObject(OBJ_FG, 2).visible());
+  EXPECT_EQ(savepoint_stack_size, rlmachine.GetStackSize());
+
+  // The restored state is the new savepoint, so it saves the same way.
+  rlmachine.SetIntValue(IntMemRef('A', 10), 9);
+  int second = rlmachine.quick_saves().Save(rlmachine);
+  rlmachine.SetIntValue(IntMemRef('A', 10), 11);
+  ASSERT_TRUE(rlmachine.quick_saves().Load(rlmachine, second));
+  EXPECT_EQ(5, rlmachine.GetIntValue(IntMemRef('A', 10)));
+}
+
+// Running line and kidoku markers and expressions in the same step as the
+// element after them ends in the same state as running one element per step,
+// and line actions still see the state as of their line.
+TEST_F(RLMachineTest, FusedInstructionsMatchUnfused) {
+  libreallive::Archive expressions(
+      locateTestCase("ExpressionTest_SEEN/basicOperators.TXT"));
+  int scene = expressions.begin()->first;
+  TestSystem unfused_system;
+  RLMachine fused(system, expressions);
+  RLMachine unfused(unfused_system, expressions);
+  unfused.set_fuse_instructions(false);
+
+  // Line 26 is "intA[1] += 1", which comes after "intA[1] = intA[0]".
+  std::vector<pair<int, int>> fused_seen, unfused_seen;
+  fused.AddLineAction(scene, 26, [&]() {
+    fused_seen.emplace_back(fused.line_number(),
+                            fused.GetIntValue(IntMemRef('A', 1)));
+  });
+  unfused.AddLineAction(scene, 26, [&]() {
+    unfused_seen.emplace_back(unfused.line_number(),
+                              unfused.GetIntValue(IntMemRef('A', 1)));
+  });
+
+  int fused_steps = 0, unfused_steps = 0;
+  while (!fused.halted()) {
+    fused.ExecuteNextInstruction();
+    fused_steps++;
+  }
+  while (!unfused.halted()) {
+    unfused.ExecuteNextInstruction();
+    unfused_steps++;
+  }
+
+  EXPECT_LT(fused_steps, unfused_steps);
+  ASSERT_EQ(1u, fused_seen.size());
+  EXPECT_EQ(make_pair(26, 2), fused_seen[0]);
+  EXPECT_EQ(unfused_seen, fused_seen);
+  EXPECT_EQ(unfused.line_number(), fused.line_number());
+
+  // Without line actions, line markers take a shortcut.
+  TestSystem plain_system;
+  RLMachine plain(plain_system, expressions);
+  plain.ExecuteUntilHalted();
+  EXPECT_EQ(unfused.line_number(), plain.line_number());
+  EXPECT_EQ(unfused.GetIntValue(IntMemRef('A', 1)),
+            plain.GetIntValue(IntMemRef('A', 1)));
+
+  for (char bank : std::string("ABCDEF")) {
+    for (int i = 0; i < 20; ++i) {
+      EXPECT_EQ(unfused.GetIntValue(IntMemRef(bank, i)),
+                fused.GetIntValue(IntMemRef(bank, i)));
+    }
+  }
+  for (int kidoku = 0; kidoku < 20; ++kidoku) {
+    EXPECT_EQ(unfused.memory().HasBeenRead(scene, kidoku),
+              fused.memory().HasBeenRead(scene, kidoku));
+  }
+}
+
+// ExecuteBatch() runs until the script halts, a LongOperation is pushed, the
+// system asks to redraw or the budget is spent, and reports which.
+TEST_F(RLMachineTest, ExecuteBatchReportsWhyItStopped) {
+  libreallive::Archive expressions(
+      locateTestCase("ExpressionTest_SEEN/basicOperators.TXT"));
+
+  // The test clock ticks once per read, so a budget of one tick runs out at
+  // the first clock check.
+  RLMachine budgeted(system, expressions);
+  budgeted.set_fuse_instructions(false);
+  EXPECT_EQ(RLMachine::BATCH_BUDGET_SPENT, budgeted.ExecuteBatch(1));
+  EXPECT_FALSE(budgeted.halted());
+  EXPECT_EQ(RLMachine::BATCH_HALTED, budgeted.ExecuteBatch(1000000));
+  EXPECT_TRUE(budgeted.halted());
+
+  TestSystem waiting_system;
+  RLMachine waiting(waiting_system, expressions);
+  waiting.set_fuse_instructions(false);
+  waiting_system.set_force_wait(true);
+  EXPECT_EQ(RLMachine::BATCH_FORCE_WAIT, waiting.ExecuteBatch(1000000));
+  EXPECT_FALSE(waiting.halted());
+
+  TestSystem paused_system;
+  RLMachine paused(paused_system, expressions);
+  paused.PushLongOperation(new PauseLongOperation(paused));
+  EXPECT_EQ(RLMachine::BATCH_LONG_OPERATION, paused.ExecuteBatch(1000000));
+}
+
+// Overwriting a string slot moves its original into the savepoint log, which
+// must still work when the slot is assigned to itself.
+TEST_F(RLMachineTest, StringSlotOriginalSurvivesOverwrite) {
+  Memory& memory = rlmachine.memory();
+  const std::string original = "a string longer than the inline buffer";
+  memory.SetStringValue(STRS_LOCATION, 4, original);
+  memory.SetStringValue(STRS_LOCATION, 5, original);
+  rlmachine.MarkSavepoint();
+
+  memory.SetStringValue(STRS_LOCATION, 4,
+                        memory.GetStringValue(STRS_LOCATION, 4));
+  memory.SetStringValue(STRS_LOCATION, 5, "changed");
+  EXPECT_EQ(original, memory.GetStringValue(STRS_LOCATION, 4));
+  EXPECT_EQ("changed", memory.GetStringValue(STRS_LOCATION, 5));
+
+  int id = rlmachine.quick_saves().Save(rlmachine);
+  memory.SetStringValue(STRS_LOCATION, 4, "later");
+  ASSERT_TRUE(rlmachine.quick_saves().Load(rlmachine, id));
+  EXPECT_EQ(original, memory.GetStringValue(STRS_LOCATION, 4));
+  EXPECT_EQ(original, memory.GetStringValue(STRS_LOCATION, 5));
+}
+
+// Once every slot is used, each quick save overwrites the oldest.
+TEST_F(RLMachineTest, QuickSaveRingOverwritesOldest) {
+  rlmachine.SetQuickSaveSlots(2);
+  QuickSaveRing& ring = rlmachine.quick_saves();
+  EXPECT_EQ(2, ring.capacity());
+  EXPECT_EQ(-1, ring.latest());
+
+  rlmachine.MarkSavepoint();
+  int first = ring.Save(rlmachine);
+  int second = ring.Save(rlmachine);
+  int third = ring.Save(rlmachine);
+  EXPECT_EQ(2, ring.size());
+  EXPECT_FALSE(ring.Contains(first));
+  EXPECT_TRUE(ring.Contains(second));
+  EXPECT_TRUE(ring.Contains(third));
+
+  EXPECT_FALSE(ring.Load(rlmachine, first));
+  EXPECT_TRUE(ring.Load(rlmachine, third));
+}
+
+// The parameters of every command in a scenario are parsed in the background,
+// so dispatching them doesn't parse anything.
+TEST(ParameterPreparserTest, PreparsesCommandParameters) {
+  TestSystem system;
+  libreallive::Archive arc(locateTestCase("Module_Str_SEEN/strcpy_0.TXT"));
+  RLMachine rlmachine(system, arc);
+  rlmachine.AttachModule(new StrModule);
+  rlmachine.EnableParameterPreparsing();
+
+  ParameterPreparser* preparser = rlmachine.parameter_preparser();
+  ASSERT_TRUE(preparser);
+  preparser->WaitUntilIdle();
+  preparser->InstallFinished();
+  EXPECT_EQ(1, preparser->stats().scenarios);
+  EXPECT_EQ(1, preparser->stats().commands);
+  EXPECT_TRUE(preparser->errors().empty());
+
+  libreallive::Scenario* scenario = arc.GetScenario(arc.begin()->first);
+  for (const libreallive::BytecodeElement* element : *scenario) {
+    auto command = dynamic_cast<const libreallive::CommandElement*>(element);
+    if (command) {
+      EXPECT_TRUE(command->AreParametersParsed());
+    }
+  }
+
+  rlmachine.ExecuteUntilHalted();
+  EXPECT_EQ("valid", rlmachine.GetStringValue(STRS_LOCATION, 0));
+}
+
+namespace {
+
+struct IntIntOp : public RLOpcode<IntConstant_T, IntConstant_T> {
+  void operator()(RLMachine& machine, int one, int two) {}
+};
+
+// Claims strcpy with a signature that doesn't match the bytecode.
+class MismatchedStrModule : public RLModule {
+ public:
+  MismatchedStrModule() : RLModule("Str", 1, 10) {
+    AddOpcode(0, 0, "strcpy", new IntIntOp);
+  }
+};
+
+}  // namespace
+
+// Parameters that don't fit the operation's signature are reported when the
+// scenario is loaded instead of when the line is run.
+TEST(ParameterPreparserTest, ReportsTypeMismatches) {
+  TestSystem system;
+  libreallive::Archive arc(locateTestCase("Module_Str_SEEN/strcpy_0.TXT"));
+  RLMachine rlmachine(system, arc);
+  rlmachine.AttachModule(new MismatchedStrModule);
+  rlmachine.EnableParameterPreparsing();
+
+  ParameterPreparser* preparser = rlmachine.parameter_preparser();
+  preparser->WaitUntilIdle();
+  preparser->InstallFinished();
+  EXPECT_EQ(1, preparser->stats().scenarios);
+  EXPECT_EQ(0, preparser->stats().commands);
+  ASSERT_EQ(1u, preparser->errors().size());
+  EXPECT_NE(std::string::npos, preparser->errors()[0].find("strcpy"));
+}
@@ -194,6 +194,47 @@ TEST_F(RLOperationTest, TestIntStringConstant_T) {
 
 // -----------------------------------------------------------------------
 
+struct StrViewStrViewCapturer
+    : public RLOpcode<StrConstantView_T, StrConstantView_T> {
+  std::string& one_;
+  std::string& two_;
+  const char*& one_address_;
+
+  StrViewStrViewCapturer(std::string& one,
+                         std::string& two,
+                         const char*& one_address)
+      : one_(one), two_(two), one_address_(one_address) {}
+
+  virtual void operator()(RLMachine& machine,
+                          StringPiece in_one,
+                          StringPiece in_two) {
+    one_ = in_one.as_string();
+    two_ = in_two.as_string();
+    one_address_ = in_one.data();
+  }
+};
+
+// Tests that reading an out of range strK value while another strK value is
+// held by reference doesn't move the first one.
+TEST_F(RLOperationTest, TestStrConstantViewOfStrK) {
+  rlmachine.SetStringValue(STRK_LOCATION, 0, "a string longer than SSO");
+
+  std::string one = "empty";
+  std::string two = "empty";
+  const char* one_address = NULL;
+  StrViewStrViewCapturer capturer(one, two, one_address);
+
+  vector<string> unparsed = {"$ 0A [ $ FF 00 00 00 00 ]",
+                             "$ 0A [ $ FF 05 00 00 00 ]"};
+  runDataTest(capturer, rlmachine, unparsed);
+
+  EXPECT_EQ("a string longer than SSO", one);
+  EXPECT_EQ("", two);
+  EXPECT_EQ(rlmachine.CurrentStrKBank()[0].data(), one_address);
+}
+
+// -----------------------------------------------------------------------
+
 // Tests that we can parse an StrReference_T.
 struct StrRefStrRefCapturer
     : public RLOpcode<StrReference_T, StrReference_T> {
@@ -0,0 +1,90 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+// -----------------------------------------------------------------------
+
+// Performance benchmarks. These are written as gtest cases so they share the
+// unit tests' fixtures and test data, but they live in their own binary
+// because they're slow and only print numbers; they don't assert anything
+// about timing. Run with --gtest_filter to pick individual benchmarks.
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+#include <gtest/gtest.h>
+
+#include "benchmark_utils.h"
+
+namespace {
+
+std::atomic<size_t> g_allocation_count(0);
+std::atomic<size_t> g_allocation_bytes(0);
+std::atomic<size_t> g_live_bytes(0);
+
+// Every block is prefixed with its size so that frees can be subtracted from
+// |g_live_bytes|. Sixteen bytes keeps the returned pointer max-aligned.
+const size_t kHeaderSize = 16;
+
+void* CountedAllocate(size_t size) {
+  char* block = static_cast<char*>(std::malloc(size + kHeaderSize));
+  if (!block)
+    throw std::bad_alloc();
+
+  *reinterpret_cast<size_t*>(block) = size;
+  g_allocation_count++;
+  g_allocation_bytes += size;
+  g_live_bytes += size;
+  return block + kHeaderSize;
+}
+
+void CountedFree(void* ptr) {
+  if (!ptr)
+    return;
+
+  char* block = static_cast<char*>(ptr) - kHeaderSize;
+  g_live_bytes -= *reinterpret_cast<size_t*>(block);
+  std::free(block);
+}
+
+}  // namespace
+
+// Count every heap allocation so benchmarks can report allocation pressure.
+void* operator new(size_t size) { return CountedAllocate(size); }
+void* operator new[](size_t size) { return CountedAllocate(size); }
+void operator delete(void* ptr) noexcept { CountedFree(ptr); }
+void operator delete[](void* ptr) noexcept { CountedFree(ptr); }
+
+AllocationCounts GetAllocationCounts() {
+  AllocationCounts out = {g_allocation_count, g_allocation_bytes,
+                          g_live_bytes};
+  return out;
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
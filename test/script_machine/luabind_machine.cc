@@ -35,5 +35,8 @@ using namespace luabind;
 scope register_machine() {
   return class_<ScriptMachine>("Machine")
       .def("getInt", &ScriptMachine::GetInt)
-      .def("sceneNumber", &RLMachine::SceneNumber);
+      .def("sceneNumber", &RLMachine::SceneNumber)
+      .def("quickSave", &ScriptMachine::QuickSave)
+      .def("quickLoad", &ScriptMachine::QuickLoad)
+      .def("setQuickSaveSlots", &RLMachine::SetQuickSaveSlots);
 }
@@ -35,7 +35,9 @@
 
 #include "libreallive/intmemref.h"
 #include "long_operations/button_object_select_long_operation.h"
+#include "long_operations/quick_load_long_operation.h"
 #include "long_operations/select_long_operation.h"
+#include "machine/quick_save_ring.h"
 #include "machine/serialization.h"
 #include "script_machine/script_world.h"
 
@@ -144,3 +146,13 @@ int ScriptMachine::GetInt(const std::string& bank, int position) {
 
   return GetIntValue(IntMemRef(bchar, position));
 }
+
+int ScriptMachine::QuickSave() { return quick_saves().Save(*this); }
+
+bool ScriptMachine::QuickLoad(int id) {
+  if (!quick_saves().Contains(id))
+    return false;
+
+  PushLongOperation(new QuickLoadLongOperation(id));
+  return true;
+}
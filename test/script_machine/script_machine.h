@@ -54,6 +54,13 @@ class ScriptMachine : public RLMachine {
   // Memory accessor. (Maybe just translate this in luabind_Machine?)
   int GetInt(const std::string& bank, int position);
 
+  // Saves to the in-memory QuickSaveRing, returning the id to load.
+  int QuickSave();
+
+  // Loads quick save |id| once the current instruction finishes. Returns false
+  // if it has already been overwritten.
+  bool QuickLoad(int id);
+
   // Overloaded from RLMachine:
   virtual void PushLongOperation(LongOperation* long_operation) override;
 
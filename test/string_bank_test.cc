@@ -0,0 +1,125 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// -----------------------------------------------------------------------
+
+
+#include "gtest/gtest.h"
+
+#include <string>
+
+#include "machine/string_bank.h"
+
+TEST(StringBankTest, StartsEmpty) {
+  StringBank bank(4);
+  for (int i = 0; i < bank.size(); ++i) {
+    EXPECT_TRUE(bank.Get(i).empty());
+    EXPECT_EQ('\0', *bank.Get(i).c_str());
+  }
+}
+
+TEST(StringBankTest, HoldsShortAndLongValues) {
+  const std::string long_value(1000, 'x');
+  const std::string huge_value(200000, 'y');
+
+  StringBank bank(3);
+  bank.Set(0, "short");
+  bank.Set(1, long_value);
+  bank.Set(2, huge_value);
+
+  EXPECT_EQ("short", bank.Get(0));
+  EXPECT_EQ(long_value, bank.Get(1));
+  EXPECT_EQ(huge_value, bank.Get(2));
+  EXPECT_EQ('\0', bank.Get(1).c_str()[long_value.size()]);
+
+  // Shrinking back into the slot frees the block.
+  bank.Set(1, "tiny");
+  EXPECT_EQ("tiny", bank.Get(1));
+}
+
+TEST(StringBankTest, ReusesFreedBlocks) {
+  const std::string first(100, 'a');
+  const std::string second(100, 'b');
+
+  StringBank bank(2);
+  bank.Set(0, first);
+  const char* block = bank.Get(0).data();
+
+  bank.Set(0, "");
+  bank.Set(1, second);
+  EXPECT_EQ(block, bank.Get(1).data());
+  EXPECT_EQ(second, bank.Get(1));
+}
+
+TEST(StringBankTest, SetFromItself) {
+  const std::string long_value(100, 'z');
+
+  StringBank bank(2);
+  bank.Set(0, "inline");
+  bank.Set(0, bank.Get(0));
+  EXPECT_EQ("inline", bank.Get(0));
+
+  bank.Set(1, long_value);
+  bank.Set(1, bank.Get(1));
+  EXPECT_EQ(long_value, bank.Get(1));
+}
+
+TEST(StringBankTest, InternedValuesAreShared) {
+  StringPiece constant =
+      InternString("a bytecode constant longer than a slot's buffer");
+  EXPECT_TRUE(constant.interned());
+  EXPECT_EQ(constant.data(),
+            InternString("a bytecode constant longer than a slot's buffer")
+                .data());
+
+  StringBank bank(2);
+  bank.Set(0, constant);
+  EXPECT_EQ(constant.data(), bank.Get(0).data());
+  EXPECT_TRUE(bank.Get(0).interned());
+
+  // Copying the slot keeps pointing at the constant.
+  bank.Set(1, bank.Get(0));
+  EXPECT_EQ(constant.data(), bank.Get(1).data());
+}
+
+TEST(StringBankTest, CopiesAreIndependent) {
+  const std::string long_value(100, 'q');
+
+  StringBank bank(2);
+  bank.Set(0, "short");
+  bank.Set(1, long_value);
+
+  StringBank copy(bank);
+  bank.Set(0, "changed");
+  bank.Set(1, "changed");
+  EXPECT_EQ("short", copy.Get(0));
+  EXPECT_EQ(long_value, copy.Get(1));
+
+  copy = bank;
+  EXPECT_EQ("changed", copy.Get(1));
+
+  bank.Clear();
+  EXPECT_TRUE(bank.Get(1).empty());
+  EXPECT_EQ("changed", copy.Get(1));
+}
@@ -47,6 +47,7 @@ class MockSurface : public Surface {
   // Size related stuff.
   void Allocate(const Size& size);
   void Deallocate();
+  bool allocated() const { return allocated_; }
   virtual Size GetSize() const override;
 
   MOCK_CONST_METHOD5(
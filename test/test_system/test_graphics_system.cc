@@ -34,6 +34,7 @@
 #include "systems/base/colour.h"
 #include "systems/base/graphics_object.h"
 #include "systems/base/graphics_system.h"
+#include "systems/base/image_decoder.h"
 #include "test_system/mock_colour_filter.h"
 #include "test_system/mock_surface.h"
 #include "utilities/exception.h"
@@ -99,6 +100,10 @@ void TestGraphicsSystem::FreeDC(int dc) {
   }
 }
 
+bool TestGraphicsSystem::IsDCAllocated(int dc) {
+  return display_contexts_[dc]->allocated();
+}
+
 void TestGraphicsSystem::InjectSurface(
     const std::string& short_filename,
     const std::shared_ptr<Surface>& surface) {
@@ -135,6 +140,12 @@ std::shared_ptr<Surface> TestGraphicsSystem::BuildSurface(const Size& s) {
   return std::shared_ptr<Surface>(MockSurface::Create(oss.str(), s));
 }
 
+std::shared_ptr<Surface> TestGraphicsSystem::BuildSurfaceFromImage(
+    const DecodedImage& image) {
+  return std::shared_ptr<Surface>(
+      MockSurface::Create("Decoded image", image.size));
+}
+
 ColourFilter* TestGraphicsSystem::BuildColourFiller() {
   return new MockColourFilter;
 }
@@ -50,6 +50,7 @@ class TestGraphicsSystem : public GraphicsSystem {
   virtual void AllocateDC(int dc, Size s) override;
   virtual void SetMinimumSizeForDC(int, Size) override;
   virtual void FreeDC(int dc) override;
+  virtual bool IsDCAllocated(int dc) override;
 
   // Make a null Surface object?
   virtual std::shared_ptr<const Surface> LoadSurfaceFromFile(
@@ -57,6 +58,8 @@ class TestGraphicsSystem : public GraphicsSystem {
   virtual std::shared_ptr<Surface> GetHaikei() override;
   virtual std::shared_ptr<Surface> GetDC(int dc) override;
   virtual std::shared_ptr<Surface> BuildSurface(const Size& s) override;
+  virtual std::shared_ptr<Surface> BuildSurfaceFromImage(
+      const DecodedImage& image) override;
   virtual ColourFilter* BuildColourFiller() override;
 
   virtual void BeginFrame() override;
@@ -49,7 +49,8 @@ void TestMachine::AttachModule(RLModule* module) {
     unsigned char overload = 0;
     RLModule::UnpackOpcodeNumber(it->first, opcode, overload);
 
-    RLOperation* op = it->second.get();
+    RegisteredOperation op = {it->second.get(), module->module_type(),
+                              module->module_number(), opcode};
     registry_.emplace(make_pair(it->second->name(), overload), op);
   }
 
@@ -86,23 +87,22 @@ void TestMachine::RunOpcode(const std::string& name,
                             unsigned char overload,
                             int argc,
                             const std::string& argument_string) {
+  OpcodeRegistry::const_iterator it = registry_.find(make_pair(name, overload));
+  if (it == registry_.end())
+    throw rlvm::Exception("Illegal opcode TestMachine::runOpcode");
+  const RegisteredOperation& op = it->second;
+
   string repr;
   repr.resize(8, 0);
   repr[0] = '#';
-  repr[1] = 0;             // type
-  repr[2] = 0;             // module
-  insert_i16(repr, 3, 0);  // opcode
+  repr[1] = op.module_type;
+  repr[2] = op.module_number;
+  insert_i16(repr, 3, op.opcode);
   insert_i16(repr, 5, argc);
   repr[7] = overload;
 
   string full = repr + '(' + argument_string + ')';
   std::unique_ptr<libreallive::CommandElement> element(
       libreallive::BuildFunctionElement(full.c_str()));
-
-  RLOperation* op = registry_[make_pair(name, overload)];
-  if (op) {
-    op->DispatchFunction(*this, *element.get());
-  } else {
-    throw rlvm::Exception("Illegal opcode TestMachine::runOpcode");
-  }
+  op.op->DispatchFunction(*this, *element.get());
 }
@@ -229,7 +229,16 @@ class TestMachine : public RLMachine {
                  int argc,
                  const std::string& argument_string);
 
-  typedef std::map<std::pair<std::string, unsigned char>, RLOperation*>
+  // An attached operation and its place in the opcode space, so the commands
+  // we build serialize to something that can be replayed.
+  struct RegisteredOperation {
+    RLOperation* op;
+    int module_type;
+    int module_number;
+    int opcode;
+  };
+
+  typedef std::map<std::pair<std::string, unsigned char>, RegisteredOperation>
       OpcodeRegistry;
   OpcodeRegistry registry_;
 };
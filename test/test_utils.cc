@@ -27,7 +27,10 @@
 
 #include "test_utils.h"
 #include <vector>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/filesystem/fstream.hpp>
 #include <boost/filesystem/operations.hpp>
+#include <algorithm>
 #include <stdexcept>
 #include <sstream>
 #include <string>
@@ -57,6 +60,36 @@ string locateTestCase(const string& baseName) {
 }
 
 // -----------------------------------------------------------------------
+vector<string> locateAllTestSEENs() {
+  vector<string> seens;
+  for (vector<string>::const_iterator it = testPaths.begin();
+       it != testPaths.end();
+       ++it) {
+    if (!fs::is_directory(*it))
+      continue;
+
+    fs::directory_iterator end;
+    for (fs::directory_iterator dir(*it); dir != end; ++dir) {
+      if (!fs::is_directory(dir->path()) ||
+          !boost::ends_with(dir->path().filename().string(), "_SEEN"))
+        continue;
+
+      for (fs::directory_iterator file(dir->path()); file != end; ++file) {
+        if (boost::iends_with(file->path().filename().string(), ".TXT"))
+          seens.push_back(file->path().string());
+      }
+    }
+
+    if (!seens.empty())
+      break;
+  }
+
+  if (seens.empty())
+    throw std::runtime_error("Could not locate any test SEEN files.");
+
+  std::sort(seens.begin(), seens.end());
+  return seens;
+}
 
 FullSystemTest::FullSystemTest()
     : arc(locateTestCase("Module_Str_SEEN/strcpy_0.TXT")),
@@ -64,3 +97,168 @@ FullSystemTest::FullSystemTest()
       rlmachine(system, arc) {}
 
 FullSystemTest::~FullSystemTest() {}
+
+// -----------------------------------------------------------------------
+
+static void PutLittleEndian(string& data, int value, int bytes) {
+  for (int i = 0; i < bytes; ++i)
+    data.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+}
+
+void WriteType0G00(const string& path,
+                   int width,
+                   int height,
+                   const vector<int>& pixels) {
+  // Each flag byte describes the next eight items, low bit first: a set bit
+  // is a literal 3 byte pixel and a clear bit is a 16 bit back reference
+  // whose top 12 bits are a distance and bottom 4 bits a length, in pixels.
+  string stream;
+  size_t flag_pos = 0;
+  int items_in_flag = 8;
+  for (size_t i = 0; i < pixels.size();) {
+    if (items_in_flag == 8) {
+      flag_pos = stream.size();
+      stream.push_back(0);
+      items_in_flag = 0;
+    }
+
+    size_t run = 0;
+    while (i > 0 && i + run < pixels.size() && run < 16 &&
+           pixels[i + run] == pixels[i - 1]) {
+      ++run;
+    }
+
+    if (run) {
+      PutLittleEndian(stream, (1 << 4) | (run - 1), 2);
+      i += run;
+    } else {
+      stream[flag_pos] |= 1 << items_in_flag;
+      PutLittleEndian(stream, pixels[i], 3);
+      ++i;
+    }
+    ++items_in_flag;
+  }
+
+  string data(1, 0);
+  PutLittleEndian(data, width, 2);
+  PutLittleEndian(data, height, 2);
+  PutLittleEndian(data, 8 + stream.size(), 4);
+  PutLittleEndian(data, width * height * 3, 4);
+  data += stream;
+
+  fs::ofstream file(path, std::ios::binary);
+  file.write(data.data(), data.size());
+}
+
+// Compresses |raw| with the byte oriented LZ that type 1 and 2 G00s use.
+// Flags work as in WriteType0G00(), but a literal is one byte and a back
+// reference's distance and length (less two) are in bytes. Runs that repeat
+// the four bytes before them become back references.
+static string CompressG00Bytes(const string& raw) {
+  string stream;
+  size_t flag_pos = 0;
+  int items_in_flag = 8;
+  for (size_t i = 0; i < raw.size();) {
+    if (items_in_flag == 8) {
+      flag_pos = stream.size();
+      stream.push_back(0);
+      items_in_flag = 0;
+    }
+
+    size_t run = 0;
+    while (i >= 4 && i + run < raw.size() && run < 17 &&
+           raw[i + run] == raw[i + run - 4]) {
+      ++run;
+    }
+
+    if (run >= 2) {
+      PutLittleEndian(stream, (4 << 4) | (run - 2), 2);
+      i += run;
+    } else {
+      stream[flag_pos] |= 1 << items_in_flag;
+      stream.push_back(raw[i]);
+      ++i;
+    }
+    ++items_in_flag;
+  }
+  return stream;
+}
+
+void WriteType1G00(const string& path,
+                   int width,
+                   int height,
+                   const vector<int>& palette,
+                   const vector<unsigned char>& indices) {
+  string raw;
+  PutLittleEndian(raw, palette.size(), 2);
+  for (int colour : palette)
+    PutLittleEndian(raw, colour, 4);
+  raw.append(indices.begin(), indices.end());
+  string stream = CompressG00Bytes(raw);
+
+  string data(1, 1);
+  PutLittleEndian(data, width, 2);
+  PutLittleEndian(data, height, 2);
+  PutLittleEndian(data, 8 + stream.size(), 4);
+  PutLittleEndian(data, raw.size(), 4);
+  data += stream;
+
+  fs::ofstream file(path, std::ios::binary);
+  file.write(data.data(), data.size());
+}
+
+void WriteType2G00(const string& path,
+                   int width,
+                   int height,
+                   const vector<G00Region>& regions) {
+  // The decompressed data starts with an (offset, length) pair for each
+  // region's block. A block is a 0x74 byte header followed by its parts,
+  // each of which is a 0x5c byte header followed by its pixels.
+  string raw;
+  PutLittleEndian(raw, regions.size(), 4);
+  string blocks;
+  size_t blocks_start = 4 + regions.size() * 8;
+  for (const G00Region& region : regions) {
+    string block;
+    if (!region.parts.empty()) {
+      block.resize(0x74);
+      for (const G00Part& part : region.parts) {
+        string header;
+        PutLittleEndian(header, part.x, 2);
+        PutLittleEndian(header, part.y, 2);
+        PutLittleEndian(header, 0, 2);
+        PutLittleEndian(header, part.width, 2);
+        PutLittleEndian(header, part.height, 2);
+        header.resize(0x5c);
+        block += header;
+        for (int pixel : part.pixels)
+          PutLittleEndian(block, pixel, 4);
+      }
+    }
+
+    PutLittleEndian(raw, blocks_start + blocks.size(), 4);
+    PutLittleEndian(raw, block.size(), 4);
+    blocks += block;
+  }
+  raw += blocks;
+  string stream = CompressG00Bytes(raw);
+
+  string data(1, 2);
+  PutLittleEndian(data, width, 2);
+  PutLittleEndian(data, height, 2);
+  PutLittleEndian(data, regions.size(), 4);
+  for (const G00Region& region : regions) {
+    PutLittleEndian(data, region.x1, 4);
+    PutLittleEndian(data, region.y1, 4);
+    PutLittleEndian(data, region.x2, 4);
+    PutLittleEndian(data, region.y2, 4);
+    PutLittleEndian(data, 0, 4);
+    PutLittleEndian(data, 0, 4);
+  }
+  PutLittleEndian(data, 8 + stream.size(), 4);
+  PutLittleEndian(data, raw.size(), 4);
+  data += stream;
+
+  fs::ofstream file(path, std::ios::binary);
+  file.write(data.data(), data.size());
+}
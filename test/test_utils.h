@@ -29,6 +29,7 @@
 #define TEST_TESTUTILS_HPP_
 
 #include <string>
+#include <vector>
 
 #include "gtest/gtest.h"
 #include "libreallive/archive.h"
@@ -38,6 +39,49 @@
 // Locates a test file in the test/ directory.
 std::string locateTestCase(const std::string& baseName);
 
+// Returns the paths of every compiled SEEN file in the *_SEEN test
+// directories.
+std::vector<std::string> locateAllTestSEENs();
+
+// Writes a type 0 (LZ compressed RGB) G00 image to |path|. |pixels| holds
+// width * height 0xRRGGBB values in row order; runs of a repeated pixel are
+// compressed, everything else is stored as literals.
+void WriteType0G00(const std::string& path,
+                   int width,
+                   int height,
+                   const std::vector<int>& pixels);
+
+// Writes a type 1 (LZ compressed, paletted) G00 image to |path|. |palette|
+// holds up to 256 0xAARRGGBB colours and |indices| holds width * height
+// entries into it.
+void WriteType1G00(const std::string& path,
+                   int width,
+                   int height,
+                   const std::vector<int>& palette,
+                   const std::vector<unsigned char>& indices);
+
+// A rectangle of 0xAARRGGBB pixels in a type 2 G00, positioned relative to
+// the top left of its region.
+struct G00Part {
+  int x, y, width, height;
+  std::vector<int> pixels;
+};
+
+// A type 2 G00 region and the parts stored for it. The coordinates are
+// inclusive, as in the file.
+struct G00Region {
+  int x1, y1, x2, y2;
+  std::vector<G00Part> parts;
+};
+
+// Writes a type 2 (LZ compressed RGBA, split into regions) G00 image to
+// |path|. Runs of a repeated pixel are compressed, everything else is stored
+// as literals.
+void WriteType2G00(const std::string& path,
+                   int width,
+                   int height,
+                   const std::vector<G00Region>& regions);
+
 // A base class for all tests that instantiate an archive, a System and a
 // Machine.
 class FullSystemTest : public ::testing::Test {
@@ -26,9 +26,13 @@
 
 #include "gtest/gtest.h"
 
+#include <vector>
+
 #include "libreallive/gameexe.h"
 #include "systems/base/rect.h"
+#include "utilities/finished_queue.h"
 #include "utilities/graphics.h"
+#include "utilities/worker_pool.h"
 
 TEST(UtilitiesTest, ClipDestination_Superset) {
   Rect clip(Point(5, 5), Size(5, 5));
@@ -64,3 +68,18 @@ TEST(UtilitiesTest, ScreenSizeModKey) {
   me.parseLine("#SCREENSIZE_MOD=999,800,600");
   EXPECT_EQ(Size(800, 600), GetScreenSize(me));
 }
+
+TEST(UtilitiesTest, FinishedQueueHandsBackResultsInOrder) {
+  WorkerPool pool(1);
+  FinishedQueue<int> queue;
+  EXPECT_TRUE(queue.TakeFinished().empty());
+
+  for (int i = 0; i < 3; ++i)
+    queue.Post(pool, [i] { return i * 10; });
+  EXPECT_EQ(3, queue.pending());
+
+  pool.WaitUntilIdle();
+  EXPECT_EQ(std::vector<int>({0, 10, 20}), queue.TakeFinished());
+  EXPECT_EQ(0, queue.pending());
+  EXPECT_TRUE(queue.TakeFinished().empty());
+}